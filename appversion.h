@@ -0,0 +1,3 @@
+#define APPVERSION 2154
+#define APPHASH "5d00ea2-modified"
+#define APPDATE 1792383229
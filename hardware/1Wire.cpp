@@ -133,114 +133,210 @@ bool IsTemperatureValid(_e1WireFamilyType deviceFamily, float temperature)
 
 void C1Wire::SensorThread()
 {
-	int pollIterations = 1, pollPeriod, afterIterations=0,i;
-
 	BuildSensorList();
 	m_bSensorFirstTime = true;
 
 	if (m_sensors.size() == 0) return;  // quit if no sensors
 
-	pollPeriod=m_sensorThreadPeriod/m_sensors.size();
-
-	if (pollPeriod > 1000)
-	{
-		pollIterations = pollPeriod / 1000;
-		pollPeriod = 1000;
-		afterIterations = (m_sensorThreadPeriod/1000) - (pollIterations*m_sensors.size());
-	}
-
 	// initial small delay
 	sleep_milliseconds(1000);
 
 	while (!m_stoprequested)
 	{
+		struct timeval tvStart;
+		getclock(&tvStart);
+
 		if (m_sensors.size() > 2)
 		{
 			m_system->StartSimultaneousTemperatureRead(); // this can take upto 1sec
 		}
 
-		// Parse our devices
-		std::set<_t1WireDevice>::const_iterator itt;
-		for (itt=m_sensors.begin(); itt!=m_sensors.end() && !m_stoprequested; ++itt)
+		// Read all sensors right after the conversion, then report them
+		ReadSensors();
+		std::vector<_t1WireSensorReading>::const_iterator itt;
+		for (itt = m_readings.begin(); itt != m_readings.end() && !m_stoprequested; ++itt)
+		{
+			ReportSensor(*itt);
+		}
+		m_bSensorFirstTime = false;
+
+		// Wait for the next cycle
+		while (!m_stoprequested)
+		{
+			struct timeval tvNow, tvDiff;
+			getclock(&tvNow);
+			timeval_subtract(&tvDiff, &tvNow, &tvStart);
+			long elapsed = (tvDiff.tv_sec * 1000) + (tvDiff.tv_usec / 1000);
+			if (elapsed >= m_sensorThreadPeriod)
+				break;
+			sleep_milliseconds(std::min(1000L, m_sensorThreadPeriod - elapsed));
+		}
+	}
+
+	_log.Log(LOG_STATUS, "1-Wire: Sensor thread terminating");
+}
+
+// Reads all sensors, several at the same time when the system allows it (multiple buses, OWFS)
+void C1Wire::ReadSensors()
+{
+	m_readings.clear();
+	std::set<_t1WireDevice>::const_iterator itt;
+	for (itt = m_sensors.begin(); itt != m_sensors.end(); ++itt)
+	{
+		_t1WireSensorReading reading;
+		reading.device = *itt;
+		m_readings.push_back(reading);
+	}
+	m_nextReading = 0;
+
+	size_t nReaders = std::min((size_t)m_system->GetMaxConcurrentReads(), m_readings.size());
+	if (nReaders < 2)
+	{
+		ReadSensorsWorker();
+		return;
+	}
+	boost::thread_group readers;
+	for (size_t ii = 0; ii < nReaders; ii++)
+		readers.create_thread(boost::bind(&C1Wire::ReadSensorsWorker, this));
+	readers.join_all();
+}
+
+void C1Wire::ReadSensorsWorker()
+{
+	while (!m_stoprequested)
+	{
+		_t1WireSensorReading *pReading;
+		{
+			boost::lock_guard<boost::mutex> l(m_readMutex);
+			if (m_nextReading >= m_readings.size())
+				return;
+			pReading = &m_readings[m_nextReading++];
+		}
+		ReadSensor(*pReading);
+	}
+}
+
+void C1Wire::ReadSensor(_t1WireSensorReading &reading)
+{
+	const _t1WireDevice& device = reading.device;
+
+	// Manage families specificities
+	switch(device.family)
+	{
+		case high_precision_digital_thermometer:
+		case Thermachron:
+		case Econo_Digital_Thermometer:
+		case Temperature_memory:
+		case programmable_resolution_digital_thermometer:
+		case Temperature_IO:
 		{
-			const _t1WireDevice& device=*itt;
+			reading.temperature = m_system->GetTemperature(device);
+			break;
+		}
 
-			// Manage families specificities
-			switch(device.family)
+		case Environmental_Monitors:
+		{
+			reading.temperature = m_system->GetTemperature(device);
+			if (IsTemperatureValid(device.family, reading.temperature))
 			{
-				case high_precision_digital_thermometer:
-				case Thermachron:
-				case Econo_Digital_Thermometer:
-				case Temperature_memory:
-				case programmable_resolution_digital_thermometer:
-				case Temperature_IO:
-				{
-					float temperature=m_system->GetTemperature(device);
-					if (IsTemperatureValid(device.family, temperature))
-					{
-						ReportTemperature(device.devid, temperature);
-					}
-					break;
-				}
-
-				case Environmental_Monitors:
-				{
-					float temperature = m_system->GetTemperature(device);
-					if (IsTemperatureValid(device.family, temperature))
-					{
-						ReportTemperatureHumidity(device.devid, temperature, m_system->GetHumidity(device));
-					}
-					ReportPressure(device.devid,m_system->GetPressure(device));
-					break;
-				}
-
-				case _4k_ram_with_counter:
-				{
-					ReportCounter(device.devid,0,m_system->GetCounter(device,0));
-					ReportCounter(device.devid,1,m_system->GetCounter(device,1));
-					break;
-				}
-
-				case quad_ad_converter:
-				{
-					ReportVoltage(device.devid, 0, m_system->GetVoltage(device, 0));
-					ReportVoltage(device.devid, 1, m_system->GetVoltage(device, 1));
-					ReportVoltage(device.devid, 2, m_system->GetVoltage(device, 2));
-					ReportVoltage(device.devid, 3, m_system->GetVoltage(device, 3));
-					break;
-				}
-
-				case smart_battery_monitor:
-				{
-					float temperature = m_system->GetTemperature(device);
-					if (IsTemperatureValid(device.family, temperature))
-					{
-						ReportTemperature(device.devid, temperature);
-					}
-					ReportHumidity(device.devid,m_system->GetHumidity(device));
-					ReportVoltage(device.devid, 0, m_system->GetVoltage(device, 0));   // VAD
-					ReportVoltage(device.devid, 1, m_system->GetVoltage(device, 1));   // VDD
-					ReportVoltage(device.devid, 2, m_system->GetVoltage(device, 2));   // vis
-					ReportPressure(device.devid,m_system->GetPressure(device));
-					// Commonly used as Illuminance sensor, see http://www.hobby-boards.com/store/products/Solar-Radiation-Detector.html
-					ReportIlluminance(device.devid, m_system->GetIlluminance(device));
-					break;
-				}
-				default: // not a supported sensor
-					break;
+				reading.humidity = m_system->GetHumidity(device);
 			}
+			reading.pressure = m_system->GetPressure(device);
+			break;
+		}
+
+		case _4k_ram_with_counter:
+		{
+			reading.counter[0] = m_system->GetCounter(device, 0);
+			reading.counter[1] = m_system->GetCounter(device, 1);
+			break;
+		}
 
-			if (!m_stoprequested && !m_bSensorFirstTime)
-				for (i=0;i<pollIterations;i++)
-					sleep_milliseconds(pollPeriod);
+		case quad_ad_converter:
+		{
+			for (int unit = 0; unit < 4; unit++)
+				reading.voltage[unit] = m_system->GetVoltage(device, unit);
+			break;
 		}
-		m_bSensorFirstTime = false;
-		if (!m_stoprequested)
-			for (i=0;i<afterIterations;i++)
-				sleep_milliseconds(pollPeriod);
+
+		case smart_battery_monitor:
+		{
+			reading.temperature = m_system->GetTemperature(device);
+			reading.humidity = m_system->GetHumidity(device);
+			reading.voltage[0] = m_system->GetVoltage(device, 0);   // VAD
+			reading.voltage[1] = m_system->GetVoltage(device, 1);   // VDD
+			reading.voltage[2] = m_system->GetVoltage(device, 2);   // vis
+			reading.pressure = m_system->GetPressure(device);
+			// Commonly used as Illuminance sensor, see http://www.hobby-boards.com/store/products/Solar-Radiation-Detector.html
+			reading.illuminance = m_system->GetIlluminance(device);
+			break;
+		}
+		default: // not a supported sensor
+			break;
 	}
+}
 
-	_log.Log(LOG_STATUS, "1-Wire: Sensor thread terminating");
+void C1Wire::ReportSensor(const _t1WireSensorReading &reading)
+{
+	const _t1WireDevice& device = reading.device;
+
+	switch(device.family)
+	{
+		case high_precision_digital_thermometer:
+		case Thermachron:
+		case Econo_Digital_Thermometer:
+		case Temperature_memory:
+		case programmable_resolution_digital_thermometer:
+		case Temperature_IO:
+		{
+			if (IsTemperatureValid(device.family, reading.temperature))
+			{
+				ReportTemperature(device.devid, reading.temperature);
+			}
+			break;
+		}
+
+		case Environmental_Monitors:
+		{
+			if (IsTemperatureValid(device.family, reading.temperature))
+			{
+				ReportTemperatureHumidity(device.devid, reading.temperature, reading.humidity);
+			}
+			ReportPressure(device.devid, reading.pressure);
+			break;
+		}
+
+		case _4k_ram_with_counter:
+		{
+			ReportCounter(device.devid, 0, reading.counter[0]);
+			ReportCounter(device.devid, 1, reading.counter[1]);
+			break;
+		}
+
+		case quad_ad_converter:
+		{
+			for (int unit = 0; unit < 4; unit++)
+				ReportVoltage(device.devid, unit, reading.voltage[unit]);
+			break;
+		}
+
+		case smart_battery_monitor:
+		{
+			if (IsTemperatureValid(device.family, reading.temperature))
+			{
+				ReportTemperature(device.devid, reading.temperature);
+			}
+			ReportHumidity(device.devid, reading.humidity);
+			ReportVoltage(device.devid, 0, reading.voltage[0]);
+			ReportVoltage(device.devid, 1, reading.voltage[1]);
+			ReportVoltage(device.devid, 2, reading.voltage[2]);
+			ReportPressure(device.devid, reading.pressure);
+			ReportIlluminance(device.devid, reading.illuminance);
+			break;
+		}
+		default: // not a supported sensor
+			break;
+	}
 }
 
 void C1Wire::SwitchThread()
@@ -516,7 +612,7 @@ void C1Wire::ReportCounter(const std::string& deviceId, const int unit, const un
 	unsigned char deviceIdByteArray[DEVICE_ID_SIZE]={0};
 	DeviceIdToByteArray(deviceId,deviceIdByteArray);
 
-	SendMeterSensor(deviceIdByteArray[0], deviceIdByteArray[1]+unit, 255, (const float)counter/1000.0f, "Counter");
+	SendMeterSensor(deviceIdByteArray[0], deviceIdByteArray[1]+unit, 255, (float)counter/1000.0f, "Counter");
 }
 
 void C1Wire::ReportVoltage(const std::string& deviceId, const int unit, const int voltage)
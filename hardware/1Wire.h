@@ -16,6 +16,29 @@ public:
 	bool WriteToHardware(const char *pdata, const unsigned char length);
 
 private:
+	struct _t1WireSensorReading
+	{
+		_t1WireDevice device;
+		float temperature;
+		float humidity;
+		float pressure;
+		float illuminance;
+		unsigned long counter[2];
+		int voltage[4];
+
+		//-1000 is 'not read', the Report functions skip those values
+		_t1WireSensorReading() :
+			temperature(-1000.0f),
+			humidity(-1000.0f),
+			pressure(-1000.0f),
+			illuminance(-1000.0f)
+		{
+			counter[0] = counter[1] = 0;
+			for (int ii = 0; ii < 4; ii++)
+				voltage[ii] = -1000;
+		}
+	};
+
 	volatile bool m_stoprequested;
 	boost::shared_ptr<boost::thread> m_threadSensors;
 	boost::shared_ptr<boost::thread> m_threadSwitches;
@@ -30,10 +53,19 @@ private:
 	bool m_bSensorFirstTime;
 	bool m_bSwitchFirstTime;
 
+	// Shared by the sensor readers of one cycle
+	boost::mutex m_readMutex;
+	std::vector<_t1WireSensorReading> m_readings;
+	size_t m_nextReading;
+
 	void DetectSystem();
 	bool StartHardware();
 	bool StopHardware();
 	void SensorThread();
+	void ReadSensors();
+	void ReadSensorsWorker();
+	void ReadSensor(_t1WireSensorReading &reading);
+	void ReportSensor(const _t1WireSensorReading &reading);
 	void SwitchThread();
 	void BuildSensorList();
 	void BuildSwitchList();
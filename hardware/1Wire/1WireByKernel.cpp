@@ -9,6 +9,12 @@
 #include "1WireByKernel.h"
 
 #include <fstream>
+#include <algorithm>
+#ifdef WIN32
+#include "../../main/dirent_windows.h"
+#else
+#include <dirent.h>
+#endif
 #include "../../main/Logger.h"
 #include "../../main/Helper.h"
 #include "../../main/mainworker.h"
@@ -24,8 +30,11 @@
 #endif //_DEBUG
 
 
-C1WireByKernel::C1WireByKernel()
+C1WireByKernel::C1WireByKernel(const std::string& baseDir) :
+   m_BaseDir(baseDir)
 {
+   if (m_BaseDir.empty())
+      m_BaseDir=Wire1_Base_Dir;
    m_Thread = new boost::thread(&C1WireByKernel::ThreadFunction,this);
    _log.Log(LOG_STATUS,"Using 1-Wire support (kernel W1 module)...");
 }
@@ -37,11 +46,11 @@ C1WireByKernel::~C1WireByKernel()
    delete m_Thread;
 }
 
-bool C1WireByKernel::IsAvailable()
+bool C1WireByKernel::IsAvailable(const std::string& baseDir)
 {
    //Check if system have the w1-gpio interface
    std::ifstream infile1wire;
-   std::string wire1catfile=Wire1_Base_Dir;
+   std::string wire1catfile=(baseDir.empty())?Wire1_Base_Dir:baseDir;
    wire1catfile+="/w1_bus_master1/w1_master_slaves";
    infile1wire.open(wire1catfile.c_str());
    if (infile1wire.is_open())
@@ -72,72 +81,165 @@ void C1WireByKernel::ThreadFunction()
       // Thread is stopped
    }
    m_PendingChanges.clear();
+   m_Buses.clear();
    for (DeviceCollection::iterator it=m_Devices.begin();it!=m_Devices.end();++it) {delete (*it).second;}
    m_Devices.clear();
 }
 
 void C1WireByKernel::ReadStates()
 {
-	for (DeviceCollection::const_iterator it = m_Devices.begin(); it != m_Devices.end(); ++it)
+	// Not while PrepareDevices rebuilds the lists
+	boost::lock_guard<boost::mutex> listLock(m_DeviceListMutex);
+
+	// Priority to changes asked by Domoticz
+	ThreadProcessPendingChanges();
+
+	// Let all thermometers convert at the same time, the reads below return without waiting
+	StartBulkConversion();
+
+	if (m_Buses.size() < 2)
 	{
-		// Next read one device state
-		try
+		for (BusCollection::const_iterator it = m_Buses.begin(); it != m_Buses.end(); ++it)
+			ReadBusStates(&(*it).second);
+		return;
+	}
+
+	// The kernel locks per bus master, so the buses can be read in parallel
+	boost::thread_group readers;
+	for (BusCollection::const_iterator it = m_Buses.begin(); it != m_Buses.end(); ++it)
+		readers.create_thread(boost::bind(&C1WireByKernel::ReadBusStates, this, &(*it).second));
+	try
+	{
+		readers.join_all();
+	}
+	catch (boost::thread_interrupted&)
+	{
+		// Do not free the devices while the readers still use them
+		readers.join_all();
+		throw;
+	}
+}
+
+void C1WireByKernel::ReadBusStates(const std::vector<DeviceState*>* devices)
+{
+	for (std::vector<DeviceState*>::const_iterator it = devices->begin(); it != devices->end(); ++it)
+	{
+		// Priority to changes asked by Domoticz
+		ThreadProcessPendingChanges();
+		ReadDeviceState(*it);
+	}
+}
+
+// Kernels with bulk read support in w1_therm (5.10+) convert all thermometers of a bus with one command
+bool C1WireByKernel::StartBulkConversion()
+{
+	std::vector<std::string> pending;
+	for (BusCollection::const_iterator it = m_Buses.begin(); it != m_Buses.end(); ++it)
+	{
+		bool bHaveThermometer = false;
+		for (std::vector<DeviceState*>::const_iterator itDev = (*it).second.begin(); itDev != (*it).second.end() && !bHaveThermometer; ++itDev)
 		{
-			// Priority to changes asked by Domoticz
-			ThreadProcessPendingChanges();
+			_e1WireFamilyType family = (*itDev)->GetDevice().family;
+			bHaveThermometer = ((family == high_precision_digital_thermometer) || (family == programmable_resolution_digital_thermometer));
+		}
+		if (!bHaveThermometer)
+			continue;
+
+		std::string fileName = m_BaseDir + "/" + (*it).first + "/therm_bulk_read";
+		std::ifstream infile(fileName.c_str());
+		if (!infile.is_open())
+			continue; // not supported by this kernel
+		infile.close();
+		std::ofstream outfile(fileName.c_str());
+		if (!outfile.is_open())
+			continue;
+		outfile << "trigger\n";
+		outfile.close();
+		pending.push_back(fileName);
+	}
+	if (pending.empty())
+		return false;
 
-			DeviceState* device = (*it).second;
-			switch (device->GetDevice().family)
-			{
-			case high_precision_digital_thermometer:
-			case programmable_resolution_digital_thermometer:
+	// Reads -1 while a conversion is still running, wait for it (at most 1 second)
+	for (int iWait = 0; (iWait < 20) && (!pending.empty()); iWait++)
+	{
+		sleep_milliseconds(50);
+		std::vector<std::string>::iterator it = pending.begin();
+		while (it != pending.end())
+		{
+			std::ifstream file((*it).c_str());
+			std::string sLine;
+			if (file.is_open())
+				getline(file, sLine);
+			if (sLine == "-1")
+				++it;
+			else
+				it = pending.erase(it);
+		}
+	}
+	return true;
+}
+
+void C1WireByKernel::ReadDeviceState(DeviceState* device)
+{
+	try
+	{
+		switch (device->GetDevice().family)
+		{
+		case high_precision_digital_thermometer:
+		case programmable_resolution_digital_thermometer:
+		{
+			// Reading can take up to 750ms, do not keep the devices locked
+			float temperature = ThreadReadRawDataHighPrecisionDigitalThermometer(device->GetDevice().filename);
+			Locker l(m_Mutex);
+			device->m_Temperature = temperature;
+			break;
+		}
+		case dual_channel_addressable_switch:
+		{
+			unsigned char answer = ThreadReadRawDataDualChannelAddressableSwitch(device->GetDevice().filename);
+			// Don't update if change is pending
+			Locker l(m_Mutex);
+			if (!GetDevicePendingState(device->GetDevice().devid))
 			{
-				Locker l(m_Mutex);
-				device->m_Temperature = ThreadReadRawDataHighPrecisionDigitalThermometer(device->GetDevice().filename);
-				break;
+				// Caution : 0 means 'transistor active', we have to invert
+				device->m_DigitalIo[0] = (answer & 0x01) ? false : true;
+				device->m_DigitalIo[1] = (answer & 0x04) ? false : true;
 			}
-			case dual_channel_addressable_switch:
+			break;
+		}
+		case _8_channel_addressable_switch:
+		{
+			unsigned char answer = ThreadReadRawData8ChannelAddressableSwitch(device->GetDevice().filename);
+			// Don't update if change is pending
+			Locker l(m_Mutex);
+			if (!GetDevicePendingState(device->GetDevice().devid))
 			{
-				unsigned char answer = ThreadReadRawDataDualChannelAddressableSwitch(device->GetDevice().filename);
-				// Don't update if change is pending
-				Locker l(m_Mutex);
-				if (!GetDevicePendingState(device->GetDevice().devid))
+				for (unsigned int idxBit = 0, mask = 0x01; mask != 0x100; mask <<= 1)
 				{
 					// Caution : 0 means 'transistor active', we have to invert
-					device->m_DigitalIo[0] = (answer & 0x01) ? false : true;
-					device->m_DigitalIo[1] = (answer & 0x04) ? false : true;
-				}
-				break;
-			}
-			case _8_channel_addressable_switch:
-			{
-				unsigned char answer = ThreadReadRawData8ChannelAddressableSwitch(device->GetDevice().filename);
-				// Don't update if change is pending
-				Locker l(m_Mutex);
-				if (!GetDevicePendingState(device->GetDevice().devid))
-				{
-					for (unsigned int idxBit = 0, mask = 0x01; mask != 0x100; mask <<= 1)
-					{
-						// Caution : 0 means 'transistor active', we have to invert
-						device->m_DigitalIo[idxBit++] = (answer&mask) ? false : true;
-					}
+					device->m_DigitalIo[idxBit++] = (answer&mask) ? false : true;
 				}
-				break;
-			}
-			default: // Device not supported in kernel mode (maybe later...), use OWFS solution.
-				break;
 			}
+			break;
 		}
-		catch (const OneWireReadErrorException& e)
-		{
-			_log.Log(LOG_ERROR, e.what());
+		default: // Device not supported in kernel mode (maybe later...), use OWFS solution.
+			break;
 		}
 	}
-
+	catch (const OneWireReadErrorException& e)
+	{
+		_log.Log(LOG_ERROR, e.what());
+	}
 }
 
 void C1WireByKernel::ThreadProcessPendingChanges()
 {
+   // Called by all bus readers, one of them handles the queue
+   boost::mutex::scoped_try_lock writeLock(m_PendingWriteMutex);
+   if (!writeLock.owns_lock())
+      return;
+
    while (!m_PendingChanges.empty())
    {
       bool success=false;
@@ -185,14 +287,41 @@ void C1WireByKernel::ThreadProcessPendingChanges()
 
 void C1WireByKernel::ThreadBuildDevicesList()
 {
-	std::string catfile=Wire1_Base_Dir;
-	catfile+="/w1_bus_master1/w1_master_slaves";
+   // The thread reads the devices, GetDevices and the Get functions look them up
+   boost::lock_guard<boost::mutex> listLock(m_DeviceListMutex);
+   {
+      Locker l(m_Mutex);
+      m_Buses.clear();
+      for (DeviceCollection::iterator it=m_Devices.begin();it!=m_Devices.end();++it) {delete (*it).second;}
+      m_Devices.clear();
+   }
+
+   // One w1_bus_masterN directory per bus
+   std::vector<std::string> busMasters;
+   DIR *d=opendir(m_BaseDir.c_str());
+   if (d != NULL)
+   {
+      struct dirent *de=NULL;
+      while ((de=readdir(d)))
+      {
+         std::string dirname=de->d_name;
+         if (dirname.find("w1_bus_master")==0)
+            busMasters.push_back(dirname);
+      }
+      closedir(d);
+   }
+   std::sort(busMasters.begin(),busMasters.end());
+
+   for (std::vector<std::string>::const_iterator itBus=busMasters.begin();itBus!=busMasters.end();++itBus)
+      ThreadAddBusDevices(*itBus);
+}
+
+void C1WireByKernel::ThreadAddBusDevices(const std::string& busMaster)
+{
+	std::string catfile=m_BaseDir + "/" + busMaster + "/w1_master_slaves";
 	std::ifstream infile;
    std::string sLine;
 
-   for (DeviceCollection::iterator it=m_Devices.begin();it!=m_Devices.end();++it) {delete (*it).second;}
-   m_Devices.clear();
-
    infile.open(catfile.c_str());
 	if (!infile.is_open())
       return;
@@ -213,8 +342,11 @@ void C1WireByKernel::ThreadBuildDevicesList()
 			case dual_channel_addressable_switch:
 			case _8_channel_addressable_switch:
 			case programmable_resolution_digital_thermometer:
+            if (m_Devices.find(device.devid)!=m_Devices.end())
+               break;
             m_Devices[device.devid]=new DeviceState(device);
-			_log.Log(LOG_STATUS,"1Wire: Added Device: %s",sLine.c_str());
+            m_Buses[busMaster].push_back(m_Devices[device.devid]);
+			_log.Log(LOG_STATUS,"1Wire: Added Device: %s (%s)",sLine.c_str(),busMaster.c_str());
             break;
          default: // Device not supported in kernel mode (maybe later...), use OWFS solution.
 			_log.Log(LOG_ERROR,"1Wire: Device not yet supported in Kernel mode (Please report!) ID:%s, family: %02X",sLine.c_str(),device.family);
@@ -522,7 +654,7 @@ void C1WireByKernel::GetDevice(const std::string& deviceName, /*out*/_t1WireDevi
    std_to_upper(deviceName.substr(3,3+6*2),device.devid);
 
    // Filename (full path)
-   device.filename=Wire1_Base_Dir;
+   device.filename=m_BaseDir;
    device.filename+="/" + deviceName;
 }
 
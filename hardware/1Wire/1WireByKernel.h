@@ -4,7 +4,8 @@
 class C1WireByKernel : public I_1WireSystem
 {
 public:
-   C1WireByKernel();
+   // baseDir can point to a copy of the sysfs tree, empty means the kernel one
+   explicit C1WireByKernel(const std::string& baseDir = "");
    virtual ~C1WireByKernel();
 
    // I_1WireSystem implementation
@@ -23,19 +24,24 @@ public:
    virtual void PrepareDevices();
    // END : I_1WireSystem implementation
 
-   static bool IsAvailable();
+   // baseDir as for the constructor
+   static bool IsAvailable(const std::string& baseDir = "");
 
 protected:
    void GetDevice(const std::string& deviceName, /*out*/_t1WireDevice& device) const;
 
    bool sendAndReceiveByRwFile(std::string path,const unsigned char * const cmd,size_t cmdSize,unsigned char * const answer,size_t answerSize) const;
    void ReadStates();
+   bool StartBulkConversion();
+
+   std::string m_BaseDir;
 
    // Thread management
    boost::thread* m_Thread;
    void ThreadFunction();
    void ThreadProcessPendingChanges();
    void ThreadBuildDevicesList();
+   void ThreadAddBusDevices(const std::string& busMaster);
    float ThreadReadRawDataHighPrecisionDigitalThermometer(const std::string& deviceFileName) const;
    unsigned char ThreadReadRawDataDualChannelAddressableSwitch(const std::string& deviceFileName) const;
    unsigned char ThreadReadRawData8ChannelAddressableSwitch(const std::string& deviceFileName) const;
@@ -48,7 +54,13 @@ protected:
    class DeviceState
    {
    public:
-	   explicit DeviceState(const _t1WireDevice device) : m_Device(device) {}
+	   explicit DeviceState(const _t1WireDevice device) : m_Unit(0), m_Device(device)
+      {
+         // Not read yet, -1000 is not reported
+         memset(m_DigitalIo, 0, sizeof(m_DigitalIo));
+         if ((device.family == high_precision_digital_thermometer) || (device.family == programmable_resolution_digital_thermometer))
+            m_Temperature = -1000.0f;
+      }
       _t1WireDevice GetDevice() const {return m_Device;}
       union
       {
@@ -70,11 +82,19 @@ protected:
    };
    typedef std::map<std::string,DeviceState*> DeviceCollection;
    DeviceCollection m_Devices;
+   // Devices per bus master (not owned), the buses are read in parallel
+   typedef std::map<std::string,std::vector<DeviceState*> > BusCollection;
+   BusCollection m_Buses;
+   // Held while the lists above are rebuilt or the devices are read
+   boost::mutex m_DeviceListMutex;
+   void ReadBusStates(const std::vector<DeviceState*>* devices);
+   void ReadDeviceState(DeviceState* device);
 
    // Pending changes queue
    std::list<DeviceState> m_PendingChanges;
    const DeviceState* GetDevicePendingState(const std::string& deviceId) const;
    boost::mutex m_PendingChangesMutex;
+   boost::mutex m_PendingWriteMutex;
    boost::condition_variable m_PendingChangesCondition;
    class IsPendingChanges
    {
@@ -14,7 +14,8 @@
 #include "../../main/Helper.h"
 
 C1WireByOWFS::C1WireByOWFS(const std::string& path):
-	m_path(path)
+	m_path(path),
+	m_bSimultaneousTemperatureRead(false)
 {
 	if (m_path.empty())
 		m_path = "/mnt/1wire";
@@ -194,7 +195,12 @@ void C1WireByOWFS::SetLightState(const std::string& sId,int unit,bool value, con
 
 float C1WireByOWFS::GetTemperature(const _t1WireDevice& device) const
 {
-   std::string readValue=readRawData(std::string(device.filename+"/temperature"));
+   std::string readValue;
+   // After a simultaneous conversion, reading "temperature" would start a new conversion
+   if (m_bSimultaneousTemperatureRead)
+      readValue=readRawData(std::string(device.filename+"/latesttemp"));
+   if (readValue.empty())
+      readValue=readRawData(std::string(device.filename+"/temperature"));
 
    if (m_mainworker.GetVerboseLevel() == EVBL_DEBUG)
    {
@@ -371,12 +377,14 @@ void C1WireByOWFS::StartSimultaneousTemperatureRead()
 	{
 		_log.Log(LOG_STATUS, "1Wire (OWFS): Initiating simultaneous temperature read");
 	}
+	m_bSimultaneousTemperatureRead = false;
 	std::ofstream file;
 	file.open(m_simultaneousTemperaturePath.c_str());
 	if (file.is_open())
 	{
 		file << "1";
 		file.close();
+		m_bSimultaneousTemperatureRead = true;
 		if (m_mainworker.GetVerboseLevel() == EVBL_DEBUG)
 		{
 			_log.Log(LOG_STATUS, "1Wire (OWFS): Simultaneous temperature read successful");
@@ -389,6 +397,12 @@ void C1WireByOWFS::PrepareDevices()
 {
 }
 
+unsigned int C1WireByOWFS::GetMaxConcurrentReads() const
+{
+	// owserver serializes the requests per bus, the other buses and hubs are read meanwhile
+	return 4;
+}
+
 bool C1WireByOWFS::IsValidDir(const struct dirent*const de)
 {
     // Check dirent type
@@ -13,6 +13,7 @@ class C1WireByOWFS : public I_1WireSystem
 private:
 	std::string m_path; // OWFS mountpoint
 	std::string m_simultaneousTemperaturePath; // OWFS mountpoint + "/simultaneous/temperature"
+	bool m_bSimultaneousTemperatureRead; // converted values can be read from "latesttemp"
 
 public:
    explicit C1WireByOWFS(const std::string& path);
@@ -32,6 +33,7 @@ public:
    int GetWiper(const _t1WireDevice& device) const;
    virtual void StartSimultaneousTemperatureRead();
    virtual void PrepareDevices();
+   virtual unsigned int GetMaxConcurrentReads() const;
    // END : I_1WireSystem implementation
 
 protected:
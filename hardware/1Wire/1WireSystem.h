@@ -24,4 +24,6 @@ public:
    virtual int GetWiper(const _t1WireDevice& device) const = 0;
    virtual void StartSimultaneousTemperatureRead()=0;
    virtual void PrepareDevices() = 0;
+   // Number of sensors that can be read at the same time (different buses or OWFS paths)
+   virtual unsigned int GetMaxConcurrentReads() const { return 1; }
 };
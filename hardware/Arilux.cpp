@@ -14,6 +14,7 @@
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include "../notifications/NotificationHelper.h"
 
 
 
@@ -133,6 +134,7 @@ void Arilux::InsertUpdateSwitch(const std::string &nodeID, const std::string &li
 		ycmd.command = cmd;
 		m_mainworker.PushAndWaitRxMessage(this, (const unsigned char *)&ycmd, NULL, -1);
 		m_sql.safe_query("UPDATE DeviceStatus SET Name='%q', SwitchType=%d, LastLevel=%d WHERE(HardwareID == %d) AND (DeviceID == '%q')", lightName.c_str(), (STYPE_Dimmer), value, m_HwdID, szDeviceID);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szDeviceID);
 	}
 	else {
 
@@ -8,9 +8,86 @@
 #include "../main/SQLHelper.h"
 #include "../main/mainworker.h"
 #include "hardwaretypes.h"
+#include "../notifications/NotificationHelper.h"
 
 #define round(a) ( int ) ( a + .5 )
 
+//Pacing and repeat rules for the transmit thread, matched on the packet type/sub type of a frame (-1 = all sub types)
+//gap is the pause after each transmission, before the next frame is written to the same hardware
+typedef struct _tTxPacingRule
+{
+	unsigned char packettype;
+	int subtype;
+	int repeat;
+	long gap;
+} TxPacingRule;
+
+static const TxPacingRule TxPacingRules[] =
+{
+	{ pTypeLighting5, sTypeTRC02, 1, 100 },
+	{ pTypeLighting5, sTypeTRC02_2, 1, 100 },
+	{ pTypeLimitlessLights, -1, 1, 100 },
+	{ pTypeSecurity1, sTypeKD101, 2, 500 },	//send it twice
+	{ pTypeSecurity1, sTypeSA30, 2, 500 },
+	{ 0, 0, 0, 0 }
+};
+
+static const TxPacingRule *FindTxPacingRule(const std::string &frame)
+{
+	if (frame.size() < 3)
+		return NULL;
+	unsigned char packettype = (unsigned char)frame[1];
+	unsigned char subtype = (unsigned char)frame[2];
+	for (const TxPacingRule *pRule = TxPacingRules; pRule->packettype != 0; pRule++)
+	{
+		if ((pRule->packettype == packettype) && ((pRule->subtype == -1) || (pRule->subtype == subtype)))
+			return pRule;
+	}
+	return NULL;
+}
+
+CTxCompletion::CTxCompletion()
+{
+	m_bDone = false;
+	m_bResult = false;
+}
+
+void CTxCompletion::Set(const bool bResult)
+{
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	m_bResult = bResult;
+	m_bDone = true;
+	lock.unlock();
+	m_cond.notify_all();
+}
+
+bool CTxCompletion::IsDone()
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	return m_bDone;
+}
+
+bool CTxCompletion::Wait()
+{
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	while (!m_bDone)
+		m_cond.wait(lock);
+	return m_bResult;
+}
+
+bool CTxCompletion::TimedWait(const long milliseconds, bool &bResult)
+{
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	boost::system_time const timeout = boost::get_system_time() + boost::posix_time::milliseconds(milliseconds);
+	while (!m_bDone)
+	{
+		if (!m_cond.timed_wait(lock, timeout))
+			break;
+	}
+	bResult = m_bResult;
+	return m_bDone;
+}
+
 CDomoticzHardwareBase::CDomoticzHardwareBase()
 {
 	m_HwdID=0; //should be uniquely assigned
@@ -26,6 +103,8 @@ CDomoticzHardwareBase::CDomoticzHardwareBase()
 	m_bSkipReceiveCheck = false;
 	m_bOutputLog = true;
 	m_iHBCounter = 0;
+	m_iBatchDepth = 0;
+	m_stopTxRequested = false;
 
 	m_baro_minuteCount = 0;
 	m_last_forecast = wsbaroforcast_unknown;
@@ -34,16 +113,24 @@ CDomoticzHardwareBase::CDomoticzHardwareBase()
 
 CDomoticzHardwareBase::~CDomoticzHardwareBase()
 {
+	//the transmit thread calls WriteToHardware of the derived class, it has to be stopped (Stop or StopTxThread) before we get here
+	assert(!m_txThread);
 }
 
 bool CDomoticzHardwareBase::Start()
 {
 	m_iHBCounter = 0;
+	{
+		boost::lock_guard<boost::mutex> l(m_txMutex);
+		m_stopTxRequested = false;
+	}
 	return StartHardware();
 }
 
 bool CDomoticzHardwareBase::Stop()
 {
+	//some hardware takes the read queue mutex in WriteToHardware, so stop transmitting first
+	StopTxThread();
 	boost::lock_guard<boost::mutex> l(readQueueMutex);
 	return StopHardware();
 }
@@ -86,6 +173,186 @@ bool CDomoticzHardwareBase::onRFXMessage(const unsigned char *pBuffer, const siz
 	return true;
 }
 
+boost::shared_ptr<CTxCompletion> CDomoticzHardwareBase::QueueWrite(const char *pdata, const unsigned char length, const std::string &coalesceKey)
+{
+	std::vector<std::string> frames;
+	frames.push_back(std::string(pdata, length));
+	return QueueWrite(frames, coalesceKey);
+}
+
+boost::shared_ptr<CTxCompletion> CDomoticzHardwareBase::QueueWrite(const std::vector<std::string> &frames, const std::string &coalesceKey)
+{
+	boost::shared_ptr<CTxCompletion> completion(new CTxCompletion());
+	std::vector<std::string>::const_iterator ittFrame;
+	for (ittFrame = frames.begin(); ittFrame != frames.end(); ++ittFrame)
+	{
+		if (ittFrame->size() > 255)
+		{
+			_log.Log(LOG_ERROR, "%s: Frame of %d bytes is too long to be written, command not sent", Name.c_str(), (int)ittFrame->size());
+			completion->Set(false);
+			return completion;
+		}
+	}
+	boost::unique_lock<boost::mutex> lock(m_txMutex);
+	if (m_stopTxRequested)
+	{
+		//hardware is stopped, nothing will be sent until it is started again
+		completion->Set(false);
+		return completion;
+	}
+	if ((m_txThread) && (m_txThread->get_id() == boost::this_thread::get_id()))
+	{
+		//queued from a call on the transmit thread itself (scene), write it now to keep the order of the calls
+		lock.unlock();
+		completion->Set(WriteTxFrames(frames));
+		return completion;
+	}
+	if (!coalesceKey.empty())
+	{
+		std::deque<_tTxCommand>::iterator itt;
+		for (itt = m_txQueue.begin(); itt != m_txQueue.end(); ++itt)
+		{
+			if (itt->coalesceKey == coalesceKey)
+			{
+				//not sent yet, replace it by the latest command
+				itt->frames = frames;
+				itt->completions.push_back(completion);
+				return completion;
+			}
+		}
+	}
+	_tTxCommand tcmd;
+	tcmd.frames = frames;
+	tcmd.coalesceKey = coalesceKey;
+	tcmd.gap = 0;
+	tcmd.completions.push_back(completion);
+	PushTxCommand(tcmd);
+	return completion;
+}
+
+boost::shared_ptr<CTxCompletion> CDomoticzHardwareBase::QueueCall(const boost::function<bool()> &call, const long gap)
+{
+	boost::shared_ptr<CTxCompletion> completion(new CTxCompletion());
+	boost::lock_guard<boost::mutex> l(m_txMutex);
+	if (m_stopTxRequested)
+	{
+		completion->Set(false);
+		return completion;
+	}
+	_tTxCommand tcmd;
+	tcmd.call = call;
+	tcmd.gap = gap;
+	tcmd.completions.push_back(completion);
+	PushTxCommand(tcmd);
+	return completion;
+}
+
+//Add a command to the queue and start the transmit thread when needed, m_txMutex has to be locked
+void CDomoticzHardwareBase::PushTxCommand(const _tTxCommand &tcmd)
+{
+	m_txQueue.push_back(tcmd);
+	if (!m_txThread)
+	{
+		m_txThread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CDomoticzHardwareBase::Do_Tx_Work, this)));
+	}
+	m_txCondition.notify_one();
+}
+
+void CDomoticzHardwareBase::StopTxThread()
+{
+	boost::shared_ptr<boost::thread> txThread;
+	{
+		boost::lock_guard<boost::mutex> l(m_txMutex);
+		m_stopTxRequested = true;
+		txThread = m_txThread;
+		m_txCondition.notify_one();
+	}
+	if (txThread)
+	{
+		txThread->join();
+	}
+	boost::lock_guard<boost::mutex> l(m_txMutex);
+	m_txThread.reset();
+	//commands that were not sent anymore
+	std::deque<_tTxCommand>::iterator itt;
+	for (itt = m_txQueue.begin(); itt != m_txQueue.end(); ++itt)
+	{
+		std::vector<boost::shared_ptr<CTxCompletion> >::iterator ittCompletion;
+		for (ittCompletion = itt->completions.begin(); ittCompletion != itt->completions.end(); ++ittCompletion)
+			(*ittCompletion)->Set(false);
+	}
+	if (!m_txQueue.empty())
+		_log.Log(LOG_ERROR, "%s: %d queued command(s) not sent, hardware stopped", Name.c_str(), (int)m_txQueue.size());
+	m_txQueue.clear();
+}
+
+//Sleep between transmissions, returns false when the thread has to stop
+bool CDomoticzHardwareBase::TxSleep(const long milliseconds)
+{
+	boost::unique_lock<boost::mutex> lock(m_txMutex);
+	boost::system_time const timeout = boost::get_system_time() + boost::posix_time::milliseconds(milliseconds);
+	while (!m_stopTxRequested)
+	{
+		if (!m_txCondition.timed_wait(lock, timeout))
+			break;
+	}
+	return !m_stopTxRequested;
+}
+
+//Write the frames of one command with the pacing/repeat rules of their protocol
+bool CDomoticzHardwareBase::WriteTxFrames(const std::vector<std::string> &frames)
+{
+	std::vector<std::string>::const_iterator itt;
+	for (itt = frames.begin(); itt != frames.end(); ++itt)
+	{
+		const TxPacingRule *pRule = FindTxPacingRule(*itt);
+		int repeat = (pRule != NULL) ? pRule->repeat : 1;
+		for (int ii = 0; ii < repeat; ii++)
+		{
+			if (!WriteToHardware(itt->c_str(), static_cast<unsigned char>(itt->size())))
+			{
+				_log.Log(LOG_ERROR, "%s: Error writing queued command to hardware", Name.c_str());
+				return false;
+			}
+			if ((pRule != NULL) && (pRule->gap > 0))
+			{
+				if (!TxSleep(pRule->gap))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void CDomoticzHardwareBase::Do_Tx_Work()
+{
+	while (true)
+	{
+		_tTxCommand tcmd;
+		{
+			boost::unique_lock<boost::mutex> lock(m_txMutex);
+			while ((m_txQueue.empty()) && (!m_stopTxRequested))
+				m_txCondition.wait(lock);
+			if (m_stopTxRequested)
+				break;
+			tcmd = m_txQueue.front();
+			m_txQueue.pop_front();
+		}
+		bool bResult;
+		if (tcmd.call)
+		{
+			bResult = tcmd.call();
+			if ((tcmd.gap > 0) && (!TxSleep(tcmd.gap)))
+				bResult = false;
+		}
+		else
+			bResult = WriteTxFrames(tcmd.frames);
+		std::vector<boost::shared_ptr<CTxCompletion> >::iterator ittCompletion;
+		for (ittCompletion = tcmd.completions.begin(); ittCompletion != tcmd.completions.end(); ++ittCompletion)
+			(*ittCompletion)->Set(bResult);
+	}
+}
+
 void CDomoticzHardwareBase::StartHeartbeatThread()
 {
 	m_stopHeartbeatrequested = false;
@@ -129,6 +396,19 @@ void CDomoticzHardwareBase::SetHeartbeatReceived()
 	mytime(&m_LastHeartbeatReceive);
 }
 
+void CDomoticzHardwareBase::BeginBatch()
+{
+	m_iBatchDepth++;
+}
+
+void CDomoticzHardwareBase::EndBatch()
+{
+	if (m_iBatchDepth == 0)
+		return;
+	if (--m_iBatchDepth == 0)
+		m_mainworker.FlushRxBatch(m_HwdID);
+}
+
 void CDomoticzHardwareBase::HandleHBCounter(const int iInterval)
 {
 	m_iHBCounter++;
@@ -745,6 +1025,7 @@ void CDomoticzHardwareBase::SendCustomSensor(const int NodeID, const int ChildID
 		std::string soptions = "1;" + defaultLabel;
 		m_sql.safe_query("UPDATE DeviceStatus SET Options='%q' WHERE (HardwareID==%d) AND (DeviceID=='%q') AND (Type==%d) AND (Subtype==%d)",
 			soptions.c_str(), m_HwdID, szTmp, int(pTypeGeneral), int(sTypeCustom));
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szTmp);
 	}
 }
 
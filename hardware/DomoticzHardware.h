@@ -1,11 +1,29 @@
 #pragma once
 
 #include <boost/signals2.hpp>
+#include <boost/function.hpp>
+#include <deque>
 #include "../main/RFXNames.h"
 
 //Base class with functions all notification systems should have
 #define RX_BUFFER_SIZE 100
 
+//Completion of a queued transmit command, signalled by the transmit thread after the last frame is written
+class CTxCompletion
+{
+public:
+	CTxCompletion();
+	void Set(const bool bResult);
+	bool IsDone();
+	bool Wait();
+	bool TimedWait(const long milliseconds, bool &bResult);
+private:
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	bool m_bDone;
+	bool m_bResult;
+};
+
 class CDomoticzHardwareBase
 {
 	friend class MainWorker;
@@ -17,6 +35,14 @@ public:
 	bool Stop();
 	virtual bool WriteToHardware(const char *pdata, const unsigned char length)=0;
 
+	//Queue one command (one or more frames) for the transmit thread of this hardware, the caller does not wait.
+	//A pending command with the same coalesce key (device) is replaced, so only the last one is sent.
+	//The completion is already failed when the command is refused (hardware stopped, frame longer than 255 bytes)
+	boost::shared_ptr<CTxCompletion> QueueWrite(const std::vector<std::string> &frames, const std::string &coalesceKey = "");
+	boost::shared_ptr<CTxCompletion> QueueWrite(const char *pdata, const unsigned char length, const std::string &coalesceKey = "");
+	//Queue a call for the transmit thread, run in order with the other commands of this hardware, with a pause of gap milliseconds after it
+	boost::shared_ptr<CTxCompletion> QueueCall(const boost::function<bool()> &call, const long gap = 0);
+
 	void EnableOutputLog(const bool bEnableLog);
 
 	bool IsStarted() { return m_bIsStarted; }
@@ -43,6 +69,16 @@ protected:
 	virtual bool StopHardware()=0;
 	bool onRFXMessage(const unsigned char *pBuffer, const size_t Len);
 
+	//Group all readings sent between BeginBatch and EndBatch (e.g. a complete telegram)
+	//in one receive unit, one database transaction and one event system notification
+	void BeginBatch();
+	void EndBatch();
+	int m_iBatchDepth;
+
+	//Stops the transmit thread and fails the commands still queued, Stop() does this before StopHardware.
+	//A derived class that can be deleted without Stop() has to call it in its own destructor
+	void StopTxThread();
+
     //Heartbeat thread for classes that can not provide this themselves
 	void StartHeartbeatThread();
 	void StopHeartbeatThread();
@@ -103,6 +139,26 @@ protected:
 private:
     void Do_Heartbeat_Work();
 
+	//Outbound queue
+	struct _tTxCommand
+	{
+		std::vector<std::string> frames;
+		std::string coalesceKey;
+		boost::function<bool()> call;
+		long gap;
+		std::vector<boost::shared_ptr<CTxCompletion> > completions;
+	};
+	void PushTxCommand(const _tTxCommand &tcmd);
+	void Do_Tx_Work();
+	bool WriteTxFrames(const std::vector<std::string> &frames);
+	bool TxSleep(const long milliseconds);
+
+	std::deque<_tTxCommand> m_txQueue;
+	boost::mutex m_txMutex;
+	boost::condition_variable m_txCondition;
+	volatile bool m_stopTxRequested;
+	boost::shared_ptr<boost::thread> m_txThread;
+
     volatile bool m_stopHeartbeatrequested;
     boost::shared_ptr<boost::thread> m_Heartbeatthread;
 
@@ -11,6 +11,7 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <sstream>
+#include "../notifications/NotificationHelper.h"
 
 CDummy::CDummy(const int ID)
 {
@@ -273,6 +274,7 @@ namespace http {
 					{
 						//Set switch type to dimmer
 						m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (ID==%" PRIu64 ")", STYPE_Dimmer, DeviceRowIdx);
+						m_notifications.InvalidateDeviceInfo(DeviceRowIdx);
 					}
 					bCreated = true;
 				}
@@ -360,6 +362,7 @@ namespace http {
 					{
 						//Set switch type to selector
 						m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (ID==%" PRIu64 ")", STYPE_Selector, DeviceRowIdx);
+						m_notifications.InvalidateDeviceInfo(DeviceRowIdx);
 						//Set default device options
 						m_sql.SetDeviceOptions(DeviceRowIdx, m_sql.BuildDeviceOptions("SelectorStyle:0;LevelNames:Off|Level1|Level2|Level3", false));
 					}
@@ -376,6 +379,7 @@ namespace http {
 					{
 						//Set switch type to dimmer
 						m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (ID==%" PRIu64 ")", STYPE_Dimmer, DeviceRowIdx);
+						m_notifications.InvalidateDeviceInfo(DeviceRowIdx);
 					}
 					bCreated = true;
 				}
@@ -391,6 +395,7 @@ namespace http {
 					{
 						//Set the Label
 						m_sql.safe_query("UPDATE DeviceStatus SET Options='%q' WHERE (ID==%" PRIu64 ")", soptions.c_str(), DeviceRowIdx);
+						m_notifications.InvalidateDeviceInfo(DeviceRowIdx);
 					}
 					bCreated = true;
 				}
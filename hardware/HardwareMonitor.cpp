@@ -307,6 +307,7 @@ void CHardwareMonitor::GetInternalCurrent()
 
 void CHardwareMonitor::FetchData()
 {
+	BeginBatch();
 #ifdef WIN32
 	if (IsOHMRunning()) {
 		_log.Log(LOG_NORM,"Hardware Monitor: Fetching data (System sensors)");
@@ -314,7 +315,6 @@ void CHardwareMonitor::FetchData()
 		RunWMIQuery("Sensor","Load");
 		RunWMIQuery("Sensor","Fan");
 		RunWMIQuery("Sensor","Voltage");
-		return;
 	}
 #elif defined(__linux__) || defined(__CYGWIN32__) || defined(__FreeBSD__) || defined(__OpenBSD__)
 	if (bHasInternalTemperature)
@@ -326,6 +326,7 @@ void CHardwareMonitor::FetchData()
 	if (bHasInternalCurrent)
 		GetInternalCurrent();
 #endif
+	EndBatch();
 }
 
 void CHardwareMonitor::UpdateSystemSensor(const std::string& qType, const int dindex, const std::string& devName, const std::string& devValue)
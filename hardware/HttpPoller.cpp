@@ -74,6 +74,7 @@ bool CHttpPoller::StopHardware()
 		m_stoprequested = true;
 		m_thread->join();
 	}
+	m_pLuaHandler.reset();
     m_bIsStarted=false;
     return true;
 }
@@ -150,7 +151,8 @@ void CHttpPoller::GetScript()
 		}
 	}
 
-	// Got some data, send them to the lua parsers for processing
-	CLuaHandler luaScript(m_HwdID);
-	luaScript.executeLuaScript(m_script, sResult);
+	// Got some data, send them to the lua parser for processing
+	if (!m_pLuaHandler)
+		m_pLuaHandler = boost::shared_ptr<CLuaHandler>(new CLuaHandler(m_HwdID));
+	m_pLuaHandler->executeCachedLuaScript(m_script, sResult.c_str(), sResult.size());
 }
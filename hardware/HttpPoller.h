@@ -2,6 +2,8 @@
 
 #include "DomoticzHardware.h"
 
+class CLuaHandler;
+
 namespace Json
 {
 	class Value;
@@ -28,6 +30,7 @@ private:
 
 	volatile bool m_stoprequested;
 	boost::shared_ptr<boost::thread> m_thread;
+	boost::shared_ptr<CLuaHandler> m_pLuaHandler; //only used by the worker thread
 
 	void Init();
 	bool StartHardware();
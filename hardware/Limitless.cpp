@@ -8,6 +8,7 @@
 #include "../main/mainworker.h"
 #include "../main/WebServer.h"
 #include "../webserver/cWebem.h"
+#include "../notifications/NotificationHelper.h"
 
 #define round(a) ( int ) ( a + .5 )
 
@@ -198,6 +199,7 @@ bool CLimitLess::AddSwitchIfNotExits(const unsigned char Unit, const std::string
 			{
 				//Set type to dimmer
 				m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (ID==%q)", STYPE_Dimmer, result[0][0].c_str());
+				m_notifications.InvalidateDeviceInfo(result[0][0]);
 			}
 			return false;
 		}
@@ -215,6 +217,7 @@ bool CLimitLess::AddSwitchIfNotExits(const unsigned char Unit, const std::string
 			{
 				//Set type to dimmer
 				m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (ID==%q)", STYPE_Dimmer, result[0][0].c_str());
+				m_notifications.InvalidateDeviceInfo(result[0][0]);
 			}
 			return false;
 		}
@@ -6,6 +6,7 @@
 #include "../main/localtime_r.h"
 #include "../main/mainworker.h"
 #include "../main/SQLHelper.h"
+#include "../main/DeviceSnapshot.h"
 #include "../json/json.h"
 #include "../notifications/NotificationHelper.h"
 #define __STDC_FORMAT_MACROS
@@ -387,6 +388,7 @@ void MQTT::on_message(const struct mosquitto_message *message)
 	else if (szCommand == "getdeviceinfo")
 	{
 		int HardwareID = atoi(result[0][0].c_str());
+		m_devicesnapshots.Invalidate(idx);
 		SendDeviceInfo(HardwareID, idx, "request device", NULL);
 	}
 	else if (szCommand == "getsceneinfo")
@@ -555,60 +557,43 @@ void MQTT::SendDeviceInfo(const int m_HwdID, const uint64_t DeviceRowIdx, const
 	boost::lock_guard<boost::mutex> l(m_mqtt_mutex);
 	if (!m_IsConnected)
 		return;
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT DeviceID, Unit, Name, [Type], SubType, nValue, sValue, SwitchType, SignalLevel, BatteryLevel, Options, Description FROM DeviceStatus WHERE (HardwareID==%d) AND (ID==%" PRIu64 ")", m_HwdID, DeviceRowIdx);
-	if (result.size() > 0)
+	device_snapshot_ptr snapshot = m_devicesnapshots.Get(DeviceRowIdx);
+	if ((snapshot) && (snapshot->HardwareID == m_HwdID))
 	{
-		std::vector<std::string> sd = result[0];
-		std::string did = sd[0];
-		int dunit = atoi(sd[1].c_str());
-		std::string name = sd[2];
-		int dType = atoi(sd[3].c_str());
-		int dSubType = atoi(sd[4].c_str());
-		int nvalue = atoi(sd[5].c_str());
-		std::string svalue = sd[6];
-		_eSwitchType switchType = (_eSwitchType)atoi(sd[7].c_str());
-		int RSSI = atoi(sd[8].c_str());
-		int BatteryLevel = atoi(sd[9].c_str());
-		std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sd[10]);
-		std::string description = sd[11];
+		std::vector<std::vector<std::string> > result;
+		int dType = snapshot->Type;
 
 		Json::Value root;
 
 		root["idx"] = DeviceRowIdx;
-		root["id"] = did;
-		root["unit"] = dunit;
-		root["name"] = name;
-		root["dtype"] = RFX_Type_Desc(dType,1);
-		root["stype"] = RFX_Type_SubType_Desc(dType, dSubType);
+		root["id"] = snapshot->DeviceID;
+		root["unit"] = snapshot->Unit;
+		root["name"] = snapshot->Name;
+		root["dtype"] = snapshot->TypeDesc;
+		root["stype"] = snapshot->SubTypeDesc;
 
-		if (IsLightOrSwitch(dType, dSubType) == true) {
-			root["switchType"] = Switch_Type_Desc(switchType);
+		if (snapshot->bIsLightOrSwitch) {
+			root["switchType"] = snapshot->SwitchTypeDesc;
 		}
 		else if ((dType = pTypeRFXMeter) || (dType = pTypeRFXSensor)) {
-			root["meterType"] = Meter_Type_Desc((_eMeterType)switchType);
+			root["meterType"] = snapshot->MeterTypeDesc;
 		}
 		// Add device options
 		std::map<std::string, std::string>::const_iterator ittOptions;
-		for (ittOptions = options.begin(); ittOptions != options.end(); ++ittOptions)
+		for (ittOptions = snapshot->Options.begin(); ittOptions != snapshot->Options.end(); ++ittOptions)
 		{
-			std::string optionName = ittOptions->first.c_str();
-			std::string optionValue = ittOptions->second.c_str();
-			root[optionName] = optionValue;
+			root[ittOptions->first] = ittOptions->second;
 		}
 
-		root["RSSI"] = RSSI;
-		root["Battery"] = BatteryLevel;
-		root["nvalue"] = nvalue;
-		root["description"] = description;
+		root["RSSI"] = snapshot->SignalLevel;
+		root["Battery"] = snapshot->BatteryLevel;
+		root["nvalue"] = snapshot->nValue;
+		root["description"] = snapshot->Description;
 
 		//give all svalues separate
-		std::vector<std::string> strarray;
-		StringSplit(svalue, ";", strarray);
-
 		std::vector<std::string>::const_iterator itt;
 		int sIndex = 1;
-		for (itt = strarray.begin(); itt != strarray.end(); ++itt)
+		for (itt = snapshot->sValues.begin(); itt != snapshot->sValues.end(); ++itt)
 		{
 			std::stringstream szQuery;
 			szQuery << "svalue" << sIndex;
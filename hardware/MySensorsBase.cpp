@@ -244,6 +244,7 @@ m_GatewayVersion("?")
 	m_AckNodeID = -1;
 	m_AckChildID = -1;
 	m_AckSetType = V_UNKNOWN;
+	m_bRegistryDirty = false;
 }
 
 MySensorsBase::~MySensorsBase(void)
@@ -304,6 +305,97 @@ void MySensorsBase::LoadDevicesFromDatabase()
 			m_nodes[ID] = mNode;
 		}
 	}
+	LoadRegistryFromDatabase();
+}
+
+#define MYSENSORS_VAR_KEY(NodeID, ChildID, VarID) ((((unsigned int)(NodeID) & 0xFF) << 16) | (((unsigned int)(ChildID) & 0xFF) << 8) | ((unsigned int)(VarID) & 0xFF))
+#define MYSENSORS_CHILD_KEY(NodeID, ChildID) ((((unsigned int)(NodeID) & 0xFF) << 8) | ((unsigned int)(ChildID) & 0xFF))
+
+void MySensorsBase::LoadRegistryFromDatabase()
+{
+	boost::lock_guard<boost::mutex> l(m_registryMutex);
+	m_vars.clear();
+	m_childinfo.clear();
+	m_bRegistryDirty = false;
+
+	std::vector<std::vector<std::string> > result;
+	std::vector<std::vector<std::string> >::const_iterator itt;
+	result = m_sql.safe_query("SELECT NodeID, ChildID, VarID, [Value] FROM MySensorsVars WHERE (HardwareID=%d)", m_HwdID);
+	for (itt = result.begin(); itt != result.end(); ++itt)
+	{
+		_tMySensorVarEntry vEntry;
+		vEntry.Value = (*itt)[3];
+		vEntry.bInDatabase = true;
+		vEntry.bDirty = false;
+		m_vars[MYSENSORS_VAR_KEY(atoi((*itt)[0].c_str()), atoi((*itt)[1].c_str()), atoi((*itt)[2].c_str()))] = vEntry;
+	}
+	result = m_sql.safe_query("SELECT NodeID, ChildID, [Type], [Name], UseAck FROM MySensorsChilds WHERE (HardwareID=%d)", m_HwdID);
+	for (itt = result.begin(); itt != result.end(); ++itt)
+	{
+		_tMySensorChildEntry cEntry;
+		cEntry.pType = (_ePresentationType)atoi((*itt)[2].c_str());
+		cEntry.Name = (*itt)[3];
+		cEntry.UseAck = (atoi((*itt)[4].c_str()) != 0);
+		cEntry.bInDatabase = true;
+		cEntry.bDirty = false;
+		m_childinfo[MYSENSORS_CHILD_KEY(atoi((*itt)[0].c_str()), atoi((*itt)[1].c_str()))] = cEntry;
+	}
+}
+
+//Write all changed registry entries to the database in one transaction
+void MySensorsBase::FlushRegistry()
+{
+	//a node or child removed during the flush would otherwise be inserted again
+	boost::lock_guard<boost::mutex> lf(m_registryFlushMutex);
+	std::vector<std::pair<unsigned int, _tMySensorVarEntry> > vars;
+	std::vector<std::pair<unsigned int, _tMySensorChildEntry> > childs;
+	{
+		boost::lock_guard<boost::mutex> l(m_registryMutex);
+		if (!m_bRegistryDirty)
+			return;
+		std::map<unsigned int, _tMySensorVarEntry>::iterator itt;
+		for (itt = m_vars.begin(); itt != m_vars.end(); ++itt)
+		{
+			if (!itt->second.bDirty)
+				continue;
+			vars.push_back(*itt);
+			itt->second.bDirty = false;
+			itt->second.bInDatabase = true;
+		}
+		std::map<unsigned int, _tMySensorChildEntry>::iterator itt2;
+		for (itt2 = m_childinfo.begin(); itt2 != m_childinfo.end(); ++itt2)
+		{
+			if (!itt2->second.bDirty)
+				continue;
+			childs.push_back(*itt2);
+			itt2->second.bDirty = false;
+			itt2->second.bInDatabase = true;
+		}
+		m_bRegistryDirty = false;
+	}
+
+	CSQLScopedTransaction transaction(m_sql);
+	std::vector<std::pair<unsigned int, _tMySensorVarEntry> >::const_iterator ittVar;
+	for (ittVar = vars.begin(); ittVar != vars.end(); ++ittVar)
+	{
+		int NodeID = (ittVar->first >> 16) & 0xFF;
+		int ChildID = (ittVar->first >> 8) & 0xFF;
+		int VarID = ittVar->first & 0xFF;
+		if (ittVar->second.bInDatabase)
+			m_sql.safe_query("UPDATE MySensorsVars SET [Value]='%q' WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d) AND (VarID=%d)", ittVar->second.Value.c_str(), m_HwdID, NodeID, ChildID, VarID);
+		else
+			m_sql.safe_query("INSERT INTO MySensorsVars (HardwareID, NodeID, ChildID, VarID, [Value]) VALUES (%d, %d, %d, %d,'%q')", m_HwdID, NodeID, ChildID, VarID, ittVar->second.Value.c_str());
+	}
+	std::vector<std::pair<unsigned int, _tMySensorChildEntry> >::const_iterator ittChild;
+	for (ittChild = childs.begin(); ittChild != childs.end(); ++ittChild)
+	{
+		int NodeID = (ittChild->first >> 8) & 0xFF;
+		int ChildID = ittChild->first & 0xFF;
+		if (ittChild->second.bInDatabase)
+			m_sql.safe_query("UPDATE MySensorsChilds SET [Type]='%d', [Name]='%q' WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d)", ittChild->second.pType, ittChild->second.Name.c_str(), m_HwdID, NodeID, ChildID);
+		else
+			m_sql.safe_query("INSERT INTO MySensorsChilds (HardwareID, NodeID, ChildID, [Type], [Name], UseAck) VALUES (%d, %d, %d, %d, '%q', %d)", m_HwdID, NodeID, ChildID, ittChild->second.pType, ittChild->second.Name.c_str(), (ittChild->second.UseAck) ? 1 : 0);
+	}
 }
 
 void MySensorsBase::Add2Database(const int nodeID, const std::string &SketchName, const std::string &SketchVersion)
@@ -377,12 +469,22 @@ void MySensorsBase::UpdateNode(const int nodeID, const std::string &name)
 
 void MySensorsBase::RemoveNode(const int nodeID)
 {
+	boost::lock_guard<boost::mutex> lf(m_registryFlushMutex);
+	{
+		boost::lock_guard<boost::mutex> l(m_registryMutex);
+		m_childinfo.erase(m_childinfo.lower_bound(MYSENSORS_CHILD_KEY(nodeID, 0)), m_childinfo.upper_bound(MYSENSORS_CHILD_KEY(nodeID, 255)));
+	}
 	m_sql.safe_query("DELETE FROM MySensors WHERE (HardwareID==%d) AND (ID==%d)", m_HwdID, nodeID);
 	m_sql.safe_query("DELETE FROM MySensorsChilds WHERE (HardwareID==%d) AND (NodeID=='%d')",m_HwdID, nodeID);
 }
 
 void MySensorsBase::RemoveChild(const int nodeID, const int childID)
 {
+	boost::lock_guard<boost::mutex> lf(m_registryFlushMutex);
+	{
+		boost::lock_guard<boost::mutex> l(m_registryMutex);
+		m_childinfo.erase(MYSENSORS_CHILD_KEY(nodeID, childID));
+	}
 	m_sql.safe_query("DELETE FROM MySensorsChilds WHERE (HardwareID==%d) AND (NodeID=='%d') AND (ChildID=='%d')", m_HwdID, nodeID, childID);
 }
 
@@ -390,7 +492,14 @@ void MySensorsBase::UpdateChild(const int nodeID, const int childID, const bool
 {
 	if (_tMySensorNode *pNode = FindNode(nodeID))
 	{
+		FlushRegistry();
 		m_sql.safe_query("UPDATE MySensorsChilds SET [UseAck]='%d', [AckTimeout]='%d' WHERE (HardwareID==%d) AND (NodeID=='%d') AND (ChildID=='%d')", (UseAck == true) ? 1 : 0, AckTimeout, m_HwdID, nodeID, childID);
+		{
+			boost::lock_guard<boost::mutex> l(m_registryMutex);
+			std::map<unsigned int, _tMySensorChildEntry>::iterator itt = m_childinfo.find(MYSENSORS_CHILD_KEY(nodeID, childID));
+			if (itt != m_childinfo.end())
+				itt->second.UseAck = UseAck;
+		}
 		_tMySensorChild *pChild = pNode->FindChild(childID);
 		if (pChild)
 		{
@@ -1609,46 +1718,57 @@ bool MySensorsBase::WriteToHardware(const char *pdata, const unsigned char lengt
 
 void MySensorsBase::UpdateVar(const int NodeID, const int ChildID, const int VarID, const std::string &svalue)
 {
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT ROWID FROM MySensorsVars WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d) AND (VarID=%d)", m_HwdID, NodeID, ChildID, VarID);
-	if (result.size() == 0)
+	boost::lock_guard<boost::mutex> l(m_registryMutex);
+	std::map<unsigned int, _tMySensorVarEntry>::iterator itt = m_vars.find(MYSENSORS_VAR_KEY(NodeID, ChildID, VarID));
+	if (itt == m_vars.end())
 	{
-		//Insert
-		m_sql.safe_query("INSERT INTO MySensorsVars (HardwareID, NodeID, ChildID, VarID, [Value]) VALUES (%d, %d, %d, %d,'%q')", m_HwdID, NodeID, ChildID, VarID, svalue.c_str());
+		_tMySensorVarEntry vEntry;
+		vEntry.Value = svalue;
+		vEntry.bInDatabase = false;
+		vEntry.bDirty = true;
+		m_vars[MYSENSORS_VAR_KEY(NodeID, ChildID, VarID)] = vEntry;
 	}
 	else
 	{
-		//Update
-		m_sql.safe_query("UPDATE MySensorsVars SET [Value]='%q' WHERE (ROWID = '%q')", svalue.c_str(), result[0][0].c_str());
+		if (itt->second.Value == svalue)
+			return;
+		itt->second.Value = svalue;
+		itt->second.bDirty = true;
 	}
+	m_bRegistryDirty = true;
 }
 
 bool MySensorsBase::GetVar(const int NodeID, const int ChildID, const int VarID, std::string &sValue)
 {
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT [Value] FROM MySensorsVars WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d) AND (VarID=%d)", m_HwdID, NodeID, ChildID, VarID);
-	if (result.size() < 1)
+	boost::lock_guard<boost::mutex> l(m_registryMutex);
+	std::map<unsigned int, _tMySensorVarEntry>::const_iterator itt = m_vars.find(MYSENSORS_VAR_KEY(NodeID, ChildID, VarID));
+	if (itt == m_vars.end())
 		return false;
-	std::vector<std::string> sd = result[0];
-	sValue = sd[0];
+	sValue = itt->second.Value;
 	return true;
 }
 
 void MySensorsBase::UpdateChildDBInfo(const int NodeID, const int ChildID, const _ePresentationType pType, const std::string &Name)
 {
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT ROWID FROM MySensorsChilds WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d)", m_HwdID, NodeID, ChildID);
-	if (result.size() < 1)
+	boost::lock_guard<boost::mutex> l(m_registryMutex);
+	std::map<unsigned int, _tMySensorChildEntry>::iterator itt = m_childinfo.find(MYSENSORS_CHILD_KEY(NodeID, ChildID));
+	if (itt == m_childinfo.end())
 	{
-		//Insert
-		bool bUseAck = (ChildID == 255) ? false : true;
-		m_sql.safe_query("INSERT INTO MySensorsChilds (HardwareID, NodeID, ChildID, [Type], [Name], UseAck) VALUES (%d, %d, %d, %d, '%q', %d)", m_HwdID, NodeID, ChildID, pType, Name.c_str(), (bUseAck) ? 1 : 0);
+		_tMySensorChildEntry cEntry;
+		cEntry.pType = pType;
+		cEntry.Name = Name;
+		cEntry.UseAck = (ChildID == 255) ? false : true;
+		cEntry.bInDatabase = false;
+		cEntry.bDirty = true;
+		m_childinfo[MYSENSORS_CHILD_KEY(NodeID, ChildID)] = cEntry;
 	}
 	else
 	{
-		//Update
-		m_sql.safe_query("UPDATE MySensorsChilds SET [Type]='%d', [Name]='%q' WHERE (ROWID = '%q')", pType, Name.c_str(), result[0][0].c_str());
+		itt->second.pType = pType;
+		itt->second.Name = Name;
+		itt->second.bDirty = true;
 	}
+	m_bRegistryDirty = true;
 }
 
 bool MySensorsBase::GetChildDBInfo(const int NodeID, const int ChildID, _ePresentationType &pType, std::string &Name, bool &UseAck)
@@ -1656,13 +1776,13 @@ bool MySensorsBase::GetChildDBInfo(const int NodeID, const int ChildID, _ePresen
 	pType = S_UNKNOWN;
 	Name = "";
 	UseAck = false;
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT [Type], [Name], [UseAck] FROM MySensorsChilds WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d)", m_HwdID, NodeID, ChildID);
-	if (result.size() < 1)
+	boost::lock_guard<boost::mutex> l(m_registryMutex);
+	std::map<unsigned int, _tMySensorChildEntry>::const_iterator itt = m_childinfo.find(MYSENSORS_CHILD_KEY(NodeID, ChildID));
+	if (itt == m_childinfo.end())
 		return false;
-	pType = (_ePresentationType)atoi(result[0][0].c_str());
-	Name = result[0][1];
-	UseAck = (atoi(result[0][2].c_str()) != 0);
+	pType = itt->second.pType;
+	Name = itt->second.Name;
+	UseAck = itt->second.UseAck;
 	return true;
 }
 
@@ -1732,7 +1852,7 @@ void MySensorsBase::ParseLine()
 			break;
 		case I_SKETCH_NAME:
 			_log.Log(LOG_STATUS, "MySensors: Node: %d, Sketch Name: %s", node_id, payload.c_str());
-			if (_tMySensorNode *pNode = FindNode(node_id))
+			if (FindNode(node_id) != NULL)
 			{
 				DatabaseUpdateSketchName(node_id, payload);
 			}
@@ -1745,7 +1865,7 @@ void MySensorsBase::ParseLine()
 			break;
 		case I_SKETCH_VERSION:
 			_log.Log(LOG_STATUS, "MySensors: Node: %d, Sketch Version: %s", node_id, payload.c_str());
-			if (_tMySensorNode *pNode = FindNode(node_id))
+			if (FindNode(node_id) != NULL)
 			{
 				DatabaseUpdateSketchVersion(node_id, payload);
 			}
@@ -2281,16 +2401,25 @@ void MySensorsBase::StopSendQueue()
 
 void MySensorsBase::Do_Send_Work()
 {
+	time_t lastFlush = mytime(NULL);
 	while (true)
 	{
 		std::string toSend;
 		bool hasPopped = m_sendQueue.timed_wait_and_pop<boost::posix_time::milliseconds>(toSend, boost::posix_time::milliseconds(2000));
+		time_t atime = mytime(NULL);
+		if ((!hasPopped) || (atime - lastFlush >= 10))
+		{
+			//Write back the registry changes
+			lastFlush = atime;
+			FlushRegistry();
+		}
 		if (!hasPopped) {
 			continue;
 		}
 		if (toSend.empty())
 		{
 			//Exit thread
+			FlushRegistry();
 			return;
 		}
 #ifdef _DEBUG
@@ -2408,6 +2537,7 @@ namespace http {
 			root["title"] = "MySensorsGetChilds";
 			int NodeID = atoi(nodeid.c_str());
 			MySensorsBase::_tMySensorNode* pNode = pMySensorsHardware->FindNode(NodeID);
+			pMySensorsHardware->FlushRegistry();
 			std::vector<std::vector<std::string> >::const_iterator itt2;
 			std::vector<std::vector<std::string> > result;
 			result = m_sql.safe_query("SELECT ChildID, [Type], Name, UseAck, AckTimeout FROM MySensorsChilds WHERE (HardwareID=%d) AND (NodeID == %d) ORDER BY ChildID ASC", iHardwareID, NodeID);
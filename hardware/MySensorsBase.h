@@ -412,9 +412,15 @@ public:
 	static std::string GetMySensorsValueTypeStr(const enum _eSetType vType);
 	static std::string GetMySensorsPresentationTypeStr(const enum _ePresentationType pType);
 	std::string GetGatewayVersion();
-private:
+	void FlushRegistry();
+protected:
+	//What the gateway transports use
 	virtual void WriteInt(const std::string &sendStr) = 0;
 	void ParseData(const unsigned char *pData, int Len);
+	void LoadDevicesFromDatabase();
+	bool StartSendQueue();
+	void StopSendQueue();
+private:
 	void ParseLine();
 
 	void UpdateChildDBInfo(const int NodeID, const int ChildID, const _ePresentationType pType, const std::string &Name);
@@ -435,7 +441,6 @@ private:
 
 	bool GetBlindsValue(const int NodeID, const int ChildID, int &blind_value);
 
-	void LoadDevicesFromDatabase();
 	void Add2Database(const int nodeID, const std::string &SketchName, const std::string &SketchVersion);
 	void DatabaseUpdateSketchName(const int nodeID, const std::string &SketchName);
 	void DatabaseUpdateSketchVersion(const int nodeID, const std::string &SketchVersion);
@@ -455,12 +460,32 @@ private:
 	void UpdateVar(const int NodeID, const int ChildID, const int VarID, const std::string &svalue);
 	bool GetVar(const int NodeID, const int ChildID, const int VarID, std::string &sValue);
 
+	//In memory copy of the MySensorsVars/MySensorsChilds tables, changes are written back by the send thread
+	struct _tMySensorVarEntry
+	{
+		std::string Value;
+		bool bInDatabase;
+		bool bDirty;
+	};
+	struct _tMySensorChildEntry
+	{
+		_ePresentationType pType;
+		std::string Name;
+		bool UseAck;
+		bool bInDatabase;
+		bool bDirty;
+	};
+	void LoadRegistryFromDatabase();
+	std::map<unsigned int, _tMySensorVarEntry> m_vars;
+	std::map<unsigned int, _tMySensorChildEntry> m_childinfo;
+	boost::mutex m_registryMutex;
+	boost::mutex m_registryFlushMutex;
+	bool m_bRegistryDirty;
+
 	std::map<int, _tMySensorNode> m_nodes;
 
 	concurrent_queue<std::string > m_sendQueue;
 	boost::shared_ptr<boost::thread> m_send_thread;
-	bool StartSendQueue();
-	void StopSendQueue();
 	void Do_Send_Work();
 
 	std::string m_GatewayVersion;
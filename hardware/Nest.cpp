@@ -9,6 +9,7 @@
 #include "../httpclient/HTTPClient.h"
 #include "../main/mainworker.h"
 #include "../json/json.h"
+#include "../notifications/NotificationHelper.h"
 
 #define round(a) ( int ) ( a + .5 )
 
@@ -355,6 +356,7 @@ void CNest::UpdateSmokeSensor(const unsigned char Idx, const bool bOn, const std
 		if (!result.empty())
 		{
 			m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (ID=='%q')", STYPE_SMOKEDETECTOR, result[0][0].c_str());
+			m_notifications.InvalidateDeviceInfo(result[0][0]);
 		}
 	}
 	else
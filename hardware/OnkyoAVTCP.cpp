@@ -10,6 +10,7 @@
 #include "../json/json.h"
 
 #include <sstream>
+#include "../notifications/NotificationHelper.h"
 
 
 #define RETRY_DELAY 30
@@ -308,6 +309,9 @@ void OnkyoAVTCP::ReceiveSwitchMsg(const char *pData, int Len, bool muting, int I
 	if (result.empty()) {
 		m_mainworker.PushAndWaitRxMessage(this, (const unsigned char *)&gswitch, switch_types[ID].name, 255);
 		m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d, CustomImage=%d WHERE(HardwareID == %d) AND (DeviceID == '%08x')", switch_types[ID].switchType, switch_types[ID].customImage, m_HwdID, ID);
+		char szDeviceID[10];
+		sprintf(szDeviceID, "%08x", ID);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szDeviceID);
 		if (switch_types[ID].options) {
 			result = m_sql.safe_query("SELECT ID FROM DeviceStatus WHERE (HardwareID==%d) AND (DeviceID=='%08x') AND (Type==%d) ", m_HwdID, ID, pTypeGeneralSwitch);
 			if (result.size() > 0) {
@@ -8,39 +8,79 @@
 #define CRC16_ARC	0x8005
 #define CRC16_ARC_REFL	0xA001
 
+// CRC16/ARC lookup table (polynomial 0x8005 reflected), one step per byte instead of per bit
+static const uint16_t crc16_arc_table[256] = {
+	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+	0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+	0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+	0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+	0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+	0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+	0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+	0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+	0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+	0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+	0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+	0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+	0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+	0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+	0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+	0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+	0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+	0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+	0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+	0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+	0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+	0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+	0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+	0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+	0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+	0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+	0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+	0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+	0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+	0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+	0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
 typedef enum {
-	ID=0,
-	EXCLMARK,
-	STD,
+	STD=0,
 	DEVTYPE,
 	GAS,
 	LINE17,
 	LINE18
 } MatchType;
 
-#define P1SMID		"/"		// Smart Meter ID. Used to detect start of telegram.
-#define P1VER		"1-3:0.2.8"	// P1 version
-#define P1TS		"0-0:1.0.0"	// Timestamp
-#define P1PU1		"1-0:1.8.1"	// total power usage tariff 1
-#define P1PU2		"1-0:1.8.2"	// total power usage tariff 2
-#define P1PD1		"1-0:2.8.1"	// total delivered power tariff 1
-#define P1PD2		"1-0:2.8.2"	// total delivered power tariff 2
-#define P1TIP		"0-0:96.14.0"	// tariff indicator power
-#define P1PUC		"1-0:1.7.0"	// current power usage
-#define P1PDC		"1-0:2.7.0"	// current power delivery
-#define P1VOLTL1	"1-0:32.7.0"	// voltage L1 (DSMRv5)
-#define P1VOLTL2	"1-0:52.7.0"	// voltage L2 (DSMRv5)
-#define P1VOLTL3	"1-0:72.7.0"	// voltage L3 (DSMRv5)
-#define P1GTS		"0-n:24.3.0"	// DSMR2 timestamp gas usage sample
-#define P1GUDSMR2	"("		// DSMR2 gas usage sample
-#define P1GUDSMR4	"0-n:24.2.1"	// DSMR4 gas usage sample
-#define P1MBTYPE	"0-n:24.1.0"	// M-Bus device type
-#define P1EOT		"!"		// End of telegram.
+// OBIS code A-B:C.D.E packed in 32 bits, B=0xF matches the gas meter M-Bus channel ("0-n")
+#define OBIS_CHANNEL	0xF
+#define OBIS_KEY(a,b,c,d,e)	((uint32_t)(((a)<<28)|((b)<<24)|((c)<<16)|((d)<<8)|(e)))
+
+#define P1VER		OBIS_KEY(1,3,0,2,8)		// 1-3:0.2.8	P1 version
+#define P1TS		OBIS_KEY(0,0,1,0,0)		// 0-0:1.0.0	Timestamp
+#define P1PU1		OBIS_KEY(1,0,1,8,1)		// 1-0:1.8.1	total power usage tariff 1
+#define P1PU2		OBIS_KEY(1,0,1,8,2)		// 1-0:1.8.2	total power usage tariff 2
+#define P1PD1		OBIS_KEY(1,0,2,8,1)		// 1-0:2.8.1	total delivered power tariff 1
+#define P1PD2		OBIS_KEY(1,0,2,8,2)		// 1-0:2.8.2	total delivered power tariff 2
+#define P1TIP		OBIS_KEY(0,0,96,14,0)		// 0-0:96.14.0	tariff indicator power
+#define P1PUC		OBIS_KEY(1,0,1,7,0)		// 1-0:1.7.0	current power usage
+#define P1PDC		OBIS_KEY(1,0,2,7,0)		// 1-0:2.7.0	current power delivery
+#define P1VOLTL1	OBIS_KEY(1,0,32,7,0)		// 1-0:32.7.0	voltage L1 (DSMRv5)
+#define P1VOLTL2	OBIS_KEY(1,0,52,7,0)		// 1-0:52.7.0	voltage L2 (DSMRv5)
+#define P1VOLTL3	OBIS_KEY(1,0,72,7,0)		// 1-0:72.7.0	voltage L3 (DSMRv5)
+#define P1GTS		OBIS_KEY(0,OBIS_CHANNEL,24,3,0)	// 0-n:24.3.0	DSMR2 timestamp gas usage sample
+#define P1GUDSMR4	OBIS_KEY(0,OBIS_CHANNEL,24,2,1)	// 0-n:24.2.1	DSMR4 gas usage sample
+#define P1MBTYPE	OBIS_KEY(0,OBIS_CHANNEL,24,1,0)	// 0-n:24.1.0	M-Bus device type
+
+#define P1SMID		'/'		// Smart Meter ID. Used to detect start of telegram.
+#define P1GUDSMR2	'('		// DSMR2 gas usage sample (line following P1GTS)
+#define P1EOT		'!'		// End of telegram.
+
+// longest accepted value inside the brackets
+#define P1MAXVALUELEN	19
 
 typedef enum {
-	P1TYPE_SMID=0,
-	P1TYPE_END,
-	P1TYPE_VERSION,
+	P1TYPE_VERSION=0,
 	P1TYPE_POWERUSAGE1,
 	P1TYPE_POWERUSAGE2,
 	P1TYPE_POWERDELIV1,
@@ -59,30 +99,79 @@ typedef enum {
 typedef struct _tMatch {
 	MatchType matchtype;
 	P1Type type;
-	const char* key;
+	uint32_t key;
 	const char* topic;
-	int start;
-	int width;
 } Match;
 
-Match matchlist[] = {
-	{ID,		P1TYPE_SMID,			P1SMID,		"",			 0,  0},
-	{EXCLMARK,	P1TYPE_END,			P1EOT,		"",			 0,  0},
-	{STD,		P1TYPE_VERSION,			P1VER,		"version",		10,  2},
-	{STD,		P1TYPE_POWERUSAGE1,		P1PU1,		"powerusage1",		10,  9},
-	{STD,		P1TYPE_POWERUSAGE2,		P1PU2,		"powerusage2",		10,  9},
-	{STD,		P1TYPE_POWERDELIV1,		P1PD1,		"powerdeliv1",		10,  9},
-	{STD,		P1TYPE_POWERDELIV2,		P1PD2,		"powerdeliv2",		10,  9},
-	{STD,		P1TYPE_USAGECURRENT,		P1PUC,		"powerusagec",		10,  7},
-	{STD,		P1TYPE_DELIVCURRENT,		P1PDC,		"powerdelivc",		10,  7},
-	{STD,		P1TYPE_VOLTAGEL1,		P1VOLTL1,	"voltagel1",		11,  5},
-	{STD,		P1TYPE_VOLTAGEL2,		P1VOLTL2,	"voltagel2",		11,  5},
-	{STD,		P1TYPE_VOLTAGEL3,		P1VOLTL3,	"voltagel3",		11,  5},
-	{DEVTYPE,	P1TYPE_MBUSDEVICETYPE,		P1MBTYPE,	"mbusdevicetype",	11,  3},
-	{GAS,		P1TYPE_GASUSAGEDSMR4,		P1GUDSMR4,	"gasusage",	 	26,  8},
-	{LINE17,	P1TYPE_GASTIMESTAMP,		P1GTS,		"gastimestamp",		11, 12},
-	{LINE18,	P1TYPE_GASUSAGE,		P1GUDSMR2,	"gasusage",		 1,  9}
-}; // must keep DEVTYPE, GAS, LINE17 and LINE18 in this order at end of matchlist
+static const Match matchlist[] = {
+	{STD,		P1TYPE_VERSION,			P1VER,		"version"},
+	{STD,		P1TYPE_POWERUSAGE1,		P1PU1,		"powerusage1"},
+	{STD,		P1TYPE_POWERUSAGE2,		P1PU2,		"powerusage2"},
+	{STD,		P1TYPE_POWERDELIV1,		P1PD1,		"powerdeliv1"},
+	{STD,		P1TYPE_POWERDELIV2,		P1PD2,		"powerdeliv2"},
+	{STD,		P1TYPE_USAGECURRENT,		P1PUC,		"powerusagec"},
+	{STD,		P1TYPE_DELIVCURRENT,		P1PDC,		"powerdelivc"},
+	{STD,		P1TYPE_VOLTAGEL1,		P1VOLTL1,	"voltagel1"},
+	{STD,		P1TYPE_VOLTAGEL2,		P1VOLTL2,	"voltagel2"},
+	{STD,		P1TYPE_VOLTAGEL3,		P1VOLTL3,	"voltagel3"},
+	{DEVTYPE,	P1TYPE_MBUSDEVICETYPE,		P1MBTYPE,	"mbusdevicetype"},
+	{GAS,		P1TYPE_GASUSAGEDSMR4,		P1GUDSMR4,	"gasusage"},
+	{LINE17,	P1TYPE_GASTIMESTAMP,		P1GTS,		"gastimestamp"},
+	{LINE18,	P1TYPE_GASUSAGE,		0,		"gasusage"}
+};
+
+// Parse the OBIS code at the start of a line into its packed key, returns a pointer to the character following the code
+static const char *ParseObisCode(const char *pLine, uint32_t &key, uint8_t &channel)
+{
+	const char separators[5] = { '-', ':', '.', '.', '(' };
+	unsigned int fields[5];
+	const char *p = pLine;
+	for (int ii = 0; ii < 5; ii++)
+	{
+		if ((*p < '0') || (*p > '9'))
+			return NULL;
+		unsigned int value = 0;
+		while ((*p >= '0') && (*p <= '9'))
+		{
+			value = (value * 10) + (*p - '0');
+			if (value > 255)
+				return NULL;
+			p++;
+		}
+		if (*p != separators[ii])
+			return NULL;
+		fields[ii] = value;
+		if (ii < 4)
+			p++;
+	}
+	if ((fields[0] > 0xE) || (fields[1] > 0xE))
+		return NULL;
+	channel = (uint8_t)fields[1];
+	key = OBIS_KEY(fields[0], fields[1], fields[2], fields[3], fields[4]);
+	return p;
+}
+
+static const Match *FindMatch(const uint32_t key)
+{
+	for (size_t ii = 0; ii < sizeof(matchlist) / sizeof(Match); ii++)
+	{
+		if (matchlist[ii].key == key)
+			return &matchlist[ii];
+	}
+	return NULL;
+}
+
+// Locate the value of a bracketed group, it ends at the unit separator or the closing bracket
+static bool GetGroupValue(const char *pGroup, const char *&pStart, const char *&pEnd)
+{
+	if (*pGroup != '(')
+		return false;
+	pStart = pGroup + 1;
+	pEnd = pStart;
+	while ((*pEnd != 0) && (*pEnd != '*') && (*pEnd != ')'))
+		pEnd++;
+	return (*pEnd != 0);
+}
 
 P1MeterBase::P1MeterBase(void)
 {
@@ -100,6 +189,7 @@ void P1MeterBase::Init()
 	m_exclmarkfound=0;
 	m_CRfound=0;
 	m_bufferpos=0;
+	m_buffercrc=0;
 	m_lastgasusage=0;
 	m_lastSharedSendGas=0;
 	m_lastUpdateTime=0;
@@ -114,22 +204,10 @@ void P1MeterBase::Init()
 	memset(&m_buffer,0,sizeof(m_buffer));
 	memset(&l_buffer,0,sizeof(l_buffer));
 
-	memset(&m_power,0,sizeof(m_power));
-	memset(&m_gas,0,sizeof(m_gas));
-
-	m_power.len=sizeof(P1Power)-1;
-	m_power.type=pTypeP1Power;
-	m_power.subtype=sTypeP1Power;
-	m_power.ID=1;
-
-	m_gas.len=sizeof(P1Gas)-1;
-	m_gas.type=pTypeP1Gas;
-	m_gas.subtype=sTypeP1Gas;
-	m_gas.ID=1;
-	m_gas.gasusage=0;
+	m_power=P1Power();
+	m_gas=P1Gas();
 
 	m_gasmbuschannel=0;
-	m_gasprefix="0-n";
 	m_gastimestamp="";
 	m_gasclockskew=0;
 	m_gasoktime=0;
@@ -142,7 +220,6 @@ void P1MeterBase::Init()
 		if ((s_gasmbuschannel.length()==1) && (s_gasmbuschannel[0]>0x30) && (s_gasmbuschannel[0]<0x35)) // value must be a single digit number between 1 and 4
 		{
 			m_gasmbuschannel=(char)s_gasmbuschannel[0];
-			m_gasprefix[2]=m_gasmbuschannel;
 			_log.Log(LOG_STATUS,"P1 Smart Meter: Gas meter M-Bus channel %c enforced by 'P1GasMeterChannel' user variable", m_gasmbuschannel);
 		}
 	}
@@ -150,271 +227,270 @@ void P1MeterBase::Init()
 
 bool P1MeterBase::MatchLine()
 {
-	if ((strlen((const char*)&l_buffer)<1)||(l_buffer[0]==0x0a))
+	const char *pLine = (const char*)&l_buffer;
+	if ((pLine[0]==0)||(pLine[0]==0x0a))
 		return true; //null value (startup)
-	uint8_t i;
-	uint8_t found=0;
-	Match *t;
-	char value[20]="";
-	std::string vString;
 
-	for(i=0;(i<sizeof(matchlist)/sizeof(Match))&(!found);i++)
+	if (pLine[0]==P1SMID)
 	{
-		t = &matchlist[i];
-		switch(t->matchtype)
-		{
-		case ID:
-			// start of data
-			if(strncmp(t->key, (const char*)&l_buffer, strlen(t->key)) == 0) {
-				m_linecount=1;
-				found=1;
-			}
-			continue; // we do not process anything else on this line
-			break;
-		case EXCLMARK:
-			// end of data
-			if(strncmp(t->key, (const char*)&l_buffer, strlen(t->key)) == 0) {
-				l_exclmarkfound=1;
-				found=1;
-			}
-			break;
-		case STD:
-			if(strncmp(t->key, (const char*)&l_buffer, strlen(t->key)) == 0)
-				found=1;
-			break;
-		case DEVTYPE:
-			if(m_gasmbuschannel==0){
-				vString=(const char*)t->key+3;
-				if (strncmp(vString.c_str(), (const char*)&l_buffer+3, strlen(t->key)-3) == 0)
-					found=1;
-				else
-					i+=100; // skip matches with any other gas lines - we need to find the M0-Bus channel first
-			}
-			break;
-		case GAS:
-			if(strncmp((m_gasprefix+(t->key+3)).c_str(), (const char*)&l_buffer, strlen(t->key)) == 0){
-				found=1;
-			}
-			if (m_p1version>=4)
-				i+=100; // skip matches with any DSMR v2 gas lines
-			break;
-		case LINE17:
-			if(strncmp((m_gasprefix+(t->key+3)).c_str(), (const char*)&l_buffer, strlen(t->key)) == 0){
-				m_linecount = 17;
-				found=1;
-			}
-			break;
-		case LINE18:
-			if((m_linecount == 18)&&(strncmp(t->key, (const char*)&l_buffer, strlen(t->key)) == 0))
-				found=1;
-			break;
-		} //switch
-
-		if(!found)
-			continue;
+		// start of data, we do not process anything else on this line
+		m_linecount=1;
+		return true;
+	}
+	if (pLine[0]==P1EOT)
+	{
+		// end of data
+		SendTelegram();
+		m_linecount=0;
+		l_exclmarkfound=0;
+		return true;
+	}
 
-		if (l_exclmarkfound) {
-			if (m_p1version==0)
-			{
-				_log.Log(LOG_STATUS,"P1 Smart Meter: Meter is pre DSMR 4.0 - using DSMR 2.2 compatibility");
-				m_p1version=2;
-			}
-			time_t atime=mytime(NULL);
-			if (difftime(atime,m_lastUpdateTime)>=m_ratelimit) {
-				m_lastUpdateTime=atime;
-				sDecodeRXMessage(this, (const unsigned char *)&m_power, "Power", 255);
-				if (m_voltagel1) {
-					SendVoltageSensor(0, 1, 255, m_voltagel1, "Voltage L1");
-					if (m_voltagel2)
-						SendVoltageSensor(0, 2, 255, m_voltagel2, "Voltage L2");
-					if (m_voltagel3)
-						SendVoltageSensor(0, 3, 255, m_voltagel3, "Voltage L3");
-				}
-				if ( (m_gas.gasusage>0)&&( (m_gas.gasusage!=m_lastgasusage)||(difftime(atime,m_lastSharedSendGas)>=300) ) ){
-					//only update gas when there is a new value, or 5 minutes are passed
-					if (m_gasclockskew>=300){ // just accept it - we cannot sync to our clock
-						m_lastSharedSendGas=atime;
-						m_lastgasusage=m_gas.gasusage;
-						sDecodeRXMessage(this, (const unsigned char *)&m_gas, "Gas", 255);
-					}
-					else if (atime>=m_gasoktime){
-						struct tm ltime;
-						localtime_r(&atime, &ltime);
-						char myts[16];
-						sprintf(myts,"%02d%02d%02d%02d%02d%02dW",ltime.tm_year%100,ltime.tm_mon+1,ltime.tm_mday,ltime.tm_hour,ltime.tm_min,ltime.tm_sec);
-						if (ltime.tm_isdst)
-						myts[12]='S';
-						if ( (m_gastimestamp.length()>13) || (strncmp((const char*)&myts,m_gastimestamp.c_str(),m_gastimestamp.length())>=0) )
-						{
-							m_lastSharedSendGas=atime;
-							m_lastgasusage=m_gas.gasusage;
-							m_gasoktime+=300;
-							sDecodeRXMessage(this, (const unsigned char *)&m_gas, "Gas", 255);
-						}
-						else // gas clock is ahead
-						{
-							struct tm gastm;
-							gastm.tm_year = atoi(m_gastimestamp.substr(0, 2).c_str()) + 100;
-							gastm.tm_mon = atoi(m_gastimestamp.substr(2, 2).c_str()) - 1;
-							gastm.tm_mday = atoi(m_gastimestamp.substr(4, 2).c_str());
-							gastm.tm_hour = atoi(m_gastimestamp.substr(6, 2).c_str());
-							gastm.tm_min = atoi(m_gastimestamp.substr(8, 2).c_str());
-							gastm.tm_sec = atoi(m_gastimestamp.substr(10, 2).c_str());
-							if (m_gastimestamp.length()==12)
-								gastm.tm_isdst = -1;
-							else if (m_gastimestamp[12]=='W')
-								gastm.tm_isdst = 0;
-							else
-								gastm.tm_isdst = 1;
-
-							time_t gtime=mktime(&gastm);
-							m_gasclockskew=difftime(gtime,atime);
-							if (m_gasclockskew>=300){
-								_log.Log(LOG_ERROR, "P1 Smart Meter: Unable to synchronize to the gas meter clock because it is more than 5 minutes ahead of my time");
-							}
-							else {
-								m_gasoktime=gtime;
-								_log.Log(LOG_STATUS, "P1 Smart Meter: Gas meter clock is %i seconds ahead - wait for my clock to catch up", (int)m_gasclockskew);
-							}
-						}
-					}
-				}
-			}
-			m_linecount=0;
-			l_exclmarkfound=0;
+	const Match *t = NULL;
+	const char *pGroup = NULL;
+	if (pLine[0]==P1GUDSMR2)
+	{
+		// DSMR2 gas usage is on the line following the gas timestamp
+		if ((m_linecount == 18) && (m_p1version < 4) && (m_gasmbuschannel != 0))
+		{
+			t = &matchlist[sizeof(matchlist) / sizeof(Match) - 1];
+			pGroup = pLine;
 		}
-		else
+	}
+	else
+	{
+		uint32_t key;
+		uint8_t channel;
+		pGroup = ParseObisCode(pLine, key, channel);
+		if (pGroup == NULL)
+			return true; //not an OBIS line we know
+		t = FindMatch(key);
+		if ((t == NULL) && (key >> 28 == 0))
 		{
-			vString=(const char*)&l_buffer+t->start;
-			int ePos=t->width;
-			ePos=vString.find_first_of("*)");
-
-			if (ePos==std::string::npos)
+			// gas lines are only accepted from the M-Bus channel of the gas meter, which the device type line tells us
+			t = FindMatch((key & 0xF0FFFFFF) | (OBIS_CHANNEL << 24));
+			if (t != NULL)
 			{
-				// invalid message: value not delimited
-				_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - value is not delimited in line \"%s\"", l_buffer);
-				return false;
+				if (m_gasmbuschannel == 0)
+				{
+					if (t->matchtype != DEVTYPE)
+						t = NULL;
+				}
+				else if ((t->matchtype == DEVTYPE) || (channel != m_gasmbuschannel - '0'))
+					t = NULL;
+				else if ((t->matchtype == LINE17) && (m_p1version >= 4))
+					t = NULL; // skip DSMR v2 gas lines
 			}
+		}
+	}
+	if (t == NULL)
+		return true;
 
-			if (ePos>19)
-			{
-				// invalid message: line too long
-				_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - value in line \"%s\" is oversized", l_buffer);
-				return false;
-			}
+	if (t->matchtype == LINE17)
+		m_linecount = 17;
 
-			if (ePos>0)
-			{
-				strcpy(value,vString.substr(0,ePos).c_str());
+	const char *pValue;
+	const char *pValueEnd;
+	if (t->type == P1TYPE_GASUSAGEDSMR4)
+	{
+		// first group is the timestamp of the sample, the value is in the second one
+		const char *pTimestamp;
+		if (!GetGroupValue(pGroup, pTimestamp, pValueEnd))
+		{
+			_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - value is not delimited in line \"%s\"", l_buffer);
+			return false;
+		}
+		if (pValueEnd - pTimestamp > 13)
+			pValueEnd = pTimestamp + 13;
+		m_gastimestamp.assign(pTimestamp, pValueEnd - pTimestamp);
+		pGroup = strchr(pValueEnd, ')');
+		if (pGroup != NULL)
+			pGroup++;
+	}
+	if ((pGroup == NULL) || (!GetGroupValue(pGroup, pValue, pValueEnd)))
+	{
+		// invalid message: value not delimited
+		_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - value is not delimited in line \"%s\"", l_buffer);
+		return false;
+	}
+	int ePos = (int)(pValueEnd - pValue);
+	if (ePos > P1MAXVALUELEN)
+	{
+		// invalid message: line too long
+		_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - value in line \"%s\" is oversized", l_buffer);
+		return false;
+	}
 #ifdef _DEBUG
-				_log.Log(LOG_NORM,"P1 Smart Meter: Key: %s, Value: %s", t->topic,value);
+	_log.Log(LOG_NORM,"P1 Smart Meter: Key: %s, Value: %.*s", t->topic, ePos, pValue);
 #endif
-			}
 
-			unsigned long temp_usage = 0;
-			float temp_volt = 0;
-			char *validate=value+ePos;
+	// values are parsed in place, they are terminated by '*' or ')' which ends strtod as well
+	unsigned long temp_usage = 0;
+	float temp_volt = 0;
+	char *validate = (char*)pValueEnd;
 
-			switch (t->type)
-			{
-			case P1TYPE_VERSION:
-				if (m_p1version==0)
-					_log.Log(LOG_STATUS,"P1 Smart Meter: Meter reports as DSMR %c.%c", value[0], value[1]);
-				m_p1version=value[0]-0x30;
-				break;
-			case P1TYPE_MBUSDEVICETYPE:
-				temp_usage = (unsigned long)(strtod(value,&validate));
-				if (temp_usage == 3) {
-					m_gasmbuschannel = (char)l_buffer[2];
-					m_gasprefix[2]=m_gasmbuschannel;
-					_log.Log(LOG_STATUS,"P1 Smart Meter: Found gas meter on M-Bus channel %c", m_gasmbuschannel);
-				}
-				break;
-			case P1TYPE_POWERUSAGE1:
-				temp_usage = (unsigned long)(strtod(value,&validate)*1000.0f);
-				if (!m_power.powerusage1 || m_p1version >= 4)
-					m_power.powerusage1 = temp_usage;
-				else if (temp_usage - m_power.powerusage1 < 10000)
-					m_power.powerusage1 = temp_usage;
-				break;
-			case P1TYPE_POWERUSAGE2:
-				temp_usage = (unsigned long)(strtod(value,&validate)*1000.0f);
-				if (!m_power.powerusage2 || m_p1version >= 4)
-					m_power.powerusage2 = temp_usage;
-				else if (temp_usage - m_power.powerusage2 < 10000)
-					m_power.powerusage2 = temp_usage;
-				break;
-			case P1TYPE_POWERDELIV1:
-				temp_usage = (unsigned long)(strtod(value,&validate)*1000.0f);
-				if (!m_power.powerdeliv1 || m_p1version >= 4)
-					m_power.powerdeliv1 = temp_usage;
-				else if (temp_usage - m_power.powerdeliv1 < 10000)
-					m_power.powerdeliv1 = temp_usage;
-				break;
-			case P1TYPE_POWERDELIV2:
-				temp_usage = (unsigned long)(strtod(value,&validate)*1000.0f);
-				if (!m_power.powerdeliv2 || m_p1version >= 4)
-					m_power.powerdeliv2 = temp_usage;
-				else if (temp_usage - m_power.powerdeliv2 < 10000)
-					m_power.powerdeliv2 = temp_usage;
-				break;
-			case P1TYPE_USAGECURRENT:
-				temp_usage = (unsigned long)(strtod(value,&validate)*1000.0f);	//Watt
-				if (temp_usage < 17250)
-					m_power.usagecurrent = temp_usage;
-				break;
-			case P1TYPE_DELIVCURRENT:
-				temp_usage = (unsigned long)(strtod(value,&validate)*1000.0f);	//Watt;
-				if (temp_usage < 17250)
-					m_power.delivcurrent = temp_usage;
-				break;
-			case P1TYPE_VOLTAGEL1:
-				temp_volt = strtof(value,&validate);
-				if (temp_volt < 300)
-					m_voltagel1 = temp_volt; //Voltage L1;
-				break;
-			case P1TYPE_VOLTAGEL2:
-				temp_volt = strtof(value,&validate);
-				if (temp_volt < 300)
-					m_voltagel2 = temp_volt; //Voltage L2;
-				break;
-			case P1TYPE_VOLTAGEL3:
-				temp_volt = strtof(value,&validate);
-				if (temp_volt < 300)
-					m_voltagel3 = temp_volt; //Voltage L3;
-				break;
-			case P1TYPE_GASTIMESTAMP:
-				m_gastimestamp = std::string(value);
-				break;
-			case P1TYPE_GASUSAGE:
-			case P1TYPE_GASUSAGEDSMR4:
-				temp_usage = (unsigned long)(strtod(value,&validate)*1000.0f);
-				if (!m_gas.gasusage || m_p1version >= 4)
-					m_gas.gasusage = temp_usage;
-				else if (temp_usage - m_gas.gasusage < 20000)
-					m_gas.gasusage = temp_usage;
-				break;
-			}
+	switch (t->type)
+	{
+	case P1TYPE_VERSION:
+		if (ePos < 2)
+			break;
+		if (m_p1version==0)
+			_log.Log(LOG_STATUS,"P1 Smart Meter: Meter reports as DSMR %c.%c", pValue[0], pValue[1]);
+		m_p1version=pValue[0]-0x30;
+		break;
+	case P1TYPE_MBUSDEVICETYPE:
+		temp_usage = (unsigned long)(strtod(pValue,&validate));
+		if (temp_usage == 3) {
+			m_gasmbuschannel = (char)l_buffer[2];
+			_log.Log(LOG_STATUS,"P1 Smart Meter: Found gas meter on M-Bus channel %c", m_gasmbuschannel);
+		}
+		break;
+	case P1TYPE_POWERUSAGE1:
+		temp_usage = (unsigned long)(strtod(pValue,&validate)*1000.0f);
+		if (!m_power.powerusage1 || m_p1version >= 4)
+			m_power.powerusage1 = temp_usage;
+		else if (temp_usage - m_power.powerusage1 < 10000)
+			m_power.powerusage1 = temp_usage;
+		break;
+	case P1TYPE_POWERUSAGE2:
+		temp_usage = (unsigned long)(strtod(pValue,&validate)*1000.0f);
+		if (!m_power.powerusage2 || m_p1version >= 4)
+			m_power.powerusage2 = temp_usage;
+		else if (temp_usage - m_power.powerusage2 < 10000)
+			m_power.powerusage2 = temp_usage;
+		break;
+	case P1TYPE_POWERDELIV1:
+		temp_usage = (unsigned long)(strtod(pValue,&validate)*1000.0f);
+		if (!m_power.powerdeliv1 || m_p1version >= 4)
+			m_power.powerdeliv1 = temp_usage;
+		else if (temp_usage - m_power.powerdeliv1 < 10000)
+			m_power.powerdeliv1 = temp_usage;
+		break;
+	case P1TYPE_POWERDELIV2:
+		temp_usage = (unsigned long)(strtod(pValue,&validate)*1000.0f);
+		if (!m_power.powerdeliv2 || m_p1version >= 4)
+			m_power.powerdeliv2 = temp_usage;
+		else if (temp_usage - m_power.powerdeliv2 < 10000)
+			m_power.powerdeliv2 = temp_usage;
+		break;
+	case P1TYPE_USAGECURRENT:
+		temp_usage = (unsigned long)(strtod(pValue,&validate)*1000.0f);	//Watt
+		if (temp_usage < 17250)
+			m_power.usagecurrent = temp_usage;
+		break;
+	case P1TYPE_DELIVCURRENT:
+		temp_usage = (unsigned long)(strtod(pValue,&validate)*1000.0f);	//Watt;
+		if (temp_usage < 17250)
+			m_power.delivcurrent = temp_usage;
+		break;
+	case P1TYPE_VOLTAGEL1:
+		temp_volt = strtof(pValue,&validate);
+		if (temp_volt < 300)
+			m_voltagel1 = temp_volt; //Voltage L1;
+		break;
+	case P1TYPE_VOLTAGEL2:
+		temp_volt = strtof(pValue,&validate);
+		if (temp_volt < 300)
+			m_voltagel2 = temp_volt; //Voltage L2;
+		break;
+	case P1TYPE_VOLTAGEL3:
+		temp_volt = strtof(pValue,&validate);
+		if (temp_volt < 300)
+			m_voltagel3 = temp_volt; //Voltage L3;
+		break;
+	case P1TYPE_GASTIMESTAMP:
+		m_gastimestamp.assign(pValue, ePos);
+		break;
+	case P1TYPE_GASUSAGE:
+	case P1TYPE_GASUSAGEDSMR4:
+		temp_usage = (unsigned long)(strtod(pValue,&validate)*1000.0f);
+		if (!m_gas.gasusage || m_p1version >= 4)
+			m_gas.gasusage = temp_usage;
+		else if (temp_usage - m_gas.gasusage < 20000)
+			m_gas.gasusage = temp_usage;
+		break;
+	}
 
-			if (ePos>0 && ((validate - value) != ePos)) {
-				// invalid message: value is not a number
-				_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - value in line \"%s\" is not a number", l_buffer);
-				return false;
-			}
+	if (ePos>0 && (validate != pValueEnd)) {
+		// invalid message: value is not a number
+		_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - value in line \"%s\" is not a number", l_buffer);
+		return false;
+	}
+	return true;
+}
 
-			if (t->type == P1TYPE_GASUSAGEDSMR4){ // need to get timestamp from this line as well
-				vString=(const char*)&l_buffer+11;
-				m_gastimestamp=vString.substr(0,13);
-#ifdef _DEBUG
-				_log.Log(LOG_NORM,"P1 Smart Meter: Key: gastimestamp, Value: %s", m_gastimestamp);
-#endif
+void P1MeterBase::SendTelegram()
+{
+	if (m_p1version==0)
+	{
+		_log.Log(LOG_STATUS,"P1 Smart Meter: Meter is pre DSMR 4.0 - using DSMR 2.2 compatibility");
+		m_p1version=2;
+	}
+	time_t atime=mytime(NULL);
+	if (difftime(atime,m_lastUpdateTime)>=m_ratelimit) {
+		m_lastUpdateTime=atime;
+		BeginBatch();
+		sDecodeRXMessage(this, (const unsigned char *)&m_power, "Power", 255);
+		if (m_voltagel1) {
+			SendVoltageSensor(0, 1, 255, m_voltagel1, "Voltage L1");
+			if (m_voltagel2)
+				SendVoltageSensor(0, 2, 255, m_voltagel2, "Voltage L2");
+			if (m_voltagel3)
+				SendVoltageSensor(0, 3, 255, m_voltagel3, "Voltage L3");
+		}
+		if ( (m_gas.gasusage>0)&&( (m_gas.gasusage!=m_lastgasusage)||(difftime(atime,m_lastSharedSendGas)>=300) ) ){
+			//only update gas when there is a new value, or 5 minutes are passed
+			if (m_gasclockskew>=300){ // just accept it - we cannot sync to our clock
+				m_lastSharedSendGas=atime;
+				m_lastgasusage=m_gas.gasusage;
+				sDecodeRXMessage(this, (const unsigned char *)&m_gas, "Gas", 255);
+			}
+			else if (atime>=m_gasoktime){
+				struct tm ltime;
+				localtime_r(&atime, &ltime);
+				char myts[16];
+				sprintf(myts,"%02d%02d%02d%02d%02d%02dW",ltime.tm_year%100,ltime.tm_mon+1,ltime.tm_mday,ltime.tm_hour,ltime.tm_min,ltime.tm_sec);
+				if (ltime.tm_isdst)
+				myts[12]='S';
+				if ( (m_gastimestamp.length()>13) || (strncmp((const char*)&myts,m_gastimestamp.c_str(),m_gastimestamp.length())>=0) )
+				{
+					m_lastSharedSendGas=atime;
+					m_lastgasusage=m_gas.gasusage;
+					m_gasoktime+=300;
+					sDecodeRXMessage(this, (const unsigned char *)&m_gas, "Gas", 255);
+				}
+				else // gas clock is ahead
+				{
+					struct tm gastm;
+					gastm.tm_year = atoi(m_gastimestamp.substr(0, 2).c_str()) + 100;
+					gastm.tm_mon = atoi(m_gastimestamp.substr(2, 2).c_str()) - 1;
+					gastm.tm_mday = atoi(m_gastimestamp.substr(4, 2).c_str());
+					gastm.tm_hour = atoi(m_gastimestamp.substr(6, 2).c_str());
+					gastm.tm_min = atoi(m_gastimestamp.substr(8, 2).c_str());
+					gastm.tm_sec = atoi(m_gastimestamp.substr(10, 2).c_str());
+					if (m_gastimestamp.length()==12)
+						gastm.tm_isdst = -1;
+					else if (m_gastimestamp[12]=='W')
+						gastm.tm_isdst = 0;
+					else
+						gastm.tm_isdst = 1;
+
+					time_t gtime=mktime(&gastm);
+					m_gasclockskew=difftime(gtime,atime);
+					if (m_gasclockskew>=300){
+						_log.Log(LOG_ERROR, "P1 Smart Meter: Unable to synchronize to the gas meter clock because it is more than 5 minutes ahead of my time");
+					}
+					else {
+						m_gasoktime=gtime;
+						_log.Log(LOG_STATUS, "P1 Smart Meter: Gas meter clock is %i seconds ahead - wait for my clock to catch up", (int)m_gasclockskew);
+					}
+				}
 			}
 		}
+		EndBatch();
 	}
-	return true;
 }
 
-
 /*
 / GB3:	DSMR 4.0 defines a CRC checksum at the end of the message, calculated from
 /	and including the message starting character '/' upto and including the message
@@ -452,21 +528,8 @@ bool P1MeterBase::CheckCRC()
 	crc_str[4]=0;
 	uint16_t m_crc16=(uint16_t)strtoul(crc_str,NULL,16);
 
-	// calculate CRC
-	const unsigned char* c_buffer=m_buffer;
-	uint8_t i;
-	uint16_t crc=0;
-	int m_size=m_bufferpos;
-	while (m_size--) {
-		crc = crc ^ *c_buffer++;
-		for (i=0;i<8;i++){
-			if ((crc & 0x0001)){
-				crc = (crc >> 1) ^ CRC16_ARC_REFL;
-			} else {
-				crc = crc >> 1;
-			}
-		}
-	}
+	// CRC was calculated while assembling the message
+	uint16_t crc=m_buffercrc;
 	if (crc != m_crc16){
 		_log.Log(LOG_NORM,"P1 Smart Meter: Dismiss incoming - CRC failed");
 	}
@@ -493,15 +556,19 @@ void P1MeterBase::ParseData(const unsigned char *pData, const int Len, const boo
 	int ii=0;
 	m_ratelimit=ratelimit;
 	// a new message should not start with an empty line, but just in case it does (crude check is sufficient here)
-	while ((m_linecount==0) && (pData[ii]<0x10)){
+	while ((ii<Len) && (m_linecount==0) && (pData[ii]<0x10)){
 		ii++;
 	}
+	if (ii==Len)
+		return;
 
 	// re enable reading pData when a new message starts, empty buffers
 	if (pData[ii]==0x2f)
 	{
 		if ((l_buffer[0]==0x21) && !l_exclmarkfound && (m_linecount>0)) {
 			_log.Log(LOG_STATUS,"P1 Smart Meter: WARNING: got new message but buffer still contains unprocessed data from previous message.");
+			if (l_bufferpos==(int)sizeof(l_buffer))
+				l_bufferpos--;
 			l_buffer[l_bufferpos] = 0;
 			if (disable_crc || CheckCRC()) {
 				MatchLine();
@@ -510,14 +577,16 @@ void P1MeterBase::ParseData(const unsigned char *pData, const int Len, const boo
 		m_linecount = 1;
 		l_bufferpos = 0;
 		m_bufferpos = 0;
+		m_buffercrc = 0;
 		m_exclmarkfound = 0;
 	}
 
 	// assemble complete message in message buffer
-	while ((ii<Len) && (m_linecount>0) && (!m_exclmarkfound) && (m_bufferpos<sizeof(m_buffer))){
+	while ((ii<Len) && (m_linecount>0) && (!m_exclmarkfound) && (m_bufferpos<(int)sizeof(m_buffer))){
 		const unsigned char c = pData[ii];
 		m_buffer[m_bufferpos] = c;
 		m_bufferpos++;
+		m_buffercrc = (m_buffercrc >> 8) ^ crc16_arc_table[(m_buffercrc ^ c) & 0xFF];
 		if(c==0x21){
 			// stop reading at exclamation mark (do not include CRC)
 			ii=Len;
@@ -527,7 +596,7 @@ void P1MeterBase::ParseData(const unsigned char *pData, const int Len, const boo
 		}
 	}
 
-	if(m_bufferpos==sizeof(m_buffer)){
+	if(m_bufferpos==(int)sizeof(m_buffer)){
 		// discard oversized message
 		if ((Len > 400) || (pData[0]==0x21)){
 			// 400 is an arbitrary chosen number to differentiate between full messages and single line commits
@@ -551,7 +620,7 @@ void P1MeterBase::ParseData(const unsigned char *pData, const int Len, const boo
 		if (c==0x0a) {
 			// close string, parse line and clear it.
 			m_linecount++;
-			if ((l_bufferpos>0) && (l_bufferpos<sizeof(l_buffer))) {
+			if ((l_bufferpos>0) && (l_bufferpos<(int)sizeof(l_buffer))) {
 				// don't try to match empty or oversized lines
 				l_buffer[l_bufferpos] = 0;
 				if(l_buffer[0]==0x21 && !disable_crc){
@@ -567,7 +636,7 @@ void P1MeterBase::ParseData(const unsigned char *pData, const int Len, const boo
 			}
 			l_bufferpos = 0;
 		}
-		else if (l_bufferpos<sizeof(l_buffer)) {
+		else if (l_bufferpos<(int)sizeof(l_buffer)) {
 			l_buffer[l_bufferpos] = c;
 			l_bufferpos++;
 		}
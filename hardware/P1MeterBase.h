@@ -21,6 +21,7 @@ private:
 
 	unsigned char m_buffer[1400];
 	int m_bufferpos;
+	uint16_t m_buffercrc;
 	unsigned char m_exclmarkfound;
 	unsigned char m_linecount;
 	unsigned char m_CRfound;
@@ -38,14 +39,15 @@ private:
 	float m_voltagel3;
 
 	unsigned char m_gasmbuschannel;
-	std::string m_gasprefix;
 	std::string m_gastimestamp;
 	double m_gasclockskew;
 	time_t m_gasoktime;
 
-	void Init();
 	bool MatchLine();
-	void ParseData(const unsigned char *pData, const int Len, const bool disable_crc, int ratelimit);
+	void SendTelegram();
 
 	bool CheckCRC();
+protected:
+	void Init();
+	void ParseData(const unsigned char *pData, const int Len, const bool disable_crc, int ratelimit);
 };
@@ -13,6 +13,7 @@
 #include "../../json/json.h"
 #include "../hardwaretypes.h"
 #include <boost/make_shared.hpp>
+#include "../../notifications/NotificationHelper.h"
 
 #define round(a) ( int ) ( a + .5 )
 
@@ -424,6 +425,7 @@ void CPhilipsHue::InsertUpdateSwitch(const int NodeID, const _eHueLightType LTyp
 			//Set Name/Parameters
 			m_sql.safe_query("UPDATE DeviceStatus SET Name='%q', SwitchType=%d, nValue=%d, sValue='%q', LastLevel=%d WHERE(HardwareID == %d) AND (DeviceID == '%q')",
 				Name.c_str(), int(STYPE_Dimmer), int(cmd), szSValue, BrightnessLevel, m_HwdID, szID);
+			m_notifications.InvalidateDeviceInfo(m_HwdID, szID);
 		}
 	}
 	else if (LType == HLTYPE_SCENE)
@@ -456,6 +458,7 @@ void CPhilipsHue::InsertUpdateSwitch(const int NodeID, const _eHueLightType LTyp
 		{
 			m_sql.safe_query("UPDATE DeviceStatus SET Name='%q', SwitchType=%d, Options='%q' WHERE (HardwareID == %d) AND(DeviceID == '%q')",
 				Name.c_str(), int(STYPE_PushOn), Options.c_str(), m_HwdID, szID);
+			m_notifications.InvalidateDeviceInfo(m_HwdID, szID);
 		}
 	}
 	else
@@ -536,6 +539,7 @@ void CPhilipsHue::InsertUpdateSwitch(const int NodeID, const _eHueLightType LTyp
 			//Set Name/Parameters
 			m_sql.safe_query("UPDATE DeviceStatus SET Name='%q', SwitchType=%d, LastLevel=%d, nValue=%d, sValue='%q' WHERE (HardwareID==%d) AND (DeviceID=='%q')",
 				Name.c_str(), int(LType == HLTYPE_DIM ? STYPE_Dimmer : STYPE_OnOff), BrightnessLevel, int(cmd), szLevel, m_HwdID, szID);
+			m_notifications.InvalidateDeviceInfo(m_HwdID, szID);
 		}
 	}
 }
@@ -997,6 +1001,7 @@ void CPhilipsHue::InsertUpdateSwitch(const int NodeID, const _eSwitchType SType,
 		m_mainworker.PushAndWaitRxMessage(this, (const unsigned char *)&xcmd, Name.c_str(), BatteryLevel);
 
 		m_sql.safe_query("UPDATE DeviceStatus SET Name='%q', SwitchType=%d, CustomImage=%i WHERE(HardwareID == %d) AND (DeviceID == '%q')", Name.c_str(), (SType), 0, m_HwdID, ID);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, ID);
 	}
 	else 
 	{
@@ -12,6 +12,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <stdio.h>
+#ifndef WIN32
+#include <sys/select.h>
+#include <unistd.h>
+#endif
 #include "Rtl433.h"
 
 void removeCharsFromString(std::string &str, const char* charsToRemove ) {
@@ -28,6 +32,8 @@ CRtl433::CRtl433(const int ID, const std::string &cmdline) :
 	removeCharsFromString(m_cmdline, ":;/$()`<>|&");
 	m_HwdID = ID;
 	m_hPipe = NULL;
+	m_lineLen = 0;
+	m_bSkipLine = false;
 }
 
 CRtl433::~CRtl433()
@@ -56,32 +62,449 @@ bool CRtl433::StopHardware()
 	return true;
 }
 
-std::vector<std::string> CRtl433::ParseCSVLine(const char *input)
+#define RTL433_DUPLICATE_WINDOW 2 //seconds
+#define RTL433_MAX_LAST_FRAMES 256
+#define RTL433_FNV_OFFSET 14695981039346656037ULL
+#define RTL433_FNV_PRIME 1099511628211ULL
+
+enum _eRtl433Field
+{
+	RTL433_FIELD_BATTERY = 0,
+	RTL433_FIELD_CHANNEL,
+	RTL433_FIELD_COMMAND,
+	RTL433_FIELD_DEPTH,
+	RTL433_FIELD_DEPTH_CM,
+	RTL433_FIELD_HUMIDITY,
+	RTL433_FIELD_ID,
+	RTL433_FIELD_MODEL,
+	RTL433_FIELD_PRESSURE,
+	RTL433_FIELD_RAIN,
+	RTL433_FIELD_STATE,
+	RTL433_FIELD_TEMPERATURE_C,
+	RTL433_FIELD_TIME,
+	RTL433_FIELD_UNIT,
+	RTL433_FIELD_UNKNOWN
+};
+
+//Must stay sorted on name (binary search)
+static const struct _tRtl433FieldName
+{
+	const char *name;
+	_eRtl433Field field;
+} Rtl433Fields[] = {
+	{ "battery", RTL433_FIELD_BATTERY },
+	{ "channel", RTL433_FIELD_CHANNEL },
+	{ "command", RTL433_FIELD_COMMAND },
+	{ "depth", RTL433_FIELD_DEPTH },
+	{ "depth_cm", RTL433_FIELD_DEPTH_CM },
+	{ "humidity", RTL433_FIELD_HUMIDITY },
+	{ "id", RTL433_FIELD_ID },
+	{ "model", RTL433_FIELD_MODEL },
+	{ "pressure", RTL433_FIELD_PRESSURE },
+	{ "rain", RTL433_FIELD_RAIN },
+	{ "state", RTL433_FIELD_STATE },
+	{ "temperature_C", RTL433_FIELD_TEMPERATURE_C },
+	{ "time", RTL433_FIELD_TIME },
+	{ "unit", RTL433_FIELD_UNIT },
+};
+
+static _eRtl433Field FindRtl433Field(const char *key, const size_t len)
+{
+	int low = 0;
+	int high = (int)(sizeof(Rtl433Fields) / sizeof(Rtl433Fields[0])) - 1;
+	while (low <= high)
+	{
+		int mid = (low + high) / 2;
+		const char *name = Rtl433Fields[mid].name;
+		int cmp = strncmp(name, key, len);
+		if ((cmp == 0) && (name[len] != 0))
+			cmp = 1;
+		if (cmp == 0)
+			return Rtl433Fields[mid].field;
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return RTL433_FIELD_UNKNOWN;
+}
+
+static uint64_t HashRtl433Bytes(uint64_t hash, const void *data, const size_t len)
 {
-	std::vector<std::string> line;
-	std::string field;
-	const char *s = input;
-	while (*s)
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t i = 0; i < len; i++)
 	{
-		if (*s == '\\')
+		hash ^= p[i];
+		hash *= RTL433_FNV_PRIME;
+	}
+	return hash;
+}
+
+static bool SliceEquals(const char *str, const size_t len, const char *value)
+{
+	return (strncmp(str, value, len) == 0) && (value[len] == 0);
+}
+
+static const char *SkipJSONWhitespace(const char *p)
+{
+	while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+		p++;
+	return p;
+}
+
+//Returns the position after the closing quote, or NULL when the string is not terminated
+static const char *SkipJSONString(const char *p)
+{
+	p++;
+	while (*p)
+	{
+		if (*p == '\\')
 		{
-			s++;
-			if (*s) {
-				field += *s;
+			p++;
+			if (!*p)
+				return NULL;
+		}
+		else if (*p == '"')
+			return p + 1;
+		p++;
+	}
+	return NULL;
+}
+
+//Skips a string, number, literal or nested object/array
+static const char *SkipJSONValue(const char *p)
+{
+	if (*p == '"')
+		return SkipJSONString(p);
+	if ((*p == '{') || (*p == '['))
+	{
+		int depth = 0;
+		while (*p)
+		{
+			if (*p == '"')
+			{
+				p = SkipJSONString(p);
+				if (p == NULL)
+					return NULL;
+				continue;
 			}
+			if ((*p == '{') || (*p == '['))
+				depth++;
+			else if ((*p == '}') || (*p == ']'))
+			{
+				if (--depth == 0)
+					return p + 1;
+			}
+			p++;
+		}
+		return NULL;
+	}
+	while ((*p) && (*p != ',') && (*p != '}') && (*p != ']') && (*p != ' ') && (*p != '\t') && (*p != '\r') && (*p != '\n'))
+		p++;
+	return p;
+}
+
+//Parses one line of 'rtl_433 -F json' output in place, values are converted straight from the line buffer
+bool CRtl433::ParseJSONLine(const char *line, _tRtl433Frame &frame)
+{
+	memset(&frame, 0, sizeof(frame));
+	frame.batterylevel = 255;
+	uint64_t hash = RTL433_FNV_OFFSET;
+
+	const char *p = SkipJSONWhitespace(line);
+	if (*p != '{')
+		return false;
+	p = SkipJSONWhitespace(p + 1);
+	while (true)
+	{
+		if (*p != '"')
+			return false;
+		const char *key = p + 1;
+		const char *keyEnd = SkipJSONString(p);
+		if (keyEnd == NULL)
+			return false;
+		const size_t keyLen = keyEnd - key - 1;
+		p = SkipJSONWhitespace(keyEnd);
+		if (*p != ':')
+			return false;
+		const char *value = SkipJSONWhitespace(p + 1);
+		const char *valueEnd = SkipJSONValue(value);
+		if ((valueEnd == NULL) || (valueEnd == value))
+			return false;
+
+		const _eRtl433Field field = FindRtl433Field(key, keyLen);
+		//the time differs for every repeat of the same frame
+		if (field != RTL433_FIELD_TIME)
+			hash = HashRtl433Bytes(hash, key, valueEnd - key);
+
+		const bool bString = (*value == '"');
+		const char *str = (bString) ? value + 1 : value;
+		const size_t len = (bString) ? valueEnd - value - 2 : valueEnd - value;
+		if ((len > 0) && (!SliceEquals(str, len, "null")))
+		{
+			//atoi/atof stop at the closing quote or delimiter
+			switch (field)
+			{
+			case RTL433_FIELD_ID:
+				frame.id = atoi(str);
+				frame.hasid = true;
+				break;
+			case RTL433_FIELD_UNIT:
+				frame.unit = atoi(str);
+				frame.hasunit = true;
+				break;
+			case RTL433_FIELD_CHANNEL:
+				frame.channel = atoi(str);
+				frame.haschannel = true;
+				break;
+			case RTL433_FIELD_BATTERY:
+				if (SliceEquals(str, len, "LOW"))
+				{
+					frame.batterylevel = 10;
+					frame.hasbattery = true;
+				}
+				else if (SliceEquals(str, len, "OK"))
+				{
+					frame.batterylevel = 100;
+					frame.hasbattery = true;
+				}
+				break;
+			case RTL433_FIELD_TEMPERATURE_C:
+				frame.tempC = (float)atof(str);
+				frame.hastempC = true;
+				break;
+			case RTL433_FIELD_HUMIDITY:
+				frame.humidity = atoi(str);
+				frame.hashumidity = true;
+				break;
+			case RTL433_FIELD_PRESSURE:
+				frame.pressure = (float)atof(str);
+				frame.haspressure = true;
+				break;
+			case RTL433_FIELD_RAIN:
+				frame.rain = (float)atof(str);
+				frame.hasrain = true;
+				break;
+			case RTL433_FIELD_DEPTH_CM:
+				frame.depth_cm = (float)atof(str);
+				frame.hasdepth_cm = true;
+				break;
+			case RTL433_FIELD_DEPTH:
+				frame.depth = (float)atof(str);
+				frame.hasdepth = true;
+				break;
+			case RTL433_FIELD_MODEL:
+				{
+					size_t mlen = (len < sizeof(frame.model) - 1) ? len : sizeof(frame.model) - 1;
+					memcpy(frame.model, str, mlen);
+					frame.model[mlen] = 0;
+				}
+				break;
+			case RTL433_FIELD_STATE:
+				frame.hasstate = true;
+				if (SliceEquals(str, len, "ON"))
+					frame.state = true;
+				break;
+			case RTL433_FIELD_COMMAND:
+				frame.hasstate = true;
+				if (SliceEquals(str, len, "On"))
+					frame.state = true;
+				break;
+			default:
+				break;
+			}
+		}
+
+		p = SkipJSONWhitespace(valueEnd);
+		if (*p == ',')
+		{
+			p = SkipJSONWhitespace(p + 1);
+			continue;
+		}
+		if (*p == '}')
+			break;
+		return false;
+	}
+	frame.contentHash = hash;
+	return true;
+}
+
+//Sensors repeat each frame a few times, skip identical frames of the same device within a short window
+bool CRtl433::IsDuplicate(const _tRtl433Frame &frame, const time_t atime)
+{
+	uint64_t key = HashRtl433Bytes(RTL433_FNV_OFFSET, frame.model, strlen(frame.model));
+	key = HashRtl433Bytes(key, &frame.id, sizeof(frame.id));
+	key = HashRtl433Bytes(key, &frame.channel, sizeof(frame.channel));
+
+	std::map<uint64_t, _tLastFrame>::iterator itt = m_lastFrames.find(key);
+	if (itt != m_lastFrames.end())
+	{
+		if ((itt->second.contentHash == frame.contentHash) && (atime - itt->second.time < RTL433_DUPLICATE_WINDOW))
+			return true;
+		itt->second.contentHash = frame.contentHash;
+		itt->second.time = atime;
+		return false;
+	}
+	if (m_lastFrames.size() >= RTL433_MAX_LAST_FRAMES)
+	{
+		//entries outside the window can not match anymore
+		itt = m_lastFrames.begin();
+		while (itt != m_lastFrames.end())
+		{
+			if (atime - itt->second.time >= RTL433_DUPLICATE_WINDOW)
+				m_lastFrames.erase(itt++);
+			else
+				++itt;
+		}
+	}
+	_tLastFrame lframe;
+	lframe.contentHash = frame.contentHash;
+	lframe.time = atime;
+	m_lastFrames[key] = lframe;
+	return false;
+}
+
+bool CRtl433::ProcessLine(const char *line)
+{
+	const char *p = line;
+	while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+		p++;
+	if (*p == 0)
+		return false;
+
+	_tRtl433Frame frame;
+	if (!ParseJSONLine(p, frame))
+	{
+		_log.Log(LOG_ERROR, "Rtl433: Invalid data received! (%s)", line);
+		return false;
+	}
+	if (IsDuplicate(frame, time(NULL)))
+		return true;
+	HandleFrame(frame, line);
+	return true;
+}
+
+void CRtl433::HandleFrame(const _tRtl433Frame &frame, const char *line)
+{
+	const std::string model = frame.model;
+
+	if (frame.hasstate)
+	{
+		unsigned int switchidx = (frame.id & 0xfffffff) | ((frame.channel & 0xf) << 28);
+		SendSwitch(switchidx,
+			frame.unit,
+			frame.batterylevel,
+			frame.state,
+			0,
+			model);
+		return;
+	}
+
+	unsigned int sensoridx = (frame.id & 0xff) | ((frame.channel & 0xff) << 8);
+	bool bHaveSend = false;
+	if (frame.hastempC && frame.hashumidity && frame.haspressure)
+	{
+		int iForecast = 0;
+		SendTempHumBaroSensor(sensoridx,
+			frame.batterylevel,
+			frame.tempC,
+			frame.humidity,
+			frame.pressure,
+			iForecast,
+			model);
+		bHaveSend = true;
+	}
+	else if (frame.hastempC && frame.hashumidity)
+	{
+		SendTempHumSensor(sensoridx,
+			frame.batterylevel,
+			frame.tempC,
+			frame.humidity,
+			model);
+		bHaveSend = true;
+	}
+	else if (frame.hastempC && !frame.hashumidity)
+	{
+		SendTempSensor(sensoridx,
+			frame.batterylevel,
+			frame.tempC,
+			model);
+		bHaveSend = true;
+	}
+	else if (!frame.hastempC && frame.hashumidity)
+	{
+		SendHumiditySensor(sensoridx,
+			frame.batterylevel,
+			frame.humidity,
+			model);
+		bHaveSend = true;
+	}
+
+	if (frame.hasrain)
+	{
+		SendRainSensor(sensoridx,
+			frame.batterylevel,
+			frame.rain,
+			model);
+		bHaveSend = true;
+	}
+	if (frame.hasdepth_cm)
+	{
+		SendDistanceSensor(sensoridx, frame.unit,
+			frame.batterylevel, frame.depth_cm, model);
+		bHaveSend = true;
+	}
+	if (frame.hasdepth)
+	{
+		SendDistanceSensor(sensoridx, frame.unit,
+			frame.batterylevel, frame.depth, model);
+		bHaveSend = true;
+	}
+
+	if (!bHaveSend)
+	{
+		_log.Log(LOG_STATUS, "Rtl433: Unhandled sensor type, please report: (%s)", line);
+	}
+}
+
+bool CRtl433::ParseData(const char *data, const size_t len)
+{
+	bool bHaveReceivedData = false;
+	const char *pData = data;
+	const char *pEnd = data + len;
+	while (pData < pEnd)
+	{
+		const char *pNewLine = (const char*)memchr(pData, '\n', pEnd - pData);
+		const size_t chunk = ((pNewLine != NULL) ? pNewLine : pEnd) - pData;
+		if (m_bSkipLine)
+		{
+			if (pNewLine != NULL)
+				m_bSkipLine = false;
 		}
-		else if (*s == ',')
+		else if (m_lineLen + chunk > sizeof(m_line) - 1)
 		{
-			line.push_back(field);
-			field.clear();
+			_log.Log(LOG_ERROR, "Rtl433: Line too long, discarding data!");
+			m_lineLen = 0;
+			//without the end of the line the remainder would be parsed as a new line
+			m_bSkipLine = (pNewLine == NULL);
 		}
 		else
 		{
-			field += *s;
+			memcpy(m_line + m_lineLen, pData, chunk);
+			m_lineLen += chunk;
+			if (pNewLine != NULL)
+			{
+				m_line[m_lineLen] = 0;
+				if (ProcessLine(m_line))
+					bHaveReceivedData = true;
+				m_lineLen = 0;
+			}
 		}
-		s++;
+		pData += chunk;
+		if (pNewLine != NULL)
+			pData++;
 	}
-	return line;
+	return bHaveReceivedData;
 }
 
 void CRtl433::Do_Work()
@@ -95,11 +518,11 @@ void CRtl433::Do_Work()
 	bool bHaveReceivedData = false;
 	while (!m_stoprequested)
 	{
-		char line[2048];
-		std::vector<std::string> headers;
-		std::string sLastLine = "";
+		m_lastFrames.clear();
+		m_lineLen = 0;
+		m_bSkipLine = false;
 
-		std::string szFlags = "-F csv -q -I 2 " + m_cmdline; // -f 433.92e6 -f 868.24e6 -H 60 -d 0
+		std::string szFlags = "-F json -q -I 2 " + m_cmdline; // -f 433.92e6 -f 868.24e6 -H 60 -d 0
 #ifdef WIN32
 		std::string szCommand = "C:\\rtl_433.exe " + szFlags;
 		m_hPipe = _popen(szCommand.c_str(), "r");
@@ -122,247 +545,57 @@ void CRtl433::Do_Work()
 			}
 			continue;
 		}
-#ifndef WIN32
-		//Set to non-blocking mode
+#ifdef WIN32
+		char line[2048];
+		while (!m_stoprequested)
+		{
+			if (m_hPipe == NULL)
+				break;
+			line[0] = 0;
+			if (fgets(line, sizeof(line) - 1, m_hPipe) == NULL)
+				break; // bail out, subprocess has failed
+			if (ProcessLine(line))
+				bHaveReceivedData = true;
+		} // while !m_stoprequested
+#else
+		//Set to non-blocking mode, and wait for data with select so a stop request is handled quickly
 		int fd = fileno(m_hPipe);
 		int flags;
 		flags = fcntl(fd, F_GETFL, 0);
 		flags |= O_NONBLOCK;
 		fcntl(fd, F_SETFL, flags);
-#endif
-		bool bFirstTime = true;
-		time_t time_last_received = time(NULL);
+
+		char buffer[1024];
 		while (!m_stoprequested)
 		{
-			sleep_milliseconds(100);
-			if (m_hPipe == NULL)
-				break;
-			//size_t bread = read(fd, (char*)&line, sizeof(line));
-			line[0] = 0;
-			if (fgets(line, sizeof(line) - 1, m_hPipe) != NULL)
+			fd_set fds;
+			FD_ZERO(&fds);
+			FD_SET(fd, &fds);
+			struct timeval tv;
+			tv.tv_sec = 0;
+			tv.tv_usec = 500000;
+			int ret = select(fd + 1, &fds, NULL, NULL, &tv);
+			if (ret < 0)
 			{
-				bHaveReceivedData = true;
-
-				if (bFirstTime)
-				{
-					bFirstTime = false;
-					headers = ParseCSVLine(line);
+				if (errno == EINTR)
 					continue;
-				}
-				time_t atime = time(NULL);
-				std::string slineRaw(line);
-				if (slineRaw.find(',') != std::string::npos)
-				{
-					slineRaw = slineRaw.substr(slineRaw.find(',') + 1);
-					if (slineRaw == sLastLine)
-					{
-						if (atime - time_last_received < 2)
-							continue; //skip duplicate RF frames
-					}
-					sLastLine = slineRaw;
-				}
-				time_last_received = atime;
-				std::vector<std::string> values = ParseCSVLine(line);
-				// load field values into a map
-				std::map<std::string, std::string> data;
-				std::vector<std::string>::iterator h = headers.begin();
-				for (std::vector<std::string>::iterator vi = values.begin(); vi != values.end(); vi++)
-				{
-					std::string header = *(h++);
-					data[header] = *vi;
-				}
-				int id = 0;
-				bool hasid = false;
-				int unit = 0;
-				bool hasunit = false;
-				int channel = 0;
-				bool haschannel = false;
-				int batterylevel = 255;
-				bool hasbattery = false;
-				float tempC;
-				bool hastempC = false;
-				int humidity;
-				bool hashumidity = false;
-				float pressure;
-				bool haspressure = false;
-				float rain;
-				bool hasrain = false;
-				float depth_cm;
-				bool hasdepth_cm = false;
-				float depth;
-				bool hasdepth = false;
-				// attempt parsing field values
-				//atoi/f functions return 0 if string conv fails.
-
-				if (!data["id"].empty()) {
-					id = atoi(data["id"].c_str());
-					hasid = true;
-				}
-
-
-				if (!data["unit"].empty())
-				{
-					unit = atoi(data["unit"].c_str());
-					hasunit = true;
-				}
-
-
-				if (!data["channel"].empty())
-				{
-					channel = atoi(data["channel"].c_str());
-					haschannel = true;
-				}
-
-				if (!data["battery"].empty())
-				{
-					if (data["battery"] == "LOW") {
-						batterylevel = 10;
-						hasbattery = true;
-					}
-					if (data["battery"] == "OK") {
-						batterylevel = 100;
-						hasbattery = true;
-					}
-				}
-
-				if (!data["temperature_C"].empty())
-				{
-					tempC = (float)atof(data["temperature_C"].c_str());
-					hastempC = true;
-				}
-
-
-				if (!data["humidity"].empty())
-				{
-					humidity = atoi(data["humidity"].c_str());
-					hashumidity = true;
-				}
-
-				if (!data["pressure"].empty())
-				{
-					pressure = (float)atof(data["pressure"].c_str());
-					haspressure = true;
-				}
-
-				if (!data["rain"].empty())
-				{
-					rain = (float)atof(data["rain"].c_str());
-					hasrain = true;
-				}
-				if (!data["depth_cm"].empty())
-				{
-					depth_cm = (float)atof(data["depth_cm"].c_str());
-					hasdepth_cm = true;
-				}
-
-				if (!data["depth"].empty())
-				{
-					depth = (float)atof(data["depth"].c_str());
-					hasdepth = true;
-				}
-
-
-				std::string model = data["model"];
-
-				bool hasstate =
-					(!data["state"].empty()) ||
-					(!data["command"].empty());
-				bool state =
-					data["state"] == "ON" ||
-					data["command"] == "On";
-
-				if (hasstate)
-				{
-					unsigned int switchidx = (id & 0xfffffff) | ((channel & 0xf) << 28);
-					SendSwitch(switchidx,
-						unit,
-						batterylevel,
-						state,
-						0,
-						model);
-					continue;
-				}
-
-				unsigned int sensoridx = (id & 0xff) | ((channel & 0xff) << 8);
-				bool bHaveSend = false;
-				if (hastempC && hashumidity && haspressure)
-				{
-					int iForecast = 0;
-					SendTempHumBaroSensor(sensoridx,
-						batterylevel,
-						tempC,
-						humidity,
-						pressure,
-						iForecast,
-						model);
-					bHaveSend = true;
-				}
-				else if (hastempC && hashumidity)
-				{
-					SendTempHumSensor(sensoridx,
-						batterylevel,
-						tempC,
-						humidity,
-						model);
-					bHaveSend = true;
-				}
-				else if (hastempC && !hashumidity)
-				{
-					SendTempSensor(sensoridx,
-						batterylevel,
-						tempC,
-						model);
-					bHaveSend = true;
-				}
-				else if (!hastempC && hashumidity)
-				{
-					SendHumiditySensor(sensoridx,
-						batterylevel,
-						humidity,
-						model);
-					bHaveSend = true;
-				}
-
-				if (hasrain)
-				{
-					SendRainSensor(sensoridx,
-						batterylevel,
-						rain,
-						model);
-					bHaveSend = true;
-				}
-				if (hasdepth_cm)
-				{
-
-					SendDistanceSensor(sensoridx, unit,
-						batterylevel, depth_cm, model);
-					bHaveSend = true;
-				}
-				if (hasdepth)
-				{
-
-					SendDistanceSensor(sensoridx, unit,
-						batterylevel, depth, model);
-					bHaveSend = true;
-				}
-
-				if (!bHaveSend)
-				{
-					_log.Log(LOG_STATUS, "Rtl433: Unhandled sensor type, please report: (%s)", line);
-				}
-				else
-				{
-					//Useful as some sensors will be skipped if temp is available  	
-					//_log.Log(LOG_NORM, "Rtl433: Raw Data: (%s)", line);
-				}
+				break;
 			}
-			else { //fgets
-				if ((errno == EWOULDBLOCK)|| (errno == EAGAIN)) {
+			if (ret == 0)
+				continue;
+			ssize_t bread = read(fd, buffer, sizeof(buffer));
+			if (bread == 0)
+				break; // subprocess has exited
+			if (bread < 0)
+			{
+				if ((errno == EWOULDBLOCK) || (errno == EAGAIN) || (errno == EINTR))
 					continue;
-				}
 				break; // bail out, subprocess has failed
 			}
+			if (ParseData(buffer, (size_t)bread))
+				bHaveReceivedData = true;
 		} // while !m_stoprequested
+#endif
 		if (m_hPipe)
 		{
 #ifdef WIN32
@@ -9,15 +9,57 @@ public:
 	virtual ~CRtl433();
 
 	bool WriteToHardware(const char *pdata, const unsigned char length);
+protected:
+	//Splits the rtl_433 output into lines and handles them, data may end in the middle of a line
+	bool ParseData(const char *data, const size_t len);
 private:
+	struct _tRtl433Frame
+	{
+		char model[64];
+		int id;
+		bool hasid;
+		int unit;
+		bool hasunit;
+		int channel;
+		bool haschannel;
+		int batterylevel;
+		bool hasbattery;
+		float tempC;
+		bool hastempC;
+		int humidity;
+		bool hashumidity;
+		float pressure;
+		bool haspressure;
+		float rain;
+		bool hasrain;
+		float depth_cm;
+		bool hasdepth_cm;
+		float depth;
+		bool hasdepth;
+		bool state;
+		bool hasstate;
+		uint64_t contentHash; //hash of all fields except the time
+	};
+	struct _tLastFrame
+	{
+		uint64_t contentHash;
+		time_t time;
+	};
 	volatile bool m_stoprequested;
 	boost::shared_ptr<boost::thread> m_thread;
 	boost::mutex m_pipe_mutex;
 	FILE *m_hPipe;
 	std::string m_cmdline;
+	std::map<uint64_t, _tLastFrame> m_lastFrames; //keyed on model+id+channel
+	char m_line[2048];
+	size_t m_lineLen;
+	bool m_bSkipLine; //rest of a line that was too long
 
 	bool StartHardware();
 	bool StopHardware();
 	void Do_Work();
-	static std::vector<std::string> ParseCSVLine(const char *input);
+	static bool ParseJSONLine(const char *line, _tRtl433Frame &frame);
+	bool IsDuplicate(const _tRtl433Frame &frame, const time_t atime);
+	bool ProcessLine(const char *line);
+	void HandleFrame(const _tRtl433Frame &frame, const char *line);
 };
@@ -9,6 +9,7 @@
 #include "../main/localtime_r.h"
 #include "../main/mainworker.h"
 #include "../main/SQLHelper.h"
+#include "../notifications/NotificationHelper.h"
 
 #ifdef _DEBUG
 	#define DEBUG_SatelIntegra
@@ -1012,6 +1013,7 @@ void SatelIntegra::UpdateZoneName(const int Idx, const unsigned char* name, cons
 		_log.Log(LOG_STATUS, "Satel Integra: update name for %d to '%s:%s'", Idx, namePrefix.c_str(), shortName.c_str());
 #endif
 		m_sql.safe_query("UPDATE DeviceStatus SET Name='%q:%q', SwitchType=%d, Unit=%d WHERE (HardwareID==%d) AND (DeviceID=='%q') AND (Unit=1)", namePrefix.c_str(), shortName.c_str(), STYPE_Contact, partition, m_HwdID, szTmp);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szTmp);
 	}
 }
 
@@ -1035,6 +1037,7 @@ void SatelIntegra::UpdateTempName(const int Idx, const unsigned char* name, cons
 		_log.Log(LOG_STATUS, "Satel Integra: update name for %d to 'Temp:%s'", Idx, shortName.c_str());
 #endif
 		m_sql.safe_query("UPDATE DeviceStatus SET Name='Temp:%q', SwitchType=%d, Unit=%d WHERE (HardwareID==%d) AND (DeviceID=='%q') AND (Unit=0)", shortName.c_str(), STYPE_Contact, partition, m_HwdID, szTmp);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szTmp);
 	}
 }
 
@@ -1065,6 +1068,7 @@ void SatelIntegra::UpdateOutputName(const int Idx, const unsigned char* name, co
 #endif
 
 		m_sql.safe_query("UPDATE DeviceStatus SET Name='Output:%q', SwitchType=%d WHERE (HardwareID==%d) AND (DeviceID=='%q') AND (Unit=1)", shortName.c_str(), switchType, m_HwdID, szTmp);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szTmp);
 	}
 }
 
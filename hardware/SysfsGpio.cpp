@@ -127,6 +127,7 @@
 #include "../main/mainworker.h"
 #include "../main/SQLHelper.h"
 #include "../main/localtime_r.h"
+#include "../notifications/NotificationHelper.h"
 
 /*
 Note:
@@ -680,6 +681,7 @@ void CSysfsGpio::UpdateDomoticzDatabase()
 				m_sql.safe_query(
 					"UPDATE DeviceStatus SET nValue=%d,Options=%d WHERE (HardwareID==%d) AND (Unit==%d)",
 					m_saved_state[i].value, m_saved_state[i].direction, m_HwdID, m_saved_state[i].pin_number);
+				m_notifications.InvalidateDeviceInfo(m_HwdID, "");
 
 				m_saved_state[i].db_state = m_saved_state[i].value;
 				m_saved_state[i].id_valid = -1;
@@ -89,6 +89,9 @@ void CTeleinfoBase::ProcessTeleinfo(const std::string &name, int rank, Teleinfo
 	}
 	rank = rank -1;				 // Now it is 0 to 3
 
+	// All readings of one frame are processed as a single batch
+	BeginBatch();
+
 	// Guess if we are running with one phase or three
 	// some devices like EcoDevices always send all variables so presence/absence of IINSTx is not significant
 	// Also, EcoDevices always sends the same value for IINST and IINST1, so check must be done on IINST2 and IINST3
@@ -337,4 +340,5 @@ void CTeleinfoBase::ProcessTeleinfo(const std::string &name, int rank, Teleinfo
 			}
 		}
 	}
+	EndBatch();
 }
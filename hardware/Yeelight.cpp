@@ -9,6 +9,7 @@
 #include "../main/WebServer.h"
 #include "../webserver/cWebem.h"
 #include "../json/json.h"
+#include "../notifications/NotificationHelper.h"
 
 /*
 Yeelight (Mi Light) is a company that created White and RGBW lights
@@ -159,6 +160,7 @@ void Yeelight::InsertUpdateSwitch(const std::string &nodeID, const std::string &
 		ycmd.command = cmd;
 		m_mainworker.PushAndWaitRxMessage(this, (const unsigned char *)&ycmd, NULL, -1);
 		m_sql.safe_query("UPDATE DeviceStatus SET Name='%q', SwitchType=%d, LastLevel=%d WHERE(HardwareID == %d) AND (DeviceID == '%q')", lightName.c_str(), (STYPE_Dimmer), value, m_HwdID, szDeviceID);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szDeviceID);
 	}
 	else {
 
@@ -17,6 +17,7 @@
 #include "../main/SQLHelper.h"
 
 #include "OpenZWave.h"
+#include "../notifications/NotificationHelper.h"
 
 #define CONTROLLER_COMMAND_TIMEOUT 30
 
@@ -238,6 +239,7 @@ void ZWaveBase::SendSwitchIfNotExists(const _tZWaveDevice *pDevice)
 
 		//Set Switch Type
 		m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (HardwareID==%d) AND (DeviceID=='%q')", STYPE_Dimmer, m_HwdID, szID);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szID);
 	}
 	else
 	{
@@ -312,6 +314,7 @@ void ZWaveBase::SendSwitchIfNotExists(const _tZWaveDevice *pDevice)
 		//Set SwitchType
 		m_sql.safe_query("UPDATE DeviceStatus SET SwitchType=%d WHERE (HardwareID==%d) AND (Unit==%d) AND (Type==%d) AND (SubType==%d) AND (DeviceID=='%q')",
 			SwitchType, m_HwdID, int(unitcode), pTypeGeneralSwitch, sSwitchGeneralSwitch, szID);
+		m_notifications.InvalidateDeviceInfo(m_HwdID, szID);
 	}
 }
 
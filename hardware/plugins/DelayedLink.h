@@ -81,6 +81,10 @@ namespace Plugins {
 		DECLARE_PYTHON_SYMBOL(void, PyErr_Clear, );
 		DECLARE_PYTHON_SYMBOL(void, PyErr_Fetch, PyObject** COMMA PyObject** COMMA PyObject**);
 		DECLARE_PYTHON_SYMBOL(PyObject*, PyImport_ImportModule, const char*);
+		DECLARE_PYTHON_SYMBOL(PyObject*, PyImport_AddModule, const char*);
+		DECLARE_PYTHON_SYMBOL(PyObject*, Py_CompileStringExFlags, const char* COMMA const char* COMMA int COMMA PyCompilerFlags* COMMA int);
+		DECLARE_PYTHON_SYMBOL(PyObject*, PyEval_EvalCode, PyObject* COMMA PyObject* COMMA PyObject*);
+		DECLARE_PYTHON_SYMBOL(void, PyErr_Print, );
 		DECLARE_PYTHON_SYMBOL(PyObject*, PyObject_CallObject, PyObject* COMMA PyObject*);
 		DECLARE_PYTHON_SYMBOL(int, PyFrame_GetLineNumber, PyFrameObject*);
 		DECLARE_PYTHON_SYMBOL(PyThreadState*, PyEval_SaveThread, void);
@@ -184,6 +188,10 @@ namespace Plugins {
 					RESOLVE_PYTHON_SYMBOL(PyErr_Clear);
 					RESOLVE_PYTHON_SYMBOL(PyErr_Fetch);
 					RESOLVE_PYTHON_SYMBOL(PyImport_ImportModule);
+					RESOLVE_PYTHON_SYMBOL(PyImport_AddModule);
+					RESOLVE_PYTHON_SYMBOL(Py_CompileStringExFlags);
+					RESOLVE_PYTHON_SYMBOL(PyEval_EvalCode);
+					RESOLVE_PYTHON_SYMBOL(PyErr_Print);
 					RESOLVE_PYTHON_SYMBOL(PyObject_CallObject);
 					RESOLVE_PYTHON_SYMBOL(PyFrame_GetLineNumber);
 					RESOLVE_PYTHON_SYMBOL(PyEval_SaveThread);
@@ -347,6 +355,10 @@ extern	SharedLibraryProxy* pythonLib;
 #define PyErr_Clear				pythonLib->PyErr_Clear
 #define PyErr_Fetch				pythonLib->PyErr_Fetch
 #define PyImport_ImportModule	pythonLib->PyImport_ImportModule
+#define PyImport_AddModule		pythonLib->PyImport_AddModule
+#define Py_CompileStringExFlags	pythonLib->Py_CompileStringExFlags
+#define PyEval_EvalCode			pythonLib->PyEval_EvalCode
+#define PyErr_Print				pythonLib->PyErr_Print
 #define PyObject_CallObject		pythonLib->PyObject_CallObject
 #define PyFrame_GetLineNumber	pythonLib->PyFrame_GetLineNumber
 #define PyEval_SaveThread		pythonLib->PyEval_SaveThread
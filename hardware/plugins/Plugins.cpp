@@ -15,6 +15,7 @@
 
 #include "../main/Helper.h"
 #include "../main/Logger.h"
+#include "../main/Metrics.h"
 #include "../main/SQLHelper.h"
 #include "../main/mainworker.h"
 #include "../main/localtime_r.h"
@@ -1313,6 +1314,7 @@ namespace Plugins {
 				{
 					if (m_bDebug) _log.Log(LOG_NORM, "(%s) Calling message handler '%s'.", Name.c_str(), sHandler.c_str());
 
+					CMetricTimer timer(m_metrics.GetHistogram("plugin_callback", "callback", Name + "." + sHandler));
 					PyErr_Clear();
 					PyObject*	pReturnValue = PyObject_CallObject(pFunc, (PyObject*)pParams);
 					if (!pReturnValue)
@@ -1499,6 +1501,7 @@ namespace Plugins {
 
 	CPluginNotifier::~CPluginNotifier()
 	{
+		StopThread();
 		m_notifications.RemoveNotifier(this);
 	}
 
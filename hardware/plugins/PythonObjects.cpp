@@ -10,12 +10,14 @@
 #include "../hardware/hardwaretypes.h"
 #include "../main/localtime_r.h"
 #include "../main/mainworker.h"
+#include "../main/DeviceSnapshot.h"
 #include "../main/EventSystem.h"
 #include "PythonObjects.h"
 #include "PluginMessages.h"
 #include "PluginProtocols.h"
 #include "PluginTransports.h"
 #include <datetime.h>
+#include "../notifications/NotificationHelper.h"
 
 namespace Plugins {
 
@@ -784,6 +786,7 @@ namespace Plugins {
 			m_sql.UpdateValue(self->HwdID, sDeviceID.c_str(), (const unsigned char)self->Unit, (const unsigned char)self->Type, (const unsigned char)self->SubType, iSignalLevel, iBatteryLevel, nValue, std::string(sValue).c_str(), sName, true);
 
 			// Notify MQTT and various push mechanisms
+			m_devicesnapshots.Invalidate(self->ID);
 			m_mainworker.sOnDeviceReceived(self->pPlugin->m_HwdID, self->ID, self->pPlugin->Name, NULL);
 
 			// Image change
@@ -794,6 +797,7 @@ namespace Plugins {
 				localtime_r(&now, &ltime);
 				m_sql.safe_query("UPDATE DeviceStatus SET CustomImage=%d, LastUpdate='%04d-%02d-%02d %02d:%02d:%02d' WHERE (HardwareID==%d) and (Unit==%d)",
 					iImage, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday, ltime.tm_hour, ltime.tm_min, ltime.tm_sec, self->HwdID, self->Unit);
+				m_notifications.InvalidateDeviceInfo(self->HwdID, "");
 			}
 
 			if ((self->SubType != sTypeCustom) && (pOptionsDict != NULL))
@@ -0,0 +1,466 @@
+#include "stdafx.h"
+#include "BlocklyCondition.h"
+#include <stdlib.h>
+#include <ctype.h>
+
+//Blockly conditions are compiled when the events are loaded, conditions the compiler does not understand stay Lua
+enum _eBlocklyTokenType
+{
+	BTK_NUMBER = 0,
+	BTK_STRING,
+	BTK_NAME,
+	BTK_OPERATOR,
+	BTK_LPAREN,
+	BTK_RPAREN,
+	BTK_LBRACKET,
+	BTK_RBRACKET
+};
+
+enum _eBlocklyNodeType
+{
+	BN_NIL = 0,
+	BN_BOOL,
+	BN_NUMBER,
+	BN_STRING,
+	BN_TABLE,
+	BN_GLOBAL,
+	BN_NOT,
+	BN_AND,
+	BN_OR,
+	BN_COMPARE
+};
+
+enum _eBlocklyOperator
+{
+	BOP_EQ = 0,
+	BOP_NE,
+	BOP_LT,
+	BOP_LE,
+	BOP_GT,
+	BOP_GE
+};
+
+static const struct
+{
+	const char *szName;
+	int iTable;
+} BlocklyTables[] =
+{
+	{ "device", BT_DEVICE },
+	{ "variable", BT_VARIABLE },
+	{ "temperaturedevice", BT_TEMPERATURE },
+	{ "dewpointdevice", BT_DEWPOINT },
+	{ "humiditydevice", BT_HUMIDITY },
+	{ "barometerdevice", BT_BAROMETER },
+	{ "utilitydevice", BT_UTILITY },
+	{ "weatherdevice", BT_WEATHER },
+	{ "raindevice", BT_RAIN },
+	{ "rainlasthourdevice", BT_RAINLASTHOUR },
+	{ "uvdevice", BT_UV },
+	{ "winddirdevice", BT_WINDDIR },
+	{ "windspeeddevice", BT_WINDSPEED },
+	{ "windgustdevice", BT_WINDGUST },
+	{ "zwavealarms", BT_ZWAVEALARMS },
+	{ NULL, 0 }
+};
+
+static const struct
+{
+	const char *szName;
+	int iGlobal;
+} BlocklyGlobals[] =
+{
+	{ "timeofday", BG_TIMEOFDAY },
+	{ "weekday", BG_WEEKDAY },
+	{ "securitystatus", BG_SECURITYSTATUS },
+	{ "@Sunrise", BG_SUNRISE },
+	{ "@Sunset", BG_SUNSET },
+	{ NULL, 0 }
+};
+
+bool CBlocklyCondition::Tokenize(const std::string &conditions, std::vector<_tToken> &tokens)
+{
+	size_t pos = 0;
+	while (pos < conditions.size())
+	{
+		char c = conditions[pos];
+		if (isspace((unsigned char)c))
+		{
+			pos++;
+			continue;
+		}
+		_tToken token;
+		token.fValue = 0;
+		if (isdigit((unsigned char)c))
+		{
+			char *pEnd = NULL;
+			token.Type = BTK_NUMBER;
+			token.fValue = strtod(conditions.c_str() + pos, &pEnd);
+			size_t end = pEnd - conditions.c_str();
+			token.Text = conditions.substr(pos, end - pos);
+			pos = end;
+		}
+		else if (isalpha((unsigned char)c) || (c == '_') || (c == '@'))
+		{
+			size_t end = pos + 1;
+			while ((end < conditions.size()) && (isalnum((unsigned char)conditions[end]) || (conditions[end] == '_')))
+				end++;
+			token.Type = BTK_NAME;
+			token.Text = conditions.substr(pos, end - pos);
+			pos = end;
+		}
+		else if ((c == '"') || (c == '\''))
+		{
+			token.Type = BTK_STRING;
+			pos++;
+			while ((pos < conditions.size()) && (conditions[pos] != c))
+			{
+				if (conditions[pos] == '\\')
+				{
+					pos++;
+					if (pos >= conditions.size())
+						return false;
+					char e = conditions[pos];
+					if (e == 'n')
+						token.Text += '\n';
+					else if (e == 't')
+						token.Text += '\t';
+					else if ((e == '\\') || (e == '"') || (e == '\''))
+						token.Text += e;
+					else
+						return false;
+				}
+				else
+					token.Text += conditions[pos];
+				pos++;
+			}
+			if (pos >= conditions.size())
+				return false; //unterminated string
+			pos++;
+		}
+		else if ((c == '=') || (c == '~') || (c == '<') || (c == '>'))
+		{
+			token.Type = BTK_OPERATOR;
+			if ((pos + 1 < conditions.size()) && (conditions[pos + 1] == '='))
+			{
+				token.Text = conditions.substr(pos, 2);
+				pos += 2;
+			}
+			else
+			{
+				if ((c == '=') || (c == '~'))
+					return false;
+				token.Text = c;
+				pos++;
+			}
+		}
+		else if (c == '-')
+		{
+			if ((pos + 1 < conditions.size()) && (conditions[pos + 1] == '-'))
+				return false; //comment
+			token.Type = BTK_OPERATOR;
+			token.Text = c;
+			pos++;
+		}
+		else if (c == '(')
+		{
+			token.Type = BTK_LPAREN;
+			pos++;
+		}
+		else if (c == ')')
+		{
+			token.Type = BTK_RPAREN;
+			pos++;
+		}
+		else if (c == '[')
+		{
+			token.Type = BTK_LBRACKET;
+			pos++;
+		}
+		else if (c == ']')
+		{
+			token.Type = BTK_RBRACKET;
+			pos++;
+		}
+		else
+			return false;
+		tokens.push_back(token);
+	}
+	return true;
+}
+
+//Recursive descent with the Lua precedence: or(0) < and(1) < comparison(2) < not/unary minus(3)
+//Returns the index of the created node or -1 on unsupported syntax
+int CBlocklyCondition::ParseExpression(const std::vector<_tToken> &tokens, size_t &pos, std::vector<_tNode> &tree, const int level)
+{
+	_tNode node;
+	node.Type = BN_NIL;
+	node.Operator = 0;
+	node.Table = 0;
+	node.Index = 0;
+	node.fValue = 0;
+	node.Left = -1;
+	node.Right = -1;
+
+	if (level < 3)
+	{
+		int left = ParseExpression(tokens, pos, tree, level + 1);
+		if (left < 0)
+			return -1;
+		while (pos < tokens.size())
+		{
+			const _tToken &token = tokens[pos];
+			if (level == 0)
+			{
+				if ((token.Type != BTK_NAME) || (token.Text != "or"))
+					break;
+				node.Type = BN_OR;
+			}
+			else if (level == 1)
+			{
+				if ((token.Type != BTK_NAME) || (token.Text != "and"))
+					break;
+				node.Type = BN_AND;
+			}
+			else
+			{
+				if ((token.Type != BTK_OPERATOR) || (token.Text == "-"))
+					break;
+				node.Type = BN_COMPARE;
+				if (token.Text == "==")
+					node.Operator = BOP_EQ;
+				else if (token.Text == "~=")
+					node.Operator = BOP_NE;
+				else if (token.Text == "<")
+					node.Operator = BOP_LT;
+				else if (token.Text == "<=")
+					node.Operator = BOP_LE;
+				else if (token.Text == ">")
+					node.Operator = BOP_GT;
+				else
+					node.Operator = BOP_GE;
+			}
+			pos++;
+			int right = ParseExpression(tokens, pos, tree, level + 1);
+			if (right < 0)
+				return -1;
+			node.Left = left;
+			node.Right = right;
+			tree.push_back(node);
+			left = (int)tree.size() - 1;
+		}
+		return left;
+	}
+
+	if (pos >= tokens.size())
+		return -1;
+	const _tToken &token = tokens[pos++];
+	switch (token.Type)
+	{
+	case BTK_NUMBER:
+		node.Type = BN_NUMBER;
+		node.fValue = token.fValue;
+		break;
+	case BTK_STRING:
+		node.Type = BN_STRING;
+		node.sValue = token.Text;
+		break;
+	case BTK_OPERATOR:
+		//only a negative number constant
+		if ((token.Text != "-") || (pos >= tokens.size()) || (tokens[pos].Type != BTK_NUMBER))
+			return -1;
+		node.Type = BN_NUMBER;
+		node.fValue = -tokens[pos++].fValue;
+		break;
+	case BTK_LPAREN:
+		{
+			int inner = ParseExpression(tokens, pos, tree, 0);
+			if ((inner < 0) || (pos >= tokens.size()) || (tokens[pos].Type != BTK_RPAREN))
+				return -1;
+			pos++;
+			return inner;
+		}
+	case BTK_NAME:
+		if (token.Text == "not")
+		{
+			int operand = ParseExpression(tokens, pos, tree, 3);
+			if (operand < 0)
+				return -1;
+			node.Type = BN_NOT;
+			node.Left = operand;
+			break;
+		}
+		if (token.Text == "nil")
+			break;
+		if ((token.Text == "true") || (token.Text == "false"))
+		{
+			node.Type = BN_BOOL;
+			node.fValue = (token.Text == "true") ? 1 : 0;
+			break;
+		}
+		if ((pos < tokens.size()) && (tokens[pos].Type == BTK_LBRACKET))
+		{
+			int ii = 0;
+			while ((BlocklyTables[ii].szName != NULL) && (token.Text != BlocklyTables[ii].szName))
+				ii++;
+			if (BlocklyTables[ii].szName == NULL)
+				return -1;
+			if ((pos + 2 >= tokens.size()) || (tokens[pos + 1].Type != BTK_NUMBER) || (tokens[pos + 2].Type != BTK_RBRACKET))
+				return -1;
+			node.Type = BN_TABLE;
+			node.Table = BlocklyTables[ii].iTable;
+			node.Index = (uint64_t)tokens[pos + 1].fValue;
+			pos += 3;
+			break;
+		}
+		else
+		{
+			int ii = 0;
+			while ((BlocklyGlobals[ii].szName != NULL) && (token.Text != BlocklyGlobals[ii].szName))
+				ii++;
+			if (BlocklyGlobals[ii].szName == NULL)
+				return -1;
+			node.Type = BN_GLOBAL;
+			node.Table = BlocklyGlobals[ii].iGlobal;
+		}
+		break;
+	default:
+		return -1;
+	}
+	tree.push_back(node);
+	return (int)tree.size() - 1;
+}
+
+void CBlocklyCondition::GetReferences(const std::string &conditions, std::set<uint64_t> &devices, std::set<uint64_t> &variables)
+{
+	size_t pos = 0;
+	while ((pos = conditions.find('[', pos)) != std::string::npos)
+	{
+		size_t start = pos;
+		while ((start > 0) && (isalpha((unsigned char)conditions[start - 1])))
+			start--;
+		std::string table = conditions.substr(start, pos - start);
+		pos++;
+		size_t end = pos;
+		uint64_t idx = 0;
+		while ((end < conditions.size()) && isdigit((unsigned char)conditions[end]))
+			idx = (idx * 10) + (conditions[end++] - '0');
+		if ((end == pos) || (end >= conditions.size()) || (conditions[end] != ']'))
+			continue;
+		if (table == "variable")
+			variables.insert(idx);
+		else
+			devices.insert(idx);
+	}
+}
+
+bool CBlocklyCondition::Compile(const std::string &conditions)
+{
+	std::vector<_tToken> tokens;
+	m_tree.clear();
+	if (!Tokenize(conditions, tokens))
+		return false;
+	size_t pos = 0;
+	int root = ParseExpression(tokens, pos, m_tree, 0);
+	if ((root >= 0) && (pos == tokens.size()))
+		return true;
+	m_tree.clear();
+	return false;
+}
+
+_tBlocklyValue CBlocklyCondition::EvaluateNode(const int nodeIdx, CBlocklyState &state, bool &bError) const
+{
+	const _tNode &node = m_tree[nodeIdx];
+	_tBlocklyValue value;
+	value.Type = BV_NIL;
+	value.fValue = 0;
+
+	switch (node.Type)
+	{
+	case BN_BOOL:
+		value.Type = BV_BOOL;
+		value.fValue = node.fValue;
+		break;
+	case BN_NUMBER:
+		value.Type = BV_NUMBER;
+		value.fValue = node.fValue;
+		break;
+	case BN_STRING:
+		value.Type = BV_STRING;
+		value.sValue = node.sValue;
+		break;
+	case BN_TABLE:
+		return state.GetTableValue(node.Table, node.Index);
+	case BN_GLOBAL:
+		value.Type = BV_NUMBER;
+		value.fValue = state.GetGlobal(node.Table);
+		break;
+	case BN_NOT:
+		{
+			_tBlocklyValue operand = EvaluateNode(node.Left, state, bError);
+			value.Type = BV_BOOL;
+			value.fValue = ((operand.Type == BV_NIL) || ((operand.Type == BV_BOOL) && (operand.fValue == 0))) ? 1 : 0;
+		}
+		break;
+	case BN_AND:
+	case BN_OR:
+		{
+			value = EvaluateNode(node.Left, state, bError);
+			bool bTrue = !((value.Type == BV_NIL) || ((value.Type == BV_BOOL) && (value.fValue == 0)));
+			if (bTrue == (node.Type == BN_AND))
+				value = EvaluateNode(node.Right, state, bError);
+		}
+		break;
+	case BN_COMPARE:
+		{
+			_tBlocklyValue left = EvaluateNode(node.Left, state, bError);
+			_tBlocklyValue right = EvaluateNode(node.Right, state, bError);
+			value.Type = BV_BOOL;
+			if ((node.Operator == BOP_EQ) || (node.Operator == BOP_NE))
+			{
+				bool bEqual = (left.Type == right.Type);
+				if (bEqual)
+				{
+					if (left.Type == BV_STRING)
+						bEqual = (left.sValue == right.sValue);
+					else
+						bEqual = (left.fValue == right.fValue);
+				}
+				value.fValue = (bEqual == (node.Operator == BOP_EQ)) ? 1 : 0;
+				break;
+			}
+			int cmp;
+			if ((left.Type == BV_NUMBER) && (right.Type == BV_NUMBER))
+				cmp = (left.fValue < right.fValue) ? -1 : ((left.fValue > right.fValue) ? 1 : 0);
+			else if ((left.Type == BV_STRING) && (right.Type == BV_STRING))
+				cmp = left.sValue.compare(right.sValue);
+			else
+			{
+				//Lua raises an error here
+				bError = true;
+				break;
+			}
+			if (node.Operator == BOP_LT)
+				value.fValue = (cmp < 0) ? 1 : 0;
+			else if (node.Operator == BOP_LE)
+				value.fValue = (cmp <= 0) ? 1 : 0;
+			else if (node.Operator == BOP_GT)
+				value.fValue = (cmp > 0) ? 1 : 0;
+			else
+				value.fValue = (cmp >= 0) ? 1 : 0;
+		}
+		break;
+	}
+	return value;
+}
+
+bool CBlocklyCondition::Evaluate(CBlocklyState &state, bool &bError) const
+{
+	bError = false;
+	if (m_tree.empty())
+		return false;
+	_tBlocklyValue result = EvaluateNode((int)m_tree.size() - 1, state, bError);
+	if (bError)
+		return false;
+	return !((result.Type == BV_NIL) || ((result.Type == BV_BOOL) && (result.fValue == 0)));
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <stdint.h>
+
+enum _eBlocklyValueType
+{
+	BV_NIL = 0,
+	BV_BOOL,
+	BV_NUMBER,
+	BV_STRING
+};
+
+//The Lua tables a condition can refer to (device[12], temperaturedevice[5], ...)
+enum _eBlocklyTable
+{
+	BT_DEVICE = 0,
+	BT_VARIABLE,
+	BT_TEMPERATURE,
+	BT_DEWPOINT,
+	BT_HUMIDITY,
+	BT_BAROMETER,
+	BT_UTILITY,
+	BT_WEATHER,
+	BT_RAIN,
+	BT_RAINLASTHOUR,
+	BT_UV,
+	BT_WINDDIR,
+	BT_WINDSPEED,
+	BT_WINDGUST,
+	BT_ZWAVEALARMS
+};
+
+enum _eBlocklyGlobal
+{
+	BG_TIMEOFDAY = 0,
+	BG_WEEKDAY,
+	BG_SECURITYSTATUS,
+	BG_SUNRISE,
+	BG_SUNSET
+};
+
+struct _tBlocklyValue
+{
+	int Type;
+	double fValue;
+	std::string sValue;
+};
+
+//Supplies the device/variable states and globals a condition reads while it is evaluated
+class CBlocklyState
+{
+public:
+	virtual ~CBlocklyState() {}
+	//Type BV_NIL when the table has no such idx
+	virtual _tBlocklyValue GetTableValue(const int table, const uint64_t idx) = 0;
+	virtual double GetGlobal(const int global) = 0;
+};
+
+//Blockly condition compiled into an expression tree, evaluated with the Lua semantics
+class CBlocklyCondition
+{
+public:
+	//False (and nothing compiled) when the condition uses syntax the compiler does not handle
+	bool Compile(const std::string &conditions);
+	bool IsCompiled() const { return !m_tree.empty(); }
+	void Clear() { m_tree.clear(); }
+	//bError is set when Lua would raise an error (comparing values of a different type)
+	bool Evaluate(CBlocklyState &state, bool &bError) const;
+
+	//The device and variable idx's the condition text refers to
+	static void GetReferences(const std::string &conditions, std::set<uint64_t> &devices, std::set<uint64_t> &variables);
+private:
+	//nodes refer to each other by index, the root is the last node
+	struct _tNode
+	{
+		int Type;
+		int Operator;
+		int Table;
+		uint64_t Index;
+		double fValue;
+		std::string sValue;
+		int Left;
+		int Right;
+	};
+	struct _tToken
+	{
+		int Type;
+		std::string Text;
+		double fValue;
+	};
+	std::vector<_tNode> m_tree;
+
+	_tBlocklyValue EvaluateNode(const int nodeIdx, CBlocklyState &state, bool &bError) const;
+	static bool Tokenize(const std::string &conditions, std::vector<_tToken> &tokens);
+	static int ParseExpression(const std::vector<_tToken> &tokens, size_t &pos, std::vector<_tNode> &tree, const int level);
+};
@@ -12,18 +12,46 @@
 #include "WebServer.h"
 #include "../webserver/cWebem.h"
 #include "../json/json.h"
+#include <inttypes.h>
 
 #define CAMERA_POLL_INTERVAL 30
+#define CAMERA_SNAPSHOT_MAX_AGE 1000
+#define CAMERA_RELAY_MIN_INTERVAL 200
+#define CAMERA_MJPEG_BOUNDARY "domoticzframe"
 
 extern std::string szUserDataFolder;
 
+static uint64_t CameraClockMs()
+{
+	struct timeval tv;
+	getclock(&tv);
+	return ((uint64_t)tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
 CCameraHandler::CCameraHandler(void)
 {
 	m_seconds_counter=0;
+	m_snapshotMaxAge = CAMERA_SNAPSHOT_MAX_AGE;
+	m_bStopRelays = false;
 }
 
 CCameraHandler::~CCameraHandler(void)
 {
+	std::vector<boost::shared_ptr<boost::thread> > threads;
+	{
+		boost::lock_guard<boost::mutex> l(m_frameMutex);
+		m_bStopRelays = true;
+		std::map<uint64_t, _tCameraFrame>::iterator itt;
+		for (itt = m_frames.begin(); itt != m_frames.end(); ++itt)
+		{
+			if (itt->second.relayThread)
+				threads.push_back(itt->second.relayThread);
+		}
+	}
+	m_frameCondition.notify_all();
+	std::vector<boost::shared_ptr<boost::thread> >::iterator ittThread;
+	for (ittThread = threads.begin(); ittThread != threads.end(); ++ittThread)
+		(*ittThread)->join();
 }
 
 void CCameraHandler::ReloadCameras()
@@ -34,6 +62,17 @@ void CCameraHandler::ReloadCameras()
 	std::vector<std::vector<std::string> > result;
 	std::vector<std::vector<std::string> >::const_iterator itt;
 
+	int nMaxAge = CAMERA_SNAPSHOT_MAX_AGE;
+	m_sql.GetPreferencesVar("CameraSnapshotMaxAge", nMaxAge);
+	{
+		//settings might have changed, do not serve old snapshots
+		boost::lock_guard<boost::mutex> l2(m_frameMutex);
+		m_snapshotMaxAge = (nMaxAge > 0) ? nMaxAge : 0;
+		std::map<uint64_t, _tCameraFrame>::iterator ittFrame;
+		for (ittFrame = m_frames.begin(); ittFrame != m_frames.end(); ++ittFrame)
+			ittFrame->second.fetchTime = 0;
+	}
+
 	result=m_sql.safe_query("SELECT ID, Name, Address, Port, Username, Password, ImageURL, Protocol FROM Cameras WHERE (Enabled == 1) ORDER BY ID");
 	if (result.size()>0)
 	{
@@ -63,6 +102,22 @@ void CCameraHandler::ReloadCameras()
 		//Get Active Devices/Scenes
 		ReloadCameraActiveDevices(*ittCam);
 	}
+
+	//forget the frames of removed or disabled cameras, once nobody uses them anymore
+	boost::lock_guard<boost::mutex> l2(m_frameMutex);
+	std::map<uint64_t, _tCameraFrame>::iterator ittFrame = m_frames.begin();
+	while (ittFrame != m_frames.end())
+	{
+		_tCameraFrame &cframe = ittFrame->second;
+		if ((GetCamera(ittFrame->first) != NULL) || (cframe.viewers > 0) || (cframe.bFetching) || (cframe.bRelayRunning))
+		{
+			++ittFrame;
+			continue;
+		}
+		if (cframe.relayThread)
+			cframe.relayThread->join(); //relay has stopped already
+		m_frames.erase(ittFrame++);
+	}
 }
 
 void CCameraHandler::ReloadCameraActiveDevices(const std::string &CamID)
@@ -264,26 +319,201 @@ bool CCameraHandler::TakeUVCSnapshot(const std::string &device, std::vector<unsi
 
 bool CCameraHandler::TakeSnapshot(const uint64_t CamID, std::vector<unsigned char> &camimage)
 {
-	boost::lock_guard<boost::mutex> l(m_mutex);
+	std::string szURL;
+	std::string ImageURL;
+	std::string Username;
+	{
+		//do not keep the camera list locked during the fetch
+		boost::lock_guard<boost::mutex> l(m_mutex);
 
-	cameraDevice *pCamera=GetCamera(CamID);
-	if (pCamera==NULL)
-		return false;
+		cameraDevice *pCamera=GetCamera(CamID);
+		if (pCamera==NULL)
+			return false;
 
-	std::string szURL=GetCameraURL(pCamera);
-	szURL+="/" + pCamera->ImageURL;
-	stdreplace(szURL, "#USERNAME", pCamera->Username);
-	stdreplace(szURL, "#PASSWORD", pCamera->Password);
+		szURL=GetCameraURL(pCamera);
+		szURL+="/" + pCamera->ImageURL;
+		stdreplace(szURL, "#USERNAME", pCamera->Username);
+		stdreplace(szURL, "#PASSWORD", pCamera->Password);
+		ImageURL = pCamera->ImageURL;
+		Username = pCamera->Username;
+	}
 
-	if (pCamera->ImageURL=="raspberry.cgi")
+	if (ImageURL=="raspberry.cgi")
 		return TakeRaspberrySnapshot(camimage);
-	else if (pCamera->ImageURL=="uvccapture.cgi")
-		return TakeUVCSnapshot(pCamera->Username, camimage);
+	else if (ImageURL=="uvccapture.cgi")
+		return TakeUVCSnapshot(Username, camimage);
 
 	std::vector<std::string> ExtraHeaders;
 	return HTTPClient::GETBinary(szURL,ExtraHeaders,camimage,5);
 }
 
+bool CCameraHandler::GetSnapshot(const std::string &CamID, std::vector<unsigned char> &camimage)
+{
+	std::stringstream s_str(CamID);
+	uint64_t ulID;
+	s_str >> ulID;
+	return GetSnapshot(ulID, camimage);
+}
+
+bool CCameraHandler::GetSnapshot(const uint64_t CamID, std::vector<unsigned char> &camimage)
+{
+	int maxAge;
+	{
+		boost::lock_guard<boost::mutex> l(m_frameMutex);
+		maxAge = m_snapshotMaxAge;
+	}
+	boost::shared_ptr<const std::vector<unsigned char> > frame;
+	if (!GetFrame(CamID, maxAge, frame))
+		return false;
+	camimage = *frame;
+	return true;
+}
+
+bool CCameraHandler::GetFrame(const uint64_t CamID, const int maxAge, boost::shared_ptr<const std::vector<unsigned char> > &frame)
+{
+	if (!IsCamera(CamID))
+		return false;
+	boost::unique_lock<boost::mutex> lock(m_frameMutex);
+	_tCameraFrame *pFrame = &m_frames[CamID];
+	if ((pFrame->image) && (CameraClockMs() - pFrame->fetchTime < (uint64_t)maxAge))
+	{
+		frame = pFrame->image;
+		return true;
+	}
+	if (pFrame->bFetching)
+	{
+		//somebody else is fetching this camera already, use that result
+		unsigned long sequence = pFrame->sequence;
+		while (pFrame->bFetching)
+		{
+			m_frameCondition.wait(lock);
+			//ReloadCameras may have removed the entry once the fetch was done
+			std::map<uint64_t, _tCameraFrame>::iterator itt = m_frames.find(CamID);
+			if (itt == m_frames.end())
+				return false;
+			pFrame = &itt->second;
+		}
+		if ((pFrame->sequence == sequence) || (!pFrame->image))
+			return false; //that fetch failed
+		frame = pFrame->image;
+		return true;
+	}
+	pFrame->bFetching = true;
+	lock.unlock();
+
+	boost::shared_ptr<std::vector<unsigned char> > pImage(new std::vector<unsigned char>);
+	bool bOK = TakeSnapshot(CamID, *pImage) && (!pImage->empty());
+
+	std::vector<boost::function<void()> > waiting;
+	lock.lock();
+	pFrame->bFetching = false;
+	if (bOK)
+	{
+		pFrame->image = pImage;
+		pFrame->fetchTime = CameraClockMs();
+		pFrame->sequence++;
+		frame = pImage;
+		waiting.swap(pFrame->waiting);
+	}
+	lock.unlock();
+	m_frameCondition.notify_all();
+
+	std::vector<boost::function<void()> >::iterator itt;
+	for (itt = waiting.begin(); itt != waiting.end(); ++itt)
+		(*itt)();
+	return bOK;
+}
+
+//Only known cameras get a frame entry, the camera list is checked before m_frameMutex is taken (ReloadCameras locks them in that order)
+bool CCameraHandler::IsCamera(const uint64_t CamID)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	return (GetCamera(CamID) != NULL);
+}
+
+void CCameraHandler::AddRelayViewer(const uint64_t CamID)
+{
+	if (!IsCamera(CamID))
+		return; //GetRelayFrame ends the stream
+	boost::lock_guard<boost::mutex> l(m_frameMutex);
+	_tCameraFrame &cframe = m_frames[CamID];
+	cframe.viewers++;
+	if ((cframe.bRelayRunning) || (m_bStopRelays))
+		return;
+	if (cframe.relayThread)
+		cframe.relayThread->join(); //previous relay has stopped already
+	cframe.bRelayRunning = true;
+	cframe.relayThread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CCameraHandler::Do_Relay_Work, this, CamID)));
+}
+
+void CCameraHandler::RemoveRelayViewer(const uint64_t CamID)
+{
+	{
+		boost::lock_guard<boost::mutex> l(m_frameMutex);
+		std::map<uint64_t, _tCameraFrame>::iterator itt = m_frames.find(CamID);
+		if (itt == m_frames.end())
+			return;
+		itt->second.viewers--;
+	}
+	m_frameCondition.notify_all();
+}
+
+bool CCameraHandler::GetRelayFrame(const uint64_t CamID, unsigned long &sequence, boost::shared_ptr<const std::vector<unsigned char> > &frame, const boost::function<void()> &onReady)
+{
+	boost::lock_guard<boost::mutex> l(m_frameMutex);
+	frame.reset();
+	std::map<uint64_t, _tCameraFrame>::iterator itt = m_frames.find(CamID);
+	if (itt == m_frames.end())
+		return true;
+	_tCameraFrame &cframe = itt->second;
+	if ((cframe.image) && (cframe.sequence != sequence))
+	{
+		sequence = cframe.sequence;
+		frame = cframe.image;
+		return true;
+	}
+	if (!cframe.bRelayRunning)
+		return true;
+	cframe.waiting.push_back(onReady);
+	return false;
+}
+
+void CCameraHandler::Do_Relay_Work(const uint64_t CamID)
+{
+	_log.Log(LOG_STATUS, "Camera: MJPEG relay started (idx: %" PRIu64 ")", CamID);
+	while (true)
+	{
+		uint64_t tStart = CameraClockMs();
+		boost::shared_ptr<const std::vector<unsigned char> > frame;
+		if (!GetFrame(CamID, 0, frame))
+		{
+			boost::lock_guard<boost::mutex> l(m_mutex);
+			if (GetCamera(CamID) == NULL)
+				break; //camera removed or disabled
+		}
+
+		//wait for the next frame, or until the last viewer left
+		boost::unique_lock<boost::mutex> lock(m_frameMutex);
+		uint64_t tNext = tStart + std::max(m_snapshotMaxAge, CAMERA_RELAY_MIN_INTERVAL);
+		uint64_t tNow;
+		while ((m_frames[CamID].viewers > 0) && (!m_bStopRelays) && ((tNow = CameraClockMs()) < tNext))
+			m_frameCondition.timed_wait(lock, boost::posix_time::milliseconds(tNext - tNow));
+		if ((m_frames[CamID].viewers <= 0) || (m_bStopRelays))
+			break;
+	}
+
+	std::vector<boost::function<void()> > waiting;
+	{
+		boost::lock_guard<boost::mutex> l(m_frameMutex);
+		m_frames[CamID].bRelayRunning = false;
+		waiting.swap(m_frames[CamID].waiting);
+	}
+	std::vector<boost::function<void()> >::iterator itt;
+	for (itt = waiting.begin(); itt != waiting.end(); ++itt)
+		(*itt)();
+	_log.Log(LOG_STATUS, "Camera: MJPEG relay stopped (idx: %" PRIu64 ")", CamID);
+}
+
 std::string WrapBase64(const std::string &szSource, const size_t lsize=72)
 {
 	std::string cstring = szSource;
@@ -356,7 +586,7 @@ bool CCameraHandler::EmailCameraSnapshot(const std::string &CamIdx, const std::s
 
 		std::vector<unsigned char> camimage;
 
-		if (!TakeSnapshot(*camIt, camimage))
+		if (!GetSnapshot(*camIt, camimage))
 			return false;
 
 		std::vector<char> filedata;
@@ -453,13 +683,67 @@ namespace http {
 			if (idx == "") {
 				return;
 			}
-			if (!m_mainworker.m_cameras.TakeSnapshot(idx, camimage)) {
+			if (!m_mainworker.m_cameras.GetSnapshot(idx, camimage)) {
 				return;
 			}
 			reply::set_content(&rep, camimage.begin(), camimage.end());
 			reply::add_header_attachment(&rep, "snapshot.jpg");
 		}
 
+		//Sends the frames of the camera relay as multipart JPEG, until the client disconnects
+		class CCameraMJPEGStream : public reply_stream
+		{
+		public:
+			explicit CCameraMJPEGStream(const uint64_t CamID) :
+				m_CamID(CamID),
+				m_sequence(0)
+			{
+				m_mainworker.m_cameras.AddRelayViewer(m_CamID);
+			}
+			~CCameraMJPEGStream()
+			{
+				m_mainworker.m_cameras.RemoveRelayViewer(m_CamID);
+			}
+			virtual bool data_ready(const boost::function<void()> &on_ready)
+			{
+				return m_mainworker.m_cameras.GetRelayFrame(m_CamID, m_sequence, m_frame, on_ready);
+			}
+			virtual bool next_chunk(std::string &chunk)
+			{
+				if (!m_frame)
+					return false; //relay stopped
+				std::stringstream sstr;
+				sstr << "--" CAMERA_MJPEG_BOUNDARY "\r\n"
+					<< "Content-Type: image/jpeg\r\n"
+					<< "Content-Length: " << m_frame->size() << "\r\n\r\n";
+				chunk = sstr.str();
+				chunk.append(m_frame->begin(), m_frame->end());
+				chunk += "\r\n";
+				m_frame.reset();
+				return true;
+			}
+		private:
+			uint64_t m_CamID;
+			unsigned long m_sequence;
+			boost::shared_ptr<const std::vector<unsigned char> > m_frame;
+		};
+
+		void CWebServer::GetCameraMJPEG(WebEmSession & session, const request& req, reply & rep)
+		{
+			std::string idx = request::findValue(&req, "idx");
+			if (idx == "") {
+				return;
+			}
+			if (m_mainworker.m_cameras.GetCamera(idx) == NULL) {
+				return;
+			}
+			std::stringstream s_str(idx);
+			uint64_t CamID;
+			s_str >> CamID;
+			reply::set_content_stream(&rep, boost::shared_ptr<reply_stream>(new CCameraMJPEGStream(CamID)));
+			reply::add_header(&rep, "Content-Type", "multipart/x-mixed-replace; boundary=" CAMERA_MJPEG_BOUNDARY);
+		}
+
 		void CWebServer::Cmd_AddCamera(WebEmSession & session, const request& req, Json::Value &root)
 		{
 			if (session.rights < 2)
@@ -2,6 +2,9 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 
 class CCameraHandler
 {
@@ -38,6 +41,9 @@ public:
 
 	bool TakeSnapshot(const uint64_t CamID, std::vector<unsigned char> &camimage);
 	bool TakeSnapshot(const std::string &CamID, std::vector<unsigned char> &camimage);
+	//Returns the cached snapshot when it is recent enough, concurrent requests share one fetch
+	bool GetSnapshot(const uint64_t CamID, std::vector<unsigned char> &camimage);
+	bool GetSnapshot(const std::string &CamID, std::vector<unsigned char> &camimage);
 	bool TakeRaspberrySnapshot(std::vector<unsigned char> &camimage);
 	bool TakeUVCSnapshot(const std::string &device, std::vector<unsigned char> &camimage);
 	cameraDevice* GetCamera(const uint64_t CamID);
@@ -49,11 +55,39 @@ public:
 	std::string GetCameraURL(cameraDevice *pCamera);
 	std::string GetCameraURL(const std::string &CamID);
 	std::string GetCameraURL(const uint64_t CamID);
+
+	//MJPEG relay, all viewers of a camera share one fetch loop
+	void AddRelayViewer(const uint64_t CamID);
+	void RemoveRelayViewer(const uint64_t CamID);
+	//Returns false (and calls onReady later) when there is no newer frame yet, an empty frame means the relay stopped
+	bool GetRelayFrame(const uint64_t CamID, unsigned long &sequence, boost::shared_ptr<const std::vector<unsigned char> > &frame, const boost::function<void()> &onReady);
 private:
+	struct _tCameraFrame
+	{
+		boost::shared_ptr<const std::vector<unsigned char> > image;
+		uint64_t fetchTime; //ms
+		unsigned long sequence;
+		bool bFetching;
+		int viewers;
+		bool bRelayRunning;
+		boost::shared_ptr<boost::thread> relayThread;
+		std::vector<boost::function<void()> > waiting;
+		_tCameraFrame() : fetchTime(0), sequence(0), bFetching(false), viewers(0), bRelayRunning(false) {}
+	};
+
 	void ReloadCameraActiveDevices(const std::string &CamID);
+	bool IsCamera(const uint64_t CamID);
+	bool GetFrame(const uint64_t CamID, const int maxAge, boost::shared_ptr<const std::vector<unsigned char> > &frame);
+	void Do_Relay_Work(const uint64_t CamID);
 
 	boost::mutex m_mutex;
 	unsigned char m_seconds_counter;
 	std::vector<cameraDevice> m_cameradevices;
+
+	boost::mutex m_frameMutex;
+	boost::condition_variable m_frameCondition;
+	std::map<uint64_t, _tCameraFrame> m_frames;
+	int m_snapshotMaxAge; //ms
+	bool m_bStopRelays;
 };
 
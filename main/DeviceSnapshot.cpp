@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "DeviceSnapshot.h"
+#include "Helper.h"
+#include "RFXNames.h"
+#include "SQLHelper.h"
+#include <inttypes.h>
+
+CDeviceSnapshots::CDeviceSnapshots() :
+	m_generation(0)
+{
+}
+
+device_snapshot_ptr CDeviceSnapshots::Load(const uint64_t DeviceRowIdx)
+{
+	std::vector<std::vector<std::string> > result;
+	result = m_sql.safe_query("SELECT HardwareID, DeviceID, Unit, Name, Used, Type, SubType, SwitchType, nValue, sValue, SignalLevel, BatteryLevel, Options, Description, LastUpdate, strftime('%%s', LastUpdate) FROM DeviceStatus WHERE (ID==%" PRIu64 ")",
+		DeviceRowIdx);
+	if (result.empty())
+		return device_snapshot_ptr();
+	std::vector<std::string> sd = result[0];
+
+	boost::shared_ptr<_tDeviceSnapshot> pSnapshot(new _tDeviceSnapshot);
+	_tDeviceSnapshot &snapshot = *pSnapshot;
+	snapshot.ID = DeviceRowIdx;
+	snapshot.HardwareID = atoi(sd[0].c_str());
+	snapshot.DeviceID = sd[1];
+	snapshot.Unit = atoi(sd[2].c_str());
+	snapshot.Name = sd[3];
+	snapshot.bUsed = (atoi(sd[4].c_str()) != 0);
+	snapshot.Type = atoi(sd[5].c_str());
+	snapshot.SubType = atoi(sd[6].c_str());
+	snapshot.SwitchType = atoi(sd[7].c_str());
+	snapshot.nValue = atoi(sd[8].c_str());
+	snapshot.sValue = sd[9];
+	StringSplit(snapshot.sValue, ";", snapshot.sValues);
+	snapshot.SignalLevel = atoi(sd[10].c_str());
+	snapshot.BatteryLevel = atoi(sd[11].c_str());
+	snapshot.sOptions = sd[12];
+	snapshot.Options = m_sql.BuildDeviceOptions(sd[12]);
+	snapshot.Description = sd[13];
+	snapshot.LastUpdate = sd[14];
+	snapshot.LastUpdateEpoch = (time_t)atoi(sd[15].c_str());
+
+	snapshot.TypeDesc = RFX_Type_Desc(snapshot.Type, 1);
+	snapshot.SubTypeDesc = RFX_Type_SubType_Desc(snapshot.Type, snapshot.SubType);
+	snapshot.bIsLightOrSwitch = IsLightOrSwitch(snapshot.Type, snapshot.SubType);
+	snapshot.SwitchTypeDesc = Switch_Type_Desc((_eSwitchType)snapshot.SwitchType);
+	snapshot.MeterTypeDesc = Meter_Type_Desc((_eMeterType)snapshot.SwitchType);
+	return pSnapshot;
+}
+
+void CDeviceSnapshots::Invalidate(const uint64_t DeviceRowIdx)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_generation++;
+	m_snapshots.erase(DeviceRowIdx);
+}
+
+device_snapshot_ptr CDeviceSnapshots::Get(const uint64_t DeviceRowIdx)
+{
+	unsigned long generation;
+	{
+		boost::lock_guard<boost::mutex> l(m_mutex);
+		std::map<uint64_t, device_snapshot_ptr>::const_iterator itt = m_snapshots.find(DeviceRowIdx);
+		if (itt != m_snapshots.end())
+			return itt->second;
+		generation = m_generation;
+	}
+	device_snapshot_ptr pSnapshot = Load(DeviceRowIdx);
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	if ((pSnapshot) && (generation == m_generation))
+		m_snapshots[DeviceRowIdx] = pSnapshot;
+	return pSnapshot;
+}
+
+void CDeviceSnapshots::Remove(const uint64_t DeviceRowIdx)
+{
+	Invalidate(DeviceRowIdx);
+}
+
+void CDeviceSnapshots::Clear()
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_generation++;
+	m_snapshots.clear();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+//Immutable copy of a DeviceStatus row, with the fields parsed and the display strings precomputed
+struct _tDeviceSnapshot
+{
+	uint64_t ID;
+	int HardwareID;
+	std::string DeviceID;
+	int Unit;
+	std::string Name;
+	bool bUsed;
+	int Type;
+	int SubType;
+	int SwitchType;
+	int nValue;
+	std::string sValue;
+	std::vector<std::string> sValues;
+	int SignalLevel;
+	int BatteryLevel;
+	std::string Description;
+	std::string LastUpdate;
+	time_t LastUpdateEpoch; //as strftime('%s') returns it, local time
+	std::string sOptions;
+	std::map<std::string, std::string> Options;
+
+	std::string TypeDesc;
+	std::string SubTypeDesc;
+	std::string SwitchTypeDesc;
+	std::string MeterTypeDesc;
+	bool bIsLightOrSwitch;
+};
+
+typedef boost::shared_ptr<const _tDeviceSnapshot> device_snapshot_ptr;
+
+//Latest snapshot per device. The receive path invalidates it before the exporters are signalled, the first exporter
+//that asks for the device reads it once. Readers get a reference counted pointer, the snapshot itself is never modified afterwards.
+class CDeviceSnapshots
+{
+public:
+	CDeviceSnapshots();
+	//The device changed, the next Get reads it from the database again
+	void Invalidate(const uint64_t DeviceRowIdx);
+	//Returns the current snapshot, reads it from the database when there is none (NULL when the device does not exist)
+	device_snapshot_ptr Get(const uint64_t DeviceRowIdx);
+	void Remove(const uint64_t DeviceRowIdx);
+	void Clear();
+private:
+	device_snapshot_ptr Load(const uint64_t DeviceRowIdx);
+
+	boost::mutex m_mutex; //only held to copy or replace a pointer
+	std::map<uint64_t, device_snapshot_ptr> m_snapshots;
+	unsigned long m_generation; //changed by every invalidation, a snapshot read before it is not stored
+};
+
+extern CDeviceSnapshots m_devicesnapshots;
@@ -5,10 +5,12 @@
 #include "Helper.h"
 #include "SQLHelper.h"
 #include "Logger.h"
+#include "Metrics.h"
 #include "../hardware/hardwaretypes.h"
 #include "../hardware/Kodi.h"
 #include "../hardware/LogitechMediaServer.h"
 #include <iostream>
+#include <set>
 #include "../httpclient/HTTPClient.h"
 #include "../httpclient/UrlEncode.h"
 #include "localtime_r.h"
@@ -142,6 +144,8 @@ void CEventSystem::StartEventSystem()
     Plugins::PythonEventsInitialize(szUserDataFolder);
 #endif
 
+	m_metrics.GetGauge("event_queue_depth")->SetCallback(boost::bind(&concurrent_queue<_tEventQueue>::size, &m_eventqueue));
+
 	m_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CEventSystem::Do_Work, this)));
 	m_eventqueuethread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CEventSystem::EventQueueThread, this)));
 	m_szStartTime = TimeToString(&m_StartTime, TF_DateTime);
@@ -189,6 +193,10 @@ void CEventSystem::LoadEvents()
 	boost::unique_lock<boost::shared_mutex> eventsMutexLock(m_eventsMutex);
 	_log.Log(LOG_STATUS, "EventSystem: reset all events...");
 	m_events.clear();
+	m_blocklyDeviceRules.clear();
+	m_blocklyVariableRules.clear();
+	m_blocklySecurityRules.clear();
+	m_blocklyTimeRules.clear();
 
 	// Remove dzVents DB files from disk
 	std::vector<std::string> FileEntries;
@@ -260,6 +268,8 @@ void CEventSystem::LoadEvents()
 			eitem.Actions = sd[3];
 			eitem.EventStatus = atoi(sd[4].c_str());
 			eitem.SequenceNo = atoi(sd[5].c_str());
+			if ((eitem.Interpreter == "Blockly") && (eitem.EventStatus == 1))
+				CompileBlockly(eitem, m_events.size());
 			m_events.push_back(eitem);
 
 		}
@@ -1399,6 +1409,7 @@ void CEventSystem::EventQueueThread()
 		if (m_stoprequested)
 			break;
 
+		CMetricTimer timer(m_metrics.GetHistogram("event_evaluate", "reason", m_szReason[item.reason]));
 		EvaluateEvent(item);
 		if (item.DeviceID || item.varId)
 			UpdateLastUpdate(item);
@@ -1433,7 +1444,7 @@ void CEventSystem::ProcessDevice(const int HardwareID, const uint64_t ulDevID, c
 			item.lastUpdate = sd[2];
 			item.lastLevel = atoi(sd[3].c_str());
 			item.trigger = NULL;
-			m_eventqueue.push(item);
+			QueueDeviceEvent(item);
 		}
 		else
 			UpdateSingleState(ulDevID, devname, nValue, sValue, devType, subType, switchType, sd[2], atoi(sd[3].c_str()), options);
@@ -1444,6 +1455,57 @@ void CEventSystem::ProcessDevice(const int HardwareID, const uint64_t ulDevID, c
 	}
 }
 
+//Device events of the calling thread are held back during a batch and pushed to the event queue at once when it ends
+void CEventSystem::BeginBatch()
+{
+	boost::lock_guard<boost::mutex> l(m_batchMutex);
+	std::map<boost::thread::id, _tEventBatch>::iterator itt = m_batches.find(boost::this_thread::get_id());
+	if (itt != m_batches.end())
+	{
+		itt->second.depth++;
+		return;
+	}
+	_tEventBatch batch;
+	batch.depth = 1;
+	m_batches[boost::this_thread::get_id()] = batch;
+}
+
+void CEventSystem::EndBatch()
+{
+	boost::lock_guard<boost::mutex> l(m_batchMutex);
+	std::map<boost::thread::id, _tEventBatch>::iterator itt = m_batches.find(boost::this_thread::get_id());
+	if (itt == m_batches.end())
+		return;
+	if (--itt->second.depth > 0)
+		return;
+	if (!itt->second.items.empty())
+		m_eventqueue.push(itt->second.items.begin(), itt->second.items.end());
+	m_batches.erase(itt);
+}
+
+void CEventSystem::QueueDeviceEvent(const _tEventQueue &item)
+{
+	boost::lock_guard<boost::mutex> l(m_batchMutex);
+	std::map<boost::thread::id, _tEventBatch>::iterator itt = m_batches.find(boost::this_thread::get_id());
+	if (itt == m_batches.end())
+	{
+		m_eventqueue.push(item);
+		return;
+	}
+	//a repeat of the same value is dropped, every change of the device still gets its own event
+	std::vector<_tEventQueue> &items = itt->second.items;
+	std::vector<_tEventQueue>::reverse_iterator ritt;
+	for (ritt = items.rbegin(); ritt != items.rend(); ++ritt)
+	{
+		if (ritt->DeviceID != item.DeviceID)
+			continue;
+		if ((ritt->reason == item.reason) && (ritt->nValue == item.nValue) && (ritt->sValue == item.sValue))
+			return;
+		break;
+	}
+	items.push_back(item);
+}
+
 void CEventSystem::ProcessMinute()
 {
 	_tEventQueue item;
@@ -1821,232 +1883,223 @@ lua_State *CEventSystem::CreateBlocklyLuaState()
 	return lua_state;
 }
 
-void CEventSystem::EvaluateBlockly(const _tEventQueue &item)
+//Blockly conditions are compiled when the events are loaded, a condition the compiler does not understand is kept as a Lua chunk
+void CEventSystem::CompileBlockly(_tEventItem &eitem, const size_t eventIdx)
 {
-//#ifdef _DEBUG
-	//    _log.Log(LOG_STATUS,"EventSystem: blockly %s trigger",reason.c_str());
-//#endif
-
-	lua_State *lua_state=NULL;
+	const std::string &conditions = eitem.Conditions;
+
+	//Reverse index on the devices/variables the rule refers to
+	std::set<uint64_t> devices, variables;
+	CBlocklyCondition::GetReferences(conditions, devices, variables);
+	std::set<uint64_t>::const_iterator itt;
+	for (itt = devices.begin(); itt != devices.end(); ++itt)
+		m_blocklyDeviceRules[*itt].push_back(eventIdx);
+	for (itt = variables.begin(); itt != variables.end(); ++itt)
+		m_blocklyVariableRules[*itt].push_back(eventIdx);
+	if (conditions.find("securitystatus") != std::string::npos)
+		m_blocklySecurityRules.push_back(eventIdx);
+	if ((conditions.find("timeofday") != std::string::npos) || (conditions.find("weekday") != std::string::npos))
+		m_blocklyTimeRules.push_back(eventIdx);
+
+	if (eitem.Blockly.Compile(conditions))
+		return;
 
-	if ((item.reason == REASON_DEVICE) && (item.DeviceID >0)) {
-		std::size_t found;
-		boost::shared_lock<boost::shared_mutex> eventsMutexLock(m_eventsMutex);
-		std::vector<_tEventItem>::iterator it;
-		for (it = m_events.begin(); it != m_events.end(); ++it) {
-			bool eventInScope = ((it->Interpreter == "Blockly") && ((it->Type=="all")||(it->Type == m_szReason[item.reason])));
-			bool eventActive = (it->EventStatus == 1);
-			if (eventInScope && eventActive)
-			{
-				std::stringstream sstr;
-				//sstr << "device[" << DeviceID << "]";
-				sstr << "[" << item.DeviceID << "]";
-				std::string conditions(it->Conditions);
-				found = conditions.find(sstr.str());
-				if (found != std::string::npos)
-				{
-					// Replace Sunrise and sunset placeholder with actual time for query
-					if (conditions.find("@Sunrise") != std::string::npos) {
-						int intRise = getSunRiseSunSetMinutes("Sunrise");
-						std::stringstream ssRise;
-						ssRise << intRise;
-						stdreplace(conditions, "@Sunrise", ssRise.str());
-					}
-					if (conditions.find("@Sunset") != std::string::npos) {
-						int intSet = getSunRiseSunSetMinutes("Sunset");
-						std::stringstream ssSet;
-						ssSet << intSet;
-						stdreplace(conditions, "@Sunset", ssSet.str());
-					}
+	//Fallback, sunrise/sunset are set as globals when the rule is evaluated
+	std::string luaConditions = conditions;
+	stdreplace(luaConditions, "@Sunrise", "blockly_sunrise");
+	stdreplace(luaConditions, "@Sunset", "blockly_sunset");
+	eitem.BlocklyLua = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + luaConditions + " then result = 1 end; return result";
+}
 
-					std::string ifCondition = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + conditions + " then result = 1 end; return result";
+CEventSystem::CBlocklyContext::CBlocklyContext(CEventSystem *pEventSystem) :
+	m_pEventSystem(pEventSystem),
+	m_bHaveTime(false),
+	m_timeofday(0),
+	m_weekday(0),
+	m_sunrise(0),
+	m_sunset(0),
+	m_bHaveMeasurements(false)
+{
+}
 
-					if (lua_state == NULL)
-					{
-						lua_state = CreateBlocklyLuaState();
-						if (lua_state == NULL)
-							return;
-					}
+_tBlocklyValue CEventSystem::CBlocklyContext::GetTableValue(const int table, const uint64_t idx)
+{
+	_tBlocklyValue value;
+	value.Type = BV_NIL;
+	value.fValue = 0;
 
-					//_log.Log(LOG_STATUS,"EventSystem: ifc: %s",ifCondition.c_str());
-					if (luaL_dostring(lua_state, ifCondition.c_str()))
-					{
-						_log.Log(LOG_ERROR, "EventSystem: Lua script error (Blockly), Name: %s => %s", it->Name.c_str(), lua_tostring(lua_state, -1));
-					}
-					else
-					{
-						lua_Number ruleTrue = lua_tonumber(lua_state, -1);
-						if (ruleTrue != 0)
-						{
-							if (m_sql.m_bLogEventScriptTrigger)
-								_log.Log(LOG_NORM, "EventSystem: Event triggered: %s", it->Name.c_str());
-							parseBlocklyActions(it->Actions, it->Name, it->ID);
-						}
-					}
-				}
+	if (table == BT_DEVICE)
+	{
+		boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_pEventSystem->m_devicestatesMutex);
+		std::map<uint64_t, _tDeviceStatus>::const_iterator itt = m_pEventSystem->m_devicestates.find(idx);
+		if (itt != m_pEventSystem->m_devicestates.end())
+		{
+			value.Type = BV_STRING;
+			value.sValue = itt->second.nValueWording;
+		}
+		return value;
+	}
+	if (table == BT_VARIABLE)
+	{
+		boost::shared_lock<boost::shared_mutex> uservariablesMutexLock(m_pEventSystem->m_uservariablesMutex);
+		std::map<uint64_t, _tUserVariable>::const_iterator itt = m_pEventSystem->m_uservariables.find(idx);
+		if (itt != m_pEventSystem->m_uservariables.end())
+		{
+			if (itt->second.variableType == 0)
+			{
+				value.Type = BV_NUMBER;
+				value.fValue = atoi(itt->second.variableValue.c_str());
+			}
+			else if (itt->second.variableType == 1)
+			{
+				value.Type = BV_NUMBER;
+				value.fValue = atof(itt->second.variableValue.c_str());
+			}
+			else
+			{
+				value.Type = BV_STRING;
+				value.sValue = itt->second.variableValue;
 			}
 		}
+		return value;
 	}
-	else if (item.reason == REASON_SECURITY) {
-		// security status change
-		std::size_t found;
-		boost::shared_lock<boost::shared_mutex> eventsMutexLock(m_eventsMutex);
-		std::vector<_tEventItem>::iterator it;
-		for (it = m_events.begin(); it != m_events.end(); ++it) {
-			bool eventInScope = ((it->Interpreter == "Blockly") && ((it->Type == "all") || (it->Type == m_szReason[item.reason])));
-			bool eventActive = (it->EventStatus == 1);
-			std::stringstream sstr;
-			sstr << "securitystatus";
-			std::string conditions (it->Conditions);
-			found = conditions.find(sstr.str());
-
-			if ((eventInScope) && (eventActive) && (found != std::string::npos)) {
-
-				// Replace Sunrise and sunset placeholder with actual time for query
-				if (conditions.find("@Sunrise") != std::string::npos) {
-					int intRise = getSunRiseSunSetMinutes("Sunrise");
-					std::stringstream ssRise;
-					ssRise << intRise;
-					stdreplace(conditions, "@Sunrise", ssRise.str());
-				}
-				if (conditions.find("@Sunset") != std::string::npos) {
-					int intSet = getSunRiseSunSetMinutes("Sunset");
-					std::stringstream ssSet;
-					ssSet << intSet;
-					stdreplace(conditions, "@Sunset", ssSet.str());
-				}
-
-				std::string ifCondition = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + conditions + " then result = 1 end; return result";
-
-				if (lua_state == NULL)
-				{
-					lua_state = CreateBlocklyLuaState();
-					if (lua_state == NULL)
-						return;
-				}
-
-				//_log.Log(LOG_NORM,"ifc: %s",ifCondition.c_str());
-				if (luaL_dostring(lua_state, ifCondition.c_str()))
-				{
-					_log.Log(LOG_ERROR, "EventSystem: Lua script error (Blockly), Name: %s => %s", it->Name.c_str(), lua_tostring(lua_state, -1));
-				}
-				else {
-					lua_Number ruleTrue = lua_tonumber(lua_state, -1);
 
-					if (ruleTrue != 0)
-					{
-						if (m_sql.m_bLogEventScriptTrigger)
-							_log.Log(LOG_NORM, "EventSystem: Event triggered: %s", it->Name.c_str());
-						parseBlocklyActions(it->Actions, it->Name, it->ID);
-					}
-				}
-			}
+	boost::lock_guard<boost::mutex> measurementStatesMutexLock(m_pEventSystem->m_measurementStatesMutex);
+	if (!m_bHaveMeasurements)
+	{
+		m_pEventSystem->GetCurrentMeasurementStates();
+		m_bHaveMeasurements = true;
+	}
+	if ((table == BT_HUMIDITY) || (table == BT_ZWAVEALARMS))
+	{
+		const std::map<uint64_t, int> &values = (table == BT_HUMIDITY) ? m_pEventSystem->m_humValuesByID : m_pEventSystem->m_zwaveAlarmValuesByID;
+		std::map<uint64_t, int>::const_iterator itt = values.find(idx);
+		if (itt != values.end())
+		{
+			value.Type = BV_NUMBER;
+			value.fValue = (lua_Number)itt->second;
 		}
+		return value;
 	}
-	else if (item.reason == REASON_TIME) {
-		boost::shared_lock<boost::shared_mutex> eventsMutexLock(m_eventsMutex);
-		std::vector<_tEventItem>::iterator it;
-		for (it = m_events.begin(); it != m_events.end(); ++it) {
-			bool eventInScope = ((it->Interpreter == "Blockly") && ((it->Type == "all") || (it->Type == m_szReason[item.reason])));
-			bool eventActive = (it->EventStatus == 1);
-			if ((eventInScope) && (eventActive)) {
-				// time rules will only run when time or date based critera are found
-				std::string conditions (it->Conditions);
-				if ((conditions.find("timeofday") != std::string::npos) || (conditions.find("weekday") != std::string::npos)) {
-
-					// Replace Sunrise and sunset placeholder with actual time for query
-					if (conditions.find("@Sunrise") != std::string::npos) {
-						int intRise = getSunRiseSunSetMinutes("Sunrise");
-						std::stringstream ssRise;
-						ssRise << intRise;
-						stdreplace(conditions, "@Sunrise", ssRise.str());
-					}
-					if (conditions.find("@Sunset") != std::string::npos) {
-						int intSet = getSunRiseSunSetMinutes("Sunset");
-						std::stringstream ssSet;
-						ssSet << intSet;
-						stdreplace(conditions, "@Sunset", ssSet.str());
-					}
+	const std::map<uint64_t, float> *pValues = NULL;
+	switch (table)
+	{
+	case BT_TEMPERATURE: pValues = &m_pEventSystem->m_tempValuesByID; break;
+	case BT_DEWPOINT: pValues = &m_pEventSystem->m_dewValuesByID; break;
+	case BT_BAROMETER: pValues = &m_pEventSystem->m_baroValuesByID; break;
+	case BT_UTILITY: pValues = &m_pEventSystem->m_utilityValuesByID; break;
+	case BT_WEATHER: pValues = &m_pEventSystem->m_weatherValuesByID; break;
+	case BT_RAIN: pValues = &m_pEventSystem->m_rainValuesByID; break;
+	case BT_RAINLASTHOUR: pValues = &m_pEventSystem->m_rainLastHourValuesByID; break;
+	case BT_UV: pValues = &m_pEventSystem->m_uvValuesByID; break;
+	case BT_WINDDIR: pValues = &m_pEventSystem->m_winddirValuesByID; break;
+	case BT_WINDSPEED: pValues = &m_pEventSystem->m_windspeedValuesByID; break;
+	case BT_WINDGUST: pValues = &m_pEventSystem->m_windgustValuesByID; break;
+	default: return value;
+	}
+	std::map<uint64_t, float>::const_iterator itt = pValues->find(idx);
+	if (itt != pValues->end())
+	{
+		value.Type = BV_NUMBER;
+		value.fValue = (lua_Number)itt->second;
+	}
+	return value;
+}
 
-					std::string ifCondition = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + conditions + " then result = 1 end; return result";
+double CEventSystem::CBlocklyContext::GetGlobal(const int global)
+{
+	if (global == BG_SECURITYSTATUS)
+		return m_pEventSystem->m_SecStatus;
+	if (!m_bHaveTime)
+	{
+		time_t now = mytime(NULL);
+		struct tm ltime;
+		localtime_r(&now, &ltime);
+		m_timeofday = (ltime.tm_hour * 60) + ltime.tm_min;
+		m_weekday = ltime.tm_wday + 1;
+		m_sunrise = m_pEventSystem->getSunRiseSunSetMinutes("Sunrise");
+		m_sunset = m_pEventSystem->getSunRiseSunSetMinutes("Sunset");
+		m_bHaveTime = true;
+	}
+	if (global == BG_TIMEOFDAY)
+		return m_timeofday;
+	if (global == BG_WEEKDAY)
+		return m_weekday;
+	if (global == BG_SUNRISE)
+		return m_sunrise;
+	return m_sunset;
+}
 
-					if (lua_state == NULL)
-					{
-						lua_state = CreateBlocklyLuaState();
-						if (lua_state == NULL)
-							return;
-					}
+void CEventSystem::EvaluateBlockly(const _tEventQueue &item)
+{
+	boost::shared_lock<boost::shared_mutex> eventsMutexLock(m_eventsMutex);
+	CMetricTimer timer(m_metrics.GetHistogram("event_script", "script", "blockly"));
 
-					//_log.Log(LOG_NORM,"ifc: %s",ifCondition.c_str());
-					if (luaL_dostring(lua_state, ifCondition.c_str()))
-					{
-						_log.Log(LOG_ERROR, "EventSystem: Lua script error (Blockly), Name: %s => %s", it->Name.c_str(), lua_tostring(lua_state, -1));
-					}
-					else {
-						lua_Number ruleTrue = lua_tonumber(lua_state, -1);
-						if (ruleTrue != 0)
-						{
-							if (m_sql.m_bLogEventScriptTrigger)
-								_log.Log(LOG_NORM, "EventSystem: Event triggered: %s", it->Name.c_str());
-							parseBlocklyActions(it->Actions, it->Name, it->ID);
-						}
-					}
-				}
-			}
-		}
+	const std::vector<size_t> *pRules = NULL;
+	if ((item.reason == REASON_DEVICE) && (item.DeviceID > 0))
+	{
+		std::map<uint64_t, std::vector<size_t> >::const_iterator itt = m_blocklyDeviceRules.find(item.DeviceID);
+		if (itt != m_blocklyDeviceRules.end())
+			pRules = &itt->second;
+	}
+	else if (item.reason == REASON_SECURITY)
+		pRules = &m_blocklySecurityRules;
+	else if (item.reason == REASON_TIME)
+		pRules = &m_blocklyTimeRules;
+	else if ((item.reason == REASON_USERVARIABLE) && (item.varId > 0))
+	{
+		std::map<uint64_t, std::vector<size_t> >::const_iterator itt = m_blocklyVariableRules.find(item.varId);
+		if (itt != m_blocklyVariableRules.end())
+			pRules = &itt->second;
 	}
-	else if ((item.reason == REASON_USERVARIABLE) && (item.varId >0)) {
-		std::size_t found;
-		boost::shared_lock<boost::shared_mutex> eventsMutexLock(m_eventsMutex);
-		std::vector<_tEventItem>::iterator it;
-		for (it = m_events.begin(); it != m_events.end(); ++it) {
-			bool eventInScope = ((it->Interpreter == "Blockly") && ((it->Type == "all") || (it->Type == m_szReason[item.reason])));
-			bool eventActive = (it->EventStatus == 1);
-			std::stringstream sstr;
-			sstr << "variable[" << item.varId << "]";
-			std::string conditions (it->Conditions);
-			found = conditions.find(sstr.str());
-
-			if ((eventInScope) && (eventActive) && (found != std::string::npos)) {
-
-				// Replace Sunrise and sunset placeholder with actual time for query
-				if (conditions.find("@Sunrise") != std::string::npos) {
-					int intRise = getSunRiseSunSetMinutes("Sunrise");
-					std::stringstream ssRise;
-					ssRise << intRise;
-					stdreplace(conditions, "@Sunrise", ssRise.str());
-				}
-				if (conditions.find("@Sunset") != std::string::npos) {
-					int intSet = getSunRiseSunSetMinutes("Sunset");
-					std::stringstream ssSet;
-					ssSet << intSet;
-					stdreplace(conditions, "@Sunset", ssSet.str());
-				}
-				std::string ifCondition = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + conditions + " then result = 1 end; return result";
+	if (pRules == NULL)
+		return;
 
-				if (lua_state == NULL)
-				{
-					lua_state = CreateBlocklyLuaState();
-					if (lua_state == NULL)
-						return;
-				}
+	lua_State *lua_state = NULL;
+	CBlocklyContext ctx(this);
 
-				//_log.Log(LOG_STATUS,"ifc: %s",ifCondition.c_str());
-				if (luaL_dostring(lua_state, ifCondition.c_str()))
-				{
-					_log.Log(LOG_ERROR, "EventSystem: Lua script error (Blockly), Name: %s => %s", it->Name.c_str(), lua_tostring(lua_state, -1));
-				}
-				else {
-					lua_Number ruleTrue = lua_tonumber(lua_state, -1);
+	std::vector<size_t>::const_iterator itt;
+	for (itt = pRules->begin(); itt != pRules->end(); ++itt)
+	{
+		const _tEventItem &eitem = m_events[*itt];
+		if ((eitem.Type != "all") && (eitem.Type != m_szReason[item.reason]))
+			continue;
 
-					if (ruleTrue != 0)
-					{
-						if (m_sql.m_bLogEventScriptTrigger)
-							_log.Log(LOG_NORM, "EventSystem: Event triggered: %s", it->Name.c_str());
-						parseBlocklyActions(it->Actions, it->Name, it->ID);
-					}
-				}
+		bool bRuleTrue = false;
+		if (eitem.Blockly.IsCompiled())
+		{
+			bool bError;
+			bRuleTrue = eitem.Blockly.Evaluate(ctx, bError);
+			if (bError)
+				_log.Log(LOG_ERROR, "EventSystem: Blockly condition error, Name: %s => attempt to compare values of a different type", eitem.Name.c_str());
+		}
+		else
+		{
+			if (lua_state == NULL)
+			{
+				lua_state = CreateBlocklyLuaState();
+				if (lua_state == NULL)
+					return;
+				lua_pushnumber(lua_state, (lua_Number)getSunRiseSunSetMinutes("Sunrise"));
+				lua_setglobal(lua_state, "blockly_sunrise");
+				lua_pushnumber(lua_state, (lua_Number)getSunRiseSunSetMinutes("Sunset"));
+				lua_setglobal(lua_state, "blockly_sunset");
 			}
+			if (luaL_dostring(lua_state, eitem.BlocklyLua.c_str()))
+			{
+				_log.Log(LOG_ERROR, "EventSystem: Lua script error (Blockly), Name: %s => %s", eitem.Name.c_str(), lua_tostring(lua_state, -1));
+			}
+			else
+			{
+				bRuleTrue = (lua_tonumber(lua_state, -1) != 0);
+			}
+			lua_settop(lua_state, 0);
+		}
+		if (bRuleTrue)
+		{
+			if (m_sql.m_bLogEventScriptTrigger)
+				_log.Log(LOG_NORM, "EventSystem: Event triggered: %s", eitem.Name.c_str());
+			parseBlocklyActions(eitem.Actions, eitem.Name, eitem.ID);
 		}
 	}
 
@@ -2590,6 +2643,13 @@ void CEventSystem::ParseActionString( const std::string &oAction_, _tActionParse
 #endif
 }
 
+//Script files are labeled without their directory, database events by their name
+static CMetricHistogram *ScriptHistogram(const std::string &filename)
+{
+	size_t pos = filename.find_last_of("/\\");
+	return m_metrics.GetHistogram("event_script", "script", (pos != std::string::npos) ? filename.substr(pos + 1) : filename);
+}
+
 #ifdef ENABLE_PYTHON
 
 // Python EventModule helper functions
@@ -2602,9 +2662,20 @@ void CEventSystem::EvaluatePython(const _tEventQueue &item, const std::string &f
 {
 	//_log.Log(LOG_NORM, "EventSystem: Already scheduled this event, skipping");
 	// _log.Log(LOG_STATUS, "EventSystem: script %s trigger, file: %s, script: %s, deviceName: %s" , reason.c_str(), filename.c_str(), PyString.c_str(), devname.c_str());
+	struct timeval tvStart, tvEnd, tvDiff;
+	getclock(&tvStart);
+
+	int intSunRise = getSunRiseSunSetMinutes("Sunrise");
+	int intSunSet = getSunRiseSunSetMinutes("Sunset");
+	boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
+	Plugins::PythonEventsProcessPython(m_szReason[item.reason], filename, PyString, item.DeviceID, m_devicestates, devicestatesMutexLock, m_uservariables, intSunRise, intSunSet);
+	if (devicestatesMutexLock.owns_lock())
+		devicestatesMutexLock.unlock();
 
-    Plugins::PythonEventsProcessPython(m_szReason[item.reason], filename, PyString, item.DeviceID, m_devicestates, m_uservariables, getSunRiseSunSetMinutes("Sunrise"),
-        getSunRiseSunSetMinutes("Sunset"));
+	getclock(&tvEnd);
+	timeval_subtract(&tvDiff, &tvEnd, &tvStart);
+	uint64_t usec = ((uint64_t)tvDiff.tv_sec * 1000000) + tvDiff.tv_usec;
+	ScriptHistogram(filename)->Record(usec);
 
 	//Py_Finalize();
 }
@@ -2669,6 +2740,7 @@ void CEventSystem::ExportDeviceStatesToLua(lua_State *lua_state)
 void CEventSystem::EvaluateLua(const _tEventQueue &item, const std::string &filename, const std::string &LuaString)
 {
 	boost::lock_guard<boost::mutex> l(luaMutex);
+	CMetricTimer timer(ScriptHistogram(filename));
 
 	//if (isEventscheduled(filename))
 	//{
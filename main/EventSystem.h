@@ -17,6 +17,7 @@ extern "C" {
 
 #include "LuaCommon.h"
 #include "concurrent_queue.h"
+#include "BlocklyCondition.h"
 
 #include "dzVents.h"
 
@@ -25,6 +26,24 @@ class CEventSystem : public CLuaCommon
 	friend class CdzVents;
 	typedef struct lua_State lua_State;
 
+	//Event system state as read by the compiled Blockly conditions, time and measurements are fetched once per run
+	class CBlocklyContext : public CBlocklyState
+	{
+	public:
+		explicit CBlocklyContext(CEventSystem *pEventSystem);
+		_tBlocklyValue GetTableValue(const int table, const uint64_t idx);
+		double GetGlobal(const int global);
+	private:
+		CEventSystem *m_pEventSystem;
+		bool m_bHaveTime;
+		int m_timeofday;
+		int m_weekday;
+		int m_sunrise;
+		int m_sunset;
+		bool m_bHaveMeasurements;
+	};
+	friend class CBlocklyContext;
+
 	struct _tEventItem
 	{
 		uint64_t ID;
@@ -35,7 +54,8 @@ class CEventSystem : public CLuaCommon
 		std::string Actions;
 		int SequenceNo;
 		int EventStatus;
-
+		CBlocklyCondition Blockly;
+		std::string BlocklyLua;
 	};
 
 	struct _tActionParseResults
@@ -117,6 +137,8 @@ public:
 	void LoadEvents();
 	void ProcessDevice(const int HardwareID, const uint64_t ulDevID, const unsigned char unit, const unsigned char devType, const unsigned char subType, const unsigned char signallevel, const unsigned char batterylevel, const int nValue, const char* sValue, const std::string &devname, const int varId);
 	void RemoveSingleState(const uint64_t ulDevID, const _eReason reason);
+	void BeginBatch();
+	void EndBatch();
 	void WWWUpdateSingleState(const uint64_t ulDevID, const std::string &devname, const _eReason reason);
 	void WWWUpdateSecurityState(int securityStatus);
 	void WWWGetItemStates(std::vector<_tDeviceStatus> &iStates);
@@ -170,6 +192,14 @@ private:
 		queue_element_trigger* trigger;
 	};
 	concurrent_queue<_tEventQueue> m_eventqueue;
+	struct _tEventBatch
+	{
+		int depth;
+		std::vector<_tEventQueue> items;
+	};
+	//a batch only holds back the events of the thread that started it
+	std::map<boost::thread::id, _tEventBatch> m_batches;
+	boost::mutex m_batchMutex;
 
 	std::vector<_tEventTrigger> m_eventtrigger;
 	bool m_bEnabled;
@@ -196,8 +226,10 @@ private:
 	void ProcessMinute();
 	void GetCurrentMeasurementStates();
 	std::string UpdateSingleState(const uint64_t ulDevID, const std::string &devname, const int nValue, const char* sValue, const unsigned char devType, const unsigned char subType, const _eSwitchType switchType, const std::string &lastUpdate, const unsigned char lastLevel, const std::map<std::string, std::string> & options);
+	void QueueDeviceEvent(const _tEventQueue &item);
 	void EvaluateEvent(const _tEventQueue &item);
 	void EvaluateBlockly(const _tEventQueue &item);
+	void CompileBlockly(_tEventItem &eitem, const size_t eventIdx);
 	bool parseBlocklyActions(const std::string &Actions, const std::string &eventName, const uint64_t eventID);
 	std::string ProcessVariableArgument(const std::string &Argument);
 #ifdef ENABLE_PYTHON
@@ -224,6 +256,11 @@ private:
 	void UnlockEventQueueThread();
 	//std::string reciprocalAction (std::string Action);
 	std::vector<_tEventItem> m_events;
+	//Blockly rules (index in m_events) per device/variable they refer to
+	std::map<uint64_t, std::vector<size_t> > m_blocklyDeviceRules;
+	std::map<uint64_t, std::vector<size_t> > m_blocklyVariableRules;
+	std::vector<size_t> m_blocklySecurityRules;
+	std::vector<size_t> m_blocklyTimeRules;
 
 
 	std::map<uint64_t, _tDeviceStatus> m_devicestates;
@@ -6,6 +6,8 @@
 #include "EventSystem.h"
 #include "mainworker.h"
 #include "localtime_r.h"
+#include "Helper.h"
+#include <fstream>
 
 #ifdef ENABLE_PYTHON
 
@@ -155,8 +157,10 @@
         bool PythonEventsStop() {
             if (m_PyInterpreter) {
                 PyEval_RestoreThread((PyThreadState*)m_PyInterpreter);
-				if (Plugins::Py_IsInitialized())
+				if (Plugins::Py_IsInitialized()) {
+					PythonEventsClearCache();
 					Py_EndInterpreter((PyThreadState*)m_PyInterpreter);
+				}
 				m_PyInterpreter = NULL;
                 _log.Log(LOG_STATUS, "EventSystem - Python stopped...");
                 return true;
@@ -190,9 +194,180 @@
             
             return Py_None;
         }
-       
 
-        void PythonEventsProcessPython(const std::string &reason, const std::string &filename, const std::string &PyString, const uint64_t DeviceID, std::map<uint64_t, CEventSystem::_tDeviceStatus> m_devicestates, std::map<uint64_t, CEventSystem::_tUserVariable> m_uservariables, int intSunRise, int intSunSet) {
+        // Compiled scripts, by file name (or event name for database scripts).
+        // File scripts are compiled again when the file changes, database scripts when the source changes
+        struct _tPythonScript {
+            PyObject* pCode;
+            time_t modified;
+            std::string source;
+        };
+        std::map<std::string, _tPythonScript> ScriptCache;
+
+        // Device objects exported in DomoticzEvents.Devices, only changed devices are replaced
+        struct _tPythonDevice {
+            PyObject* pDevice;
+            std::string name;
+            std::string lastUpdate;
+            int nValue;
+            std::string sValue;
+            std::string nValueWording;
+            int switchtype;
+        };
+        std::map<uint64_t, _tPythonDevice> DeviceCache;
+        PyObject* DeviceDict = NULL;
+
+        void PythonEventsClearCache() {
+            std::map<std::string, _tPythonScript>::iterator itt;
+            for (itt = ScriptCache.begin(); itt != ScriptCache.end(); ++itt)
+                Py_XDECREF(itt->second.pCode);
+            ScriptCache.clear();
+
+            std::map<uint64_t, _tPythonDevice>::iterator ittDevice;
+            for (ittDevice = DeviceCache.begin(); ittDevice != DeviceCache.end(); ++ittDevice)
+                Py_XDECREF(ittDevice->second.pDevice);
+            DeviceCache.clear();
+            Py_XDECREF(DeviceDict);
+            DeviceDict = NULL;
+        }
+
+        // Returns NULL when the script could not be compiled, the error is only reported once per change
+        PyObject* PythonEventsGetCode(const std::string &filename, const std::string &PyString) {
+            time_t modified = 0;
+            if (PyString.length() == 0) {
+                modified = file_modified_time(filename.c_str());
+                if (modified == 0) {
+                    _log.Log(LOG_ERROR, "Python EventSystem: Script file '%s' not found.", filename.c_str());
+                    return NULL;
+                }
+            }
+
+            std::map<std::string, _tPythonScript>::iterator itt = ScriptCache.find(filename);
+            if (itt != ScriptCache.end()) {
+                if ((itt->second.modified == modified) && (itt->second.source == PyString))
+                    return itt->second.pCode;
+                Py_XDECREF(itt->second.pCode);
+                ScriptCache.erase(itt);
+            }
+
+            std::string source = PyString;
+            if (source.length() == 0) {
+                std::ifstream infile(filename.c_str(), std::ios::in | std::ios::binary);
+                if (!infile.is_open()) {
+                    _log.Log(LOG_ERROR, "Python EventSystem: Failed to open script file '%s'.", filename.c_str());
+                    return NULL;
+                }
+                std::stringstream sstr;
+                sstr << infile.rdbuf();
+                source = sstr.str();
+            }
+
+            _tPythonScript script;
+            script.pCode = Plugins::Py_CompileStringExFlags(source.c_str(), filename.c_str(), Py_file_input, NULL, -1);
+            script.modified = modified;
+            script.source = PyString;
+            if (!script.pCode) {
+                _log.Log(LOG_ERROR, "Python EventSystem: Failed to compile '%s'.", filename.c_str());
+                Plugins::PyErr_Print();
+            }
+            ScriptCache[filename] = script;
+            return script.pCode;
+        }
+
+        PyObject* PythonEventsNewDevice(const CEventSystem::_tDeviceStatus &sitem) {
+            Plugins::PDevice* aDevice = (Plugins::PDevice*)Plugins::PDevice_new(&Plugins::PDeviceType, (PyObject*)NULL, (PyObject*)NULL);
+            if (!aDevice)
+                return NULL;
+
+            // If nValueWording contains %, unicode fails?
+
+            aDevice->id = static_cast<int>(sitem.ID);
+            Py_XDECREF(aDevice->name);
+            aDevice->name = Plugins::PyUnicode_FromString(sitem.deviceName.c_str());
+            aDevice->type = sitem.devType;
+            aDevice->sub_type = sitem.subType;
+            aDevice->switch_type = sitem.switchtype;
+            aDevice->n_value = sitem.nValue;
+            Py_XDECREF(aDevice->n_value_string);
+            aDevice->n_value_string = Plugins::PyUnicode_FromString(sitem.nValueWording.c_str());
+            Py_XDECREF(aDevice->s_value);
+            aDevice->s_value = Plugins::PyUnicode_FromString(sitem.sValue.c_str());
+            Py_XDECREF(aDevice->last_update_string);
+            aDevice->last_update_string = Plugins::PyUnicode_FromString(sitem.lastUpdate.c_str());
+            return (PyObject*)aDevice;
+        }
+
+        // Brings DomoticzEvents.Devices in line with the device states, returns false when the dictionary is not available
+        bool PythonEventsUpdateDevices(PyObject* pModuleDict, const std::map<uint64_t, CEventSystem::_tDeviceStatus> &devicestates) {
+            if (!DeviceDict) {
+                DeviceDict = Plugins::PyDict_New();
+                if (Plugins::PyDict_SetItemString(pModuleDict, "Devices", DeviceDict) == -1)
+                {
+                    _log.Log(LOG_ERROR, "Python EventSystem: Failed to add Device dictionary.");
+                    Py_DECREF(DeviceDict);
+                    DeviceDict = NULL;
+                    return false;
+                }
+            }
+
+            // removed devices
+            std::map<uint64_t, _tPythonDevice>::iterator ittCache = DeviceCache.begin();
+            while (ittCache != DeviceCache.end()) {
+                if (devicestates.find(ittCache->first) == devicestates.end()) {
+                    PyObject* pKey = Plugins::PyUnicode_FromString(ittCache->second.name.c_str());
+                    if (Plugins::PyDict_DelItem(DeviceDict, pKey) == -1)
+                        Plugins::PyErr_Clear();
+                    Py_DECREF(pKey);
+                    Py_XDECREF(ittCache->second.pDevice);
+                    DeviceCache.erase(ittCache++);
+                }
+                else
+                    ++ittCache;
+            }
+
+            std::map<uint64_t, CEventSystem::_tDeviceStatus>::const_iterator it_type;
+            for (it_type = devicestates.begin(); it_type != devicestates.end(); ++it_type)
+            {
+                const CEventSystem::_tDeviceStatus &sitem = it_type->second;
+                _tPythonDevice &cached = DeviceCache[sitem.ID];
+                if ((cached.pDevice) &&
+                    (cached.name == sitem.deviceName) &&
+                    (cached.lastUpdate == sitem.lastUpdate) &&
+                    (cached.nValue == sitem.nValue) &&
+                    (cached.sValue == sitem.sValue) &&
+                    (cached.nValueWording == sitem.nValueWording) &&
+                    (cached.switchtype == sitem.switchtype))
+                    continue;
+
+                if ((cached.pDevice) && (cached.name != sitem.deviceName)) {
+                    // renamed
+                    PyObject* pKey = Plugins::PyUnicode_FromString(cached.name.c_str());
+                    if (Plugins::PyDict_DelItem(DeviceDict, pKey) == -1)
+                        Plugins::PyErr_Clear();
+                    Py_DECREF(pKey);
+                }
+                Py_XDECREF(cached.pDevice);
+                cached.pDevice = PythonEventsNewDevice(sitem);
+                cached.name = sitem.deviceName;
+                cached.lastUpdate = sitem.lastUpdate;
+                cached.nValue = sitem.nValue;
+                cached.sValue = sitem.sValue;
+                cached.nValueWording = sitem.nValueWording;
+                cached.switchtype = sitem.switchtype;
+                if (!cached.pDevice)
+                    continue;
+
+                PyObject* pKey = Plugins::PyUnicode_FromString(sitem.deviceName.c_str());
+                if (Plugins::PyDict_SetItem(DeviceDict, pKey, cached.pDevice) == -1)
+                {
+                    _log.Log(LOG_ERROR, "Python EventSystem: Failed to add device '%s' to device dictionary.", sitem.deviceName.c_str());
+                }
+                Py_DECREF(pKey);
+            }
+            return true;
+        }
+
+        void PythonEventsProcessPython(const std::string &reason, const std::string &filename, const std::string &PyString, const uint64_t DeviceID, const std::map<uint64_t, CEventSystem::_tDeviceStatus> &m_devicestates, boost::shared_lock<boost::shared_mutex> &devicestatesMutexLock, const std::map<uint64_t, CEventSystem::_tUserVariable> &m_uservariables, int intSunRise, int intSunSet) {
 
        
             if (!ModuleInitalized) {
@@ -218,70 +393,33 @@
                        return;
                    }
 
-                   if (Plugins::PyDict_SetItemString(pModuleDict, "changed_device_name", Plugins::PyUnicode_FromString(m_devicestates[DeviceID].deviceName.c_str())) == -1) {
-                       _log.Log(LOG_ERROR, "Python EventSystem: Failed to set changed_device_name.");
-                       return;
-                   }
-
-                   PyObject* m_DeviceDict = Plugins::PyDict_New();
-
-                   if (Plugins::PyDict_SetItemString(pModuleDict, "Devices", (PyObject*)m_DeviceDict) == -1)
-                   {
-                       _log.Log(LOG_ERROR, "Python EventSystem: Failed to add Device dictionary.");
-                       return;
-                   }
-                   Py_DECREF(m_DeviceDict);
-
                    if (Plugins::PyType_Ready(&Plugins::PDeviceType) < 0) {
                        _log.Log(LOG_ERROR, "Python EventSystem: Unable to ready DeviceType Object.");
                        return;
                    }
 
-                   // Mutex
-                   // boost::shared_lock<boost::shared_mutex> devicestatesMutexLock1(m_devicestatesMutex);
-
-                   std::map<uint64_t, CEventSystem::_tDeviceStatus>::const_iterator it_type;
-                   for (it_type = m_devicestates.begin(); it_type != m_devicestates.end(); ++it_type)
-                   {
-                       CEventSystem::_tDeviceStatus sitem = it_type->second;
-                       // object deviceStatus = domoticz_module.attr("Device")(sitem.ID, sitem.deviceName, sitem.devType, sitem.subType, sitem.switchtype, sitem.nValue, sitem.nValueWording, sitem.sValue, sitem.lastUpdate);
-                       // devices[sitem.deviceName] = deviceStatus;
-
-                       Plugins::PDevice* aDevice = (Plugins::PDevice*)Plugins::PDevice_new(&Plugins::PDeviceType, (PyObject*)NULL, (PyObject*)NULL);
-                       PyObject* pKey = Plugins::PyUnicode_FromString(sitem.deviceName.c_str());
-
-                       if (sitem.ID == DeviceID) {
-                           if (Plugins::PyDict_SetItemString(pModuleDict, "changed_device", (PyObject*)aDevice) == -1) {
-                               _log.Log(LOG_ERROR, "Python EventSystem: Failed to add device '%s' as changed_device.", sitem.deviceName.c_str());
-                           }
-                       }
-
-                       if (Plugins::PyDict_SetItem((PyObject*)m_DeviceDict, pKey, (PyObject*)aDevice) == -1)
-                       {
-                           _log.Log(LOG_ERROR, "Python EventSystem: Failed to add device '%s' to device dictionary.", sitem.deviceName.c_str());
-                       } else {
-
-                           // _log.Log(LOG_ERROR, "Python EventSystem: nValueWording '%s' - done. ", sitem.nValueWording.c_str());
+                   if (!PythonEventsUpdateDevices(pModuleDict, m_devicestates))
+                       return;
 
-                           std::string temp_n_value_string = sitem.nValueWording;
+                   std::string changedDeviceName;
+                   std::map<uint64_t, CEventSystem::_tDeviceStatus>::const_iterator itt = m_devicestates.find(DeviceID);
+                   if (itt != m_devicestates.end())
+                       changedDeviceName = itt->second.deviceName;
+                   // the script can schedule commands, which need the device states
+                   devicestatesMutexLock.unlock();
 
-                           // If nValueWording contains %, unicode fails?
+                   PyObject* pChangedName = Plugins::PyUnicode_FromString(changedDeviceName.c_str());
+                   if (Plugins::PyDict_SetItemString(pModuleDict, "changed_device_name", pChangedName) == -1) {
+                       _log.Log(LOG_ERROR, "Python EventSystem: Failed to set changed_device_name.");
+                   }
+                   Py_DECREF(pChangedName);
 
-                           aDevice->id = static_cast<int>(sitem.ID);
-                           aDevice->name = Plugins::PyUnicode_FromString(sitem.deviceName.c_str());
-                           aDevice->type = sitem.devType;
-                           aDevice->sub_type = sitem.subType;
-                           aDevice->switch_type = sitem.switchtype;
-                           aDevice->n_value = sitem.nValue;
-                           aDevice->n_value_string = Plugins::PyUnicode_FromString(temp_n_value_string.c_str());
-                           aDevice->s_value = Plugins::PyUnicode_FromString(sitem.sValue.c_str());
-                           aDevice->last_update_string = Plugins::PyUnicode_FromString(sitem.lastUpdate.c_str());
-                           // _log.Log(LOG_STATUS, "Python EventSystem: deviceName %s added to device dictionary", sitem.deviceName.c_str());
+                   std::map<uint64_t, _tPythonDevice>::const_iterator ittChanged = DeviceCache.find(DeviceID);
+                   if ((ittChanged != DeviceCache.end()) && (ittChanged->second.pDevice)) {
+                       if (Plugins::PyDict_SetItemString(pModuleDict, "changed_device", ittChanged->second.pDevice) == -1) {
+                           _log.Log(LOG_ERROR, "Python EventSystem: Failed to add device '%s' as changed_device.", changedDeviceName.c_str());
                        }
-                       Py_DECREF(aDevice);
-                       Py_DECREF(pKey);
                    }
-                   // devicestatesMutexLock1.unlock();
 
                    // Time related
 
@@ -339,24 +477,24 @@
 
                    std::map<uint64_t, CEventSystem::_tUserVariable>::const_iterator it_var;
                    for (it_var = m_uservariables.begin(); it_var != m_uservariables.end(); ++it_var) {
-                       CEventSystem::_tUserVariable uvitem = it_var->second;
+                       const CEventSystem::_tUserVariable &uvitem = it_var->second;
                        Plugins::PyDict_SetItemString(m_uservariablesDict, uvitem.variableName.c_str(), Plugins::PyUnicode_FromString(uvitem.variableValue.c_str()));
                    }
 
                    // uservariablesMutexLock2.unlock();
                    
 
-                   if(PyString.length() > 0) {
-                       // Python-string from WebEditor
-                       Plugins::PyRun_SimpleStringFlags(PyString.c_str(), NULL);
-                       
-                   } else {
-                       // Script-file
-                       FILE* PythonScriptFile = fopen(filename.c_str(), "r");
-                       Plugins::PyRun_SimpleFileExFlags(PythonScriptFile, filename.c_str(), 0, NULL);
-                       
-                       if (PythonScriptFile!=NULL)
-                           fclose(PythonScriptFile);
+                   PyObject* pCode = PythonEventsGetCode(filename, PyString);
+                   if (pCode) {
+                       // run in __main__, like the scripts did with PyRun_Simple*
+                       PyObject* pMainDict = Plugins::PyModule_GetDict(Plugins::PyImport_AddModule("__main__"));
+                       PyObject* pFile = Plugins::PyUnicode_FromString(filename.c_str());
+                       Plugins::PyDict_SetItemString(pMainDict, "__file__", pFile);
+                       Py_DECREF(pFile);
+                       PyObject* pResult = Plugins::PyEval_EvalCode(pCode, pMainDict, pMainDict);
+                       if (!pResult)
+                           Plugins::PyErr_Print();
+                       Py_XDECREF(pResult);
                    }
                 } else {
                     _log.Log(LOG_ERROR, "Python EventSystem: Module not available to events");
@@ -16,6 +16,8 @@
         PyObject* PythonEventsGetModule (void);
         bool PythonEventsInitialize(std::string szUserDataFolder);
         bool PythonEventsStop();
-        void PythonEventsProcessPython(const std::string &reason, const std::string &filename, const std::string &PyString, const uint64_t DeviceID, std::map<uint64_t, CEventSystem::_tDeviceStatus> m_devicestates, std::map<uint64_t, CEventSystem::_tUserVariable> m_uservariables, int intSunRise, int intSunSet);
+        void PythonEventsClearCache();
+        // the device states lock is released before the script runs, the script can schedule commands
+        void PythonEventsProcessPython(const std::string &reason, const std::string &filename, const std::string &PyString, const uint64_t DeviceID, const std::map<uint64_t, CEventSystem::_tDeviceStatus> &m_devicestates, boost::shared_lock<boost::shared_mutex> &devicestatesMutexLock, const std::map<uint64_t, CEventSystem::_tUserVariable> &m_uservariables, int intSunRise, int intSunSet);
     }
 #endif
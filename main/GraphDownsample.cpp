@@ -0,0 +1,422 @@
+#include "stdafx.h"
+#include "GraphDownsample.h"
+#include "../json/json.h"
+#include <cmath>
+
+struct _tGraphSeries
+{
+	std::vector<double> values;
+	std::vector<bool> valid;
+	size_t minIndex;
+	size_t maxIndex;
+	double range;
+};
+
+static bool GetGraphValue(const Json::Value &value, double &result)
+{
+	if (value.isNumeric())
+	{
+		result = value.asDouble();
+		return true;
+	}
+	if (value.isString())
+	{
+		const char *str = value.asCString();
+		char *end = NULL;
+		result = strtod(str, &end);
+		return (end != str) && (*end == 0);
+	}
+	return false;
+}
+
+//Minutes since 1970-01-01 for "YYYY-MM-DD" and "YYYY-MM-DD HH:MM", without a timezone (only the distance matters)
+static bool GetGraphTime(const Json::Value &row, double &result)
+{
+	if (!row.isMember("d"))
+		return false;
+	const Json::Value &date = row["d"];
+	if (!date.isString())
+		return false;
+	int year, month, day;
+	int hour = 0;
+	int minute = 0;
+	if (sscanf(date.asCString(), "%d-%d-%d %d:%d", &year, &month, &day, &hour, &minute) < 3)
+		return false;
+	if ((month < 1) || (month > 12))
+		return false;
+	//days from civil
+	year -= (month <= 2) ? 1 : 0;
+	const int era = (year >= 0 ? year : year - 399) / 400;
+	const int yoe = year - era * 400;
+	const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	const double days = (double)era * 146097.0 + (double)doe - 719468.0;
+	result = days * 1440.0 + hour * 60 + minute;
+	return true;
+}
+
+static void KeepBucketExtremes(const std::vector<_tGraphSeries> &series, const size_t start, const size_t end, std::vector<bool> &keep)
+{
+	for (std::vector<_tGraphSeries>::const_iterator itt = series.begin(); itt != series.end(); ++itt)
+	{
+		size_t minIndex = end;
+		size_t maxIndex = end;
+		for (size_t ii = start; ii < end; ii++)
+		{
+			if (!itt->valid[ii])
+				continue;
+			if ((minIndex == end) || (itt->values[ii] < itt->values[minIndex]))
+				minIndex = ii;
+			if ((maxIndex == end) || (itt->values[ii] > itt->values[maxIndex]))
+				maxIndex = ii;
+		}
+		if (minIndex != end)
+			keep[minIndex] = true;
+		if (maxIndex != end)
+			keep[maxIndex] = true;
+	}
+}
+
+//LTTB over all fields at once, the triangle areas of the fields are normalized on their range and summed
+static void SelectLTTB(const std::vector<_tGraphSeries> &series, const std::vector<double> &times, const size_t maxPoints, std::vector<bool> &keep)
+{
+	const size_t total = times.size();
+	const size_t buckets = maxPoints - 2;
+	const double bucketSize = (double)(total - 2) / (double)buckets;
+	const double timeRange = (times[total - 1] > times[0]) ? times[total - 1] - times[0] : 1.0;
+
+	size_t a = 0;
+	for (size_t bb = 0; bb < buckets; bb++)
+	{
+		size_t start = (size_t)floor(bb * bucketSize) + 1;
+		size_t end = (size_t)floor((bb + 1) * bucketSize) + 1;
+		if (end > total - 1)
+			end = total - 1;
+		if (start >= end)
+			continue;
+
+		//average of the next bucket (or the last point)
+		size_t nextStart = end;
+		size_t nextEnd = (bb + 1 < buckets) ? (size_t)floor((bb + 2) * bucketSize) + 1 : total;
+		if (nextEnd > total)
+			nextEnd = total;
+		if (nextEnd <= nextStart)
+			nextEnd = nextStart + 1;
+
+		double avgTime = 0;
+		for (size_t ii = nextStart; ii < nextEnd; ii++)
+			avgTime += times[ii];
+		avgTime /= (double)(nextEnd - nextStart);
+
+		std::vector<double> avgValues(series.size(), 0.0);
+		std::vector<bool> avgValid(series.size(), false);
+		for (size_t ss = 0; ss < series.size(); ss++)
+		{
+			int count = 0;
+			for (size_t ii = nextStart; ii < nextEnd; ii++)
+			{
+				if (series[ss].valid[ii])
+				{
+					avgValues[ss] += series[ss].values[ii];
+					count++;
+				}
+			}
+			if (count > 0)
+			{
+				avgValues[ss] /= (double)count;
+				avgValid[ss] = true;
+			}
+		}
+
+		const double xa = (times[a] - times[0]) / timeRange;
+		const double xc = (avgTime - times[0]) / timeRange;
+		size_t selected = start;
+		double maxArea = -1;
+		for (size_t ii = start; ii < end; ii++)
+		{
+			const double xb = (times[ii] - times[0]) / timeRange;
+			double area = 0;
+			for (size_t ss = 0; ss < series.size(); ss++)
+			{
+				const _tGraphSeries &s = series[ss];
+				if ((!s.valid[a]) || (!s.valid[ii]) || (!avgValid[ss]) || (s.range <= 0))
+					continue;
+				const double ya = s.values[a] / s.range;
+				const double yb = s.values[ii] / s.range;
+				const double yc = avgValues[ss] / s.range;
+				area += fabs((xa - xc) * (yb - ya) - (xa - xb) * (yc - ya));
+			}
+			if (area > maxArea)
+			{
+				maxArea = area;
+				selected = ii;
+			}
+		}
+		keep[selected] = true;
+		a = selected;
+	}
+}
+
+void DownsampleGraphResult(Json::Value &rows, const size_t maxPoints, const _eDownsampleMethod method)
+{
+	if (!rows.isArray())
+		return;
+	const size_t total = rows.size();
+	if ((maxPoints < 3) || (total <= maxPoints))
+		return;
+
+	//collect the numeric fields of all rows, and their time
+	std::map<std::string, size_t> seriesIndex;
+	std::vector<_tGraphSeries> series;
+	std::vector<double> times(total);
+	bool bHaveTimes = true;
+	for (size_t ii = 0; ii < total; ii++)
+	{
+		const Json::Value &row = rows[(Json::ArrayIndex)ii];
+		if (!row.isObject())
+			return;
+		if ((bHaveTimes) && (!GetGraphTime(row, times[ii])))
+			bHaveTimes = false;
+
+		for (Json::Value::const_iterator itt = row.begin(); itt != row.end(); ++itt)
+		{
+			const std::string name = itt.name();
+			if (name == "d")
+				continue;
+			double value;
+			if (!GetGraphValue(*itt, value))
+				continue;
+			std::map<std::string, size_t>::const_iterator sitt = seriesIndex.find(name);
+			size_t sidx;
+			if (sitt == seriesIndex.end())
+			{
+				sidx = series.size();
+				seriesIndex[name] = sidx;
+				series.push_back(_tGraphSeries());
+				series[sidx].values.resize(total, 0.0);
+				series[sidx].valid.resize(total, false);
+			}
+			else
+				sidx = sitt->second;
+			series[sidx].values[ii] = value;
+			series[sidx].valid[ii] = true;
+		}
+	}
+	if (series.empty())
+		return;
+	if (!bHaveTimes)
+	{
+		for (size_t ii = 0; ii < total; ii++)
+			times[ii] = (double)ii;
+	}
+	else
+	{
+		//rows should already be ordered on their date, do not reshape anything that is not
+		for (size_t ii = 1; ii < total; ii++)
+		{
+			if (times[ii] < times[ii - 1])
+				return;
+		}
+	}
+
+	for (std::vector<_tGraphSeries>::iterator itt = series.begin(); itt != series.end(); ++itt)
+	{
+		itt->minIndex = total;
+		itt->maxIndex = total;
+		for (size_t ii = 0; ii < total; ii++)
+		{
+			if (!itt->valid[ii])
+				continue;
+			if ((itt->minIndex == total) || (itt->values[ii] < itt->values[itt->minIndex]))
+				itt->minIndex = ii;
+			if ((itt->maxIndex == total) || (itt->values[ii] > itt->values[itt->maxIndex]))
+				itt->maxIndex = ii;
+		}
+		itt->range = (itt->minIndex != total) ? itt->values[itt->maxIndex] - itt->values[itt->minIndex] : 0;
+	}
+
+	std::vector<bool> keep(total, false);
+	keep[0] = true;
+	keep[total - 1] = true;
+	if (method == DOWNSAMPLE_MINMAX)
+	{
+		//every bucket gives at most two rows per field
+		size_t buckets = maxPoints / (2 * series.size());
+		if (buckets < 1)
+			buckets = 1;
+		const double bucketSize = (double)total / (double)buckets;
+		for (size_t bb = 0; bb < buckets; bb++)
+		{
+			size_t start = (size_t)floor(bb * bucketSize);
+			size_t end = (bb + 1 < buckets) ? (size_t)floor((bb + 1) * bucketSize) : total;
+			KeepBucketExtremes(series, start, end, keep);
+		}
+	}
+	else
+	{
+		SelectLTTB(series, times, maxPoints, keep);
+		//a peak could lose against a larger triangle in its bucket
+		for (std::vector<_tGraphSeries>::const_iterator itt = series.begin(); itt != series.end(); ++itt)
+		{
+			if (itt->minIndex != total)
+				keep[itt->minIndex] = true;
+			if (itt->maxIndex != total)
+				keep[itt->maxIndex] = true;
+		}
+	}
+
+	Json::Value reduced(Json::arrayValue);
+	for (size_t ii = 0; ii < total; ii++)
+	{
+		if (keep[ii])
+			reduced.append(rows[(Json::ArrayIndex)ii]);
+	}
+	rows.swap(reduced);
+}
+
+#define NO_ROW ((size_t)-1)
+
+CGraphRowDownsampler::CGraphRowDownsampler(const size_t maxPoints, const size_t dateColumn) :
+	m_maxPoints(maxPoints),
+	m_dateColumn(dateColumn),
+	m_rowCount(0),
+	m_bucketRows(1)
+{
+}
+
+bool CGraphRowDownsampler::IsReferenced(const _tRowBucket &bucket, const size_t row)
+{
+	if ((bucket.first == row) || (bucket.last == row))
+		return true;
+	for (size_t ii = 0; ii < bucket.minRow.size(); ii++)
+	{
+		if ((bucket.minRow[ii] == row) || (bucket.maxRow[ii] == row))
+			return true;
+	}
+	return false;
+}
+
+void CGraphRowDownsampler::DropIfUnreferenced(const _tRowBucket &bucket, const size_t row)
+{
+	if ((row != NO_ROW) && (!IsReferenced(bucket, row)))
+		m_rows.erase(row);
+}
+
+void CGraphRowDownsampler::AddRow(const std::vector<std::string> &row)
+{
+	const size_t seq = m_rowCount++;
+	if (m_maxPoints == 0)
+	{
+		m_allRows.push_back(row);
+		return;
+	}
+	if ((m_buckets.empty()) || (m_buckets.back().rows >= m_bucketRows))
+	{
+		_tRowBucket bucket;
+		bucket.first = seq;
+		bucket.last = seq;
+		bucket.rows = 0;
+		bucket.minRow.resize(row.size(), NO_ROW);
+		bucket.maxRow.resize(row.size(), NO_ROW);
+		bucket.minValue.resize(row.size(), 0.0);
+		bucket.maxValue.resize(row.size(), 0.0);
+		m_buckets.push_back(bucket);
+	}
+	_tRowBucket &bucket = m_buckets.back();
+	m_rows[seq] = row;
+
+	std::vector<size_t> replaced;
+	if (bucket.rows > 0)
+		replaced.push_back(bucket.last);
+	bucket.rows++;
+	bucket.last = seq;
+	const size_t columns = std::min(row.size(), bucket.minRow.size());
+	for (size_t ii = 0; ii < columns; ii++)
+	{
+		if (ii == m_dateColumn)
+			continue;
+		const char *str = row[ii].c_str();
+		char *end = NULL;
+		const double value = strtod(str, &end);
+		if ((end == str) || (*end != 0))
+			continue;
+		if ((bucket.minRow[ii] == NO_ROW) || (value < bucket.minValue[ii]))
+		{
+			replaced.push_back(bucket.minRow[ii]);
+			bucket.minRow[ii] = seq;
+			bucket.minValue[ii] = value;
+		}
+		if ((bucket.maxRow[ii] == NO_ROW) || (value > bucket.maxValue[ii]))
+		{
+			replaced.push_back(bucket.maxRow[ii]);
+			bucket.maxRow[ii] = seq;
+			bucket.maxValue[ii] = value;
+		}
+	}
+	for (std::vector<size_t>::const_iterator itt = replaced.begin(); itt != replaced.end(); ++itt)
+		DropIfUnreferenced(bucket, *itt);
+
+	if (m_buckets.size() > 2 * m_maxPoints)
+		MergeBuckets();
+}
+
+//Every pair of buckets becomes one, keeping the first row of the left, the last row of the right and the extremes of both
+void CGraphRowDownsampler::MergeBuckets()
+{
+	std::vector<_tRowBucket> merged;
+	merged.reserve(m_buckets.size() / 2 + 1);
+	for (size_t bb = 0; bb < m_buckets.size(); bb += 2)
+	{
+		if (bb + 1 == m_buckets.size())
+		{
+			merged.push_back(m_buckets[bb]);
+			break;
+		}
+		const _tRowBucket &left = m_buckets[bb];
+		const _tRowBucket &right = m_buckets[bb + 1];
+		_tRowBucket bucket = left;
+		bucket.last = right.last;
+		bucket.rows = left.rows + right.rows;
+		for (size_t ii = 0; ii < bucket.minRow.size(); ii++)
+		{
+			if ((right.minRow[ii] != NO_ROW) && ((bucket.minRow[ii] == NO_ROW) || (right.minValue[ii] < bucket.minValue[ii])))
+			{
+				bucket.minRow[ii] = right.minRow[ii];
+				bucket.minValue[ii] = right.minValue[ii];
+			}
+			if ((right.maxRow[ii] != NO_ROW) && ((bucket.maxRow[ii] == NO_ROW) || (right.maxValue[ii] > bucket.maxValue[ii])))
+			{
+				bucket.maxRow[ii] = right.maxRow[ii];
+				bucket.maxValue[ii] = right.maxValue[ii];
+			}
+		}
+		//the rows only the old buckets used
+		DropIfUnreferenced(bucket, left.last);
+		DropIfUnreferenced(bucket, right.first);
+		for (size_t ii = 0; ii < bucket.minRow.size(); ii++)
+		{
+			DropIfUnreferenced(bucket, left.minRow[ii]);
+			DropIfUnreferenced(bucket, left.maxRow[ii]);
+			DropIfUnreferenced(bucket, right.minRow[ii]);
+			DropIfUnreferenced(bucket, right.maxRow[ii]);
+		}
+		merged.push_back(bucket);
+	}
+	m_buckets.swap(merged);
+	m_bucketRows *= 2;
+}
+
+void CGraphRowDownsampler::GetRows(std::vector<std::vector<std::string> > &rows)
+{
+	rows.clear();
+	if (m_maxPoints == 0)
+	{
+		rows.swap(m_allRows);
+		return;
+	}
+	rows.reserve(m_rows.size());
+	for (std::map<size_t, std::vector<std::string> >::const_iterator itt = m_rows.begin(); itt != m_rows.end(); ++itt)
+		rows.push_back(itt->second);
+	m_rows.clear();
+	m_buckets.clear();
+}
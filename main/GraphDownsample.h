@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Json
+{
+	class Value;
+};
+
+enum _eDownsampleMethod
+{
+	DOWNSAMPLE_LTTB = 0,	//Largest-Triangle-Three-Buckets, keeps the visual shape
+	DOWNSAMPLE_MINMAX		//Minimum and maximum of every field per bucket
+};
+
+//Reduces a graph result array (rows ordered on their "d" date, values as numbers or numeric strings) to about maxPoints rows.
+//The first and last row, and the rows holding the minimum and maximum of every field, are always kept.
+void DownsampleGraphResult(Json::Value &rows, const size_t maxPoints, const _eDownsampleMethod method);
+
+//First stage for query results, fed one row at a time while SQLite returns them (CSQLHelper::safe_queryRows) so a long
+//history is never held as a whole. Rows are grouped in buckets that keep their first and last row and the rows with the
+//minimum and maximum of every numeric column. When there are more than 2*maxPoints buckets, neighbours are merged.
+//DownsampleGraphResult then reduces the graph built from the remaining rows. Rows have to arrive ordered on their date.
+class CGraphRowDownsampler
+{
+public:
+	//maxPoints 0 keeps every row, dateColumn is not taken as a value
+	CGraphRowDownsampler(const size_t maxPoints, const size_t dateColumn);
+	void AddRow(const std::vector<std::string> &row);
+	//The remaining rows, in the order they were added
+	void GetRows(std::vector<std::vector<std::string> > &rows);
+	size_t GetRowCount() const { return m_rowCount; }
+	size_t GetKeptRowCount() const { return (m_maxPoints == 0) ? m_allRows.size() : m_rows.size(); }
+private:
+	struct _tRowBucket
+	{
+		size_t first;
+		size_t last;
+		size_t rows;
+		std::vector<size_t> minRow;
+		std::vector<size_t> maxRow;
+		std::vector<double> minValue;
+		std::vector<double> maxValue;
+	};
+	static bool IsReferenced(const _tRowBucket &bucket, const size_t row);
+	void DropIfUnreferenced(const _tRowBucket &bucket, const size_t row);
+	void MergeBuckets();
+
+	size_t m_maxPoints;
+	size_t m_dateColumn;
+	size_t m_rowCount;
+	size_t m_bucketRows;
+	std::vector<_tRowBucket> m_buckets;
+	std::map<size_t, std::vector<std::string> > m_rows; //rows still referenced by a bucket, on their sequence number
+	std::vector<std::vector<std::string> > m_allRows;
+};
@@ -286,6 +286,15 @@ bool file_exist (const char *filename)
 	return (stat(filename, &sbuffer) == 0);
 }
 
+//returns 0 when the file does not exist
+time_t file_modified_time(const char *filename)
+{
+	struct stat sbuffer;
+	if (stat(filename, &sbuffer) != 0)
+		return 0;
+	return sbuffer.st_mtime;
+}
+
 double CalculateAltitudeFromPressure(double pressure)
 {
 	double seaLevelPressure=101325.0;
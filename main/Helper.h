@@ -16,6 +16,7 @@ void stdreplace(
 	const std::string& replaceWithWhat);
 void stdupper(std::string &inoutstring);
 bool file_exist (const char *filename);
+time_t file_modified_time(const char *filename);
 std::vector<std::string> GetSerialPorts(bool &bUseDirectPath);
 double CalculateAltitudeFromPressure(double pressure);
 float pressureSeaLevelFromAltitude(float altitude, float atmospheric, float temp);
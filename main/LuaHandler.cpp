@@ -116,6 +116,14 @@ int CLuaHandler::l_domoticz_print(lua_State* lua_state)
 CLuaHandler::CLuaHandler(int hwdID)
 {
 	m_HwdID = hwdID;
+	m_cached_state = NULL;
+	m_cachedScriptRef = LUA_NOREF;
+	m_cachedScriptModified = 0;
+}
+
+CLuaHandler::~CLuaHandler()
+{
+	luaCloseCachedState();
 }
 
 void CLuaHandler::luaThread(lua_State *lua_state, const std::string &filename)
@@ -146,6 +154,25 @@ void CLuaHandler::report_errors(lua_State *L, int status)
 	}
 }
 
+void CLuaHandler::luaInitState(lua_State *lua_state)
+{
+	luaL_openlibs(lua_state);
+	lua_pushcfunction(lua_state, l_domoticz_print);
+	lua_setglobal(lua_state, "print");
+
+	lua_pushcfunction(lua_state, l_domoticz_updateDevice);
+	lua_setglobal(lua_state, "domoticz_updateDevice");
+
+	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
+	lua_setglobal(lua_state, "domoticz_applyJsonPath");
+
+	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
+	lua_setglobal(lua_state, "domoticz_applyXPath");
+
+	lua_pushinteger(lua_state, m_HwdID);
+	lua_setglobal(lua_state, "hwdId");
+}
+
 bool CLuaHandler::executeLuaScript(const std::string &script, const std::string &content)
 {
 	std::vector<std::string> allParameters;
@@ -164,22 +191,7 @@ bool CLuaHandler::executeLuaScript(const std::string &script, const std::string
 
 	lua_State *lua_state;
 	lua_state = luaL_newstate();
-
-	luaL_openlibs(lua_state);
-	lua_pushcfunction(lua_state, l_domoticz_print);
-	lua_setglobal(lua_state, "print");
-
-	lua_pushcfunction(lua_state, l_domoticz_updateDevice);
-	lua_setglobal(lua_state, "domoticz_updateDevice");
-
-	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
-	lua_setglobal(lua_state, "domoticz_applyJsonPath");
-
-	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
-	lua_setglobal(lua_state, "domoticz_applyXPath");
-
-	lua_pushinteger(lua_state, m_HwdID);
-	lua_setglobal(lua_state, "hwdId");
+	luaInitState(lua_state);
 
 	lua_createtable(lua_state, 1, 0);
 	lua_pushstring(lua_state, "content");
@@ -222,3 +234,73 @@ bool CLuaHandler::executeLuaScript(const std::string &script, const std::string
 	}
 	return false;
 }
+
+void CLuaHandler::luaCloseCachedState()
+{
+	if (m_cached_state != NULL)
+	{
+		lua_close(m_cached_state);
+		m_cached_state = NULL;
+	}
+	m_cachedScriptRef = LUA_NOREF;
+	m_cachedScriptFilename = "";
+	m_cachedScriptModified = 0;
+}
+
+bool CLuaHandler::luaLoadCachedScript(const std::string &fullfilename)
+{
+	time_t modified = file_modified_time(fullfilename.c_str());
+	if ((m_cached_state != NULL) && (fullfilename == m_cachedScriptFilename) && (modified == m_cachedScriptModified))
+		return true;
+
+	luaCloseCachedState();
+	m_cached_state = luaL_newstate();
+	luaInitState(m_cached_state);
+
+	int status = luaL_loadfile(m_cached_state, fullfilename.c_str());
+	if (status != 0)
+	{
+		report_errors(m_cached_state, status);
+		luaCloseCachedState();
+		return false;
+	}
+	//keep the compiled chunk in the registry
+	m_cachedScriptRef = luaL_ref(m_cached_state, LUA_REGISTRYINDEX);
+	m_cachedScriptFilename = fullfilename;
+	m_cachedScriptModified = modified;
+	return true;
+}
+
+bool CLuaHandler::executeCachedLuaScript(const std::string &script, const char *content, const size_t contentLength)
+{
+	std::stringstream lua_DirT;
+#ifdef WIN32
+	lua_DirT << szUserDataFolder << "scripts\\lua_parsers\\";
+#else
+	lua_DirT << szUserDataFolder << "scripts/lua_parsers/";
+#endif
+	std::string fullfilename = lua_DirT.str() + script;
+
+	if (!luaLoadCachedScript(fullfilename))
+		return false;
+
+	lua_State *lua_state = m_cached_state;
+
+	lua_createtable(lua_state, 1, 0);
+	lua_pushstring(lua_state, "content");
+	lua_pushlstring(lua_state, content, contentLength);
+	lua_rawset(lua_state, -3);
+	lua_setglobal(lua_state, "request");
+
+	m_mainworker.m_eventsystem.ExportDeviceStatesToLua(lua_state);
+
+	lua_createtable(lua_state, 0, 0);
+	lua_setglobal(lua_state, "uri");
+
+	lua_rawgeti(lua_state, LUA_REGISTRYINDEX, m_cachedScriptRef);
+	lua_sethook(lua_state, luaStop, LUA_MASKCOUNT, 10000000);
+	int status = lua_pcall(lua_state, 0, 0, 0);
+	lua_sethook(lua_state, NULL, 0, 0);
+	report_errors(lua_state, status);
+	return (status == 0);
+}
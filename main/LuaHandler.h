@@ -9,11 +9,19 @@ class CLuaHandler : public CLuaCommon
 {
 public:
 	explicit CLuaHandler(int hwdID = 0);
+	~CLuaHandler();
 
 	bool executeLuaScript(const std::string &script, const std::string &content);
 	bool executeLuaScript(const std::string &script, const std::string &content, std::vector<std::string>& allParameters);
 
+	//Runs the script in a state that is kept by this handler, the script is only compiled again when the file changes.
+	//Runs on the calling thread, for handlers owned by a hardware worker
+	bool executeCachedLuaScript(const std::string &script, const char *content, const size_t contentLength);
+
 private:
+	void luaInitState(lua_State *lua_state);
+	bool luaLoadCachedScript(const std::string &fullfilename);
+	void luaCloseCachedState();
 	void luaThread(lua_State *lua_state, const std::string &filename);
 	static void luaStop(lua_State *L, lua_Debug *ar);
 	void report_errors(lua_State *L, int status);
@@ -22,5 +30,10 @@ private:
 	static int l_domoticz_updateDevice(lua_State* lua_state);
 
 	int m_HwdID;
+
+	lua_State *m_cached_state;
+	int m_cachedScriptRef;
+	std::string m_cachedScriptFilename;
+	time_t m_cachedScriptModified;
 };
 
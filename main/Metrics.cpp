@@ -0,0 +1,369 @@
+#include "stdafx.h"
+#include "Metrics.h"
+#include "Helper.h"
+#include "../json/json.h"
+
+//values below this are stored exact, above it every power of two is split in HIST_SUB_BUCKETS
+#define HIST_LINEAR_LIMIT 16
+#define HIST_SUB_BUCKETS 8
+#define HIST_SUB_BITS 3
+#define HIST_FIRST_MSB 4
+//largest power of two with its own buckets (2^40us, about 12 days), larger values end in the last bucket
+#define HIST_LAST_MSB 40
+#define HIST_BUCKETS (HIST_LINEAR_LIMIT + ((HIST_LAST_MSB - HIST_FIRST_MSB + 1) * HIST_SUB_BUCKETS))
+
+//protects against labels with unbounded values (dynamic sql for example), they are counted as 'other'
+#define METRICS_MAX_SERIES_PER_FAMILY 256
+
+CMetricCounter::CMetricCounter() :
+	m_value(0)
+{
+}
+
+void CMetricCounter::Increment(const uint64_t value)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_value += value;
+}
+
+uint64_t CMetricCounter::Get()
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	return m_value;
+}
+
+CMetricGauge::CMetricGauge() :
+	m_value(0)
+{
+}
+
+void CMetricGauge::Set(const int64_t value)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_value = value;
+}
+
+void CMetricGauge::SetCallback(const boost::function<int64_t()> &callback)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_callback = callback;
+}
+
+int64_t CMetricGauge::Get()
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	if (m_callback)
+		m_value = m_callback();
+	return m_value;
+}
+
+CMetricHistogram::CMetricHistogram() :
+	m_count(0),
+	m_sum(0),
+	m_min(0),
+	m_max(0)
+{
+	m_buckets.resize(HIST_BUCKETS, 0);
+}
+
+size_t CMetricHistogram::BucketIndex(const uint64_t value)
+{
+	if (value < HIST_LINEAR_LIMIT)
+		return (size_t)value;
+	int msb = HIST_FIRST_MSB;
+	while ((msb < 63) && ((value >> (msb + 1)) != 0))
+		msb++;
+	if (msb > HIST_LAST_MSB)
+		return HIST_BUCKETS - 1;
+	size_t sub = (size_t)(value >> (msb - HIST_SUB_BITS)) - HIST_SUB_BUCKETS;
+	return HIST_LINEAR_LIMIT + ((msb - HIST_FIRST_MSB) * HIST_SUB_BUCKETS) + sub;
+}
+
+uint64_t CMetricHistogram::BucketValue(const size_t index)
+{
+	if (index < HIST_LINEAR_LIMIT)
+		return index;
+	int msb = HIST_FIRST_MSB + (int)((index - HIST_LINEAR_LIMIT) / HIST_SUB_BUCKETS);
+	uint64_t sub = (index - HIST_LINEAR_LIMIT) % HIST_SUB_BUCKETS;
+	uint64_t width = 1ULL << (msb - HIST_SUB_BITS);
+	//middle of the bucket
+	return ((HIST_SUB_BUCKETS + sub) * width) + (width / 2);
+}
+
+void CMetricHistogram::Record(const uint64_t value)
+{
+	size_t index = BucketIndex(value);
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	if ((m_count == 0) || (value < m_min))
+		m_min = value;
+	if (value > m_max)
+		m_max = value;
+	m_count++;
+	m_sum += value;
+	m_buckets[index]++;
+}
+
+uint64_t CMetricHistogram::Quantile(const double q) const
+{
+	if (m_count == 0)
+		return 0;
+	uint64_t rank = (uint64_t)(q * m_count);
+	if (rank < 1)
+		rank = 1;
+	uint64_t total = 0;
+	for (size_t ii = 0; ii < m_buckets.size(); ii++)
+	{
+		total += m_buckets[ii];
+		if (total >= rank)
+		{
+			uint64_t value = BucketValue(ii);
+			if (value < m_min)
+				value = m_min;
+			if (value > m_max)
+				value = m_max;
+			return value;
+		}
+	}
+	return m_max;
+}
+
+void CMetricHistogram::GetSnapshot(_tSnapshot &snapshot)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	snapshot.count = m_count;
+	snapshot.sum = m_sum;
+	snapshot.min = m_min;
+	snapshot.max = m_max;
+	snapshot.p50 = Quantile(0.5);
+	snapshot.p90 = Quantile(0.9);
+	snapshot.p99 = Quantile(0.99);
+}
+
+CMetricTimer::CMetricTimer(CMetricHistogram *pHistogram) :
+	m_pHistogram(pHistogram),
+	m_start(Now())
+{
+}
+
+CMetricTimer::~CMetricTimer()
+{
+	if (m_pHistogram == NULL)
+		return;
+	uint64_t now = Now();
+	m_pHistogram->Record((now > m_start) ? now - m_start : 0);
+}
+
+uint64_t CMetricTimer::Now()
+{
+	struct timeval tv;
+	getclock(&tv);
+	return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+CMetrics::CMetrics()
+{
+}
+
+CMetrics::~CMetrics()
+{
+	std::map<std::string, _tMetricFamily>::iterator itt;
+	for (itt = m_families.begin(); itt != m_families.end(); ++itt)
+	{
+		std::map<std::string, CMetricBase*>::iterator itt2;
+		for (itt2 = itt->second.series.begin(); itt2 != itt->second.series.end(); ++itt2)
+			delete itt2->second;
+	}
+	m_families.clear();
+}
+
+CMetricBase *CMetrics::GetSeries(const _eMetricType type, const std::string &name, const std::string &labelName, const std::string &labelValue)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	std::map<std::string, _tMetricFamily>::iterator itt = m_families.find(name);
+	if (itt == m_families.end())
+	{
+		_tMetricFamily family;
+		family.type = type;
+		family.labelName = labelName;
+		itt = m_families.insert(std::pair<std::string, _tMetricFamily>(name, family)).first;
+	}
+	_tMetricFamily &family = itt->second;
+	if (family.type != type)
+		return NULL;
+
+	std::map<std::string, CMetricBase*>::iterator itt2 = family.series.find(labelValue);
+	if (itt2 != family.series.end())
+		return itt2->second;
+	if (family.series.size() >= METRICS_MAX_SERIES_PER_FAMILY)
+	{
+		itt2 = family.series.find("other");
+		if (itt2 != family.series.end())
+			return itt2->second;
+	}
+
+	CMetricBase *pSeries = NULL;
+	switch (type)
+	{
+	case METRIC_COUNTER:
+		pSeries = new CMetricCounter();
+		break;
+	case METRIC_GAUGE:
+		pSeries = new CMetricGauge();
+		break;
+	case METRIC_HISTOGRAM:
+		pSeries = new CMetricHistogram();
+		break;
+	}
+	family.series[(family.series.size() >= METRICS_MAX_SERIES_PER_FAMILY) ? "other" : labelValue] = pSeries;
+	return pSeries;
+}
+
+CMetricCounter *CMetrics::GetCounter(const std::string &name, const std::string &labelName, const std::string &labelValue)
+{
+	return static_cast<CMetricCounter*>(GetSeries(METRIC_COUNTER, name, labelName, labelValue));
+}
+
+CMetricGauge *CMetrics::GetGauge(const std::string &name, const std::string &labelName, const std::string &labelValue)
+{
+	return static_cast<CMetricGauge*>(GetSeries(METRIC_GAUGE, name, labelName, labelValue));
+}
+
+CMetricHistogram *CMetrics::GetHistogram(const std::string &name, const std::string &labelName, const std::string &labelValue)
+{
+	return static_cast<CMetricHistogram*>(GetSeries(METRIC_HISTOGRAM, name, labelName, labelValue));
+}
+
+void CMetrics::GetJson(Json::Value &root)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	int ii = 0;
+	std::map<std::string, _tMetricFamily>::iterator itt;
+	for (itt = m_families.begin(); itt != m_families.end(); ++itt)
+	{
+		std::map<std::string, CMetricBase*>::iterator itt2;
+		for (itt2 = itt->second.series.begin(); itt2 != itt->second.series.end(); ++itt2)
+		{
+			Json::Value &item = root[ii++];
+			item["Name"] = itt->first;
+			if (!itt->second.labelName.empty())
+			{
+				item["Label"] = itt->second.labelName;
+				item["LabelValue"] = itt2->first;
+			}
+			switch (itt->second.type)
+			{
+			case METRIC_COUNTER:
+				item["Type"] = "counter";
+				item["Value"] = (Json::UInt64)static_cast<CMetricCounter*>(itt2->second)->Get();
+				break;
+			case METRIC_GAUGE:
+				item["Type"] = "gauge";
+				item["Value"] = (Json::Int64)static_cast<CMetricGauge*>(itt2->second)->Get();
+				break;
+			case METRIC_HISTOGRAM:
+				{
+					CMetricHistogram::_tSnapshot snapshot;
+					static_cast<CMetricHistogram*>(itt2->second)->GetSnapshot(snapshot);
+					item["Type"] = "histogram";
+					item["Count"] = (Json::UInt64)snapshot.count;
+					item["SumUs"] = (Json::UInt64)snapshot.sum;
+					item["MinUs"] = (Json::UInt64)snapshot.min;
+					item["MaxUs"] = (Json::UInt64)snapshot.max;
+					item["MeanUs"] = (Json::UInt64)((snapshot.count > 0) ? snapshot.sum / snapshot.count : 0);
+					item["P50Us"] = (Json::UInt64)snapshot.p50;
+					item["P90Us"] = (Json::UInt64)snapshot.p90;
+					item["P99Us"] = (Json::UInt64)snapshot.p99;
+				}
+				break;
+			}
+		}
+	}
+}
+
+static std::string PrometheusLabel(const std::string &labelName, const std::string &labelValue, const char *szQuantile)
+{
+	if (labelName.empty() && (szQuantile == NULL))
+		return "";
+	std::string ret = "{";
+	if (!labelName.empty())
+	{
+		ret += labelName + "=\"";
+		for (size_t ii = 0; ii < labelValue.size(); ii++)
+		{
+			char c = labelValue[ii];
+			if (c == '\\')
+				ret += "\\\\";
+			else if (c == '"')
+				ret += "\\\"";
+			else if (c == '\n')
+				ret += "\\n";
+			else
+				ret += c;
+		}
+		ret += "\"";
+		if (szQuantile != NULL)
+			ret += ",";
+	}
+	if (szQuantile != NULL)
+		ret += std::string("quantile=\"") + szQuantile + "\"";
+	ret += "}";
+	return ret;
+}
+
+static std::string PrometheusSeconds(const uint64_t us)
+{
+	char szTmp[40];
+	sprintf(szTmp, "%llu.%06llu", (unsigned long long)(us / 1000000), (unsigned long long)(us % 1000000));
+	return szTmp;
+}
+
+std::string CMetrics::GetPrometheusText()
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	std::stringstream sstr;
+	std::map<std::string, _tMetricFamily>::iterator itt;
+	for (itt = m_families.begin(); itt != m_families.end(); ++itt)
+	{
+		const _tMetricFamily &family = itt->second;
+		std::string name = "domoticz_" + itt->first;
+		switch (family.type)
+		{
+		case METRIC_COUNTER:
+			name += "_total";
+			sstr << "# TYPE " << name << " counter\n";
+			break;
+		case METRIC_GAUGE:
+			sstr << "# TYPE " << name << " gauge\n";
+			break;
+		case METRIC_HISTOGRAM:
+			name += "_seconds";
+			sstr << "# TYPE " << name << " summary\n";
+			break;
+		}
+		std::map<std::string, CMetricBase*>::const_iterator itt2;
+		for (itt2 = family.series.begin(); itt2 != family.series.end(); ++itt2)
+		{
+			switch (family.type)
+			{
+			case METRIC_COUNTER:
+				sstr << name << PrometheusLabel(family.labelName, itt2->first, NULL) << " " << static_cast<CMetricCounter*>(itt2->second)->Get() << "\n";
+				break;
+			case METRIC_GAUGE:
+				sstr << name << PrometheusLabel(family.labelName, itt2->first, NULL) << " " << static_cast<CMetricGauge*>(itt2->second)->Get() << "\n";
+				break;
+			case METRIC_HISTOGRAM:
+				{
+					CMetricHistogram::_tSnapshot snapshot;
+					static_cast<CMetricHistogram*>(itt2->second)->GetSnapshot(snapshot);
+					sstr << name << PrometheusLabel(family.labelName, itt2->first, "0.5") << " " << PrometheusSeconds(snapshot.p50) << "\n";
+					sstr << name << PrometheusLabel(family.labelName, itt2->first, "0.9") << " " << PrometheusSeconds(snapshot.p90) << "\n";
+					sstr << name << PrometheusLabel(family.labelName, itt2->first, "0.99") << " " << PrometheusSeconds(snapshot.p99) << "\n";
+					sstr << name << "_sum" << PrometheusLabel(family.labelName, itt2->first, NULL) << " " << PrometheusSeconds(snapshot.sum) << "\n";
+					sstr << name << "_count" << PrometheusLabel(family.labelName, itt2->first, NULL) << " " << snapshot.count << "\n";
+				}
+				break;
+			}
+		}
+	}
+	return sstr.str();
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/function.hpp>
+
+namespace Json
+{
+	class Value;
+};
+
+enum _eMetricType
+{
+	METRIC_COUNTER = 0,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM
+};
+
+class CMetricBase
+{
+public:
+	virtual ~CMetricBase() {};
+};
+
+//Monotonic increasing value (events, errors)
+class CMetricCounter : public CMetricBase
+{
+public:
+	CMetricCounter();
+	void Increment(const uint64_t value = 1);
+	uint64_t Get();
+private:
+	boost::mutex m_mutex;
+	uint64_t m_value;
+};
+
+//Current value, either set by the owner or read from a callback when the metrics are requested
+class CMetricGauge : public CMetricBase
+{
+public:
+	CMetricGauge();
+	void Set(const int64_t value);
+	void SetCallback(const boost::function<int64_t()> &callback);
+	int64_t Get();
+private:
+	boost::mutex m_mutex;
+	int64_t m_value;
+	boost::function<int64_t()> m_callback;
+};
+
+//Latency distribution in microseconds, log-linear buckets (8 sub buckets per power of two, max 12.5% error)
+class CMetricHistogram : public CMetricBase
+{
+public:
+	struct _tSnapshot
+	{
+		uint64_t count;
+		uint64_t sum;
+		uint64_t min;
+		uint64_t max;
+		uint64_t p50;
+		uint64_t p90;
+		uint64_t p99;
+	};
+	CMetricHistogram();
+	void Record(const uint64_t value);
+	void GetSnapshot(_tSnapshot &snapshot);
+private:
+	static size_t BucketIndex(const uint64_t value);
+	static uint64_t BucketValue(const size_t index);
+	uint64_t Quantile(const double q) const;
+
+	boost::mutex m_mutex;
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+	std::vector<uint32_t> m_buckets;
+};
+
+//Records the time between construction and destruction into a histogram
+class CMetricTimer
+{
+public:
+	explicit CMetricTimer(CMetricHistogram *pHistogram);
+	~CMetricTimer();
+private:
+	static uint64_t Now();
+	CMetricHistogram *m_pHistogram;
+	uint64_t m_start;
+};
+
+class CMetrics
+{
+public:
+	CMetrics();
+	~CMetrics();
+
+	//Lookups return a pointer that stays valid for the lifetime of the application, so callers can keep it
+	CMetricCounter *GetCounter(const std::string &name, const std::string &labelName = "", const std::string &labelValue = "");
+	CMetricGauge *GetGauge(const std::string &name, const std::string &labelName = "", const std::string &labelValue = "");
+	CMetricHistogram *GetHistogram(const std::string &name, const std::string &labelName = "", const std::string &labelValue = "");
+
+	void GetJson(Json::Value &root);
+	std::string GetPrometheusText();
+private:
+	struct _tMetricFamily
+	{
+		_eMetricType type;
+		std::string labelName;
+		std::map<std::string, CMetricBase*> series;
+	};
+	CMetricBase *GetSeries(const _eMetricType type, const std::string &name, const std::string &labelName, const std::string &labelValue);
+
+	boost::mutex m_mutex;
+	std::map<std::string, _tMetricFamily> m_families;
+};
+
+extern CMetrics m_metrics;
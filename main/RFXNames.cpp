@@ -49,6 +49,122 @@ const char *findTableID1ID2 (const _STR_TABLE_ID1_ID2 *t, const unsigned long id
 	return "Unknown";
 }
 
+#define MAX_DENSE_TABLE_ID 4096
+
+#ifdef RFXNAMES_VERIFY_INDEX
+//Test build (test/test_rfxnames): every indexed lookup is compared with the linear table scan
+int RFXNames_IndexMismatches = 0;
+//0 compare, 1 index only, 2 scan only (the test times both paths)
+int RFXNames_LookupMode = 0;
+#endif
+
+//Dense index over a STR_TABLE_SINGLE, built once on first use so lookups are O(1)
+//Gives the same result as findTableIDSingle1/2 (the first matching entry wins)
+class CTableIndexSingle
+{
+public:
+	CTableIndexSingle(const STR_TABLE_SINGLE *t, const bool bSecond) :
+		m_pTable(t),
+		m_bSecond(bSecond),
+		m_bSparse(false)
+	{
+		while ((bSecond) ? t->str2 : t->str1)
+		{
+			if (t->id < MAX_DENSE_TABLE_ID)
+			{
+				if (t->id >= m_index.size())
+					m_index.resize(t->id + 1, NULL);
+				if (m_index[t->id] == NULL)
+					m_index[t->id] = (bSecond) ? t->str2 : t->str1;
+			}
+			else
+				m_bSparse = true;
+			t++;
+		}
+	}
+	const char *Find(const unsigned long id) const
+	{
+#ifdef RFXNAMES_VERIFY_INDEX
+		if (RFXNames_LookupMode == 2)
+			return (m_bSecond) ? findTableIDSingle2(m_pTable, id) : findTableIDSingle1(m_pTable, id);
+#endif
+		const char *szResult = FindIndexed(id);
+#ifdef RFXNAMES_VERIFY_INDEX
+		if ((RFXNames_LookupMode == 0) && (strcmp(szResult, (m_bSecond) ? findTableIDSingle2(m_pTable, id) : findTableIDSingle1(m_pTable, id)) != 0))
+			RFXNames_IndexMismatches++;
+#endif
+		return szResult;
+	}
+private:
+	const char *FindIndexed(const unsigned long id) const
+	{
+		if (id < m_index.size())
+			return (m_index[id]) ? m_index[id] : "Unknown";
+		if (m_bSparse)
+			return (m_bSecond) ? findTableIDSingle2(m_pTable, id) : findTableIDSingle1(m_pTable, id);
+		return "Unknown";
+	}
+	const STR_TABLE_SINGLE *m_pTable;
+	bool m_bSecond;
+	bool m_bSparse;
+	std::vector<const char*> m_index;
+};
+
+//Dense index over a STR_TABLE_ID1_ID2, one array of id2 entries per id1
+class CTableIndexID1ID2
+{
+public:
+	explicit CTableIndexID1ID2(const STR_TABLE_ID1_ID2 *t) :
+		m_pTable(t),
+		m_bSparse(false)
+	{
+		while (t->str1)
+		{
+			if ((t->id1 < MAX_DENSE_TABLE_ID) && (t->id2 < MAX_DENSE_TABLE_ID))
+			{
+				if (t->id1 >= m_index.size())
+					m_index.resize(t->id1 + 1);
+				std::vector<const char*> &sub = m_index[t->id1];
+				if (t->id2 >= sub.size())
+					sub.resize(t->id2 + 1, NULL);
+				if (sub[t->id2] == NULL)
+					sub[t->id2] = t->str1;
+			}
+			else
+				m_bSparse = true;
+			t++;
+		}
+	}
+	const char *Find(const unsigned long id1, const unsigned long id2) const
+	{
+#ifdef RFXNAMES_VERIFY_INDEX
+		if (RFXNames_LookupMode == 2)
+			return findTableID1ID2(m_pTable, id1, id2);
+#endif
+		const char *szResult = FindIndexed(id1, id2);
+#ifdef RFXNAMES_VERIFY_INDEX
+		if ((RFXNames_LookupMode == 0) && (strcmp(szResult, findTableID1ID2(m_pTable, id1, id2)) != 0))
+			RFXNames_IndexMismatches++;
+#endif
+		return szResult;
+	}
+private:
+	const char *FindIndexed(const unsigned long id1, const unsigned long id2) const
+	{
+		if ((id1 < m_index.size()) && (id2 < m_index[id1].size()))
+		{
+			if (m_index[id1][id2])
+				return m_index[id1][id2];
+		}
+		if (m_bSparse)
+			return findTableID1ID2(m_pTable, id1, id2);
+		return "Unknown";
+	}
+	const STR_TABLE_ID1_ID2 *m_pTable;
+	bool m_bSparse;
+	std::vector<std::vector<const char*> > m_index;
+};
+
 const char *RFX_Humidity_Status_Desc(const unsigned char status)
 {
 	static const STR_TABLE_SINGLE	Table[] =
@@ -59,7 +175,8 @@ const char *RFX_Humidity_Status_Desc(const unsigned char status)
 		{ humstat_wet, "Wet" },
 		{  0,NULL,NULL }
 	};
-	return findTableIDSingle1 (Table, status);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(status);
 }
 
 unsigned char Get_Humidity_Level(const unsigned char hlevel)
@@ -106,7 +223,8 @@ const char *Security_Status_Desc(const unsigned char status)
 		{ sStatusNoMotionTamper, "No Motion + Tamper" },
 		{ 0, NULL }
 	};
-	return findTableIDSingle1 (Table, status);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(status);
 }
 
 const char *Timer_Type_Desc(const int tType)
@@ -129,7 +247,8 @@ const char *Timer_Type_Desc(const int tType)
 		{ TTYPE_YEARLY_WD, "Yearly (Weekday)" },
 		{  0,NULL,NULL }
 	};
-	return findTableIDSingle1 (Table, tType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(tType);
 }
 
 const char *Timer_Cmd_Desc(const int tType)
@@ -140,7 +259,8 @@ const char *Timer_Cmd_Desc(const int tType)
 		{ TCMD_OFF, "Off" },
 		{  0,NULL,NULL }
 	};
-	return findTableIDSingle1 (Table, tType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(tType);
 }
 
 const char *Hardware_Type_Desc(int hType)
@@ -258,7 +378,8 @@ const char *Hardware_Type_Desc(int hType)
 		{ HTYPE_EnphaseAPI, "Enphase Envoy with LAN (HTTP) interface" },
 		{ 0, NULL, NULL }
 	};
-	return findTableIDSingle1 (Table, hType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(hType);
 }
 
 const char *Switch_Type_Desc(const _eSwitchType sType)
@@ -287,7 +408,8 @@ const char *Switch_Type_Desc(const _eSwitchType sType)
 		{ STYPE_DoorLock, "Door Lock" },
 		{ 0, NULL, NULL }
 	};
-	return findTableIDSingle1 (Table, sType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(sType);
 }
 
 const char *Meter_Type_Desc(const _eMeterType sType)
@@ -301,7 +423,8 @@ const char *Meter_Type_Desc(const _eMeterType sType)
 		{ MTYPE_ENERGY_GENERATED, "Energy Generated" },
 		{  0,NULL,NULL }
 	};
-	return findTableIDSingle1 (Table, sType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(sType);
 }
 
 const char *Notification_Type_Desc(const int nType, const unsigned char snum)
@@ -338,10 +461,12 @@ const char *Notification_Type_Desc(const int nType, const unsigned char snum)
 		{ NTYPE_LASTUPDATE, "Last Update", "J"},
 		{  0,NULL,NULL }
 	};
+	static const CTableIndexSingle Index1(Table, false);
+	static const CTableIndexSingle Index2(Table, true);
 	if (snum==0)
-		return findTableIDSingle1 (Table, nType);
+		return Index1.Find(nType);
 	else
-		return findTableIDSingle2 (Table, nType);
+		return Index2.Find(nType);
 }
 
 const char *Notification_Type_Label(const int nType)
@@ -378,7 +503,8 @@ const char *Notification_Type_Label(const int nType)
 		{ NTYPE_LASTUPDATE, "minutes" },
 		{  0,NULL,NULL }
 	};
-	return findTableIDSingle1 (Table, nType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(nType);
 }
 
 const char *RFX_Forecast_Desc(const unsigned char Forecast)
@@ -392,7 +518,8 @@ const char *RFX_Forecast_Desc(const unsigned char Forecast)
 		{ baroForecastRain, "Rain" },
 		{  0,NULL,NULL }
 	};
-	return findTableIDSingle1 (Table, Forecast);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(Forecast);
 }
 
 const char *RFX_WSForecast_Desc(const unsigned char Forecast)
@@ -411,7 +538,8 @@ const char *RFX_WSForecast_Desc(const unsigned char Forecast)
 		{ wsbaroforcast_stable, "Stable" },
 		{ 0, NULL, NULL }
 	};
-	return findTableIDSingle1 (Table, Forecast);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(Forecast);
 }
 
 const char *BMP_Forecast_Desc(const unsigned char Forecast)
@@ -427,7 +555,8 @@ const char *BMP_Forecast_Desc(const unsigned char Forecast)
 		{ bmpbaroforecast_rain, "Cloudy/Rain" },
 		{ 0, NULL, NULL }
 	};
-	return findTableIDSingle1(Table, Forecast);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(Forecast);
 }
 
 const char *RFX_Type_Desc(const unsigned char i, const unsigned char snum)
@@ -499,10 +628,12 @@ const char *RFX_Type_Desc(const unsigned char i, const unsigned char snum)
 		{ pTypeGeneralSwitch, "Light/Switch", "lightbulb" },
 		{ 0, NULL, NULL }
 	};
+	static const CTableIndexSingle Index1(Table, false);
+	static const CTableIndexSingle Index2(Table, true);
 	if (snum==1)
-		return findTableIDSingle1 (Table, i);
+		return Index1.Find(i);
 
-	return findTableIDSingle2 (Table, i);
+	return Index2.Find(i);
 }
 
 const char *RFX_Type_SubType_Desc(const unsigned char dType, const unsigned char sType)
@@ -881,7 +1012,8 @@ const char *RFX_Type_SubType_Desc(const unsigned char dType, const unsigned char
 		{ pTypeGeneralSwitch, sSwitchTypeV2Phoenix, "V2Phoenix" },
 		{  0,0,NULL }
 	};
-	return findTableID1ID2(Table, dType, sType);
+	static const CTableIndexID1ID2 Index(Table);
+	return Index.Find(dType, sType);
 }
 
 const char *Media_Player_States(const _eMediaStatus Status)
@@ -901,7 +1033,8 @@ const char *Media_Player_States(const _eMediaStatus Status)
 		{ MSTAT_UNKNOWN, "Unknown" },
 		{ 0, NULL, NULL }
 	};
-	return findTableIDSingle1(Table, Status);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(Status);
 }
 
 const char *ZWave_Clock_Days(const unsigned char Day)
@@ -917,8 +1050,36 @@ const char *ZWave_Clock_Days(const unsigned char Day)
 		{ 6, "Sunday" },
 		{ 0, NULL, NULL }
 	};
-	return findTableIDSingle1(Table, Day);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(Day);
 }
+
+//Builds all lookup indexes during static initialization, while the process is still single threaded.
+//Function-local statics are not constructed thread safe by MSVC before VS2015
+class CRFXNamesIndexInit
+{
+public:
+	CRFXNamesIndexInit()
+	{
+		RFX_Humidity_Status_Desc(0);
+		Security_Status_Desc(0);
+		Timer_Type_Desc(0);
+		Timer_Cmd_Desc(0);
+		Hardware_Type_Desc(0);
+		Switch_Type_Desc(STYPE_OnOff);
+		Meter_Type_Desc(MTYPE_ENERGY);
+		Notification_Type_Desc(0, 0);
+		Notification_Type_Label(0);
+		RFX_Forecast_Desc(0);
+		RFX_WSForecast_Desc(0);
+		BMP_Forecast_Desc(0);
+		RFX_Type_Desc(0, 0);
+		RFX_Type_SubType_Desc(0, 0);
+		Media_Player_States(MSTAT_OFF);
+		ZWave_Clock_Days(0);
+	}
+};
+static CRFXNamesIndexInit RFXNamesIndexInit;
 /*
 const char *ZWave_Thermostat_Modes[] =
 {
@@ -6,6 +6,8 @@
 #include "RFXNames.h"
 #include "localtime_r.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "DeviceSnapshot.h"
 #include "mainworker.h"
 #ifdef WITH_EXTERNAL_SQLITE
 #include <sqlite3.h>
@@ -641,6 +643,8 @@ CSQLHelper::CSQLHelper(void)
 {
 	m_LastSwitchRowID=0;
 	m_dbase=NULL;
+	m_bBatchTransactionActive = false;
+	m_bBatchTransactionOpen = false;
 	m_stoprequested=false;
 	m_sensortimeoutcounter=0;
 	m_bAcceptNewHardware=true;
@@ -656,6 +660,8 @@ CSQLHelper::CSQLHelper(void)
 	m_bDisableDzVentsSystem = false;
 	m_ShortLogInterval = 5;
 	m_bPreviousAcceptNewHardware = false;
+	m_lastUpdateFilterFlush = 0;
+	m_deferredUpdates = 0;
 
 	SetDatabaseName("domoticz.db");
 }
@@ -2818,6 +2824,13 @@ void CSQLHelper::Do_Work()
 	{
 		sleep_milliseconds(static_cast<const long>(1000.0f / timer_resolution_hz));
 
+		if (mytime(NULL) - m_lastUpdateFilterFlush >= 60)
+		{
+			m_lastUpdateFilterFlush = mytime(NULL);
+			FlushFilteredUpdates();
+		}
+		ApplyDeferredUpdates();
+
 		if (m_bAcceptHardwareTimerActive)
 		{
 			m_iAcceptHardwareTimerCounter -= static_cast<float>(1. / timer_resolution_hz);
@@ -3139,11 +3152,27 @@ std::vector<std::vector<std::string> > CSQLHelper::safe_query(const char *fmt, .
 		std::vector<std::vector<std::string> > results;
 		return results;
 	}
+	CMetricTimer timer(GetQueryHistogram(fmt));
 	std::vector<std::vector<std::string> > results = query(zQuery);
 	sqlite3_free(zQuery);
 	return results;
 }
 
+//The format string is the statement template, so all calls of the same statement end in one histogram
+CMetricHistogram *CSQLHelper::GetQueryHistogram(const char *fmt)
+{
+	boost::lock_guard<boost::mutex> l(m_queryHistogramsMutex);
+	std::map<const char*, std::pair<std::string, CMetricHistogram*> >::const_iterator itt = m_queryHistograms.find(fmt);
+	if ((itt != m_queryHistograms.end()) && (itt->second.first == fmt))
+		return itt->second.second;
+	//formats built at runtime use a new pointer every time
+	if (m_queryHistograms.size() > 1000)
+		m_queryHistograms.clear();
+	CMetricHistogram *pHistogram = m_metrics.GetHistogram("sql_query", "statement", fmt);
+	m_queryHistograms[fmt] = std::make_pair(std::string(fmt), pHistogram);
+	return pHistogram;
+}
+
 std::vector<std::vector<std::string> > CSQLHelper::query(const std::string &szQuery)
 {
 	if (!m_dbase)
@@ -3152,7 +3181,8 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string &szQu
 		std::vector<std::vector<std::string> > results;
 		return results;
 	}
-	boost::lock_guard<boost::mutex> l(m_sqlQueryMutex);
+	boost::unique_lock<boost::recursive_mutex> l(m_sqlQueryMutex);
+	CheckBatchTransaction();
 
 	sqlite3_stmt *statement;
 	std::vector<std::vector<std::string> > results;
@@ -3194,8 +3224,11 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string &szQu
 	}
 
 	std::string error = sqlite3_errmsg(m_dbase);
-	if(error != "not an error")
+	if (error != "not an error")
+	{
 		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
+		m_metrics.GetCounter("sql_errors")->Increment();
+	}
 	return results;
 }
 
@@ -3212,6 +3245,7 @@ std::vector<std::vector<std::string> > CSQLHelper::safe_queryBlob(const char *fm
 		std::vector<std::vector<std::string> > results;
 		return results;
 	}
+	CMetricTimer timer(GetQueryHistogram(fmt));
 	results = queryBlob(zQuery);
 	sqlite3_free(zQuery);
 	return results;
@@ -3225,7 +3259,8 @@ std::vector<std::vector<std::string> > CSQLHelper::queryBlob(const std::string &
 		std::vector<std::vector<std::string> > results;
 		return results;
 	}
-	boost::lock_guard<boost::mutex> l(m_sqlQueryMutex);
+	boost::lock_guard<boost::recursive_mutex> l(m_sqlQueryMutex);
+	CheckBatchTransaction();
 
 	sqlite3_stmt *statement;
 	std::vector<std::vector<std::string> > results;
@@ -3267,6 +3302,71 @@ std::vector<std::vector<std::string> > CSQLHelper::queryBlob(const std::string &
 	return results;
 }
 
+bool CSQLHelper::safe_queryRows(const boost::function<void(const std::vector<std::string> &)> &onRow, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	char *zQuery = sqlite3_vmprintf(fmt, args);
+	va_end(args);
+	if (!zQuery)
+	{
+		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
+		return false;
+	}
+	CMetricTimer timer(GetQueryHistogram(fmt));
+	bool bResult = queryRows(zQuery, onRow);
+	sqlite3_free(zQuery);
+	return bResult;
+}
+
+//Same rows as query(), for read only statements (no trace of the result, no notification cache invalidation)
+bool CSQLHelper::queryRows(const std::string &szQuery, const boost::function<void(const std::vector<std::string> &)> &onRow)
+{
+	if (!m_dbase)
+	{
+		_log.Log(LOG_ERROR, "Database not open!!...Check your user rights!..");
+		return false;
+	}
+	boost::lock_guard<boost::recursive_mutex> l(m_sqlQueryMutex);
+	CheckBatchTransaction();
+
+	sqlite3_stmt *statement;
+	if (sqlite3_prepare_v2(m_dbase, szQuery.c_str(), -1, &statement, 0) == SQLITE_OK)
+	{
+		int cols = sqlite3_column_count(statement);
+		std::vector<std::string> values;
+		while (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			values.clear();
+			for (int col = 0; col < cols; col++)
+			{
+				char* value = (char*)sqlite3_column_text(statement, col);
+				if ((value == 0) && (col == 0))
+					break;
+				else if (value == 0)
+					values.push_back(std::string("")); //insert empty string
+				else
+					values.push_back(value);
+			}
+			if (values.size() > 0)
+				onRow(values);
+		}
+		sqlite3_finalize(statement);
+	}
+
+	if (_log.isTraceEnabled())
+		_log.Log(LOG_TRACE, "SQLQ query : %s", szQuery.c_str());
+
+	std::string error = sqlite3_errmsg(m_dbase);
+	if (error != "not an error")
+	{
+		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
+		m_metrics.GetCounter("sql_errors")->Increment();
+		return false;
+	}
+	return true;
+}
+
 uint64_t CSQLHelper::UpdateValue(const int HardwareID, const char* ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, const unsigned char signallevel, const unsigned char batterylevel, const int nValue, std::string &devname, const bool bUseOnOffAction)
 {
 	return UpdateValue(HardwareID, ID, unit, devType, subType, signallevel, batterylevel, nValue, "", devname, bUseOnOffAction);
@@ -3279,6 +3379,7 @@ uint64_t CSQLHelper::UpdateValue(const int HardwareID, const char* ID, const uns
 
 uint64_t CSQLHelper::UpdateValue(const int HardwareID, const char* ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, const unsigned char signallevel, const unsigned char batterylevel, const int nValue, const char* sValue, std::string &devname, const bool bUseOnOffAction)
 {
+	CMetricTimer timer(m_metrics.GetHistogram("device_update", "type", RFX_Type_Desc(devType, 1)));
 	uint64_t devRowID=UpdateValueInt(HardwareID, ID, unit, devType, subType, signallevel, batterylevel, nValue, sValue,devname,bUseOnOffAction);
 	if (devRowID == -1)
 		return -1;
@@ -3550,6 +3651,8 @@ uint64_t CSQLHelper::UpdateValueInt(const int HardwareID, const char* ID, const
 		_eSwitchType stype = (_eSwitchType)atoi(result[0][3].c_str());
 		int old_nValue = atoi(result[0][4].c_str());
 		std::string old_sValue = result[0][5];
+		if (FilterDeviceUpdate(ulID, HardwareID, ID, unit, devType, subType, signallevel, batterylevel, sOption, nValue, sValue, old_nValue, old_sValue))
+			return -1; //nothing changed enough, skip all further processing
 		time_t now = time(0);
 		struct tm ltime;
 		localtime_r(&now,&ltime);
@@ -4493,6 +4596,7 @@ void CSQLHelper::UpdateRainLog()
 				total,
 				rate
 				);
+			m_notifications.UpdateRainTotal(ID, total);
 		}
 	}
 }
@@ -5943,6 +6047,241 @@ void CSQLHelper::OptimizeDatabase(sqlite3 *dbase)
 	sqlite3_exec(dbase, "PRAGMA optimize;", NULL, NULL, NULL);
 }
 
+void CSQLHelper::SetUpdateFilterThread(const boost::thread::id &threadId)
+{
+	m_updateFilterThread = threadId;
+}
+
+//Compare the ';' separated values, numbers within the deadband are considered equal
+static bool IsWithinDeadBand(const char* sValue, const std::string &old_sValue, const double deadband)
+{
+	std::vector<std::string> newValues;
+	std::vector<std::string> oldValues;
+	StringSplit(sValue, ";", newValues);
+	StringSplit(old_sValue, ";", oldValues);
+	if (newValues.size() != oldValues.size())
+		return false;
+	for (size_t ii = 0; ii < newValues.size(); ii++)
+	{
+		if (newValues[ii] == oldValues[ii])
+			continue;
+		char *pEndNew = NULL;
+		char *pEndOld = NULL;
+		double newValue = strtod(newValues[ii].c_str(), &pEndNew);
+		double oldValue = strtod(oldValues[ii].c_str(), &pEndOld);
+		if ((newValues[ii].empty()) || (*pEndNew != 0) || (oldValues[ii].empty()) || (*pEndOld != 0))
+			return false; //text changed
+		if (fabs(newValue - oldValue) > deadband)
+			return false;
+	}
+	return true;
+}
+
+//Returns true when the update should be dropped because of the DeadBand and/or MinInterval (seconds) options of the device
+bool CSQLHelper::FilterDeviceUpdate(const uint64_t ulID, const int HardwareID, const char* ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, const unsigned char signallevel, const unsigned char batterylevel, const std::string &sOptions, const int nValue, const char* sValue, const int old_nValue, const std::string &old_sValue)
+{
+	if ((sOptions.find("DeadBand:") == std::string::npos) && (sOptions.find("MinInterval:") == std::string::npos))
+		return false;
+	if (boost::this_thread::get_id() != m_updateFilterThread)
+	{
+		boost::lock_guard<boost::mutex> l(m_updateFilterMutex);
+		if (boost::this_thread::get_id() != m_deferredUpdateThread)
+			return false;
+	}
+	if (IsLightOrSwitch(devType, subType))
+		return false;
+	if ((devType == pTypeGeneral) && ((subType == sTypeCounterIncremental) || (subType == sTypeTextStatus) || (subType == sTypeAlert)))
+		return false;
+
+	double deadband = -1;
+	int minInterval = 0;
+	std::map<std::string, std::string> options = BuildDeviceOptions(sOptions);
+	std::map<std::string, std::string>::const_iterator itt = options.find("DeadBand");
+	if ((itt != options.end()) && (!itt->second.empty()))
+		deadband = atof(itt->second.c_str());
+	itt = options.find("MinInterval");
+	if (itt != options.end())
+		minInterval = atoi(itt->second.c_str());
+
+	time_t now = mytime(NULL);
+	bool bSuppress = false;
+	boost::lock_guard<boost::mutex> l(m_updateFilterMutex);
+	std::map<uint64_t, _tUpdateFilterState>::iterator ittState = m_updateFilter.find(ulID);
+	if (ittState == m_updateFilter.end())
+	{
+		_tUpdateFilterState state;
+		state.lastAccepted = 0;
+		state.lastSeen = 0;
+		state.bPendingLastUpdate = false;
+		state.bPendingValue = false;
+		state.suppressed = 0;
+		ittState = m_updateFilter.insert(std::pair<uint64_t, _tUpdateFilterState>(ulID, state)).first;
+	}
+	_tUpdateFilterState &state = ittState->second;
+	if ((minInterval > 0) && (state.lastAccepted != 0) && (now - state.lastAccepted < minInterval))
+	{
+		//keep the newest value, it is applied when the interval ends
+		bSuppress = true;
+		if (!state.bPendingValue)
+			m_deferredUpdates++;
+		state.bPendingValue = true;
+		state.applyTime = state.lastAccepted + minInterval;
+		state.HardwareID = HardwareID;
+		state.ID = ID;
+		state.unit = unit;
+		state.devType = devType;
+		state.subType = subType;
+		state.signallevel = signallevel;
+		state.batterylevel = batterylevel;
+		state.nValue = nValue;
+		state.sValue = sValue;
+	}
+	else if ((deadband >= 0) && (nValue == old_nValue) && (IsWithinDeadBand(sValue, old_sValue, deadband)))
+		bSuppress = true;
+
+	if (!bSuppress)
+	{
+		state.lastAccepted = now;
+		state.bPendingLastUpdate = false;
+		if (state.bPendingValue)
+			m_deferredUpdates--;
+		state.bPendingValue = false;
+		return false;
+	}
+	//only remember we heard from the device, LastUpdate is written in the background
+	state.lastSeen = now;
+	state.bPendingLastUpdate = true;
+	state.suppressed++;
+
+	std::stringstream sstr;
+	sstr << ulID;
+	m_metrics.GetCounter("device_updates_suppressed", "idx", sstr.str())->Increment();
+	return true;
+}
+
+void CSQLHelper::FlushFilteredUpdates()
+{
+	std::vector<std::pair<uint64_t, time_t> > pending;
+	{
+		boost::lock_guard<boost::mutex> l(m_updateFilterMutex);
+		std::map<uint64_t, _tUpdateFilterState>::iterator itt;
+		for (itt = m_updateFilter.begin(); itt != m_updateFilter.end(); ++itt)
+		{
+			if (!itt->second.bPendingLastUpdate)
+				continue;
+			pending.push_back(std::pair<uint64_t, time_t>(itt->first, itt->second.lastSeen));
+			itt->second.bPendingLastUpdate = false;
+		}
+	}
+	if (pending.empty())
+		return;
+
+	CSQLScopedTransaction transaction(*this);
+	std::vector<std::pair<uint64_t, time_t> >::const_iterator itt;
+	for (itt = pending.begin(); itt != pending.end(); ++itt)
+	{
+		struct tm ltime;
+		localtime_r(&itt->second, &ltime);
+		char szLastUpdate[40];
+		sprintf(szLastUpdate, "%04d-%02d-%02d %02d:%02d:%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday, ltime.tm_hour, ltime.tm_min, ltime.tm_sec);
+		//an accepted update in the meantime already wrote a newer time
+		safe_query("UPDATE DeviceStatus SET LastUpdate='%q' WHERE (ID = %" PRIu64 ") AND (LastUpdate < '%q')", szLastUpdate, itt->first, szLastUpdate);
+	}
+}
+
+//Apply the newest value a MinInterval device reported during its interval, once the interval has ended
+void CSQLHelper::ApplyDeferredUpdates()
+{
+	std::vector<_tUpdateFilterState> due;
+	{
+		boost::lock_guard<boost::mutex> l(m_updateFilterMutex);
+		if (m_deferredUpdates == 0)
+			return;
+		m_deferredUpdateThread = boost::this_thread::get_id();
+		time_t now = mytime(NULL);
+		std::map<uint64_t, _tUpdateFilterState>::iterator itt;
+		for (itt = m_updateFilter.begin(); itt != m_updateFilter.end(); ++itt)
+		{
+			if ((!itt->second.bPendingValue) || (itt->second.applyTime > now))
+				continue;
+			due.push_back(itt->second);
+			itt->second.bPendingValue = false;
+			m_deferredUpdates--;
+		}
+	}
+	//the update goes through the decoder again, and is filtered (accepted) like a new report
+	std::vector<_tUpdateFilterState>::const_iterator itt;
+	for (itt = due.begin(); itt != due.end(); ++itt)
+		m_mainworker.UpdateDevice(itt->HardwareID, itt->ID, itt->unit, itt->devType, itt->subType, itt->nValue, itt->sValue, itt->signallevel, itt->batterylevel);
+	boost::lock_guard<boost::mutex> l(m_updateFilterMutex);
+	m_deferredUpdateThread = boost::thread::id();
+}
+
+CSQLScopedTransaction::CSQLScopedTransaction(CSQLHelper &sql) :
+	m_sqlHelper(sql),
+	m_lock(sql.m_sqlQueryMutex),
+	m_bStarted(false)
+{
+	if (!m_sqlHelper.m_dbase)
+		return;
+	m_sqlHelper.CheckBatchTransaction();
+	//nested in a transaction of this thread
+	if (!sqlite3_get_autocommit(m_sqlHelper.m_dbase))
+		return;
+	m_bStarted = (sqlite3_exec(m_sqlHelper.m_dbase, "BEGIN TRANSACTION;", NULL, NULL, NULL) == SQLITE_OK);
+}
+
+CSQLScopedTransaction::~CSQLScopedTransaction()
+{
+	if (m_bStarted)
+		sqlite3_exec(m_sqlHelper.m_dbase, "END TRANSACTION;", NULL, NULL, NULL);
+}
+
+void CSQLHelper::BeginBatchTransaction()
+{
+	boost::lock_guard<boost::recursive_mutex> l(m_sqlQueryMutex);
+	if (m_bBatchTransactionActive)
+		return;
+	m_bBatchTransactionActive = true;
+	m_bBatchTransactionOpen = false;
+	m_batchTransactionThread = boost::this_thread::get_id();
+}
+
+void CSQLHelper::EndBatchTransaction()
+{
+	boost::lock_guard<boost::recursive_mutex> l(m_sqlQueryMutex);
+	if ((!m_bBatchTransactionActive) || (m_batchTransactionThread != boost::this_thread::get_id()))
+		return;
+	if ((m_bBatchTransactionOpen) && (m_dbase))
+		sqlite3_exec(m_dbase, "END TRANSACTION;", NULL, NULL, NULL);
+	m_bBatchTransactionOpen = false;
+	m_bBatchTransactionActive = false;
+}
+
+//Called with the query lock held. The batch transaction only ever holds queries of its own thread,
+//a query of another thread commits it first and the next query of the batch starts a new one.
+//The lock is not kept for the whole batch, the batch thread runs code (notifications, hardware) that takes other locks.
+void CSQLHelper::CheckBatchTransaction()
+{
+	if (!m_bBatchTransactionActive)
+		return;
+	if (m_batchTransactionThread == boost::this_thread::get_id())
+	{
+		if ((!m_bBatchTransactionOpen) && (sqlite3_get_autocommit(m_dbase)))
+		{
+			m_bBatchTransactionOpen = (sqlite3_exec(m_dbase, "BEGIN TRANSACTION;", NULL, NULL, NULL) == SQLITE_OK);
+			if (m_bBatchTransactionOpen)
+				m_metrics.GetCounter("sql_batch_transactions")->Increment();
+		}
+	}
+	else if (m_bBatchTransactionOpen)
+	{
+		sqlite3_exec(m_dbase, "END TRANSACTION;", NULL, NULL, NULL);
+		m_bBatchTransactionOpen = false;
+		m_metrics.GetCounter("sql_batch_splits")->Increment();
+	}
+}
+
 void CSQLHelper::DeleteHardware(const std::string &idx)
 {
 	safe_query("DELETE FROM Hardware WHERE (ID == '%q')",idx.c_str());
@@ -5995,12 +6334,9 @@ void CSQLHelper::DeleteDevices(const std::string &idx)
 	if (!_idx.empty())
 	{
 		//Avoid mutex deadlock here
-		boost::lock_guard<boost::mutex> l(m_sqlQueryMutex);
+		CSQLScopedTransaction transaction(*this);
 		std::vector<std::string>::const_iterator itt;
 
-		char* errorMessage;
-		sqlite3_exec(m_dbase, "BEGIN TRANSACTION", NULL, NULL, &errorMessage);
-
 		for (itt = _idx.begin(); itt != _idx.end(); ++itt)
 		{
 			safe_exec_no_return("DELETE FROM LightingLog WHERE (DeviceRowID == '%q')", (*itt).c_str());
@@ -6032,10 +6368,20 @@ void CSQLHelper::DeleteDevices(const std::string &idx)
 			uint64_t ullidx;
 			sstridx >> ullidx;
 			m_mainworker.m_eventsystem.RemoveSingleState(ullidx, m_mainworker.m_eventsystem.REASON_DEVICE);
+			m_devicesnapshots.Remove(ullidx);
+			{
+				boost::lock_guard<boost::mutex> l(m_updateFilterMutex);
+				std::map<uint64_t, _tUpdateFilterState>::iterator ittFilter = m_updateFilter.find(ullidx);
+				if (ittFilter != m_updateFilter.end())
+				{
+					if (ittFilter->second.bPendingValue)
+						m_deferredUpdates--;
+					m_updateFilter.erase(ittFilter);
+				}
+			}
 			//and now delete all records in the DeviceStatus table itself
 			safe_exec_no_return("DELETE FROM DeviceStatus WHERE (ID == '%q')", (*itt).c_str());
 		}
-		sqlite3_exec(m_dbase, "COMMIT TRANSACTION", NULL, NULL, &errorMessage);
 	}
 	else
 		return;
@@ -6518,8 +6864,6 @@ bool CSQLHelper::BackupDatabase(const std::string &OutputFile)
 	OptimizeDatabase(m_dbase);
 	VacuumDatabase();
 
-	boost::lock_guard<boost::mutex> l(m_sqlQueryMutex);
-
 	int rc;                     // Function return code
 	sqlite3 *pFile;             // Database connection opened on zFilename
 	sqlite3_backup *pBackup;    // Backup handle used to copy data
@@ -6530,22 +6874,30 @@ bool CSQLHelper::BackupDatabase(const std::string &OutputFile)
 		return false;
 
 	// Open the sqlite3_backup object used to accomplish the transfer
-    pBackup = sqlite3_backup_init(pFile, "main", m_dbase, "main");
-    if( pBackup )
-	{
-      // Each iteration of this loop copies 5 database pages from database
-      // pDb to the backup database.
-      do {
-        rc = sqlite3_backup_step(pBackup, 5);
-        //xProgress(  sqlite3_backup_remaining(pBackup), sqlite3_backup_pagecount(pBackup) );
-        //if( rc==SQLITE_OK || rc==SQLITE_BUSY || rc==SQLITE_LOCKED ){
-          //sqlite3_sleep(250);
-        //}
-      } while( rc==SQLITE_OK || rc==SQLITE_BUSY || rc==SQLITE_LOCKED );
-
-      /* Release resources allocated by backup_init(). */
-      sqlite3_backup_finish(pBackup);
-    }
+	{
+		boost::lock_guard<boost::recursive_mutex> l(m_sqlQueryMutex);
+		CheckBatchTransaction();
+		pBackup = sqlite3_backup_init(pFile, "main", m_dbase, "main");
+	}
+	if( pBackup )
+	{
+		// Copy a limited number of pages per step and only hold the query lock during a step,
+		// so the rest of the system can keep using the database while a (large) backup is running.
+		// Changes made through our own connection in between are picked up by the backup itself.
+		do {
+			{
+				boost::lock_guard<boost::recursive_mutex> l(m_sqlQueryMutex);
+				CheckBatchTransaction();
+				rc = sqlite3_backup_step(pBackup, 64);
+			}
+			if ((rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED))
+				sqlite3_sleep(50);
+		} while( rc==SQLITE_OK || rc==SQLITE_BUSY || rc==SQLITE_LOCKED );
+
+		/* Release resources allocated by backup_init(). */
+		boost::lock_guard<boost::recursive_mutex> l(m_sqlQueryMutex);
+		sqlite3_backup_finish(pBackup);
+	}
     rc = sqlite3_errcode(pFile);
 	// Close the database connection opened on database file zFilename
 	// and return the result of this function.
@@ -7738,6 +8090,7 @@ bool CSQLHelper::SetDeviceOptions(const uint64_t idx, const std::map<std::string
 		//_log.Log(LOG_STATUS, "DEBUG : setting options '%s' on device %" PRIu64 "", options.c_str(), idx);
 		safe_query("UPDATE DeviceStatus SET Options = '%q' WHERE (ID==%" PRIu64 ")", options.c_str(), idx);
 	}
+	m_notifications.InvalidateDeviceInfo(idx);
 	return true;
 }
 
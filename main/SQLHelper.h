@@ -6,10 +6,12 @@
 #include "Helper.h"
 #include "../httpclient/UrlEncode.h"
 #include <map>
+#include <boost/function.hpp>
 
 #define timer_resolution_hz 25
 
 struct sqlite3;
+class CMetricHistogram;
 
 enum _eWindUnit
 {
@@ -306,6 +308,12 @@ public:
 	void ClearShortLog();
 	void VacuumDatabase();
 	void OptimizeDatabase(sqlite3 *dbase);
+	//Group the queries of the calling thread in one transaction until EndBatchTransaction.
+	//This is one transaction as long as no other thread queries in between: such a query commits what the batch did so far
+	//(sql_batch_splits), the rest of the batch goes in a new transaction (sql_batch_transactions counts them all).
+	//Other threads are not held back for a batch, the batch thread takes other locks while it runs.
+	void BeginBatchTransaction();
+	void EndBatchTransaction();
 
 	void DeleteHardware(const std::string &idx);
 
@@ -334,6 +342,8 @@ public:
 
 	std::vector<std::vector<std::string> > safe_query(const char *fmt, ...);
 	std::vector<std::vector<std::string> > safe_queryBlob(const char *fmt, ...);
+	//Hands every result row to onRow while SQLite steps through them, a large result is never held as a whole
+	bool safe_queryRows(const boost::function<void(const std::vector<std::string> &)> &onRow, const char *fmt, ...);
 	void safe_exec_no_return(const char *fmt, ...);
 	bool DoesColumnExistsInTable(const std::string &columnname, const std::string &tablename);
 	std::string DeleteUserVariable(const std::string &idx);
@@ -362,6 +372,9 @@ public:
 	std::map<std::string, std::string> BuildDeviceOptions(const std::string & options, const bool decode = true);
 	std::map<std::string, std::string> GetDeviceOptions(const std::string & idx);
 	bool SetDeviceOptions(const uint64_t idx, const std::map<std::string, std::string> & options);
+
+	//Sensor updates done from this thread honor the DeadBand/MinInterval device options (the RX queue worker)
+	void SetUpdateFilterThread(const boost::thread::id &threadId);
 public:
 	std::string m_LastSwitchID;	//for learning command
 	uint64_t m_LastSwitchRowID;
@@ -382,8 +395,18 @@ public:
 	bool		m_bLogEventScriptTrigger;
 	bool		m_bDisableDzVentsSystem;
 private:
-	boost::mutex	m_sqlQueryMutex;
+	boost::recursive_mutex	m_sqlQueryMutex;
 	sqlite3			*m_dbase;
+	bool			m_bBatchTransactionActive;
+	bool			m_bBatchTransactionOpen;
+	boost::thread::id m_batchTransactionThread;
+	void CheckBatchTransaction();
+	friend class CSQLScopedTransaction;
+	//sql_query histogram per format string pointer (and its text, some formats are built at runtime)
+	//own lock, the query lock is only taken by query() so it can drop it before calling out
+	boost::mutex	m_queryHistogramsMutex;
+	std::map<const char*, std::pair<std::string, CMetricHistogram*> > m_queryHistograms;
+	CMetricHistogram *GetQueryHistogram(const char *fmt);
 	std::string		m_dbase_name;
 	unsigned char	m_sensortimeoutcounter;
 	std::map<uint64_t, int> m_timeoutlastsend;
@@ -399,6 +422,35 @@ private:
 	bool StartThread();
 	void Do_Work();
 
+	struct _tUpdateFilterState
+	{
+		time_t lastAccepted;
+		time_t lastSeen;
+		bool bPendingLastUpdate;
+		uint64_t suppressed;
+		//newest report dropped by MinInterval, applied at applyTime
+		bool bPendingValue;
+		time_t applyTime;
+		int HardwareID;
+		std::string ID;
+		unsigned char unit;
+		unsigned char devType;
+		unsigned char subType;
+		unsigned char signallevel;
+		unsigned char batterylevel;
+		int nValue;
+		std::string sValue;
+	};
+	std::map<uint64_t, _tUpdateFilterState> m_updateFilter;
+	boost::mutex m_updateFilterMutex;
+	boost::thread::id m_updateFilterThread;
+	boost::thread::id m_deferredUpdateThread;
+	size_t m_deferredUpdates;
+	time_t m_lastUpdateFilterFlush;
+	bool FilterDeviceUpdate(const uint64_t ulID, const int HardwareID, const char* ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, const unsigned char signallevel, const unsigned char batterylevel, const std::string &sOptions, const int nValue, const char* sValue, const int old_nValue, const std::string &old_sValue);
+	void FlushFilteredUpdates();
+	void ApplyDeferredUpdates();
+
 	bool SwitchLightFromTasker(const std::string &idx, const std::string &switchcmd, const std::string &level, const std::string &hue);
 	bool SwitchLightFromTasker(uint64_t idx, const std::string &switchcmd, int level, int hue);
 
@@ -437,7 +489,21 @@ private:
 
 	std::vector<std::vector<std::string> > query(const std::string &szQuery);
 	std::vector<std::vector<std::string> > queryBlob(const std::string &szQuery);
+	bool queryRows(const std::string &szQuery, const boost::function<void(const std::vector<std::string> &)> &onRow);
 	void LogQueryResult(TSqlQueryResult &result);
 };
 
+//Runs all queries of its scope in one transaction, the database is locked for other threads until it goes out of scope
+//Only use it around plain queries, code that takes other locks in between can deadlock
+class CSQLScopedTransaction
+{
+public:
+	explicit CSQLScopedTransaction(CSQLHelper &sql);
+	~CSQLScopedTransaction();
+private:
+	CSQLHelper &m_sqlHelper;
+	boost::unique_lock<boost::recursive_mutex> m_lock;
+	bool m_bStarted;
+};
+
 extern CSQLHelper m_sql;
@@ -40,6 +40,8 @@
 #include "../json/json.h"
 #include "Logger.h"
 #include "SQLHelper.h"
+#include "Metrics.h"
+#include "GraphDownsample.h"
 #include "../push/BasePush.h"
 #include <algorithm>
 #ifdef ENABLE_PYTHON
@@ -49,9 +51,11 @@
 #ifndef WIN32
 #include <sys/utsname.h>
 #include <dirent.h>
+#include <unistd.h>
 #else
 #include "../msbuild/WindowsHelper.h"
 #include "dirent_windows.h"
+#include <process.h>
 #endif
 #include "../notifications/NotificationHelper.h"
 #include "../main/LuaHandler.h"
@@ -334,7 +338,9 @@ namespace http {
 			m_pWebEm->RegisterPageCode("/uploadcustomicon", boost::bind(&CWebServer::Post_UploadCustomIcon, this, _1, _2, _3));
 			m_pWebEm->RegisterPageCode("/html5.appcache", boost::bind(&CWebServer::GetAppCache, this, _1, _2, _3));
 			m_pWebEm->RegisterPageCode("/camsnapshot.jpg", boost::bind(&CWebServer::GetCameraSnapshot, this, _1, _2, _3));
+			m_pWebEm->RegisterPageCode("/cammjpeg", boost::bind(&CWebServer::GetCameraMJPEG, this, _1, _2, _3));
 			m_pWebEm->RegisterPageCode("/backupdatabase.php", boost::bind(&CWebServer::GetDatabaseBackup, this, _1, _2, _3));
+			m_pWebEm->RegisterPageCode("/metrics", boost::bind(&CWebServer::GetMetrics, this, _1, _2, _3));
 			m_pWebEm->RegisterPageCode("/raspberry.cgi", boost::bind(&CWebServer::GetInternalCameraSnapshot, this, _1, _2, _3));
 			m_pWebEm->RegisterPageCode("/uvccapture.cgi", boost::bind(&CWebServer::GetInternalCameraSnapshot, this, _1, _2, _3)); //TODO: fix me double
 
@@ -364,6 +370,7 @@ namespace http {
 			RegisterCommandCode("getversion", boost::bind(&CWebServer::Cmd_GetVersion, this, _1, _2, _3), true);
 			RegisterCommandCode("getlog", boost::bind(&CWebServer::Cmd_GetLog, this, _1, _2, _3));
 			RegisterCommandCode("clearlog", boost::bind(&CWebServer::Cmd_ClearLog, this, _1, _2, _3));
+			RegisterCommandCode("getnotificationstats", boost::bind(&CWebServer::Cmd_GetNotificationStats, this, _1, _2, _3));
 			RegisterCommandCode("getauth", boost::bind(&CWebServer::Cmd_GetAuth, this, _1, _2, _3), true);
 			RegisterCommandCode("getuptime", boost::bind(&CWebServer::Cmd_GetUptime, this, _1, _2, _3), true);
 
@@ -557,6 +564,7 @@ namespace http {
 			RegisterRType("textlog", boost::bind(&CWebServer::RType_TextLog, this, _1, _2, _3));
 			RegisterRType("scenelog", boost::bind(&CWebServer::RType_SceneLog, this, _1, _2, _3));
 			RegisterRType("settings", boost::bind(&CWebServer::RType_Settings, this, _1, _2, _3));
+			RegisterRType("metrics", boost::bind(&CWebServer::RType_Metrics, this, _1, _2, _3));
 			RegisterRType("events", boost::bind(&CWebServer::RType_Events, this, _1, _2, _3));
 
 			RegisterRType("hardware", boost::bind(&CWebServer::RType_Hardware, this, _1, _2, _3));
@@ -716,6 +724,7 @@ namespace http {
 			std::map < std::string, webserver_response_function >::iterator pf = m_webrtypes.find(rtype);
 			if (pf != m_webrtypes.end())
 			{
+				CMetricTimer timer(m_metrics.GetHistogram("web_rtype", "rtype", rtype));
 				pf->second(session, req, root);
 			}
 		}
@@ -831,6 +840,407 @@ namespace http {
 			reply::set_content(&rep, response);
 		}
 
+		// number of rows fetched per query when streaming logs
+		#define LOG_STREAM_PAGE_SIZE 500
+
+		// device details needed to describe its LightingLog rows
+		struct _tLightLogDevice
+		{
+			unsigned char dType;
+			unsigned char dSubType;
+			_eSwitchType switchtype;
+			std::map<std::string, std::string> selectorStatuses;
+		};
+
+		static bool GetLightLogDevice(const uint64_t idx, _tLightLogDevice &device)
+		{
+			std::vector<std::vector<std::string> > result;
+			//First get Device Type/SubType
+			result = m_sql.safe_query("SELECT Type, SubType, SwitchType, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")",
+				idx);
+			if (result.size() < 1)
+				return false;
+
+			unsigned char dType = atoi(result[0][0].c_str());
+			unsigned char dSubType = atoi(result[0][1].c_str());
+			_eSwitchType switchtype = (_eSwitchType)atoi(result[0][2].c_str());
+			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(result[0][3].c_str());
+
+			if (
+				(dType != pTypeLighting1) &&
+				(dType != pTypeLighting2) &&
+				(dType != pTypeLighting3) &&
+				(dType != pTypeLighting4) &&
+				(dType != pTypeLighting5) &&
+				(dType != pTypeLighting6) &&
+				(dType != pTypeFan) &&
+				(dType != pTypeLimitlessLights) &&
+				(dType != pTypeSecurity1) &&
+				(dType != pTypeSecurity2) &&
+				(dType != pTypeEvohome) &&
+				(dType != pTypeEvohomeRelay) &&
+				(dType != pTypeCurtain) &&
+				(dType != pTypeBlinds) &&
+				(dType != pTypeRFY) &&
+				(dType != pTypeRego6XXValue) &&
+				(dType != pTypeChime) &&
+				(dType != pTypeThermostat2) &&
+				(dType != pTypeThermostat3) &&
+				(dType != pTypeThermostat4) &&
+				(dType != pTypeRemote) &&
+				(dType != pTypeGeneralSwitch) &&
+				(dType != pTypeHomeConfort) &&
+				(!((dType == pTypeRadiator1) && (dSubType == sTypeSmartwaresSwitchRadiator)))
+				)
+				return false; //no light device! we should not be here!
+
+			device.dType = dType;
+			device.dSubType = dSubType;
+			device.switchtype = switchtype;
+			if (switchtype == STYPE_Selector) {
+				GetSelectorSwitchStatuses(options, device.selectorStatuses);
+			}
+			return true;
+		}
+
+		// Fill item from a (ROWID, nValue, sValue, Date) row, device wide values go into root with the first row.
+		// Returns false if the row should not be shown
+		static bool LightLogRowToJson(const _tLightLogDevice &device, const std::vector<std::string> &sd, const bool bFirst, Json::Value &item, Json::Value &root)
+		{
+			int nValue = atoi(sd[1].c_str());
+			std::string sValue = sd[2];
+
+			//skip 0-values in log for MediaPlayers
+			if ((device.switchtype == STYPE_Media) && (sValue == "0"))
+				return false;
+
+			item["idx"] = sd[0];
+
+			//add light details
+			std::string lstatus = "";
+			std::string ldata = "";
+			int llevel = 0;
+			bool bHaveDimmer = false;
+			bool bHaveSelector = false;
+			bool bHaveGroupCmd = false;
+			int maxDimLevel = 0;
+
+			if (device.switchtype == STYPE_Media) {
+				lstatus = sValue;
+				ldata = lstatus;
+
+			}
+			else if ((device.switchtype == STYPE_Selector) && (device.selectorStatuses.size() > 0)) {
+				if (bFirst) {
+					bHaveSelector = true;
+					maxDimLevel = device.selectorStatuses.size();
+				}
+				std::map<std::string, std::string>::const_iterator itt = device.selectorStatuses.find(sValue);
+				if (itt != device.selectorStatuses.end())
+					ldata = itt->second;
+				lstatus = "Set Level: " + ldata;
+				llevel = atoi(sValue.c_str());
+
+			}
+			else {
+				GetLightStatus(device.dType, device.dSubType, device.switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
+				ldata = lstatus;
+			}
+
+			if (bFirst)
+			{
+				root["HaveDimmer"] = bHaveDimmer;
+				item["MaxDimLevel"] = maxDimLevel;
+				root["HaveGroupCmd"] = bHaveGroupCmd;
+				root["HaveSelector"] = bHaveSelector;
+			}
+
+			item["Date"] = sd[3];
+			item["Data"] = ldata;
+			item["Status"] = lstatus;
+			item["Level"] = llevel;
+			return true;
+		}
+
+		// Position in the LightingLog, pages continue below this Date/ROWID
+		struct _tLogCursor
+		{
+			uint64_t RowID;
+			std::string Date;
+		};
+
+		// Newest first. Only rows older than the cursor are returned when its ROWID is set, limit 0 means all rows.
+		// The first column has to be ROWID and the last one Date
+		static std::vector<std::vector<std::string> > GetLightingLogPage(const std::string &columns, const uint64_t idx, const _tLogCursor &before, const int limit)
+		{
+			std::stringstream szLimit;
+			if (limit > 0)
+				szLimit << " LIMIT " << limit;
+			if (before.RowID == 0)
+			{
+				return m_sql.safe_query("SELECT %s FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC, ROWID DESC%s",
+					columns.c_str(), idx, szLimit.str().c_str());
+			}
+			if (before.Date.empty())
+			{
+				//rows are logged in time order, the ROWID alone is a good enough position
+				return m_sql.safe_query("SELECT %s FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") AND (ROWID < %" PRIu64 ") ORDER BY Date DESC, ROWID DESC%s",
+					columns.c_str(), idx, before.RowID, szLimit.str().c_str());
+			}
+			return m_sql.safe_query(
+				"SELECT %s FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") AND "
+				"((Date < '%q') OR ((Date == '%q') AND (ROWID < %" PRIu64 "))) "
+				"ORDER BY Date DESC, ROWID DESC%s",
+				columns.c_str(), idx, before.Date.c_str(), before.Date.c_str(), before.RowID, szLimit.str().c_str());
+		}
+
+		static void SetLogCursor(const std::vector<std::string> &sd, _tLogCursor &cursor)
+		{
+			std::stringstream s_str(sd[0]);
+			s_str >> cursor.RowID;
+			cursor.Date = sd.back();
+		}
+
+		static void GetLogPageParameters(const request& req, _tLogCursor &before, int &limit)
+		{
+			before.RowID = 0;
+			limit = 0;
+			std::string sBefore = request::findValue(&req, "before");
+			if (!sBefore.empty())
+			{
+				std::stringstream s_str(sBefore);
+				s_str >> before.RowID;
+			}
+			before.Date = request::findValue(&req, "beforedate");
+			std::string sLimit = request::findValue(&req, "limit");
+			if (!sLimit.empty())
+				limit = atoi(sLimit.c_str());
+			if (limit < 0)
+				limit = 0;
+		}
+
+		// Writes a LightingLog (lightlog or textlog) json reply while reading the log page by page,
+		// so memory use does not depend on the size of the log.
+		// The pages are read on a worker thread, the next one while the current one is being sent
+		class CLightingLogReplyStream : public reply_stream
+		{
+		public:
+			CLightingLogReplyStream(const uint64_t idx, const bool bTextLog, const _tLightLogDevice &device, const _tLogCursor &before, const int limit) :
+				m_idx(idx),
+				m_bTextLog(bTextLog),
+				m_device(device),
+				m_before(before),
+				m_limit(limit),
+				m_fetched(0),
+				m_items(0),
+				m_pagesize(0),
+				m_bStarted(false),
+				m_bFetching(false),
+				m_bHavePage(false)
+			{
+				m_writer.omitEndingLineFeed();
+			}
+			~CLightingLogReplyStream()
+			{
+				if (m_thread)
+					m_thread->join();
+			}
+			bool data_ready(const boost::function<void()> &on_ready)
+			{
+				boost::lock_guard<boost::mutex> l(m_mutex);
+				if (!m_bFetching)
+					return true;
+				m_on_ready = on_ready;
+				return false;
+			}
+			bool next_chunk(std::string &chunk)
+			{
+				chunk.clear();
+				if (!m_bStarted)
+				{
+					m_bStarted = true;
+					chunk = (m_bTextLog) ? "{\"status\":\"OK\",\"title\":\"TextLog\",\"result\":[" : "{\"status\":\"OK\",\"title\":\"LightLog\",\"result\":[";
+					StartFetch();
+					return true;
+				}
+				int pagesize = m_pagesize;
+				std::vector<std::vector<std::string> > result;
+				GetPage(result);
+
+				std::vector<std::vector<std::string> >::const_iterator itt;
+				for (itt = result.begin(); itt != result.end(); ++itt)
+				{
+					const std::vector<std::string> &sd = *itt;
+					Json::Value item;
+					if (m_bTextLog)
+					{
+						item["idx"] = sd[0];
+						item["Date"] = sd[2];
+						item["Data"] = sd[1];
+					}
+					else if (!LightLogRowToJson(m_device, sd, (m_items == 0), item, m_trailer))
+						continue;
+					if (m_items > 0)
+						chunk += ",";
+					chunk += m_writer.write(item);
+					m_items++;
+				}
+				m_fetched += (int)result.size();
+				if (!result.empty())
+					SetLogCursor(result.back(), m_before);
+				if ((pagesize > 0) && ((int)result.size() == pagesize) && ((m_limit == 0) || (m_fetched < m_limit)))
+				{
+					StartFetch();
+					return true;
+				}
+
+				chunk += "]";
+				if ((m_limit > 0) && (m_fetched >= m_limit))
+				{
+					std::stringstream sstr;
+					sstr << m_before.RowID;
+					m_trailer["NextBefore"] = sstr.str();
+					m_trailer["NextBeforeDate"] = m_before.Date;
+				}
+				Json::Value::Members members = m_trailer.getMemberNames();
+				Json::Value::Members::const_iterator ittMember;
+				for (ittMember = members.begin(); ittMember != members.end(); ++ittMember)
+				{
+					chunk += ",\"" + *ittMember + "\":" + m_writer.write(m_trailer[*ittMember]);
+				}
+				chunk += "}";
+				return false;
+			}
+		private:
+			void StartFetch()
+			{
+				m_pagesize = LOG_STREAM_PAGE_SIZE;
+				if ((m_limit > 0) && (m_limit - m_fetched < m_pagesize))
+					m_pagesize = m_limit - m_fetched;
+				if (m_pagesize <= 0)
+					return;
+				if (m_thread)
+					m_thread->join();
+				boost::lock_guard<boost::mutex> l(m_mutex);
+				m_bFetching = true;
+				m_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CLightingLogReplyStream::Do_Fetch, this)));
+			}
+			void Do_Fetch()
+			{
+				std::vector<std::vector<std::string> > result = GetLightingLogPage((m_bTextLog) ? "ROWID, sValue, Date" : "ROWID, nValue, sValue, Date", m_idx, m_before, m_pagesize);
+				boost::function<void()> on_ready;
+				{
+					boost::lock_guard<boost::mutex> l(m_mutex);
+					m_page.swap(result);
+					m_bHavePage = true;
+					m_bFetching = false;
+					on_ready.swap(m_on_ready);
+					m_fetched_cond.notify_all();
+				}
+				if (on_ready)
+					on_ready();
+			}
+			// the page read by the worker, waits for it when next_chunk is called without data_ready
+			void GetPage(std::vector<std::vector<std::string> > &result)
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				while (m_bFetching)
+					m_fetched_cond.wait(lock);
+				if (!m_bHavePage)
+					return;
+				result.swap(m_page);
+				m_page.clear();
+				m_bHavePage = false;
+			}
+
+			uint64_t m_idx;
+			bool m_bTextLog;
+			_tLightLogDevice m_device;
+			_tLogCursor m_before;
+			int m_limit;
+			int m_fetched;
+			int m_items;
+			int m_pagesize;
+			bool m_bStarted;
+			Json::Value m_trailer;
+			Json::FastWriter m_writer;
+
+			boost::shared_ptr<boost::thread> m_thread;
+			boost::mutex m_mutex;
+			boost::condition_variable m_fetched_cond;
+			bool m_bFetching;
+			bool m_bHavePage;
+			std::vector<std::vector<std::string> > m_page;
+			boost::function<void()> m_on_ready;
+		};
+
+		// Writes an already built json reply in pieces, releasing the "result" items once written.
+		// Only the serialization is chunked, the reply (e.g. a graph) is built in memory before the first piece is written.
+		class CJsonReplyStream : public reply_stream
+		{
+		public:
+			explicit CJsonReplyStream(Json::Value &root) :
+				m_index(0),
+				m_bResultStarted(false),
+				m_bStarted(false)
+			{
+				m_root.swap(root);
+				m_writer.omitEndingLineFeed();
+				m_members = m_root.getMemberNames();
+				m_itt = m_members.begin();
+			}
+			bool next_chunk(std::string &chunk)
+			{
+				chunk.clear();
+				if (!m_bStarted)
+				{
+					m_bStarted = true;
+					chunk = "{";
+				}
+				while (m_itt != m_members.end())
+				{
+					Json::Value &value = m_root[*m_itt];
+					if ((*m_itt != "result") || (!value.isArray()))
+					{
+						if (m_itt != m_members.begin())
+							chunk += ",";
+						chunk += "\"" + *m_itt + "\":" + m_writer.write(value);
+						++m_itt;
+						continue;
+					}
+					if (!m_bResultStarted)
+					{
+						m_bResultStarted = true;
+						if (m_itt != m_members.begin())
+							chunk += ",";
+						chunk += "\"result\":[";
+					}
+					Json::ArrayIndex end = std::min(value.size(), m_index + LOG_STREAM_PAGE_SIZE);
+					for (; m_index < end; m_index++)
+					{
+						if (m_index > 0)
+							chunk += ",";
+						chunk += m_writer.write(value[m_index]);
+						value[m_index] = Json::Value();
+					}
+					if (m_index < value.size())
+						return true;
+					chunk += "]";
+					++m_itt;
+				}
+				chunk += "}";
+				return false;
+			}
+		private:
+			Json::Value m_root;
+			Json::Value::Members m_members;
+			Json::Value::Members::const_iterator m_itt;
+			Json::ArrayIndex m_index;
+			bool m_bResultStarted;
+			bool m_bStarted;
+			Json::FastWriter m_writer;
+		};
+
 		void CWebServer::GetJSonPage(WebEmSession & session, const request& req, reply & rep)
 		{
 			Json::Value root;
@@ -860,11 +1270,34 @@ namespace http {
 				HandleCommand(cparam, session, req, root);
 			} //(rtype=="command")
 			else {
+				if ((request::findValue(&req, "stream") == "1") && (request::findValue(&req, "jsoncallback").empty()) &&
+					((rtype == "lightlog") || (rtype == "textlog")))
+				{
+					// read and write the log page by page
+					uint64_t idx = 0;
+					std::stringstream s_str(request::findValue(&req, "idx"));
+					s_str >> idx;
+					_tLightLogDevice device;
+					if ((rtype == "textlog") || (GetLightLogDevice(idx, device)))
+					{
+						_tLogCursor before;
+						int limit;
+						GetLogPageParameters(req, before, limit);
+						reply::set_content_stream(&rep, boost::shared_ptr<reply_stream>(new CLightingLogReplyStream(idx, (rtype == "textlog"), device, before, limit)));
+						return;
+					}
+					goto exitjson;
+				}
 				HandleRType(rtype, session, req, root);
 			}
 		exitjson:
 			std::string jcallback = request::findValue(&req, "jsoncallback");
 			if (jcallback.size() == 0) {
+				if (request::findValue(&req, "stream") == "1") {
+					// compact output, written in pieces instead of one big string (only the log types above are read while writing)
+					reply::set_content_stream(&rep, boost::shared_ptr<reply_stream>(new CJsonReplyStream(root)));
+					return;
+				}
 				reply::set_content(&rep, root.toStyledString());
 				return;
 			}
@@ -2016,6 +2449,36 @@ namespace http {
 			_log.ClearLog();
 		}
 
+		void CWebServer::Cmd_GetNotificationStats(WebEmSession & session, const request& req, Json::Value &root)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; //Only admin user allowed
+			}
+			root["status"] = "OK";
+			root["title"] = "GetNotificationStats";
+
+			int ii = 0;
+			std::map<std::string, _tNotificationQueueStats> stats = m_notifications.GetQueueStats();
+			std::map<std::string, _tNotificationQueueStats>::const_iterator itt;
+			for (itt = stats.begin(); itt != stats.end(); ++itt)
+			{
+				root["result"][ii]["Subsystem"] = itt->first;
+				root["result"][ii]["Queued"] = itt->second.Queued;
+				root["result"][ii]["Sent"] = (Json::UInt64)itt->second.Sent;
+				root["result"][ii]["Failed"] = (Json::UInt64)itt->second.Failed;
+				root["result"][ii]["Retried"] = (Json::UInt64)itt->second.Retried;
+				root["result"][ii]["Deduplicated"] = (Json::UInt64)itt->second.Deduplicated;
+				root["result"][ii]["Dropped"] = (Json::UInt64)itt->second.Dropped;
+				root["result"][ii]["LastLatency"] = (Json::UInt64)itt->second.LastLatency;
+				root["result"][ii]["AvgLatency"] = (Json::UInt64)itt->second.AvgLatency;
+				root["result"][ii]["LastSent"] = (itt->second.LastSent != 0) ? TimeToString(&itt->second.LastSent, TF_DateTime) : "-";
+				root["result"][ii]["LastFailed"] = (itt->second.LastFailed != 0) ? TimeToString(&itt->second.LastFailed, TF_DateTime) : "-";
+				ii++;
+			}
+		}
+
 		//Plan Functions
 		void CWebServer::Cmd_AddPlan(WebEmSession & session, const request& req, Json::Value &root)
 		{
@@ -3215,6 +3678,7 @@ namespace http {
 			std::map < std::string, webserver_response_function >::iterator pf = m_webcommands.find(cparam);
 			if (pf != m_webcommands.end())
 			{
+				CMetricTimer timer(m_metrics.GetHistogram("web_command", "command", cparam));
 				pf->second(session, req, root);
 				return;
 			}
@@ -5010,6 +5474,7 @@ namespace http {
 						m_sql.safe_query(
 							"UPDATE DeviceStatus SET Used=1, Name='%q', SwitchType=%d WHERE (ID == '%q')",
 							name.c_str(), switchtype, ID.c_str());
+						m_notifications.InvalidateDeviceInfo(ID);
 
 						//Now continue to insert the switch
 						dtype = pTypeRadiator1;
@@ -5200,6 +5665,7 @@ namespace http {
 				m_sql.safe_query(
 					"UPDATE DeviceStatus SET Used=1, Name='%q', SwitchType=%d WHERE (ID == '%q')",
 					name.c_str(), switchtype, ID.c_str());
+				m_notifications.InvalidateDeviceInfo(ID);
 				m_mainworker.m_eventsystem.GetCurrentStates();
 
 				//Set device options
@@ -10583,15 +11049,62 @@ namespace http {
 				session.reply_status = reply::forbidden;
 				return; //Only admin user allowed
 			}
+			// unique name, so concurrent downloads do not overwrite each others backup
+			std::string OutputFileName;
 #ifdef WIN32
-			std::string OutputFileName = szUserDataFolder + "backup.db";
+			static boost::mutex backupCounterMutex;
+			static int iBackupCounter = 0;
+			{
+				boost::lock_guard<boost::mutex> l(backupCounterMutex);
+				std::stringstream sstr;
+				sstr << szUserDataFolder << "backup_" << _getpid() << "_" << iBackupCounter++ << ".db";
+				OutputFileName = sstr.str();
+			}
 #else
-			std::string OutputFileName = "/tmp/backup.db";
+			// mkstemp creates the (empty) file, sqlite takes an empty file as a new database
+			char szTempName[] = "/tmp/backup_XXXXXX";
+			int fd = mkstemp(szTempName);
+			if (fd == -1)
+			{
+				_log.Log(LOG_ERROR, "Backup Database: Could not create a temporary file!");
+				return;
+			}
+			close(fd);
+			OutputFileName = szTempName;
 #endif
-			if (m_sql.BackupDatabase(OutputFileName))
+			if (!m_sql.BackupDatabase(OutputFileName))
 			{
-				reply::set_content_from_file(&rep, OutputFileName, "domoticz.db", true);
+				std::remove(OutputFileName.c_str());
+				return;
+			}
+			bool bGZip = false;
+			const char *encoding_header = request::get_req_header(&req, "Accept-Encoding");
+			if ((encoding_header != NULL) && (strstr(encoding_header, "gzip") != NULL))
+				bGZip = true;
+
+			// send the backup in chunks instead of loading it into memory, the file is removed when done
+			boost::shared_ptr<file_reply_stream> stream(new file_reply_stream(OutputFileName, bGZip, true));
+			if (!stream->is_open())
+				return;
+			reply::set_content_stream(&rep, stream);
+			reply::add_header_attachment(&rep, "domoticz.db");
+			reply::add_header_content_type(&rep, "application/octet-stream");
+			if (bGZip)
+			{
+				reply::add_header(&rep, "Content-Encoding", "gzip");
+				rep.bIsGZIP = true;
+			}
+		}
+
+		//Prometheus text exposition format
+		void CWebServer::GetMetrics(WebEmSession & session, const request& req, reply & rep)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; //Only admin user allowed
 			}
+			reply::set_content(&rep, m_metrics.GetPrometheusText());
 		}
 
 		void CWebServer::RType_DeleteDevice(WebEmSession & session, const request& req, Json::Value &root)
@@ -12157,6 +12670,7 @@ namespace http {
 					m_sql.safe_query(
 						"UPDATE DeviceStatus SET Used=%d, Name='%q', Description='%q', SwitchType=%d, CustomImage=%d WHERE (ID == '%q')",
 						used, name.c_str(), description.c_str(), switchtype, CustomImage, idx.c_str());
+					m_notifications.InvalidateDeviceInfo(idx);
 				}
 			}
 
@@ -12262,6 +12776,7 @@ namespace http {
 					faddjmulti = 1;
 				m_sql.safe_query("UPDATE DeviceStatus SET AddjMulti=%f WHERE (ID == '%q')",
 					faddjmulti, idx.c_str());
+				m_notifications.InvalidateDeviceInfo(idx);
 			}
 			if (!addjvalue2.empty())
 			{
@@ -12280,6 +12795,7 @@ namespace http {
 			if (!devoptions.empty())
 			{
 				m_sql.safe_query("UPDATE DeviceStatus SET Options='%q' WHERE (ID == '%q')", devoptions.c_str(), idx.c_str());
+				m_notifications.InvalidateDeviceInfo(idx);
 			}
 
 			if (used == 0)
@@ -12333,6 +12849,18 @@ namespace http {
 			}
 		}
 
+		void CWebServer::RType_Metrics(WebEmSession & session, const request& req, Json::Value &root)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; //Only admin user allowed
+			}
+			root["status"] = "OK";
+			root["title"] = "metrics";
+			m_metrics.GetJson(root["result"]);
+		}
+
 		void CWebServer::RType_Settings(WebEmSession & session, const request& req, Json::Value &root)
 		{
 			std::vector<std::vector<std::string> > result;
@@ -12716,115 +13244,36 @@ namespace http {
 				std::stringstream s_str(request::findValue(&req, "idx"));
 				s_str >> idx;
 			}
-			std::vector<std::vector<std::string> > result;
-			//First get Device Type/SubType
-			result = m_sql.safe_query("SELECT Type, SubType, SwitchType, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")",
-				idx);
-			if (result.size() < 1)
+			_tLightLogDevice device;
+			if (!GetLightLogDevice(idx, device))
 				return;
 
-			unsigned char dType = atoi(result[0][0].c_str());
-			unsigned char dSubType = atoi(result[0][1].c_str());
-			_eSwitchType switchtype = (_eSwitchType)atoi(result[0][2].c_str());
-			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(result[0][3].c_str());
-
-			if (
-				(dType != pTypeLighting1) &&
-				(dType != pTypeLighting2) &&
-				(dType != pTypeLighting3) &&
-				(dType != pTypeLighting4) &&
-				(dType != pTypeLighting5) &&
-				(dType != pTypeLighting6) &&
-				(dType != pTypeFan) &&
-				(dType != pTypeLimitlessLights) &&
-				(dType != pTypeSecurity1) &&
-				(dType != pTypeSecurity2) &&
-				(dType != pTypeEvohome) &&
-				(dType != pTypeEvohomeRelay) &&
-				(dType != pTypeCurtain) &&
-				(dType != pTypeBlinds) &&
-				(dType != pTypeRFY) &&
-				(dType != pTypeRego6XXValue) &&
-				(dType != pTypeChime) &&
-				(dType != pTypeThermostat2) &&
-				(dType != pTypeThermostat3) &&
-				(dType != pTypeThermostat4) &&
-				(dType != pTypeRemote) &&
-				(dType != pTypeGeneralSwitch) &&
-				(dType != pTypeHomeConfort) &&
-				(!((dType == pTypeRadiator1) && (dSubType == sTypeSmartwaresSwitchRadiator)))
-				)
-				return; //no light device! we should not be here!
-
 			root["status"] = "OK";
 			root["title"] = "LightLog";
 
-			result = m_sql.safe_query("SELECT ROWID, nValue, sValue, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
+			_tLogCursor before;
+			int limit;
+			GetLogPageParameters(req, before, limit);
+
+			std::vector<std::vector<std::string> > result;
+			result = GetLightingLogPage("ROWID, nValue, sValue, Date", idx, before, limit);
 			if (result.size() > 0)
 			{
-				std::map<std::string, std::string> selectorStatuses;
-				if (switchtype == STYPE_Selector) {
-					GetSelectorSwitchStatuses(options, selectorStatuses);
-				}
-
 				std::vector<std::vector<std::string> >::const_iterator itt;
 				int ii = 0;
 				for (itt = result.begin(); itt != result.end(); ++itt)
 				{
-					std::vector<std::string> sd = *itt;
-
-					int nValue = atoi(sd[1].c_str());
-					std::string sValue = sd[2];
-
-					//skip 0-values in log for MediaPlayers
-					if ((switchtype == STYPE_Media) && (sValue == "0")) continue;
-
-					root["result"][ii]["idx"] = sd[0];
-
-					//add light details
-					std::string lstatus = "";
-					std::string ldata = "";
-					int llevel = 0;
-					bool bHaveDimmer = false;
-					bool bHaveSelector = false;
-					bool bHaveGroupCmd = false;
-					int maxDimLevel = 0;
-
-					if (switchtype == STYPE_Media) {
-						lstatus = sValue;
-						ldata = lstatus;
-
-					}
-					else if ((switchtype == STYPE_Selector) && (selectorStatuses.size() > 0)) {
-						if (ii == 0) {
-							bHaveSelector = true;
-							maxDimLevel = selectorStatuses.size();
-						}
-						ldata = selectorStatuses[sValue];
-						lstatus = "Set Level: " + selectorStatuses[sValue];
-						llevel = atoi(sValue.c_str());
-
-					}
-					else {
-						GetLightStatus(dType, dSubType, switchtype, nValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
-						ldata = lstatus;
-					}
-
-					if (ii == 0)
-					{
-						root["HaveDimmer"] = bHaveDimmer;
-						root["result"][ii]["MaxDimLevel"] = maxDimLevel;
-						root["HaveGroupCmd"] = bHaveGroupCmd;
-						root["HaveSelector"] = bHaveSelector;
-					}
-
-					root["result"][ii]["Date"] = sd[3];
-					root["result"][ii]["Data"] = ldata;
-					root["result"][ii]["Status"] = lstatus;
-					root["result"][ii]["Level"] = llevel;
-
+					Json::Value item;
+					if (!LightLogRowToJson(device, *itt, (ii == 0), item, root))
+						continue;
+					root["result"][ii].swap(item);
 					ii++;
 				}
+				if ((limit > 0) && ((int)result.size() == limit))
+				{
+					root["NextBefore"] = result.back()[0];
+					root["NextBeforeDate"] = result.back().back();
+				}
 			}
 		}
 
@@ -12841,8 +13290,11 @@ namespace http {
 			root["status"] = "OK";
 			root["title"] = "TextLog";
 
-			result = m_sql.safe_query("SELECT ROWID, sValue, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC",
-				idx);
+			_tLogCursor before;
+			int limit;
+			GetLogPageParameters(req, before, limit);
+
+			result = GetLightingLogPage("ROWID, sValue, Date", idx, before, limit);
 			if (result.size() > 0)
 			{
 				std::vector<std::vector<std::string> >::const_iterator itt;
@@ -12856,6 +13308,11 @@ namespace http {
 					root["result"][ii]["Data"] = sd[1];
 					ii++;
 				}
+				if ((limit > 0) && ((int)result.size() == limit))
+				{
+					root["NextBefore"] = result.back()[0];
+					root["NextBeforeDate"] = result.back().back();
+				}
 			}
 		}
 
@@ -13016,13 +13473,23 @@ namespace http {
 			unsigned char tempsign = m_sql.m_tempsign[0];
 			int iPrev;
 
+			//Reduce the number of points to what the client can draw, normally "maxpoints" is the width of the chart in pixels.
+			//Not for totals (counters, rain, the month/year bars), leaving some out would change what they add up to,
+			//and not for the wind direction distribution
+			int maxPoints = atoi(request::findValue(&req, "maxpoints").c_str());
+			const bool bDownsample = (maxPoints > 0) && (sensor != "counter") && (sensor != "rain") && (sensor != "winddir") && (srange != "month") && (srange != "year");
+			//the sample tables are downsampled while they are read
+			const size_t maxStreamPoints = (bDownsample) ? (size_t)maxPoints : 0;
+
 			if (srange == "day")
 			{
 				if (sensor == "temp") {
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Temperature, Chill, Humidity, Barometer, Date, SetPoint FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					CGraphRowDownsampler rows(maxStreamPoints, 4);
+					m_sql.safe_queryRows(boost::bind(&CGraphRowDownsampler::AddRow, &rows, _1), "SELECT Temperature, Chill, Humidity, Barometer, Date, SetPoint FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					rows.GetRows(result);
 					if (result.size() > 0)
 					{
 						std::vector<std::vector<std::string> >::const_iterator itt;
@@ -13107,7 +13574,9 @@ namespace http {
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Percentage, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					CGraphRowDownsampler rows(maxStreamPoints, 1);
+					m_sql.safe_queryRows(boost::bind(&CGraphRowDownsampler::AddRow, &rows, _1), "SELECT Percentage, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					rows.GetRows(result);
 					if (result.size() > 0)
 					{
 						std::vector<std::vector<std::string> >::const_iterator itt;
@@ -13126,7 +13595,9 @@ namespace http {
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Speed, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					CGraphRowDownsampler rows(maxStreamPoints, 1);
+					m_sql.safe_queryRows(boost::bind(&CGraphRowDownsampler::AddRow, &rows, _1), "SELECT Speed, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					rows.GetRows(result);
 					if (result.size() > 0)
 					{
 						std::vector<std::vector<std::string> >::const_iterator itt;
@@ -14057,7 +14528,9 @@ namespace http {
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					CGraphRowDownsampler rows(maxStreamPoints, 1);
+					m_sql.safe_queryRows(boost::bind(&CGraphRowDownsampler::AddRow, &rows, _1), "SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					rows.GetRows(result);
 					if (result.size() > 0)
 					{
 						std::vector<std::vector<std::string> >::const_iterator itt;
@@ -14129,7 +14602,9 @@ namespace http {
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Direction, Speed, Gust, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					CGraphRowDownsampler rows(maxStreamPoints, 3);
+					m_sql.safe_queryRows(boost::bind(&CGraphRowDownsampler::AddRow, &rows, _1), "SELECT Direction, Speed, Gust, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					rows.GetRows(result);
 					if (result.size() > 0)
 					{
 						std::vector<std::vector<std::string> >::const_iterator itt;
@@ -17006,41 +17481,73 @@ namespace http {
 					}
 				}
 			}//custom range
+
+			if (bDownsample)
+			{
+				_eDownsampleMethod method = (request::findValue(&req, "downsample") == "minmax") ? DOWNSAMPLE_MINMAX : DOWNSAMPLE_LTTB;
+				if (root.isMember("result"))
+					DownsampleGraphResult(root["result"], (size_t)maxPoints, method);
+				if (root.isMember("resultprev"))
+					DownsampleGraphResult(root["resultprev"], (size_t)maxPoints, method);
+			}
 		}
 
+		std::map<std::string, CWebServer::_tCachedSession> CWebServer::m_sessionCache;
+		boost::mutex CWebServer::m_sessionCacheMutex;
+
 		/**
 		 * Retrieve user session from store, without remote host.
+		 * Sessions are kept in memory after the first lookup, so authenticated requests do not hit the database.
 		 */
 		const WebEmStoredSession CWebServer::GetSession(const std::string & sessionId) {
-			//_log.Log(LOG_STATUS, "SessionStore : get...");
-			WebEmStoredSession session;
-
 			if (sessionId.empty()) {
 				_log.Log(LOG_ERROR, "SessionStore : cannot get session without id.");
+				return WebEmStoredSession();
 			}
-			else {
-				std::vector<std::vector<std::string> > result;
-				result = m_sql.safe_query("SELECT SessionID, Username, AuthToken, ExpirationDate FROM UserSessions WHERE SessionID = '%q'",
-					sessionId.c_str());
-				if (result.size() > 0) {
-					session.id = result[0][0].c_str();
-					session.username = base64_decode(result[0][1]);
-					session.auth_token = result[0][2].c_str();
-
-					std::string sExpirationDate = result[0][3];
-					time_t now = mytime(NULL);
-					struct tm tExpirationDate;
-					ParseSQLdatetime(session.expires, tExpirationDate, sExpirationDate);
-					// RemoteHost is not used to restore the session
-					// LastUpdate is not used to restore the session
+			{
+				boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+				std::map<std::string, _tCachedSession>::const_iterator itt = m_sessionCache.find(sessionId);
+				if (itt != m_sessionCache.end())
+					return itt->second.session;
+			}
+			WebEmStoredSession session = LoadSession(sessionId);
+			if (!session.id.empty()) {
+				boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+				if (m_sessionCache.find(sessionId) == m_sessionCache.end()) {
+					_tCachedSession csession;
+					csession.session = session;
+					csession.bDirty = false;
+					m_sessionCache[sessionId] = csession;
 				}
 			}
+			return session;
+		}
+
+		const WebEmStoredSession CWebServer::LoadSession(const std::string & sessionId) {
+			//_log.Log(LOG_STATUS, "SessionStore : get...");
+			WebEmStoredSession session;
+
+			std::vector<std::vector<std::string> > result;
+			result = m_sql.safe_query("SELECT SessionID, Username, AuthToken, ExpirationDate FROM UserSessions WHERE SessionID = '%q'",
+				sessionId.c_str());
+			if (result.size() > 0) {
+				session.id = result[0][0].c_str();
+				session.username = base64_decode(result[0][1]);
+				session.auth_token = result[0][2].c_str();
+
+				std::string sExpirationDate = result[0][3];
+				struct tm tExpirationDate;
+				ParseSQLdatetime(session.expires, tExpirationDate, sExpirationDate);
+				// RemoteHost is not used to restore the session
+				// LastUpdate is not used to restore the session
+			}
 
 			return session;
 		}
 
 		/**
 		 * Save user session.
+		 * New sessions are written immediately, updates of known sessions are written by FlushSessions.
 		 */
 		void CWebServer::StoreSession(const WebEmStoredSession & session) {
 			//_log.Log(LOG_STATUS, "SessionStore : store...");
@@ -17049,6 +17556,27 @@ namespace http {
 				return;
 			}
 
+			{
+				boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+				std::map<std::string, _tCachedSession>::iterator itt = m_sessionCache.find(session.id);
+				if (itt != m_sessionCache.end()) {
+					itt->second.session = session;
+					itt->second.bDirty = true;
+					return;
+				}
+			}
+
+			bool bExists = !LoadSession(session.id).id.empty();
+			WriteSession(session, bExists);
+
+			boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+			_tCachedSession csession;
+			csession.session = session;
+			csession.bDirty = false;
+			m_sessionCache[session.id] = csession;
+		}
+
+		void CWebServer::WriteSession(const WebEmStoredSession & session, const bool bExists) {
 			char szExpires[30];
 			struct tm ltime;
 			localtime_r(&session.expires, &ltime);
@@ -17057,8 +17585,7 @@ namespace http {
 			std::string remote_host = (session.remote_host.size() <= 50) ? // IPv4 : 15, IPv6 : (39|45)
 				session.remote_host : session.remote_host.substr(0, 50);
 
-			WebEmStoredSession storedSession = GetSession(session.id);
-			if (storedSession.id.empty()) {
+			if (!bExists) {
 				m_sql.safe_query(
 					"INSERT INTO UserSessions (SessionID, Username, AuthToken, ExpirationDate, RemoteHost) VALUES ('%q', '%q', '%q', '%q', '%q')",
 					session.id.c_str(),
@@ -17077,6 +17604,30 @@ namespace http {
 			}
 		}
 
+		/**
+		 * Write the pending session updates in one transaction.
+		 */
+		void CWebServer::FlushSessions() {
+			std::vector<WebEmStoredSession> sessions;
+			{
+				boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+				std::map<std::string, _tCachedSession>::iterator itt;
+				for (itt = m_sessionCache.begin(); itt != m_sessionCache.end(); ++itt) {
+					if (!itt->second.bDirty)
+						continue;
+					sessions.push_back(itt->second.session);
+					itt->second.bDirty = false;
+				}
+			}
+			if (sessions.empty())
+				return;
+			CSQLScopedTransaction transaction(m_sql);
+			std::vector<WebEmStoredSession>::const_iterator itt;
+			for (itt = sessions.begin(); itt != sessions.end(); ++itt) {
+				WriteSession(*itt, true);
+			}
+		}
+
 		/**
 		 * Remove user session and expired sessions.
 		 */
@@ -17085,6 +17636,10 @@ namespace http {
 			if (sessionId.empty()) {
 				return;
 			}
+			{
+				boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+				m_sessionCache.erase(sessionId);
+			}
 			m_sql.safe_query(
 				"DELETE FROM UserSessions WHERE SessionID = '%q'",
 				sessionId.c_str());
@@ -17095,6 +17650,18 @@ namespace http {
 		 */
 		void CWebServer::CleanSessions() {
 			//_log.Log(LOG_STATUS, "SessionStore : clean...");
+			FlushSessions();
+			{
+				boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+				time_t now = mytime(NULL);
+				std::map<std::string, _tCachedSession>::iterator itt = m_sessionCache.begin();
+				while (itt != m_sessionCache.end()) {
+					if (itt->second.session.expires < now)
+						m_sessionCache.erase(itt++);
+					else
+						++itt;
+				}
+			}
 			m_sql.safe_query(
 				"DELETE FROM UserSessions WHERE ExpirationDate < datetime('now', 'localtime')");
 		}
@@ -17107,6 +17674,17 @@ namespace http {
 		 * because the username will be unknown (see cWebemRequestHandler::checkAuthToken).
 		 */
 		void CWebServer::RemoveUsersSessions(const std::string& username, const WebEmSession & exceptSession) {
+			{
+				boost::lock_guard<boost::mutex> l(m_sessionCacheMutex);
+				std::map<std::string, _tCachedSession>::iterator itt = m_sessionCache.begin();
+				while (itt != m_sessionCache.end()) {
+					const WebEmStoredSession &csession = itt->second.session;
+					if ((itt->first != exceptSession.id) && (base64_encode((const unsigned char*)csession.username.c_str(), csession.username.size()) == username))
+						m_sessionCache.erase(itt++);
+					else
+						++itt;
+				}
+			}
 			m_sql.safe_query("DELETE FROM UserSessions WHERE (Username=='%q') and (SessionID!='%q')", username.c_str(), exceptSession.id.c_str());
 		}
 
@@ -43,8 +43,10 @@ public:
 	void GetJSonPage(WebEmSession & session, const request& req, reply & rep);
 	void GetAppCache(WebEmSession & session, const request& req, reply & rep);
 	void GetCameraSnapshot(WebEmSession & session, const request& req, reply & rep);
+	void GetCameraMJPEG(WebEmSession & session, const request& req, reply & rep);
 	void GetInternalCameraSnapshot(WebEmSession & session, const request& req, reply & rep);
 	void GetDatabaseBackup(WebEmSession & session, const request& req, reply & rep);
+	void GetMetrics(WebEmSession & session, const request& req, reply & rep);
 	void Post_UploadCustomIcon(WebEmSession & session, const request& req, reply & rep);
 
 	void PostSettings(WebEmSession & session, const request& req, std::string & redirect_uri);
@@ -98,6 +100,7 @@ public:
 	void StoreSession(const WebEmStoredSession & session);
 	void RemoveSession(const std::string & sessionId);
 	void CleanSessions();
+	void FlushSessions();
 	void RemoveUsersSessions(const std::string& username, const WebEmSession & exceptSession);
 	std::string PluginHardwareDesc(int HwdID);
 
@@ -165,6 +168,7 @@ private:
 	void Cmd_AllowNewHardware(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetLog(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_ClearLog(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetNotificationStats(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_AddPlan(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_UpdatePlan(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_DeletePlan(WebEmSession & session, const request& req, Json::Value &root);
@@ -292,6 +296,7 @@ private:
 	void RType_TextLog(WebEmSession & session, const request& req, Json::Value &root);
 	void RType_SceneLog(WebEmSession & session, const request& req, Json::Value &root);
 	void RType_Settings(WebEmSession & session, const request& req, Json::Value &root);
+	void RType_Metrics(WebEmSession & session, const request& req, Json::Value &root);
 	void RType_Events(WebEmSession & session, const request& req, Json::Value &root);
 	void RType_Hardware(WebEmSession & session, const request& req, Json::Value &root);
 	void RType_Devices(WebEmSession & session, const request& req, Json::Value &root);
@@ -377,6 +382,17 @@ private:
 	std::map<int, int> m_custom_light_icons_lookup;
 	bool m_bDoStop;
 	std::string m_server_alias;
+
+	// UserSessions cache, shared by the plain and secure server because they use the same table
+	struct _tCachedSession
+	{
+		WebEmStoredSession session;
+		bool bDirty; // expiration/token changed, not yet written
+	};
+	static std::map<std::string, _tCachedSession> m_sessionCache;
+	static boost::mutex m_sessionCacheMutex;
+	const WebEmStoredSession LoadSession(const std::string & sessionId);
+	void WriteSession(const WebEmStoredSession & session, const bool bExists);
 };
 
 } //server
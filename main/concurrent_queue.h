@@ -38,11 +38,26 @@ public:
 		the_condition_variable.notify_one();
 	}
 
+	template<typename Iterator>
+	void push(Iterator first, Iterator last) {
+		boost::mutex::scoped_lock lock(the_mutex);
+		for (; first != last; ++first) {
+			the_queue.push(*first);
+		}
+		lock.unlock();
+		the_condition_variable.notify_all();
+	}
+
 	bool empty() const {
 		boost::mutex::scoped_lock lock(the_mutex);
 		return the_queue.empty();
 	}
 
+	size_t size() const {
+		boost::mutex::scoped_lock lock(the_mutex);
+		return the_queue.size();
+	}
+
 	bool try_pop(Data& popped_value) {
 		boost::mutex::scoped_lock lock(the_mutex);
 		if(the_queue.empty()) {
@@ -119,4 +134,137 @@ public:
 	}
 };
 
+/*
+ * Queue of pre-allocated elements, linked through their own 'next' member.
+ * Elements are taken from (and returned to) a free list, so once the pool has grown
+ * to the peak queue depth, push and pop do not allocate memory anymore.
+ * Data should have a 'Data *next' member.
+ */
+template<typename Data>
+class concurrent_pooled_queue : private boost::noncopyable {
+private:
+	Data *the_head;
+	Data *the_tail;
+	Data *the_free_list;
+	size_t the_pool_size;
+	size_t the_size;
+	mutable boost::mutex the_mutex;
+	mutable boost::mutex the_free_mutex;
+	boost::condition_variable the_condition_variable;
+
+	struct queue_not_empty {
+		Data *& head;
+
+		explicit queue_not_empty(Data *& head_): head(head_) {}
+
+		bool operator()() const {
+			return (head != NULL);
+		}
+	};
+
+public:
+	concurrent_pooled_queue() : the_head(NULL), the_tail(NULL), the_free_list(NULL), the_pool_size(0), the_size(0) {
+	}
+
+	~concurrent_pooled_queue() {
+		Data *element;
+		while ((element = the_head) != NULL) {
+			the_head = element->next;
+			delete element;
+		}
+		while ((element = the_free_list) != NULL) {
+			the_free_list = element->next;
+			delete element;
+		}
+	}
+
+	// get an element from the pool, to be filled and pushed
+	Data *allocate() {
+		boost::mutex::scoped_lock lock(the_free_mutex);
+		Data *element = the_free_list;
+		if (element != NULL) {
+			the_free_list = element->next;
+		}
+		else {
+			element = new Data();
+			the_pool_size++;
+		}
+		element->next = NULL;
+		return element;
+	}
+
+	// return a popped (or never pushed) element to the pool
+	void release(Data *element) {
+		boost::mutex::scoped_lock lock(the_free_mutex);
+		element->next = the_free_list;
+		the_free_list = element;
+	}
+
+	size_t pool_size() const {
+		boost::mutex::scoped_lock lock(the_free_mutex);
+		return the_pool_size;
+	}
+
+	void push(Data *element) {
+		boost::mutex::scoped_lock lock(the_mutex);
+		element->next = NULL;
+		if (the_tail != NULL) {
+			the_tail->next = element;
+		}
+		else {
+			the_head = element;
+		}
+		the_tail = element;
+		the_size++;
+		lock.unlock();
+		the_condition_variable.notify_one();
+	}
+
+	// push a linked chain of elements at once, they will be popped in order without interleaving
+	void push_chain(Data *first, Data *last) {
+		boost::mutex::scoped_lock lock(the_mutex);
+		last->next = NULL;
+		if (the_tail != NULL) {
+			the_tail->next = first;
+		}
+		else {
+			the_head = first;
+		}
+		the_tail = last;
+		for (Data *element = first; element != NULL; element = element->next) {
+			the_size++;
+		}
+		lock.unlock();
+		the_condition_variable.notify_one();
+	}
+
+	bool empty() const {
+		boost::mutex::scoped_lock lock(the_mutex);
+		return (the_head == NULL);
+	}
+
+	// number of pushed elements not yet popped
+	size_t size() const {
+		boost::mutex::scoped_lock lock(the_mutex);
+		return the_size;
+	}
+
+	template<typename Duration>
+	Data *timed_wait_and_pop(Duration const& wait_duration) {
+		boost::mutex::scoped_lock lock(the_mutex);
+		if(!the_condition_variable.timed_wait(lock, wait_duration, queue_not_empty(the_head))) {
+			return NULL;
+		}
+		Data *element = the_head;
+		the_head = element->next;
+		if (the_head == NULL) {
+			the_tail = NULL;
+		}
+		element->next = NULL;
+		the_size--;
+		return element;
+	}
+
+};
+
 #endif /* MAIN_CONCURRENT_QUEUE_H_ */
@@ -28,6 +28,8 @@
 #include "Helper.h"
 #include "WebServerHelper.h"
 #include "SQLHelper.h"
+#include "Metrics.h"
+#include "DeviceSnapshot.h"
 #include "../notifications/NotificationHelper.h"
 #include "appversion.h"
 #include "localtime_r.h"
@@ -158,6 +160,8 @@ std::string szAppDate="???";
 int ActYear;
 time_t m_StartTime=time(NULL);
 
+CMetrics m_metrics;
+CDeviceSnapshots m_devicesnapshots;
 MainWorker m_mainworker;
 CLogger _log;
 http::server::CWebServerHelper m_webservers;
@@ -6,6 +6,8 @@
 #include "Logger.h"
 #include "WebServerHelper.h"
 #include "SQLHelper.h"
+#include "Metrics.h"
+#include "DeviceSnapshot.h"
 #include "../push/FibaroPush.h"
 #include "../push/HttpPush.h"
 #include "../push/InfluxPush.h"
@@ -233,6 +235,7 @@ MainWorker::MainWorker()
 	m_iRevision = 0;
 
 	m_rxMessageIdx = 1;
+	m_bRxBatchActive = false;
 	m_bForceLogNotificationCheck = false;
 }
 
@@ -1087,6 +1090,11 @@ bool MainWorker::Stop()
 	}
 	if (m_thread)
 	{
+		//Do_Work starts the hardware and the event system a few seconds after Start, nothing may be started while stopping
+		m_stoprequested = true;
+		m_thread->join();
+		m_thread.reset();
+
 		m_webservers.StopServers();
 		m_sharedserver.StopServer();
 		_log.Log(LOG_STATUS, "Stopping all hardware...");
@@ -1100,12 +1108,9 @@ bool MainWorker::Stop()
 #ifdef ENABLE_PYTHON
 		m_pluginsystem.StopPluginSystem();
 #endif
+		m_notifications.Stop();
 
 		//    m_cameras.StopCameraGrabber();
-
-		m_stoprequested = true;
-		m_thread->join();
-		m_thread.reset();
 	}
 	return true;
 }
@@ -1160,6 +1165,9 @@ bool MainWorker::StartThread()
 		LoadSharedUsers();
 	}
 
+	m_metrics.GetGauge("rx_queue_depth")->SetCallback(boost::bind(&concurrent_pooled_queue<_tRxQueueItem>::size, &m_rxMessageQueue));
+	m_metrics.GetGauge("rx_queue_pool_size")->SetCallback(boost::bind(&concurrent_pooled_queue<_tRxQueueItem>::pool_size, &m_rxMessageQueue));
+
 	m_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&MainWorker::Do_Work, this)));
 	m_rxMessageThread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&MainWorker::Do_Work_On_Rx_Messages, this)));
 
@@ -1912,40 +1920,43 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase *pHardware, c
 		return;
 	}
 
-	// Build queue item
-	_tRxQueueItem rxMessage;
-	if (defaultName != NULL)
-	{
-		rxMessage.Name = defaultName;
+	if (m_stopRxMessageThread) {
+		// Server is stopping
+		return;
 	}
-	rxMessage.BatteryLevel = BatteryLevel;
-	rxMessage.rxMessageIdx = m_rxMessageIdx++;
-	rxMessage.hardwareId = pHardware->m_HwdID;
+
+	// Build queue item, frames are taken from a pool so this does not allocate memory
+	_tRxQueueItem *rxMessage = m_rxMessageQueue.allocate();
+	if (defaultName != NULL)
+		rxMessage->Name.assign(defaultName);
+	else
+		rxMessage->Name.clear();
+	rxMessage->BatteryLevel = BatteryLevel;
+	rxMessage->rxMessageIdx = m_rxMessageIdx++;
+	rxMessage->hardwareId = pHardware->m_HwdID;
 	// defensive copy of the command
-	rxMessage.vrxCommand.resize(pRXCommand[0] + 1);
-	rxMessage.vrxCommand.insert(rxMessage.vrxCommand.begin(), pRXCommand, pRXCommand + pRXCommand[0] + 1);
-	rxMessage.crc = 0x0;
+	memcpy(rxMessage->rxCommand, pRXCommand, pRXCommand[0] + 1);
+	rxMessage->crc = 0x0;
+	rxMessage->batchFlags = 0;
 #ifdef DEBUG_RXQUEUE
 	// CRC
 	boost::crc_optimal<16, 0x1021, 0xFFFF, 0, false, false> crc_ccitt2;
 	crc_ccitt2 = std::for_each(pRXCommand, pRXCommand + pRXCommand[0] + 1, crc_ccitt2);
-	rxMessage.crc = crc_ccitt2();
+	rxMessage->crc = crc_ccitt2();
 #endif
 
-	if (m_stopRxMessageThread) {
-		// Server is stopping
-		return;
-	}
-
-	// Trigger
-	rxMessage.trigger = NULL; // Should be initialized to NULL if trigger is no used
+	// Trigger, owned by this (waiting) thread
+	queue_element_trigger trigger;
+	rxMessage->trigger = NULL; // Should be initialized to NULL if trigger is no used
 	if (wait) { // add trigger to wait for the message to be processed
-		rxMessage.trigger = new queue_element_trigger();
+		rxMessage->trigger = &trigger;
 	}
-
 #ifdef DEBUG_RXQUEUE
+	// the frame can already be released by the queue worker when it is logged after the wait
+	unsigned long rxMessageIdx = rxMessage->rxMessageIdx;
+
 	_log.Log(LOG_STATUS, "RxQueue: push a rxMessage(%lu) (hrdwId=%d, hrdwType=%d, hrdwName=%s, type=%02X, subtype=%02X)",
-		rxMessage.rxMessageIdx,
+		rxMessageIdx,
 		pHardware->m_HwdID,
 		pHardware->HwdType,
 		pHardware->Name.c_str(),
@@ -1953,16 +1964,34 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase *pHardware, c
 		pRXCommand[2]);
 #endif
 
-	// Push item to queue
+	if (pHardware->m_iBatchDepth > 0)
+	{
+		if (!wait)
+		{
+			// Collect the frame, the whole batch is pushed when the hardware ends it
+			boost::lock_guard<boost::mutex> l(m_rxBatchMutex);
+			std::pair<_tRxQueueItem*, _tRxQueueItem*> &batch = m_rxBatches[pHardware->m_HwdID];
+			if (batch.second != NULL)
+				batch.second->next = rxMessage;
+			else
+				batch.first = rxMessage;
+			batch.second = rxMessage;
+			return;
+		}
+		// Keep the order, everything collected so far goes first
+		FlushRxBatch(pHardware->m_HwdID);
+	}
+
+	// Push item to queue, the frame is owned by the queue worker from now on
 	m_rxMessageQueue.push(rxMessage);
 
-	if (rxMessage.trigger != NULL) {
+	if (wait) {
 #ifdef DEBUG_RXQUEUE
-		_log.Log(LOG_STATUS, "RxQueue: wait for rxMessage(%lu) to be processed...", rxMessage.rxMessageIdx);
+		_log.Log(LOG_STATUS, "RxQueue: wait for rxMessage(%lu) to be processed...", rxMessageIdx);
 #endif
-		while (!rxMessage.trigger->timed_wait(boost::posix_time::milliseconds(1000))) {
+		while (!trigger.timed_wait(boost::posix_time::milliseconds(1000))) {
 #ifdef DEBUG_RXQUEUE
-			_log.Log(LOG_STATUS, "RxQueue: wait 1s for rxMessage(%lu) to be processed...", rxMessage.rxMessageIdx);
+			_log.Log(LOG_STATUS, "RxQueue: wait 1s for rxMessage(%lu) to be processed...", rxMessageIdx);
 #endif
 			if (m_stopRxMessageThread) {
 				// Server is stopping
@@ -1970,25 +1999,76 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase *pHardware, c
 			}
 		}
 #ifdef DEBUG_RXQUEUE
-		if (moreThanTimeout) {
-			_log.Log(LOG_STATUS, "RxQueue: rxMessage(%lu) processed", rxMessage.rxMessageIdx);
-		}
+		_log.Log(LOG_STATUS, "RxQueue: rxMessage(%lu) processed", rxMessageIdx);
 #endif
-		delete rxMessage.trigger;
 	}
 }
 
+void MainWorker::FlushRxBatch(const int HwdID)
+{
+	_tRxQueueItem *first = NULL;
+	_tRxQueueItem *last = NULL;
+	{
+		boost::lock_guard<boost::mutex> l(m_rxBatchMutex);
+		std::map<int, std::pair<_tRxQueueItem*, _tRxQueueItem*> >::iterator itt = m_rxBatches.find(HwdID);
+		if (itt == m_rxBatches.end())
+			return;
+		first = itt->second.first;
+		last = itt->second.second;
+		m_rxBatches.erase(itt);
+	}
+	if (first == NULL)
+		return;
+	if (m_stopRxMessageThread)
+	{
+		// Server is stopping
+		while (first != NULL)
+		{
+			_tRxQueueItem *next = first->next;
+			m_rxMessageQueue.release(first);
+			first = next;
+		}
+		return;
+	}
+	first->batchFlags |= RX_BATCH_START;
+	last->batchFlags |= RX_BATCH_END;
+	// One chain, processed by the queue worker as a single unit
+	m_rxMessageQueue.push_chain(first, last);
+}
+
+// Database updates and event system notifications of a batch are grouped
+void MainWorker::BeginRxBatch()
+{
+	if (m_bRxBatchActive)
+		return;
+	m_bRxBatchActive = true;
+	m_rxBatchTimer.reset(new CMetricTimer(m_metrics.GetHistogram("rx_batch")));
+	m_sql.BeginBatchTransaction();
+	m_eventsystem.BeginBatch();
+}
+
+void MainWorker::EndRxBatch()
+{
+	if (!m_bRxBatchActive)
+		return;
+	m_bRxBatchActive = false;
+	m_sql.EndBatchTransaction();
+	m_eventsystem.EndBatch();
+	m_rxBatchTimer.reset();
+}
+
 void MainWorker::UnlockRxMessageQueue()
 {
 #ifdef DEBUG_RXQUEUE
 	_log.Log(LOG_STATUS, "RxQueue: unlock queue using dummy message");
 #endif
 	// Push dummy message to unlock queue
-	_tRxQueueItem rxMessage;
-	rxMessage.rxMessageIdx = m_rxMessageIdx++;
-	rxMessage.hardwareId = -1;
-	rxMessage.trigger = NULL;
-	rxMessage.BatteryLevel = 0;
+	_tRxQueueItem *rxMessage = m_rxMessageQueue.allocate();
+	rxMessage->rxMessageIdx = m_rxMessageIdx++;
+	rxMessage->hardwareId = -1;
+	rxMessage->trigger = NULL;
+	rxMessage->BatteryLevel = 0;
+	rxMessage->batchFlags = 0;
 	m_rxMessageQueue.push(rxMessage);
 }
 
@@ -1996,6 +2076,8 @@ void MainWorker::Do_Work_On_Rx_Messages()
 {
 	_log.Log(LOG_STATUS, "RxQueue: queue worker started...");
 
+	m_sql.SetUpdateFilterThread(boost::this_thread::get_id());
+
 	m_stopRxMessageThread = false;
 	while (true) {
 		if (m_stopRxMessageThread) {
@@ -2004,77 +2086,85 @@ void MainWorker::Do_Work_On_Rx_Messages()
 		}
 
 		// Wait and pop next message or timeout
-		_tRxQueueItem rxQItem;
-		bool hasPopped = m_rxMessageQueue.timed_wait_and_pop<boost::posix_time::milliseconds>(rxQItem,
+		_tRxQueueItem *rxQItem = m_rxMessageQueue.timed_wait_and_pop<boost::posix_time::milliseconds>(
 			boost::posix_time::milliseconds(5000));// (if no message for 2 seconds, returns anyway to check m_stopRxMessageThread)
 
-		if (!hasPopped) {
+		if (rxQItem == NULL) {
 			// Timeout occurred : queue is empty
 #ifdef DEBUG_RXQUEUE
 				//_log.Log(LOG_STATUS, "RxQueue: the queue has been empty for five seconds");
 #endif
 			continue;
 		}
-		if (rxQItem.hardwareId == -1) {
-			// dummy message
+		if (rxQItem->batchFlags & RX_BATCH_START)
+			BeginRxBatch();
+		ProcessRxQueueItem(rxQItem);
+		if (rxQItem->batchFlags & RX_BATCH_END)
+			EndRxBatch();
+		m_rxMessageQueue.release(rxQItem);
+	}
+	EndRxBatch();
+
+	_log.Log(LOG_STATUS, "RxQueue: queue worker stopped...");
+}
+
+void MainWorker::ProcessRxQueueItem(_tRxQueueItem *rxQItem)
+{
+	if (rxQItem->hardwareId == -1) {
+		// dummy message
 #ifdef DEBUG_RXQUEUE
-			_log.Log(LOG_STATUS, "RxQueue: dummy message popped");
+		_log.Log(LOG_STATUS, "RxQueue: dummy message popped");
 #endif
-			continue;
-		}
-		if (rxQItem.hardwareId < 1) {
-			_log.Log(LOG_ERROR, "RxQueue: cannot process invalid hardware id: (%d)", rxQItem.hardwareId);
-			// cannot process message with invalid id or null message
-			if (rxQItem.trigger != NULL) rxQItem.trigger->popped();
-			continue;
-		}
+		return;
+	}
+	if (rxQItem->hardwareId < 1) {
+		_log.Log(LOG_ERROR, "RxQueue: cannot process invalid hardware id: (%d)", rxQItem->hardwareId);
+		// cannot process message with invalid id or null message
+		if (rxQItem->trigger != NULL) rxQItem->trigger->popped();
+		return;
+	}
 
-		const CDomoticzHardwareBase *pHardware = GetHardware(rxQItem.hardwareId);
+	const CDomoticzHardwareBase *pHardware = GetHardware(rxQItem->hardwareId);
 
-		// Check pointers
-		if (pHardware == NULL) {
-			_log.Log(LOG_ERROR, "RxQueue: cannot retrieve hardware with id: %d", rxQItem.hardwareId);
-			if (rxQItem.trigger != NULL) rxQItem.trigger->popped();
-			continue;
-		}
-		if (rxQItem.vrxCommand.empty()) {
-			_log.Log(LOG_ERROR, "RxQueue: cannot retrieve command with id: %d", rxQItem.hardwareId);
-			if (rxQItem.trigger != NULL) rxQItem.trigger->popped();
-			continue;
-		}
+	// Check pointers
+	if (pHardware == NULL) {
+		_log.Log(LOG_ERROR, "RxQueue: cannot retrieve hardware with id: %d", rxQItem->hardwareId);
+		if (rxQItem->trigger != NULL) rxQItem->trigger->popped();
+		return;
+	}
 
-		const unsigned char *pRXCommand = &rxQItem.vrxCommand[0];
+	const unsigned char *pRXCommand = rxQItem->rxCommand;
 
 #ifdef DEBUG_RXQUEUE
-		// CRC
-		boost::uint16_t crc = rxQItem.crc;
-		boost::crc_optimal<16, 0x1021, 0xFFFF, 0, false, false> crc_ccitt2;
-		crc_ccitt2 = std::for_each(pRXCommand, pRXCommand + rxQItem.vrxCommand.size(), crc_ccitt2);
-		if (crc != crc_ccitt2()) {
-			_log.Log(LOG_ERROR, "RxQueue: cannot process invalid rxMessage(%lu) from hardware with id=%d (type %d)",
-				rxQItem.rxMessageIdx,
-				rxQItem.hardwareId,
-				pHardware->HwdType);
-			if (rxQItem.trigger != NULL) rxQItem.trigger->popped();
-			continue;
-		}
+	// CRC
+	boost::uint16_t crc = rxQItem->crc;
+	boost::crc_optimal<16, 0x1021, 0xFFFF, 0, false, false> crc_ccitt2;
+	crc_ccitt2 = std::for_each(pRXCommand, pRXCommand + pRXCommand[0] + 1, crc_ccitt2);
+	if (crc != crc_ccitt2()) {
+		_log.Log(LOG_ERROR, "RxQueue: cannot process invalid rxMessage(%lu) from hardware with id=%d (type %d)",
+			rxQItem->rxMessageIdx,
+			rxQItem->hardwareId,
+			pHardware->HwdType);
+		if (rxQItem->trigger != NULL) rxQItem->trigger->popped();
+		return;
+	}
 
-		_log.Log(LOG_STATUS, "RxQueue: process a rxMessage(%lu) (hrdwId=%d, hrdwType=%d, hrdwName=%s, type=%02X, subtype=%02X)",
-			rxQItem.rxMessageIdx,
-			pHardware->m_HwdID,
-			pHardware->HwdType,
-			pHardware->Name.c_str(),
-			pRXCommand[1],
-			pRXCommand[2]);
+	_log.Log(LOG_STATUS, "RxQueue: process a rxMessage(%lu) (hrdwId=%d, hrdwType=%d, hrdwName=%s, type=%02X, subtype=%02X)",
+		rxQItem->rxMessageIdx,
+		pHardware->m_HwdID,
+		pHardware->HwdType,
+		pHardware->Name.c_str(),
+		pRXCommand[1],
+		pRXCommand[2]);
 #endif
-		ProcessRXMessage(pHardware, pRXCommand, rxQItem.Name.c_str(), rxQItem.BatteryLevel);
-		if (rxQItem.trigger != NULL)
-		{
-			rxQItem.trigger->popped();
-		}
+	{
+		CMetricTimer timer(m_metrics.GetHistogram("rx_process", "hardware", Hardware_Type_Desc(pHardware->HwdType)));
+		ProcessRXMessage(pHardware, pRXCommand, rxQItem->Name.c_str(), rxQItem->BatteryLevel);
+	}
+	if (rxQItem->trigger != NULL)
+	{
+		rxQItem->trigger->popped();
 	}
-
-	_log.Log(LOG_STATUS, "RxQueue: queue worker stopped...");
 }
 
 void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase *pHardware, const unsigned char *pRXCommand, const char *defaultName, const int BatteryLevel)
@@ -2391,6 +2481,9 @@ void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase *pHardware, const
 	//Send to connected Sharing Users
 	m_sharedserver.SendToAll(pHardware->m_HwdID, DeviceRowIdx, (const char*)pRXCommand, pRXCommand[0] + 1, pClient2Ignore);
 
+	CMetricTimer timer(m_metrics.GetHistogram("push_notify"));
+	//the first exporter that needs the device reads it, the others share that snapshot
+	m_devicesnapshots.Invalidate(DeviceRowIdx);
 	sOnDeviceReceived(pHardware->m_HwdID, DeviceRowIdx, DeviceName, pRXCommand);
 }
 
@@ -10749,7 +10842,22 @@ bool MainWorker::SetRFXCOMHardwaremodes(const int HardwareID, const unsigned cha
 	return true;
 }
 
-bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string switchcmd, int level, int hue, const bool IsTesting)
+//Queue a switch command on the transmit thread of the hardware, a newer command for the same device (DeviceID/Unit) replaces a pending one.
+//Returns false when the command was refused, pTxCompletion (optional) receives the completion to wait for the write result
+bool MainWorker::QueueSwitchCommand(CDomoticzHardwareBase *pHardware, const std::vector<std::string> &sd, const std::vector<std::string> &frames, boost::shared_ptr<CTxCompletion> *pTxCompletion)
+{
+	boost::shared_ptr<CTxCompletion> completion = pHardware->QueueWrite(frames, sd[1] + "/" + sd[2]);
+	if (pTxCompletion != NULL)
+		*pTxCompletion = completion;
+	if ((completion->IsDone()) && (!completion->Wait()))
+	{
+		_log.Log(LOG_ERROR, "Switch command not send!, Hardware %s did not accept it", pHardware->Name.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string switchcmd, int level, int hue, const bool IsTesting, boost::shared_ptr<CTxCompletion> *pTxCompletion)
 {
 	unsigned long ID;
 	std::stringstream s_strid;
@@ -11017,6 +11125,8 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 		if (level > 31)
 			level = 31;
 		lcmd.LIGHTING5.level = (unsigned char)level;
+		//frames are sent by the transmit thread of the hardware, paced per protocol
+		std::vector<std::string> frames;
 		if (dSubType == sTypeLivolo)
 		{
 			if ((switchcmd == "Set Level") && (level == 0))
@@ -11029,8 +11139,7 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 				//Special Case, turn off first
 				unsigned char oldCmd = lcmd.LIGHTING5.cmnd;
 				lcmd.LIGHTING5.cmnd = light5_sLivoloAllOff;
-				if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.LIGHTING5)))
-					return false;
+				frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.LIGHTING5)));
 				lcmd.LIGHTING5.cmnd = oldCmd;
 			}
 			if (switchcmd == "Set Level")
@@ -11038,14 +11147,12 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 				//dim value we have to send multiple times
 				for (int iDim = 0; iDim < level; iDim++)
 				{
-					if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.LIGHTING5)))
-						return false;
+					frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.LIGHTING5)));
 				}
 			}
 			else
 			{
-				if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.LIGHTING5)))
-					return false;
+				frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.LIGHTING5)));
 			}
 		}
 		else if ((dSubType == sTypeTRC02) || (dSubType == sTypeTRC02_2))
@@ -11065,18 +11172,14 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 				//Special Case, turn off first
 				unsigned char oldCmd = lcmd.LIGHTING5.cmnd;
 				lcmd.LIGHTING5.cmnd = light5_sRGBoff;
-				if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.LIGHTING5)))
-					return false;
+				frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.LIGHTING5)));
 				lcmd.LIGHTING5.cmnd = oldCmd;
-				sleep_milliseconds(100);
 			}
 			if ((switchcmd == "On") || (switchcmd == "Set Color"))
 			{
 				//turn on
 				lcmd.LIGHTING5.cmnd = light5_sRGBon;
-				if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.LIGHTING5)))
-					return false;
-				sleep_milliseconds(100);
+				frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.LIGHTING5)));
 
 				if (switchcmd == "Set Color")
 				{
@@ -11085,17 +11188,17 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 						double dval;
 						dval = (78.0 / 255.0)*float(oldlevel);
 						lcmd.LIGHTING5.cmnd = light5_sRGBcolormin + 1 + round(dval);
-						if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.LIGHTING5)))
-							return false;
+						frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.LIGHTING5)));
 					}
 				}
 			}
 		}
 		else
 		{
-			if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.LIGHTING5)))
-				return false;
+			frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.LIGHTING5)));
 		}
+		if (!QueueSwitchCommand(m_hardwaredevices[hindex], sd, frames, pTxCompletion))
+			return false;
 		if (!IsTesting) {
 			//send to internal for now (later we use the ACK)
 			PushAndWaitRxMessage(m_hardwaredevices[hindex], (const unsigned char *)&lcmd, NULL, -1);
@@ -11188,6 +11291,7 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 		lcmd.subtype = dSubType;
 		lcmd.id = ID;
 		lcmd.dunit = Unit;
+		std::vector<std::string> frames;
 
 		if ((switchcmd == "On") || (switchcmd == "Set Level"))
 		{
@@ -11212,16 +11316,15 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 				{
 					lcmd2.command = Limitless_SetColorToWhite;
 				}
-				if (!WriteToHardware(HardwareID, (const char*)&lcmd2, sizeof(_tLimitlessLights)))
-					return false;
-				sleep_milliseconds(100);
+				frames.push_back(std::string((const char*)&lcmd2, sizeof(_tLimitlessLights)));
 			}
 		}
 
 		lcmd.value = level;
 		if (!GetLightCommand(dType, dSubType, switchtype, switchcmd, lcmd.command, options))
 			return false;
-		if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(_tLimitlessLights)))
+		frames.push_back(std::string((const char*)&lcmd, sizeof(_tLimitlessLights)));
+		if (!QueueSwitchCommand(m_hardwaredevices[hindex], sd, frames, pTxCompletion))
 			return false;
 		if (!IsTesting) {
 			//send to internal for now (later we use the ACK)
@@ -11249,11 +11352,10 @@ bool MainWorker::SwitchLightInt(const std::vector<std::string> &sd, std::string
 		{
 			if (!GetLightCommand(dType, dSubType, switchtype, switchcmd, lcmd.SECURITY1.status, options))
 				return false;
-			//send it twice
-			if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.SECURITY1)))
-				return false;
-			sleep_milliseconds(500);
-			if (!WriteToHardware(HardwareID, (const char*)&lcmd, sizeof(lcmd.SECURITY1)))
+			//sent twice by the transmit thread (pacing rule)
+			std::vector<std::string> frames;
+			frames.push_back(std::string((const char*)&lcmd, sizeof(lcmd.SECURITY1)));
+			if (!QueueSwitchCommand(m_hardwaredevices[hindex], sd, frames, pTxCompletion))
 				return false;
 			if (!IsTesting) {
 				//send to internal for now (later we use the ACK)
@@ -12255,54 +12357,57 @@ bool MainWorker::SwitchScene(const std::string &idx, const std::string &switchcm
 	return SwitchScene(ID, switchcmd);
 }
 
-//returns if a device activates a scene
-bool MainWorker::DoesDeviceActiveAScene(const uint64_t DevRowIdx, const int Cmnd)
+//returns the devices that activate a scene with their command, -1 when any command does (groups, or no code)
+void MainWorker::GetSceneActivators(std::multimap<uint64_t, int> &activators)
 {
-	//check for scene code
+	activators.clear();
 	std::vector<std::vector<std::string> > result;
 	std::vector<std::vector<std::string> >::const_iterator itt;
 
 	result = m_sql.safe_query("SELECT Activators, SceneType FROM Scenes WHERE (Activators!='')");
-	if (result.size() > 0)
+	for (itt = result.begin(); itt != result.end(); ++itt)
 	{
-		for (itt = result.begin(); itt != result.end(); ++itt)
-		{
-			std::vector<std::string> sd = *itt;
-
-			int SceneType = atoi(sd[1].c_str());
+		std::vector<std::string> sd = *itt;
 
-			std::vector<std::string> arrayActivators;
-			StringSplit(sd[0], ";", arrayActivators);
-			std::vector<std::string>::const_iterator ittAct;
-			for (ittAct = arrayActivators.begin(); ittAct != arrayActivators.end(); ++ittAct)
-			{
-				std::string sCodeCmd = *ittAct;
+		int SceneType = atoi(sd[1].c_str());
 
-				std::vector<std::string> arrayCode;
-				StringSplit(sCodeCmd, ":", arrayCode);
+		std::vector<std::string> arrayActivators;
+		StringSplit(sd[0], ";", arrayActivators);
+		std::vector<std::string>::const_iterator ittAct;
+		for (ittAct = arrayActivators.begin(); ittAct != arrayActivators.end(); ++ittAct)
+		{
+			std::string sCodeCmd = *ittAct;
 
-				std::string sID = arrayCode[0];
-				std::string sCode = "";
-				if (arrayCode.size() == 2)
-				{
-					sCode = arrayCode[1];
-				}
+			std::vector<std::string> arrayCode;
+			StringSplit(sCodeCmd, ":", arrayCode);
 
-				uint64_t aID;
-				std::stringstream sstr;
-				sstr << sID;
-				sstr >> aID;
-				if (aID == DevRowIdx)
-				{
-					if ((SceneType == SGTYPE_GROUP) || (sCode.empty()))
-						return true;
-					int iCode = atoi(sCode.c_str());
-					if (iCode == Cmnd)
-						return true;
-				}
+			std::string sID = arrayCode[0];
+			std::string sCode = "";
+			if (arrayCode.size() == 2)
+			{
+				sCode = arrayCode[1];
 			}
+
+			uint64_t aID;
+			std::stringstream sstr;
+			sstr << sID;
+			sstr >> aID;
+			int iCode = ((SceneType == SGTYPE_GROUP) || (sCode.empty())) ? -1 : atoi(sCode.c_str());
+			activators.insert(std::pair<uint64_t, int>(aID, iCode));
 		}
 	}
+}
+
+//returns if a device activates a scene
+bool MainWorker::DoesDeviceActiveAScene(const uint64_t DevRowIdx, const int Cmnd, const std::multimap<uint64_t, int> &activators)
+{
+	std::pair<std::multimap<uint64_t, int>::const_iterator, std::multimap<uint64_t, int>::const_iterator> range = activators.equal_range(DevRowIdx);
+	std::multimap<uint64_t, int>::const_iterator itt;
+	for (itt = range.first; itt != range.second; ++itt)
+	{
+		if ((itt->second == -1) || (itt->second == Cmnd))
+			return true;
+	}
 	return false;
 }
 
@@ -12385,11 +12490,20 @@ bool MainWorker::SwitchScene(const uint64_t idx, std::string switchcmd)
 		bEventTrigger = m_eventsystem.UpdateSceneGroup(idx, nValue, szLastUpdate);
 
 	//now switch all attached devices, and only the onces that do not trigger a scene
+	//all members are resolved in one query, grouped per hardware and each group is switched by the transmit thread of its hardware
+	struct timeval tvStart;
+	getclock(&tvStart);
+
 	result = m_sql.safe_query(
-		"SELECT DeviceRowID, Cmd, Level, Hue, OnDelay, OffDelay FROM SceneDevices WHERE (SceneRowID == %" PRIu64 ") ORDER BY [Order] ASC", idx);
+		"SELECT A.DeviceRowID, A.Cmd, A.Level, A.Hue, A.OnDelay, A.OffDelay, B.HardwareID, B.DeviceID, B.Unit, B.Type, B.SubType, B.SwitchType, B.nValue, B.sValue, B.Name "
+		"FROM SceneDevices AS A, DeviceStatus AS B WHERE (A.SceneRowID == %" PRIu64 ") AND (B.ID == A.DeviceRowID) ORDER BY A.[Order] ASC", idx);
 	if (result.size() < 1)
 		return true; //no devices in the scene
 
+	std::multimap<uint64_t, int> activators;
+	GetSceneActivators(activators);
+
+	std::map<int, std::vector<_tSceneDeviceAction> > hardwareActions;
 	std::vector<std::vector<std::string> >::const_iterator itt;
 	for (itt = result.begin(); itt != result.end(); ++itt)
 	{
@@ -12400,104 +12514,141 @@ bool MainWorker::SwitchScene(const uint64_t idx, std::string switchcmd)
 		int hue = atoi(sd[3].c_str());
 		int ondelay = atoi(sd[4].c_str());
 		int offdelay = atoi(sd[5].c_str());
-		std::vector<std::vector<std::string> > result2;
-		result2 = m_sql.safe_query(
-			"SELECT HardwareID, DeviceID,Unit,Type,SubType,SwitchType, nValue, sValue, Name FROM DeviceStatus WHERE (ID == '%q')", sd[0].c_str());
-		if (result2.size() > 0)
-		{
-			std::vector<std::string> sd2 = result2[0];
-			unsigned char rnValue = atoi(sd2[6].c_str());
-			std::string sValue = sd2[7];
-			unsigned char Unit = atoi(sd2[2].c_str());
-			unsigned char dType = atoi(sd2[3].c_str());
-			unsigned char dSubType = atoi(sd2[4].c_str());
-			std::string DeviceName = sd2[8];
-			_eSwitchType switchtype = (_eSwitchType)atoi(sd2[5].c_str());
-
-			//Check if this device will not activate a scene
-			uint64_t dID;
-			std::stringstream sdID;
-			sdID << sd[0];
-			sdID >> dID;
-			if (DoesDeviceActiveAScene(dID, cmd))
-			{
-				_log.Log(LOG_ERROR, "Skipping sensor '%s' because this triggers another scene!", DeviceName.c_str());
-				continue;
-			}
+		int HardwareID = atoi(sd[6].c_str());
+		std::string sValue = sd[13];
+		unsigned char dType = atoi(sd[9].c_str());
+		unsigned char dSubType = atoi(sd[10].c_str());
+		std::string DeviceName = sd[14];
+		_eSwitchType switchtype = (_eSwitchType)atoi(sd[11].c_str());
+
+		//Check if this device will not activate a scene
+		uint64_t dID;
+		std::stringstream sdID;
+		sdID << sd[0];
+		sdID >> dID;
+		if (DoesDeviceActiveAScene(dID, cmd, activators))
+		{
+			_log.Log(LOG_ERROR, "Skipping sensor '%s' because this triggers another scene!", DeviceName.c_str());
+			continue;
+		}
 
-			std::string lstatus = switchcmd;
-			int llevel = 0;
-			bool bHaveDimmer = false;
-			bool bHaveGroupCmd = false;
-			int maxDimLevel = 0;
+		std::string lstatus = switchcmd;
+		int llevel = 0;
+		bool bHaveDimmer = false;
+		bool bHaveGroupCmd = false;
+		int maxDimLevel = 0;
 
-			GetLightStatus(dType, dSubType, switchtype, cmd, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
+		GetLightStatus(dType, dSubType, switchtype, cmd, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
 
-			if (scenetype == SGTYPE_GROUP)
-			{
-				lstatus = ((switchcmd == "On") || (switchcmd == "Group On") || (switchcmd == "Chime") || (switchcmd == "All On")) ? "On" : "Off";
-			}
-			_log.Log(LOG_NORM, "Activating Scene/Group Device: %s (%s)", DeviceName.c_str(), lstatus.c_str());
+		if (scenetype == SGTYPE_GROUP)
+		{
+			lstatus = ((switchcmd == "On") || (switchcmd == "Group On") || (switchcmd == "Chime") || (switchcmd == "All On")) ? "On" : "Off";
+		}
+		_log.Log(LOG_NORM, "Activating Scene/Group Device: %s (%s)", DeviceName.c_str(), lstatus.c_str());
 
 
-			int ilevel = maxDimLevel - 1;
+		int ilevel = maxDimLevel - 1;
 
-			if (
-				((switchtype == STYPE_Dimmer) ||
-				(switchtype == STYPE_BlindsPercentage) ||
-					(switchtype == STYPE_BlindsPercentageInverted) ||
-					(switchtype == STYPE_Selector)
-					) && (maxDimLevel != 0))
+		if (
+			((switchtype == STYPE_Dimmer) ||
+			(switchtype == STYPE_BlindsPercentage) ||
+				(switchtype == STYPE_BlindsPercentageInverted) ||
+				(switchtype == STYPE_Selector)
+				) && (maxDimLevel != 0))
+		{
+			if (lstatus == "On")
 			{
-				if (lstatus == "On")
-				{
-					lstatus = "Set Level";
-					float fLevel = (maxDimLevel / 100.0f)*level;
-					if (fLevel > 100)
-						fLevel = 100;
-					ilevel = round(fLevel) + 1;
+				lstatus = "Set Level";
+				float fLevel = (maxDimLevel / 100.0f)*level;
+				if (fLevel > 100)
+					fLevel = 100;
+				ilevel = round(fLevel) + 1;
+			}
+			if (switchtype == STYPE_Selector) {
+				if (lstatus != "Set Level") {
+					ilevel = 0;
 				}
-				if (switchtype == STYPE_Selector) {
-					if (lstatus != "Set Level") {
-						ilevel = 0;
-					}
-					ilevel = round(ilevel / 10.0f) * 10; // select only multiples of 10
-					if (ilevel == 0) {
-						lstatus = "Off";
-					}
+				ilevel = round(ilevel / 10.0f) * 10; // select only multiples of 10
+				if (ilevel == 0) {
+					lstatus = "Off";
 				}
 			}
+		}
 
-			int idx = atoi(sd[0].c_str());
-			if (switchtype != STYPE_PushOn)
+		std::vector<_tSceneDeviceAction> &actions = hardwareActions[HardwareID];
+		_tSceneDeviceAction action;
+		action.idx = atoi(sd[0].c_str());
+		action.level = ilevel;
+		action.hue = hue;
+		if (switchtype != STYPE_PushOn)
+		{
+			action.switchcmd = lstatus;
+			action.delay = (lstatus == "Off") ? offdelay : ondelay;
+			if (m_sql.m_bEnableEventSystem && !bEventTrigger)
+				m_eventsystem.SetEventTrigger(action.idx, m_eventsystem.REASON_DEVICE, static_cast<float>(action.delay));
+			actions.push_back(action);
+			if (scenetype == SGTYPE_SCENE)
 			{
-				int delay = (lstatus == "Off") ? offdelay : ondelay;
-				if (m_sql.m_bEnableEventSystem && !bEventTrigger)
-					m_eventsystem.SetEventTrigger(idx, m_eventsystem.REASON_DEVICE, static_cast<float>(delay));
-				SwitchLight(idx, lstatus, ilevel, hue, false, delay);
-				if (scenetype == SGTYPE_SCENE)
+				if ((lstatus != "Off") && (offdelay > 0))
 				{
-					if ((lstatus != "Off") && (offdelay > 0))
-					{
-						//switch with on delay, and off delay
-						if (m_sql.m_bEnableEventSystem && !bEventTrigger)
-							m_eventsystem.SetEventTrigger(idx, m_eventsystem.REASON_DEVICE, static_cast<float>(ondelay + offdelay));
-						SwitchLight(idx, "Off", ilevel, hue, false, ondelay + offdelay);
-					}
+					//switch with on delay, and off delay
+					action.switchcmd = "Off";
+					action.delay = ondelay + offdelay;
+					if (m_sql.m_bEnableEventSystem && !bEventTrigger)
+						m_eventsystem.SetEventTrigger(action.idx, m_eventsystem.REASON_DEVICE, static_cast<float>(action.delay));
+					actions.push_back(action);
 				}
 			}
-			else
+		}
+		else
+		{
+			action.switchcmd = "On";
+			action.delay = ondelay;
+			if (m_sql.m_bEnableEventSystem && !bEventTrigger)
+				m_eventsystem.SetEventTrigger(action.idx, m_eventsystem.REASON_DEVICE, static_cast<float>(action.delay));
+			actions.push_back(action);
+		}
+	}
+
+	//in scene order per hardware, with a short pause between devices
+	std::vector<boost::shared_ptr<CTxCompletion> > completions;
+	std::map<int, std::vector<_tSceneDeviceAction> >::const_iterator ittHardware;
+	for (ittHardware = hardwareActions.begin(); ittHardware != hardwareActions.end(); ++ittHardware)
+	{
+		CDomoticzHardwareBase *pHardware = GetHardware(ittHardware->first);
+		const std::vector<_tSceneDeviceAction> &actions = ittHardware->second;
+		std::vector<_tSceneDeviceAction>::const_iterator ittAction;
+		for (ittAction = actions.begin(); ittAction != actions.end(); ++ittAction)
+		{
+			if (pHardware == NULL)
 			{
-				if (m_sql.m_bEnableEventSystem && !bEventTrigger)
-					m_eventsystem.SetEventTrigger(idx, m_eventsystem.REASON_DEVICE, static_cast<float>(ondelay));
-				SwitchLight(idx, "On", ilevel, hue, false, ondelay);
+				//hardware disabled or not found, SwitchLight reports it
+				SwitchSceneDevice(*ittAction);
+				continue;
 			}
-			sleep_milliseconds(50);
+			long gap = (((ittAction + 1) != actions.end()) && ((ittAction + 1)->idx != ittAction->idx)) ? 50 : 0;
+			completions.push_back(pHardware->QueueCall(boost::bind(&MainWorker::SwitchSceneDevice, this, *ittAction), gap));
 		}
 	}
+	std::vector<boost::shared_ptr<CTxCompletion> >::const_iterator ittCompletion;
+	for (ittCompletion = completions.begin(); ittCompletion != completions.end(); ++ittCompletion)
+		(*ittCompletion)->Wait();
+
+	struct timeval tvEnd, tvDiff;
+	getclock(&tvEnd);
+	timeval_subtract(&tvDiff, &tvEnd, &tvStart);
+	uint64_t usec = ((uint64_t)tvDiff.tv_sec * 1000000) + tvDiff.tv_usec;
+	m_metrics.GetHistogram("scene_activation")->Record(usec);
+	_log.Log(LOG_NORM, "Scene/Group [%s] activated in %d ms (%d hardware)", Name.c_str(), (int)(usec / 1000), (int)hardwareActions.size());
 	return true;
 }
 
+//Switches one scene device, called by the transmit thread of its hardware
+bool MainWorker::SwitchSceneDevice(const _tSceneDeviceAction &action)
+{
+	return SwitchLight(action.idx, action.switchcmd, action.level, action.hue, false, action.delay);
+}
+
 void MainWorker::CheckSceneCode(const uint64_t DevRowIdx, const unsigned char dType, const unsigned char dSubType, const int nValue, const char* sValue)
 {
 	//check for scene code
@@ -13072,6 +13223,7 @@ bool MainWorker::UpdateDevice(const int HardwareID, const std::string &DeviceID,
 	// signal connected devices (MQTT, fibaro, http push ... ) about the web update
 	if ((pHardware) && (parseTrigger))
 	{
+		m_devicesnapshots.Invalidate(devidx);
 		sOnDeviceReceived(pHardware->m_HwdID, devidx, devname, NULL);
 	}
 
@@ -15,6 +15,13 @@
 #	include "../hardware/plugins/PluginManager.h"
 #endif
 
+//the first byte of a message holds its length, so a message never exceeds 256 bytes (>= sizeof(tRBUF))
+#define RX_FRAME_SIZE 256
+#define RX_BATCH_START 0x01
+#define RX_BATCH_END 0x02
+
+class CMetricTimer;
+
 enum eVerboseLevel
 {
 	EVBL_None = 0,
@@ -42,6 +49,7 @@ public:
 	CDomoticzHardwareBase* GetHardware(int HwdId);
 	CDomoticzHardwareBase* GetHardwareByIDType(const std::string &HwdId, const _eHardwareTypes HWType);
 	CDomoticzHardwareBase* GetHardwareByType(const _eHardwareTypes HWType);
+	void FlushRxBatch(const int HwdID);
 
 	void HeartbeatUpdate(const std::string &component);
 	void HeartbeatRemove(const std::string &component);
@@ -61,12 +69,13 @@ public:
 
 	bool SwitchLight(const std::string &idx, const std::string &switchcmd,const std::string &level, const std::string &hue, const std::string &ooc, const int ExtraDelay);
 	bool SwitchLight(const uint64_t idx, const std::string &switchcmd, const int level, const int hue, const bool ooc, const int ExtraDelay);
-	bool SwitchLightInt(const std::vector<std::string> &sd, std::string switchcmd, int level, int hue, const bool IsTesting);
+	//pTxCompletion is set for protocols written by the transmit thread of the hardware (Lighting5, LimitlessLights, Security1 KD101/SA30),
+	//wait on it for the result of the write. It is left empty when the command was written before returning
+	bool SwitchLightInt(const std::vector<std::string> &sd, std::string switchcmd, int level, int hue, const bool IsTesting, boost::shared_ptr<CTxCompletion> *pTxCompletion = NULL);
 
 	bool SwitchScene(const std::string &idx, const std::string &switchcmd);
 	bool SwitchScene(const uint64_t idx, std::string switchcmd);
 	void CheckSceneCode(const uint64_t DevRowIdx, const unsigned char dType, const unsigned char dSubType, const int nValue, const char* sValue);
-	bool DoesDeviceActiveAScene(const uint64_t DevRowIdx, const int Cmnd);
 
 	bool SetSetPoint(const std::string &idx, const float TempValue);
 	bool SetSetPoint(const std::string &idx, const float TempValue, const int newMode, const std::string &until);
@@ -192,6 +201,17 @@ private:
 	void SendResetCommand(CDomoticzHardwareBase *pHardware);
 	void SendCommand(const int HwdID, unsigned char Cmd, const char *szMessage=NULL);
 	bool WriteToHardware(const int HwdID, const char *pdata, const unsigned char length);
+	struct _tSceneDeviceAction {
+		int idx;
+		std::string switchcmd;
+		int level;
+		int hue;
+		int delay;
+	};
+	bool SwitchSceneDevice(const _tSceneDeviceAction &action);
+	void GetSceneActivators(std::multimap<uint64_t, int> &activators);
+	bool DoesDeviceActiveAScene(const uint64_t DevRowIdx, const int Cmnd, const std::multimap<uint64_t, int> &activators);
+	bool QueueSwitchCommand(CDomoticzHardwareBase *pHardware, const std::vector<std::string> &sd, const std::vector<std::string> &frames, boost::shared_ptr<CTxCompletion> *pTxCompletion);
 
 	void OnHardwareConnected(CDomoticzHardwareBase *pHardware);
 
@@ -210,16 +230,26 @@ private:
 	boost::shared_ptr<boost::thread> m_rxMessageThread;
 	void Do_Work_On_Rx_Messages();
 	struct _tRxQueueItem {
-		std::string Name;
+		_tRxQueueItem *next;
+		std::string Name; //items are reused, so the capacity of the string is reused too
 		int BatteryLevel;
 		unsigned long rxMessageIdx;
 		int hardwareId;
-		std::vector<unsigned char> vrxCommand;
+		unsigned char rxCommand[RX_FRAME_SIZE];
 		boost::uint16_t crc;
+		unsigned char batchFlags;
 		queue_element_trigger* trigger;
 	};
-	concurrent_queue<_tRxQueueItem> m_rxMessageQueue;
+	concurrent_pooled_queue<_tRxQueueItem> m_rxMessageQueue;
+	//frames collected while a hardware is in batch mode, per hardware id (first, last)
+	std::map<int, std::pair<_tRxQueueItem*, _tRxQueueItem*> > m_rxBatches;
+	boost::mutex m_rxBatchMutex;
+	bool m_bRxBatchActive;
+	boost::shared_ptr<CMetricTimer> m_rxBatchTimer; //rx_batch, from the first frame of a batch to its commit
+	void BeginRxBatch();
+	void EndRxBatch();
 	void UnlockRxMessageQueue();
+	void ProcessRxQueueItem(_tRxQueueItem *rxQItem);
 	void PushRxMessage(const CDomoticzHardwareBase *pHardware, const unsigned char *pRXCommand, const char *defaultName, const int BatteryLevel);
 	void CheckAndPushRxMessage(const CDomoticzHardwareBase *pHardware, const unsigned char *pRXCommand, const char *defaultName, const int BatteryLevel, const bool wait);
 	void ProcessRXMessage(const CDomoticzHardwareBase *pHardware, const unsigned char *pRXCommand, const char *defaultName, const int BatteryLevel); //battery level: 0-100, 255=no battery, -1 = don't set
@@ -3,6 +3,7 @@
 #include "../main/SQLHelper.h"
 #include "../main/Logger.h"
 #include "../main/Helper.h"
+#include "../main/localtime_r.h"
 #include "../httpclient/UrlEncode.h"
 #include "../webserver/Base64.h"
 
@@ -12,12 +13,17 @@ typedef std::map<std::string, int* >::iterator it_conf_type_int;
 CNotificationBase::CNotificationBase(const std::string &subsystemid, const int options):
 _subsystemid(subsystemid),
 _options(options),
-m_IsEnabled(1)
+m_IsEnabled(1),
+m_stoprequested(false)
 {
+	memset(&m_Stats, 0, sizeof(m_Stats));
 }
 
 CNotificationBase::~CNotificationBase()
 {
+	//The thread calls the derived SendMessageImplementation, it has to be stopped before the derived part is gone
+	//(CNotificationHelper::Stop, or the derived destructor)
+	assert(!m_background_task_thread);
 }
 
 void CNotificationBase::SetupConfig(const std::string &Key, std::string& Value)
@@ -128,6 +134,161 @@ bool CNotificationBase::SendMessageEx(
 	return bRet;
 }
 
+bool CNotificationBase::QueueMessage(
+	const uint64_t Idx,
+	const std::string &Name,
+	const std::string &Subject,
+	const std::string &Text,
+	const std::string &ExtraData,
+	const int Priority,
+	const std::string &Sound,
+	const bool bFromNotification)
+{
+	if ((bFromNotification) && (!m_IsEnabled))
+		return true; //not enabled
+
+	boost::lock_guard<boost::mutex> l(m_background_task_mutex);
+
+	//Skip a message that is still waiting to be delivered
+	std::deque<_tQueueItem>::const_iterator itt;
+	for (itt = m_background_task_queue.begin(); itt != m_background_task_queue.end(); ++itt)
+	{
+		if ((itt->Idx == Idx) && (itt->Subject == Subject) && (itt->Text == Text) && (itt->ExtraData == ExtraData))
+		{
+			m_Stats.Deduplicated++;
+			return true;
+		}
+	}
+	if (m_background_task_queue.size() >= NOTIFICATION_MAX_QUEUE)
+	{
+		_log.Log(LOG_ERROR, "Notification (%s): Queue full, dropping oldest message!", _subsystemid.c_str());
+		m_background_task_queue.pop_front();
+		m_Stats.Dropped++;
+	}
+
+	_tQueueItem item;
+	item.Idx = Idx;
+	item.Name = Name;
+	item.Subject = Subject;
+	item.Text = Text;
+	item.ExtraData = ExtraData;
+	item.Priority = Priority;
+	item.Sound = Sound;
+	item.bFromNotification = bFromNotification;
+	item.Retries = 0;
+	item.NextTry = 0;
+	item.QueueTime = boost::posix_time::microsec_clock::universal_time();
+	m_background_task_queue.push_back(item);
+	m_background_task_cond.notify_one();
+	return true;
+}
+
+bool CNotificationBase::StartThread()
+{
+	StopThread();
+	m_stoprequested = false;
+	m_background_task_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CNotificationBase::Do_Work, this)));
+	return (m_background_task_thread != NULL);
+}
+
+void CNotificationBase::StopThread()
+{
+	if (m_background_task_thread)
+	{
+		{
+			boost::lock_guard<boost::mutex> l(m_background_task_mutex);
+			m_stoprequested = true;
+		}
+		m_background_task_cond.notify_one();
+		m_background_task_thread->join();
+		m_background_task_thread.reset();
+	}
+}
+
+_tNotificationQueueStats CNotificationBase::GetQueueStats()
+{
+	boost::lock_guard<boost::mutex> l(m_background_task_mutex);
+	_tNotificationQueueStats stats = m_Stats;
+	stats.Queued = static_cast<int>(m_background_task_queue.size());
+	return stats;
+}
+
+void CNotificationBase::Do_Work()
+{
+	boost::unique_lock<boost::mutex> lock(m_background_task_mutex);
+	while (!m_stoprequested)
+	{
+		time_t atime = mytime(NULL);
+		while ((!m_SendTimes.empty()) && (difftime(atime, m_SendTimes.front()) >= 60))
+			m_SendTimes.pop_front();
+
+		//Find a message that is due, or else the time the next one will be
+		time_t nextTry = 0;
+		std::deque<_tQueueItem>::iterator itt = m_background_task_queue.end();
+		if (m_SendTimes.size() >= NOTIFICATION_RATE_LIMIT)
+		{
+			//rate limited, leave the messages queued
+			nextTry = m_SendTimes.front() + 60;
+		}
+		else
+		{
+			for (itt = m_background_task_queue.begin(); itt != m_background_task_queue.end(); ++itt)
+			{
+				if (itt->NextTry <= atime)
+					break;
+				if ((nextTry == 0) || (itt->NextTry < nextTry))
+					nextTry = itt->NextTry;
+			}
+		}
+		if (itt == m_background_task_queue.end())
+		{
+			//QueueMessage and StopThread wake us up
+			if (nextTry == 0)
+				m_background_task_cond.wait(lock);
+			else
+				m_background_task_cond.timed_wait(lock, boost::posix_time::seconds(static_cast<long>(nextTry - atime)));
+			continue;
+		}
+
+		_tQueueItem item = *itt;
+		m_background_task_queue.erase(itt);
+		if (!IsConfigured())
+		{
+			m_Stats.Dropped++;
+			continue;
+		}
+		m_SendTimes.push_back(atime);
+
+		lock.unlock();
+		bool bRet = SendMessageEx(item.Idx, item.Name, item.Subject, item.Text, item.ExtraData, item.Priority, item.Sound, item.bFromNotification);
+		lock.lock();
+
+		if (bRet)
+		{
+			boost::posix_time::time_duration latency = boost::posix_time::microsec_clock::universal_time() - item.QueueTime;
+			m_Stats.LastLatency = static_cast<unsigned long>(latency.total_milliseconds());
+			m_Stats.AvgLatency = (m_Stats.Sent == 0) ? m_Stats.LastLatency : static_cast<unsigned long>((m_Stats.AvgLatency * 9 + m_Stats.LastLatency) / 10);
+			m_Stats.Sent++;
+			m_Stats.LastSent = mytime(NULL);
+		}
+		else if (item.Retries < NOTIFICATION_MAX_RETRIES)
+		{
+			int delay = NOTIFICATION_RETRY_DELAY << item.Retries;
+			_log.Log(LOG_STATUS, "Notification (%s): Retrying in %d seconds...", _subsystemid.c_str(), delay);
+			item.Retries++;
+			item.NextTry = mytime(NULL) + delay;
+			m_background_task_queue.push_back(item);
+			m_Stats.Retried++;
+		}
+		else
+		{
+			_log.Log(LOG_ERROR, "Notification (%s): Giving up after %d retries!", _subsystemid.c_str(), item.Retries);
+			m_Stats.Failed++;
+			m_Stats.LastFailed = mytime(NULL);
+		}
+	}
+}
+
 void CNotificationBase::SetConfigValue(const std::string &Key, const std::string &Value)
 {
 	for (it_conf_type iter = _configValues.begin(); iter != _configValues.end(); ++iter) {
@@ -1,6 +1,8 @@
 #pragma once
 #include "../webserver/cWebem.h"
 #include "../webserver/request.hpp"
+#include <deque>
+#include <boost/thread/condition_variable.hpp>
 
 #define OPTIONS_NONE 0
 #define OPTIONS_URL_SUBJECT 1
@@ -9,8 +11,29 @@
 #define OPTIONS_HTML_BODY 8
 #define OPTIONS_URL_PARAMS 16
 
+//queued messages are retried with an increasing delay (10, 20, 40 seconds)
+#define NOTIFICATION_MAX_RETRIES 3
+#define NOTIFICATION_RETRY_DELAY 10
+//maximum number of messages sent per subsystem per minute
+#define NOTIFICATION_RATE_LIMIT 30
+#define NOTIFICATION_MAX_QUEUE 100
+
 using namespace http::server;
 
+struct _tNotificationQueueStats
+{
+	int Queued;
+	unsigned long Sent;
+	unsigned long Failed;
+	unsigned long Retried;
+	unsigned long Deduplicated;
+	unsigned long Dropped;
+	unsigned long LastLatency; //ms, from queued to delivered
+	unsigned long AvgLatency; //ms
+	time_t LastSent;
+	time_t LastFailed;
+};
+
 class CNotificationBase {
 	friend class CNotificationHelper;
 protected:
@@ -54,8 +77,45 @@ protected:
 		const bool bFromNotification) = 0;
 	void LoadConfig();
 
+	bool QueueMessage(
+		const uint64_t Idx,
+		const std::string &Name,
+		const std::string &Subject,
+		const std::string &Text,
+		const std::string &ExtraData,
+		const int Priority,
+		const std::string &Sound,
+		const bool bFromNotification);
+	bool StartThread();
+	void StopThread();
+	_tNotificationQueueStats GetQueueStats();
+
 	int m_IsEnabled;
 private:
+	struct _tQueueItem
+	{
+		uint64_t Idx;
+		std::string Name;
+		std::string Subject;
+		std::string Text;
+		std::string ExtraData;
+		int Priority;
+		std::string Sound;
+		bool bFromNotification;
+		int Retries;
+		time_t NextTry;
+		boost::posix_time::ptime QueueTime;
+	};
+	void Do_Work();
+
+	boost::shared_ptr<boost::thread> m_background_task_thread;
+	boost::mutex m_background_task_mutex;
+	boost::condition_variable m_background_task_cond;
+	std::deque<_tQueueItem> m_background_task_queue;
+	std::deque<time_t> m_SendTimes;
+	_tNotificationQueueStats m_Stats;
+	volatile bool m_stoprequested;
+
 	boost::mutex SendMessageExMutex;
 	std::string _subsystemid;
 	std::map<std::string, std::string* > _configValues;
@@ -3,6 +3,7 @@
 #include "../main/Helper.h"
 #include "../main/SQLHelper.h"
 #include "../main/localtime_r.h"
+#include "../main/RFXtrx.h"
 #include "../hardware/hardwaretypes.h"
 #include "NotificationHelper.h"
 #include "NotificationProwl.h"
@@ -36,6 +37,7 @@ CNotificationHelper::CNotificationHelper()
 {
 	m_NotificationSwitchInterval = 0;
 	m_NotificationSensorInterval = 12 * 3600;
+	m_deviceinfoGeneration = 0;
 
 	/* more notifiers can be added here */
 
@@ -57,6 +59,7 @@ CNotificationHelper::CNotificationHelper()
 
 CNotificationHelper::~CNotificationHelper()
 {
+	Stop();
 	for (it_noti_type iter = m_notifiers.begin(); iter != m_notifiers.end(); ++iter) {
 		delete iter->second;
 	}
@@ -65,6 +68,16 @@ CNotificationHelper::~CNotificationHelper()
 void CNotificationHelper::Init()
 {
 	ReloadNotifications();
+	for (it_noti_type iter = m_notifiers.begin(); iter != m_notifiers.end(); ++iter) {
+		iter->second->StartThread();
+	}
+}
+
+void CNotificationHelper::Stop()
+{
+	for (it_noti_type iter = m_notifiers.begin(); iter != m_notifiers.end(); ++iter) {
+		iter->second->StopThread();
+	}
 }
 
 void CNotificationHelper::AddNotifier(CNotificationBase *notifier)
@@ -133,7 +146,7 @@ bool CNotificationHelper::SendMessageEx(
 		if ((ActiveSystems.empty() || ittSystem != ActiveSystems.end()) && iter->second->IsConfigured())
 		{
 			if (bThread)
-				boost::thread SendMessageEx(boost::bind(&CNotificationBase::SendMessageEx, iter->second, Idx, Name, Subject, Text, ExtraData, Priority, Sound, bFromNotification));
+				iter->second->QueueMessage(Idx, Name, Subject, Text, ExtraData, Priority, Sound, bFromNotification);
 			else
 				bRet |= iter->second->SendMessageEx(Idx, Name, Subject, Text, ExtraData, Priority, Sound, bFromNotification);
 		}
@@ -155,6 +168,16 @@ void CNotificationHelper::ConfigFromGetvars(const request& req, const bool save)
 	}
 }
 
+std::map<std::string, _tNotificationQueueStats> CNotificationHelper::GetQueueStats()
+{
+	std::map<std::string, _tNotificationQueueStats> ret;
+	for (it_noti_type iter = m_notifiers.begin(); iter != m_notifiers.end(); ++iter) {
+		if (iter->second->IsConfigured())
+			ret[iter->first] = iter->second->GetQueueStats();
+	}
+	return ret;
+}
+
 bool CNotificationHelper::IsInConfig(const std::string &Key)
 {
 	for (it_noti_type iter = m_notifiers.begin(); iter != m_notifiers.end(); ++iter) {
@@ -196,7 +219,7 @@ std::string CNotificationHelper::ParseCustomMessage(const std::string &cMessage,
 	return ret;
 }
 
-bool CNotificationHelper::ApplyRule(std::string rule, bool equal, bool less)
+bool CNotificationHelper::ApplyRule(const std::string &rule, bool equal, bool less)
 {
 	if (((rule == ">") || (rule == ">=")) && (!less) && (!equal))
 		return true;
@@ -252,13 +275,11 @@ bool CNotificationHelper::CheckAndHandleTempHumidityNotification(
 			bRecoveryMessage = CustomRecoveryMessage(itt->ID, recoverymsg, true);
 			if ((atime < itt->LastSend) && (!itt->SendAlways) && (!bRecoveryMessage))
 				continue;
-			std::vector<std::string> splitresults;
-			StringSplit(itt->Params, ";", splitresults);
-			if (splitresults.size() < 3)
+			if (itt->ParamCount < 3)
 				continue; //impossible
-			std::string ntype = splitresults[0];
+			const std::string &ntype = itt->RuleType;
 			std::string custommsg;
-			float svalue = static_cast<float>(atof(splitresults[2].c_str()));
+			float svalue = itt->RuleFValue;
 			bool bSendNotification = false;
 			bool bCustomMessage = false;
 			bCustomMessage = CustomRecoveryMessage(itt->ID, custommsg, false);
@@ -279,10 +300,10 @@ bool CNotificationHelper::CheckAndHandleTempHumidityNotification(
 				else if (temp > 10.0) szExtraData += "Image=temp-10-15|";
 				else if (temp > 5.0) szExtraData += "Image=temp-5-10|";
 				else szExtraData += "Image=temp48|";
-				bSendNotification = ApplyRule(splitresults[1], (temp == svalue), (temp < svalue));
+				bSendNotification = ApplyRule(itt->RuleOperator, (temp == svalue), (temp < svalue));
 				if (bSendNotification && (!bRecoveryMessage || itt->SendAlways))
 				{
-					sprintf(szTmp, "%s temperature is %.1f %s [%s %.1f %s]", devicename.c_str(), temp, ltemp.c_str(), splitresults[1].c_str(), svalue, ltemp.c_str());
+					sprintf(szTmp, "%s temperature is %.1f %s [%s %.1f %s]", devicename.c_str(), temp, ltemp.c_str(), itt->RuleOperator.c_str(), svalue, ltemp.c_str());
 					msg = szTmp;
 					sprintf(szTmp, "%.1f", temp);
 					notValue = szTmp;
@@ -303,10 +324,10 @@ bool CNotificationHelper::CheckAndHandleTempHumidityNotification(
 			{
 				//humidity
 				szExtraData += "Image=moisture48|";
-				bSendNotification = ApplyRule(splitresults[1], (humidity == svalue), (humidity < svalue));
+				bSendNotification = ApplyRule(itt->RuleOperator, (humidity == svalue), (humidity < svalue));
 				if (bSendNotification && (!bRecoveryMessage || itt->SendAlways))
 				{
-					sprintf(szTmp, "%s Humidity is %d %% [%s %.0f %%]", devicename.c_str(), humidity, splitresults[1].c_str(), svalue);
+					sprintf(szTmp, "%s Humidity is %d %% [%s %.0f %%]", devicename.c_str(), humidity, itt->RuleOperator.c_str(), svalue);
 					msg = szTmp;
 					sprintf(szTmp, "%d", humidity);
 					notValue = szTmp;
@@ -370,13 +391,10 @@ bool CNotificationHelper::CheckAndHandleDewPointNotification(
 			TouchLastUpdate(itt->ID);
 		if ((atime >= itt->LastSend) || (itt->SendAlways)) //emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(itt->Params, ";", splitresults);
-			if (splitresults.size() < 1)
+			if (itt->ParamCount < 1)
 				continue; //impossible
-			std::string ntype = splitresults[0];
 
-			if (ntype == signdewpoint)
+			if (itt->RuleType == signdewpoint)
 			{
 				//dewpoint
 				if (temp <= dewpoint)
@@ -425,14 +443,11 @@ bool CNotificationHelper::CheckAndHandleValueNotification(
 			TouchLastUpdate(itt->ID);
 		if ((atime >= itt->LastSend) || (itt->SendAlways)) //emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(itt->Params, ";", splitresults);
-			if (splitresults.size() < 2)
+			if (itt->ParamCount < 2)
 				continue; //impossible
-			std::string ntype = splitresults[0];
-			int svalue = static_cast<int>(atoi(splitresults[1].c_str()));
+			int svalue = static_cast<int>(atoi(itt->RuleOperator.c_str()));
 
-			if (ntype == signvalue)
+			if (itt->RuleType == signvalue)
 			{
 				if (value > svalue)
 				{
@@ -492,14 +507,12 @@ bool CNotificationHelper::CheckAndHandleAmpere123Notification(
 			bRecoveryMessage = CustomRecoveryMessage(itt->ID, recoverymsg, true);
 			if ((atime < itt->LastSend) && (!itt->SendAlways) && (!bRecoveryMessage))
 				continue;
-			std::vector<std::string> splitresults;
-			StringSplit(itt->Params, ";", splitresults);
-			if (splitresults.size() < 3)
+			if (itt->ParamCount < 3)
 				continue; //impossible
-			std::string ntype = splitresults[0];
+			const std::string &ntype = itt->RuleType;
 			std::string custommsg;
 			std::string ltype;
-			float svalue = static_cast<float>(atof(splitresults[2].c_str()));
+			float svalue = itt->RuleFValue;
 			float ampere = 0.0f;
 			bool bSendNotification = false;
 			bool bCustomMessage = false;
@@ -520,10 +533,10 @@ bool CNotificationHelper::CheckAndHandleAmpere123Notification(
 				ampere = Ampere3;
 				ltype = Notification_Type_Desc(NTYPE_AMPERE3, 0);
 			}
-			bSendNotification = ApplyRule(splitresults[1], (ampere == svalue), (ampere < svalue));
+			bSendNotification = ApplyRule(itt->RuleOperator, (ampere == svalue), (ampere < svalue));
 			if (bSendNotification && (!bRecoveryMessage || itt->SendAlways))
 			{
-				sprintf(szTmp, "%s %s is %.1f Ampere [%s %.1f Ampere]", devicename.c_str(), ltype.c_str(), ampere, splitresults[1].c_str(), svalue);
+				sprintf(szTmp, "%s %s is %.1f Ampere [%s %.1f Ampere]", devicename.c_str(), ltype.c_str(), ampere, itt->RuleOperator.c_str(), svalue);
 				msg = szTmp;
 				sprintf(szTmp, "%.1f", ampere);
 				notValue = szTmp;
@@ -565,12 +578,11 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	if (notifications.size() == 0)
 		return false;
 
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
-	if (result.size() == 0)
+	_tNotificationDeviceInfo dinfo;
+	if (!GetDeviceInfo(Idx, dinfo))
 		return false;
 
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
+	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + dinfo.SwitchType + "|CustomImage=" + dinfo.CustomImage + "|";
 	std::string notValue;
 
 	time_t atime = mytime(NULL);
@@ -584,12 +596,9 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	{
 		if (itt->LastUpdate)
 			TouchLastUpdate(itt->ID);
-		std::vector<std::string> splitresults;
-		StringSplit(itt->Params, ";", splitresults);
-		if (splitresults.size() < 1)
+		if (itt->ParamCount < 1)
 			continue; //impossible
-		std::string atype = splitresults[0];
-		if (atype == ltype)
+		if (itt->RuleType == ltype)
 		{
 			if ((atime >= itt->LastSend) || (itt->SendAlways)) //emergency always goes true
 			{
@@ -626,11 +635,10 @@ bool CNotificationHelper::CheckAndHandleNotification(
 		sprintf(szTmp, "%.1f", mvalue);
 	pvalue = szTmp;
 
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
-	if (result.size() == 0)
+	_tNotificationDeviceInfo dinfo;
+	if (!GetDeviceInfo(Idx, dinfo))
 		return false;
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|";
+	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + dinfo.SwitchType + "|";
 
 	time_t atime = mytime(NULL);
 
@@ -656,23 +664,21 @@ bool CNotificationHelper::CheckAndHandleNotification(
 			bRecoveryMessage = CustomRecoveryMessage(itt->ID, recoverymsg, true);
 			if ((atime < itt->LastSend) && (!itt->SendAlways) && (!bRecoveryMessage))
 				continue;
-			std::vector<std::string> splitresults;
-			StringSplit(itt->Params, ";", splitresults);
-			if (splitresults.size() < 3)
+			if (itt->ParamCount < 3)
 				continue; //impossible
-			std::string ntype = splitresults[0];
+			const std::string &ntype = itt->RuleType;
 			std::string custommsg;
-			float svalue = static_cast<float>(atof(splitresults[2].c_str()));
+			float svalue = itt->RuleFValue;
 			bool bSendNotification = false;
 			bool bCustomMessage = false;
 			bCustomMessage = CustomRecoveryMessage(itt->ID, custommsg, false);
 
 			if (ntype == nsign)
 			{
-				bSendNotification = ApplyRule(splitresults[1], (mvalue == svalue), (mvalue < svalue));
+				bSendNotification = ApplyRule(itt->RuleOperator, (mvalue == svalue), (mvalue < svalue));
 				if (bSendNotification && (!bRecoveryMessage || itt->SendAlways))
 				{
-					sprintf(szTmp, "%s %s is %s %s [%s %.1f %s]", devicename.c_str(), ltype.c_str(), pvalue.c_str(), label.c_str(), splitresults[1].c_str(), svalue, label.c_str());
+					sprintf(szTmp, "%s %s is %s %s [%s %.1f %s]", devicename.c_str(), ltype.c_str(), pvalue.c_str(), label.c_str(), itt->RuleOperator.c_str(), svalue, label.c_str());
 					msg = szTmp;
 				}
 				else if (!bSendNotification && bRecoveryMessage)
@@ -712,14 +718,11 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	if (notifications.size() == 0)
 		return false;
 
-	std::vector<std::vector<std::string> > result;
-
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
-		Idx);
-	if (result.size() == 0)
+	_tNotificationDeviceInfo dinfo;
+	if (!GetDeviceInfo(Idx, dinfo))
 		return false;
-	_eSwitchType switchtype = (_eSwitchType)atoi(result[0][0].c_str());
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
+	_eSwitchType switchtype = (_eSwitchType)atoi(dinfo.SwitchType.c_str());
+	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + dinfo.SwitchType + "|CustomImage=" + dinfo.CustomImage + "|";
 
 	std::string msg = "";
 
@@ -733,11 +736,9 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	{
 		if ((atime >= itt->LastSend) || (itt->SendAlways)) //emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(itt->Params, ";", splitresults);
-			if (splitresults.size() < 1)
+			if (itt->ParamCount < 1)
 				continue; //impossible
-			std::string atype = splitresults[0];
+			const std::string &atype = itt->RuleType;
 
 			bool bSendNotification = false;
 			std::string notValue;
@@ -817,15 +818,12 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	std::vector<_tNotification> notifications = GetNotifications(Idx);
 	if (notifications.size() == 0)
 		return false;
-	std::vector<std::vector<std::string> > result;
-
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage, Options FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
-		Idx);
-	if (result.size() == 0)
+	_tNotificationDeviceInfo dinfo;
+	if (!GetDeviceInfo(Idx, dinfo))
 		return false;
-	_eSwitchType switchtype = (_eSwitchType)atoi(result[0][0].c_str());
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
-	std::string sOptions = result[0][2].c_str();
+	_eSwitchType switchtype = (_eSwitchType)atoi(dinfo.SwitchType.c_str());
+	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + dinfo.SwitchType + "|CustomImage=" + dinfo.CustomImage + "|";
+	const std::string &sOptions = dinfo.Options;
 
 	std::string msg = "";
 
@@ -839,11 +837,9 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	{
 		if ((atime >= itt->LastSend) || (itt->SendAlways)) //emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(itt->Params, ";", splitresults);
-			if (splitresults.size() < 1)
+			if (itt->ParamCount < 1)
 				continue; //impossible
-			std::string atype = splitresults[0];
+			const std::string &atype = itt->RuleType;
 
 			bool bSendNotification = false;
 			std::string notValue;
@@ -853,10 +849,10 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 				msg = devicename;
 				if (ntype == NTYPE_SWITCH_ON)
 				{
-					if (splitresults.size() < 3)
+					if (itt->ParamCount < 3)
 						continue; //impossible
-					bool bWhenEqual = (splitresults[1] == "=");
-					int iLevel = atoi(splitresults[2].c_str());
+					bool bWhenEqual = (itt->RuleOperator == "=");
+					int iLevel = atoi(itt->RuleValue.c_str());
 					if (!bWhenEqual || iLevel < 10 || iLevel > 100)
 						continue; //invalid
 
@@ -910,45 +906,29 @@ bool CNotificationHelper::CheckAndHandleRainNotification(
 	const _eNotificationTypes ntype,
 	const float mvalue)
 {
-	std::vector<std::vector<std::string> > result;
-
-	result = m_sql.safe_query("SELECT AddjValue,AddjMulti FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
-		Idx);
-	if (result.size() == 0)
+	if (!HasNotifications(Idx))
 		return false;
-	//double AddjValue = atof(result[0][0].c_str());
-	double AddjMulti = atof(result[0][1].c_str());
 
-	char szDateEnd[40];
-
-	time_t now = mytime(NULL);
-	struct tm tm1;
-	localtime_r(&now, &tm1);
-	struct tm ltime;
-	ltime.tm_isdst = tm1.tm_isdst;
-//GB3:	Use a midday hour to avoid a clash with possible DST jump
-	ltime.tm_hour=14;
-	ltime.tm_min = 0;
-	ltime.tm_sec = 0;
-	ltime.tm_year = tm1.tm_year;
-	ltime.tm_mon = tm1.tm_mon;
-	ltime.tm_mday = tm1.tm_mday;
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+	_tNotificationDeviceInfo dinfo;
+	if (!GetDeviceInfo(Idx, dinfo))
+		return false;
+	double AddjMulti = dinfo.AddjMulti;
 
 	if (subType != sTypeRAINWU)
 	{
-		result = m_sql.safe_query("SELECT MIN(Total) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')",
-			Idx, szDateEnd);
-		if (result.size() > 0)
+		float total_min = 0;
+		std::string szDate = GetRainDate();
 		{
-			std::vector<std::string> sd = result[0];
-
-			float total_min = static_cast<float>(atof(sd[0].c_str()));
-			float total_max = mvalue;
-			double total_real = total_max - total_min;
-			total_real *= AddjMulti;
-			CheckAndHandleNotification(Idx, devicename, devType, subType, NTYPE_RAIN, (float)total_real);
+			boost::lock_guard<boost::mutex> l(m_mutex);
+			std::map<uint64_t, _tNotificationRainTotal>::const_iterator itt = m_raintotals.find(Idx);
+			//no rain logged yet today counts as zero, like the MIN(Total) query on an empty day did
+			if ((itt != m_raintotals.end()) && (itt->second.Date == szDate))
+				total_min = itt->second.MinTotal;
 		}
+		float total_max = mvalue;
+		double total_real = total_max - total_min;
+		total_real *= AddjMulti;
+		CheckAndHandleNotification(Idx, devicename, devType, subType, NTYPE_RAIN, (float)total_real);
 	}
 	else
 	{
@@ -968,6 +948,7 @@ void CNotificationHelper::CheckAndHandleLastUpdateNotification()
 
 	time_t atime = mytime(NULL);
 	atime -= m_NotificationSensorInterval;
+	std::string ttype = Notification_Type_Desc(NTYPE_LASTUPDATE, 1);
 	std::map<uint64_t, std::vector<_tNotification> >::const_iterator itt;
 
 	for (itt = m_notifications.begin(); itt != m_notifications.end(); ++itt)
@@ -977,12 +958,9 @@ void CNotificationHelper::CheckAndHandleLastUpdateNotification()
 		{
 			if (((atime >= itt2->LastSend) || (itt2->SendAlways) || (!itt2->CustomMessage.empty())) && (itt2->LastUpdate)) //emergency always goes true
 			{
-				std::vector<std::string> splitresults;
-				StringSplit(itt2->Params, ";", splitresults);
-				if (splitresults.size() < 3)
+				if (itt2->ParamCount < 3)
 					continue;
-				std::string ttype = Notification_Type_Desc(NTYPE_LASTUPDATE, 1);
-				if (splitresults[0] == ttype)
+				if (itt2->RuleType == ttype)
 				{
 					std::string recoverymsg;
 					bool bRecoveryMessage = false;
@@ -995,10 +973,10 @@ void CNotificationHelper::CheckAndHandleLastUpdateNotification()
 					std::string szExtraData;
 					std::string custommsg;
 					uint64_t Idx = itt->first;
-					uint32_t SensorTimeOut = static_cast<uint32_t>(atoi(splitresults[2].c_str()));  // minutes
+					uint32_t SensorTimeOut = static_cast<uint32_t>(atoi(itt2->RuleValue.c_str()));  // minutes
 					uint32_t diff = static_cast<uint32_t>(round(difftime(btime, itt2->LastUpdate)));
 					bool bStartTime = (difftime(btime, m_StartTime) < SensorTimeOut * 60);
-					bool bSendNotification = ApplyRule(splitresults[1], (diff == SensorTimeOut * 60), (diff < SensorTimeOut * 60));
+					bool bSendNotification = ApplyRule(itt2->RuleOperator, (diff == SensorTimeOut * 60), (diff < SensorTimeOut * 60));
 					bool bCustomMessage = false;
 					bCustomMessage = CustomRecoveryMessage(itt2->ID, custommsg, false);
 
@@ -1006,11 +984,10 @@ void CNotificationHelper::CheckAndHandleLastUpdateNotification()
 					{
 						if (SystemUptime() < SensorTimeOut * 60 && (!bRecoveryMessage || itt2->SendAlways))
 							continue;
-						std::vector<std::vector<std::string> > result;
-						result = m_sql.safe_query("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
-						if (result.size() == 0)
+						_tNotificationDeviceInfo dinfo;
+						if (!GetDeviceInfo(Idx, dinfo))
 							continue;
-						szExtraData = "|Name=" + itt2->DeviceName + "|SwitchType=" + result[0][0] + "|";
+						szExtraData = "|Name=" + itt2->DeviceName + "|SwitchType=" + dinfo.SwitchType + "|";
 						std::string ltype = Notification_Type_Desc(NTYPE_LASTUPDATE, 0);
 						std::string label = Notification_Type_Label(NTYPE_LASTUPDATE);
 						char szDate[50];
@@ -1020,7 +997,7 @@ void CNotificationHelper::CheckAndHandleLastUpdateNotification()
 						sprintf(szDate, "%04d-%02d-%02d %02d:%02d:%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday,
 							ltime.tm_hour, ltime.tm_min, ltime.tm_sec);
 						sprintf(szTmp,"Sensor %s %s: %s [%s %d %s]", itt2->DeviceName.c_str(), ltype.c_str(), szDate,
-							splitresults[1].c_str(), SensorTimeOut, label.c_str());
+							itt2->RuleOperator.c_str(), SensorTimeOut, label.c_str());
 						msg = szTmp;
 					}
 					else if (!bSendNotification && bRecoveryMessage)
@@ -1098,7 +1075,7 @@ void CNotificationHelper::TouchLastUpdate(const uint64_t ID)
 
 bool CNotificationHelper::CustomRecoveryMessage(const uint64_t ID, std::string &msg, const bool isRecovery)
 {
-	boost::lock_guard<boost::mutex> l(m_mutex);
+	boost::unique_lock<boost::mutex> l(m_mutex);
 
 	std::map<uint64_t, std::vector<_tNotification> >::iterator itt;
 	for (itt = m_notifications.begin(); itt != m_notifications.end(); ++itt)
@@ -1108,15 +1085,10 @@ bool CNotificationHelper::CustomRecoveryMessage(const uint64_t ID, std::string &
 		{
 			if (itt2->ID == ID)
 			{
+				if ((isRecovery) && (!itt2->RuleRecovery))
+					return false;
+
 				std::vector<std::string> splitresults;
-				if (isRecovery)
-				{
-					StringSplit(itt2->Params, ";", splitresults);
-					if (splitresults.size() < 4)
-						return false;
-					if (splitresults[3] != "1")
-						return false;
-				}
 
 				std::string szTmp;
 				StringSplit(itt2->CustomMessage, ";;", splitresults);
@@ -1155,13 +1127,16 @@ bool CNotificationHelper::CustomRecoveryMessage(const uint64_t ID, std::string &
 					szTmp.append(";;[Recovered] ");
 					szTmp.append(msg);
 				}
+				itt2->CustomMessage = szTmp;
+				const std::string Params = itt2->Params;
+				l.unlock();
+				//the database is not queried while m_mutex is held
 				std::vector<std::vector<std::string> > result;
-				result = m_sql.safe_query("SELECT ID FROM Notifications WHERE (ID=='%" PRIu64 "') AND (Params=='%q')", itt2->ID, itt2->Params.c_str());
+				result = m_sql.safe_query("SELECT ID FROM Notifications WHERE (ID=='%" PRIu64 "') AND (Params=='%q')", ID, Params.c_str());
 				if (result.size() == 0)
 					return false;
 
-				m_sql.safe_query("UPDATE Notifications SET CustomMessage='%q' WHERE ID=='%" PRIu64 "'", szTmp.c_str(), itt2->ID);
-				itt2->CustomMessage = szTmp;
+				m_sql.safe_query("UPDATE Notifications SET CustomMessage='%q' WHERE ID=='%" PRIu64 "'", szTmp.c_str(), ID);
 				return true;
 			}
 		}
@@ -1243,24 +1218,175 @@ bool CNotificationHelper::HasNotifications(const uint64_t DevIdx)
 	return (m_notifications.find(DevIdx) != m_notifications.end());
 }
 
+//The device info is loaded without holding m_mutex, the notification checks run on the RX thread
+bool CNotificationHelper::GetDeviceInfo(const uint64_t DevIdx, _tNotificationDeviceInfo &info)
+{
+	unsigned long generation;
+	{
+		boost::lock_guard<boost::mutex> l(m_mutex);
+		std::map<uint64_t, _tNotificationDeviceInfo>::const_iterator itt = m_deviceinfo.find(DevIdx);
+		if (itt != m_deviceinfo.end())
+		{
+			info = itt->second;
+			return true;
+		}
+		if (m_notifications.find(DevIdx) == m_notifications.end())
+			return false;
+		generation = m_deviceinfoGeneration;
+	}
+	_tNotificationRainTotal rtotal;
+	bool bHaveRainTotal = false;
+	if (!LoadDeviceInfo(DevIdx, info, rtotal, bHaveRainTotal))
+		return false;
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	if (generation != m_deviceinfoGeneration)
+		return true;
+	m_deviceinfo[DevIdx] = info;
+	if (bHaveRainTotal)
+	{
+		//UpdateRainTotal could have run in the meantime
+		std::map<uint64_t, _tNotificationRainTotal>::iterator itt = m_raintotals.find(DevIdx);
+		if ((itt == m_raintotals.end()) || (itt->second.Date != rtotal.Date))
+			m_raintotals[DevIdx] = rtotal;
+		else if (rtotal.MinTotal < itt->second.MinTotal)
+			itt->second.MinTotal = rtotal.MinTotal;
+	}
+	return true;
+}
+
+//Called where SwitchType, CustomImage, Options or AddjMulti of a device are written,
+//the device info is reloaded on its next notification check
+void CNotificationHelper::InvalidateDeviceInfo(const uint64_t DevIdx)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_deviceinfoGeneration++;
+	m_deviceinfo.erase(DevIdx);
+}
+
+void CNotificationHelper::InvalidateDeviceInfo(const std::string &DevIdx)
+{
+	std::stringstream s_str(DevIdx);
+	uint64_t idxll;
+	s_str >> idxll;
+	InvalidateDeviceInfo(idxll);
+}
+
+//For the hardware classes that address their devices on DeviceID, an empty DeviceID invalidates all devices of the hardware
+void CNotificationHelper::InvalidateDeviceInfo(const int HardwareID, const std::string &DeviceID)
+{
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_deviceinfoGeneration++;
+	std::map<uint64_t, _tNotificationDeviceInfo>::iterator itt = m_deviceinfo.begin();
+	while (itt != m_deviceinfo.end())
+	{
+		if ((itt->second.HardwareID == HardwareID) && ((DeviceID.empty()) || (itt->second.DeviceID == DeviceID)))
+			m_deviceinfo.erase(itt++);
+		else
+			++itt;
+	}
+}
+
+//Called when a new record is written to the Rain table
+void CNotificationHelper::UpdateRainTotal(const uint64_t DevIdx, const float Total)
+{
+	std::string szDate = GetRainDate();
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	if (m_notifications.find(DevIdx) == m_notifications.end())
+		return;
+	std::map<uint64_t, _tNotificationRainTotal>::iterator itt = m_raintotals.find(DevIdx);
+	if ((itt == m_raintotals.end()) || (itt->second.Date != szDate))
+	{
+		_tNotificationRainTotal rtotal;
+		rtotal.Date = szDate;
+		rtotal.MinTotal = Total;
+		m_raintotals[DevIdx] = rtotal;
+	}
+	else if (Total < itt->second.MinTotal)
+		itt->second.MinTotal = Total;
+}
+
+std::string CNotificationHelper::GetRainDate()
+{
+	char szDate[40];
+	time_t now = mytime(NULL);
+	struct tm tm1;
+	localtime_r(&now, &tm1);
+	sprintf(szDate, "%04d-%02d-%02d", tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday);
+	return szDate;
+}
+
+//Reads the device fields (and todays rain total), m_mutex should not be locked
+bool CNotificationHelper::LoadDeviceInfo(const uint64_t DevIdx, _tNotificationDeviceInfo &info, _tNotificationRainTotal &rtotal, bool &bHaveRainTotal)
+{
+	bHaveRainTotal = false;
+	std::vector<std::vector<std::string> > result;
+	result = m_sql.safe_query("SELECT Type, SubType, SwitchType, CustomImage, Options, AddjMulti, HardwareID, DeviceID FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
+		DevIdx);
+	if (result.size() == 0)
+		return false;
+	info.devType = static_cast<unsigned char>(atoi(result[0][0].c_str()));
+	info.subType = static_cast<unsigned char>(atoi(result[0][1].c_str()));
+	info.SwitchType = result[0][2];
+	info.CustomImage = result[0][3];
+	info.Options = result[0][4];
+	info.AddjMulti = atof(result[0][5].c_str());
+	info.HardwareID = atoi(result[0][6].c_str());
+	info.DeviceID = result[0][7];
+
+	if ((info.devType == pTypeRAIN) && (info.subType != sTypeRAINWU))
+	{
+		rtotal.Date = GetRainDate();
+		result = m_sql.safe_query("SELECT MIN(Total) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')",
+			DevIdx, rtotal.Date.c_str());
+		if ((result.size() > 0) && (!result[0][0].empty()))
+		{
+			rtotal.MinTotal = static_cast<float>(atof(result[0][0].c_str()));
+			bHaveRainTotal = true;
+		}
+	}
+	return true;
+}
+
+//Splits the notification Params once, so the checks do not have to do this for every update
+void CNotificationHelper::CompileParams(_tNotification &notification)
+{
+	std::vector<std::string> splitresults;
+	StringSplit(notification.Params, ";", splitresults);
+	notification.ParamCount = splitresults.size();
+	notification.RuleType = (splitresults.size() > 0) ? splitresults[0] : "";
+	notification.RuleOperator = (splitresults.size() > 1) ? splitresults[1] : "";
+	notification.RuleValue = (splitresults.size() > 2) ? splitresults[2] : "";
+	notification.RuleFValue = static_cast<float>(atof(notification.RuleValue.c_str()));
+	notification.RuleRecovery = ((splitresults.size() > 3) && (splitresults[3] == "1"));
+}
+
 //Re(Loads) all notifications stored in the database, so we do not have to query this all the time
+//Everything is read first and swapped in under m_mutex, so the notification checks never wait for the database
 void CNotificationHelper::ReloadNotifications()
 {
-	boost::lock_guard<boost::mutex> l(m_mutex);
-	m_notifications.clear();
+	std::map<uint64_t, std::vector<_tNotification> > notifications;
+	std::map<uint64_t, _tNotificationDeviceInfo> deviceinfo;
+	std::map<uint64_t, _tNotificationRainTotal> raintotals;
+	unsigned long generation;
+	int NotificationSensorInterval;
+	int NotificationSwitchInterval;
+	{
+		boost::lock_guard<boost::mutex> l(m_mutex);
+		generation = m_deviceinfoGeneration;
+		NotificationSensorInterval = m_NotificationSensorInterval;
+		NotificationSwitchInterval = m_NotificationSwitchInterval;
+	}
 	std::vector<std::vector<std::string> > result;
 
-	m_sql.GetPreferencesVar("NotificationSensorInterval", m_NotificationSensorInterval);
-	m_sql.GetPreferencesVar("NotificationSwitchInterval", m_NotificationSwitchInterval);
+	m_sql.GetPreferencesVar("NotificationSensorInterval", NotificationSensorInterval);
+	m_sql.GetPreferencesVar("NotificationSwitchInterval", NotificationSwitchInterval);
 
 	result = m_sql.safe_query("SELECT ID, DeviceRowID, Params, CustomMessage, ActiveSystems, Priority, SendAlways, LastSend FROM Notifications ORDER BY DeviceRowID");
-	if (result.size() == 0)
-		return;
 
 	time_t mtime = mytime(NULL);
 	struct tm atime;
 	localtime_r(&mtime, &atime);
-	std::vector<std::string> splitresults;
+	std::string ttype = Notification_Type_Desc(NTYPE_LASTUPDATE, 1);
 
 	std::stringstream sstr;
 
@@ -1289,6 +1415,8 @@ void CNotificationHelper::ReloadNotifications()
 		notification.ActiveSystems = sd[4];
 		notification.Priority = atoi(sd[5].c_str());
 		notification.SendAlways = (atoi(sd[6].c_str())!=0);
+		notification.LastUpdate = 0;
+		CompileParams(notification);
 
 		std::string stime = sd[7];
 		if (stime == "0")
@@ -1300,9 +1428,7 @@ void CNotificationHelper::ReloadNotifications()
 			struct tm ntime;
 			ParseSQLdatetime(notification.LastSend, ntime, stime, atime.tm_isdst);
 		}
-		std::string ttype = Notification_Type_Desc(NTYPE_LASTUPDATE, 1);
-		StringSplit(notification.Params, ";", splitresults);
-		if (splitresults[0] == ttype) {
+		if (notification.RuleType == ttype) {
 			std::vector<std::vector<std::string> > result2;
 			result2 = m_sql.safe_query(
 				"SELECT B.Name, B.LastUpdate "
@@ -1321,6 +1447,31 @@ void CNotificationHelper::ReloadNotifications()
 				ParseSQLdatetime(notification.LastUpdate, ntime, stime, atime.tm_isdst);
 			}
 		}
-		m_notifications[Idx].push_back(notification);
+		notifications[Idx].push_back(notification);
+	}
+
+	std::map<uint64_t, std::vector<_tNotification> >::const_iterator itt2;
+	for (itt2 = notifications.begin(); itt2 != notifications.end(); ++itt2)
+	{
+		_tNotificationDeviceInfo dinfo;
+		_tNotificationRainTotal rtotal;
+		bool bHaveRainTotal;
+		if (!LoadDeviceInfo(itt2->first, dinfo, rtotal, bHaveRainTotal))
+			continue;
+		deviceinfo[itt2->first] = dinfo;
+		if (bHaveRainTotal)
+			raintotals[itt2->first] = rtotal;
 	}
+
+	boost::lock_guard<boost::mutex> l(m_mutex);
+	m_NotificationSensorInterval = NotificationSensorInterval;
+	m_NotificationSwitchInterval = NotificationSwitchInterval;
+	m_notifications.swap(notifications);
+	//a device changed while it was read is loaded again on its next check
+	if (generation == m_deviceinfoGeneration)
+		m_deviceinfo.swap(deviceinfo);
+	else
+		m_deviceinfo.clear();
+	m_deviceinfoGeneration++;
+	m_raintotals.swap(raintotals);
 }
@@ -18,6 +18,33 @@ struct _tNotification
 	std::string CustomMessage;
 	std::string ActiveSystems;
 	bool SendAlways;
+	//Params precompiled at load time (Type;Rule;Value;Recovery)
+	size_t ParamCount;
+	std::string RuleType;
+	std::string RuleOperator;
+	std::string RuleValue;
+	float RuleFValue;
+	bool RuleRecovery;
+};
+
+//Device fields needed to compose a notification, kept in memory so the RX path does not have to query them
+struct _tNotificationDeviceInfo
+{
+	int HardwareID;
+	std::string DeviceID;
+	unsigned char devType;
+	unsigned char subType;
+	std::string SwitchType;
+	std::string CustomImage;
+	std::string Options;
+	double AddjMulti;
+};
+
+//Lowest rain counter total logged today, used for the daily rain notification
+struct _tNotificationRainTotal
+{
+	std::string Date;
+	float MinTotal;
 };
 
 class CNotificationHelper {
@@ -25,6 +52,7 @@ public:
 	CNotificationHelper();
 	~CNotificationHelper();
 	void Init();
+	void Stop();
 	bool SendMessage(
 		const uint64_t Idx,
 		const std::string &Name,
@@ -48,6 +76,7 @@ public:
 	void LoadConfig();
 	void ConfigFromGetvars(const request& req, const bool save);
 	bool IsInConfig(const std::string &Key);
+	std::map<std::string, _tNotificationQueueStats> GetQueueStats();
 
 	//notification functions
 	void CheckAndHandleLastUpdateNotification();
@@ -68,6 +97,10 @@ public:
 	bool CustomRecoveryMessage(const uint64_t ID, std::string &msg, const bool isRecovery);
 	bool HasNotifications(const uint64_t DevIdx);
 	bool HasNotifications(const std::string &DevIdx);
+	void InvalidateDeviceInfo(const uint64_t DevIdx);
+	void InvalidateDeviceInfo(const std::string &DevIdx);
+	void InvalidateDeviceInfo(const int HardwareID, const std::string &DeviceID);
+	void UpdateRainTotal(const uint64_t DevIdx, const float Total);
 
 	bool CheckAndHandleTempHumidityNotification(
 		const uint64_t Idx,
@@ -128,9 +161,16 @@ protected:
 	void SetConfigValue(const std::string &key, const std::string &value);
 private:
 	std::string ParseCustomMessage(const std::string &cMessage, const std::string &sName, const std::string &sValue);
-	bool ApplyRule(std::string rule, bool equal, bool less);
+	bool ApplyRule(const std::string &rule, bool equal, bool less);
+	void CompileParams(_tNotification &notification);
+	bool GetDeviceInfo(const uint64_t DevIdx, _tNotificationDeviceInfo &info);
+	bool LoadDeviceInfo(const uint64_t DevIdx, _tNotificationDeviceInfo &info, _tNotificationRainTotal &rtotal, bool &bHaveRainTotal);
+	std::string GetRainDate();
 	boost::mutex m_mutex;
 	std::map<uint64_t, std::vector<_tNotification> > m_notifications;
+	std::map<uint64_t, _tNotificationDeviceInfo> m_deviceinfo;
+	unsigned long m_deviceinfoGeneration; //changed by every invalidation, a load that raced with one is not cached
+	std::map<uint64_t, _tNotificationRainTotal> m_raintotals;
 	int m_NotificationSensorInterval;
 	int m_NotificationSwitchInterval;
 };
@@ -8,6 +8,7 @@
 #include "../main/mainworker.h"
 #include "../main/RFXtrx.h"
 #include "../main/SQLHelper.h"
+#include "../main/DeviceSnapshot.h"
 #include "../webserver/Base64.h"
 #include "../main/WebServer.h"
 #include "../webserver/cWebem.h"
@@ -73,10 +74,13 @@ void CFibaroPush::DoFibaroPush()
 		(fibaroPassword == "")
 		)
 		return;
+	device_snapshot_ptr snapshot = m_devicesnapshots.Get(m_DeviceRowIdx);
+	if (!snapshot)
+		return;
 	std::vector<std::vector<std::string> > result;
 	result = m_sql.safe_query(
-		"SELECT A.DeviceID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, A.IncludeUnit, B.SwitchType FROM FibaroLink as A, DeviceStatus as B "
-		"WHERE (A.DeviceID == '%" PRIu64 "' AND A.Enabled = '1' AND A.DeviceID==B.ID)",
+		"SELECT DeviceID, DelimitedValue, TargetType, TargetVariable, TargetDeviceID, TargetProperty, IncludeUnit FROM FibaroLink "
+		"WHERE (DeviceID == '%" PRIu64 "' AND Enabled = '1')",
 		m_DeviceRowIdx);
 	if (result.size()>0)
 	{
@@ -86,16 +90,16 @@ void CFibaroPush::DoFibaroPush()
 		{
 			std::vector<std::string> sd=*itt;
 			int delpos = atoi(sd[1].c_str());
-			int dType = atoi(sd[3].c_str());
-			int dSubType = atoi(sd[4].c_str());
-			int nValue = atoi(sd[5].c_str());
-			std::string sValue = sd[6].c_str();
-			int targetType = atoi(sd[7].c_str());
-			std::string targetVariable = sd[8].c_str();
-			int targetDeviceID = atoi(sd[9].c_str());
-			std::string targetProperty = sd[10].c_str();
-			int includeUnit = atoi(sd[11].c_str());
-			int metertype = atoi(sd[12].c_str());
+			int dType = snapshot->Type;
+			int dSubType = snapshot->SubType;
+			int nValue = snapshot->nValue;
+			std::string sValue = snapshot->sValue;
+			int targetType = atoi(sd[2].c_str());
+			std::string targetVariable = sd[3].c_str();
+			int targetDeviceID = atoi(sd[4].c_str());
+			std::string targetProperty = sd[5].c_str();
+			int includeUnit = atoi(sd[6].c_str());
+			int metertype = snapshot->SwitchType;
 			std::string lstatus="";
 
 			if ((targetType==0)||(targetType==1)) {
@@ -6,6 +6,7 @@
 #include "../hardware/hardwaretypes.h"
 #include "../main/RFXtrx.h"
 #include "../main/SQLHelper.h"
+#include "../main/DeviceSnapshot.h"
 #include "../webserver/Base64.h"
 #include "../main/localtime_r.h"
 #include "../main/WebServer.h"
@@ -70,10 +71,13 @@ void CHttpPush::DoHttpPush()
 	if (httpDebugActiveInt == 1) {
 		httpDebugActive = true;
 	}
+	device_snapshot_ptr snapshot = m_devicesnapshots.Get(m_DeviceRowIdx);
+	if (!snapshot)
+		return;
 	std::vector<std::vector<std::string> > result;
 	result=m_sql.safe_query(
-		"SELECT A.DeviceID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, A.IncludeUnit, B.SwitchType, strftime('%%s', B.LastUpdate), B.Name FROM HttpLink as A, DeviceStatus as B "
-		"WHERE (A.DeviceID == '%" PRIu64 "' AND A.Enabled = '1' AND A.DeviceID==B.ID)",
+		"SELECT DeviceID, DelimitedValue, TargetType, TargetVariable, TargetDeviceID, TargetProperty, IncludeUnit FROM HttpLink "
+		"WHERE (DeviceID == '%" PRIu64 "' AND Enabled = '1')",
 		m_DeviceRowIdx);
 	if (result.size()>0)
 	{
@@ -92,20 +96,20 @@ void CHttpPush::DoHttpPush()
 			std::string sdeviceId = sd[0].c_str();
 			std::string ldelpos = sd[1].c_str();
 			int delpos = atoi(sd[1].c_str());
-			int dType = atoi(sd[3].c_str());
-			int dSubType = atoi(sd[4].c_str());
-			int nValue = atoi(sd[5].c_str());
-			std::string sValue = sd[6].c_str();
-			int targetType = atoi(sd[7].c_str());
-			std::string targetVariable = sd[8].c_str();
-			int targetDeviceID = atoi(sd[9].c_str());
-			std::string targetProperty = sd[10].c_str();
-			int includeUnit = atoi(sd[11].c_str());
-			int metertype = atoi(sd[12].c_str());
-			int lastUpdate = atoi(sd[13].c_str());
-			std::string ltargetVariable = sd[8].c_str();
-			std::string ltargetDeviceId = sd[9].c_str();
-			std::string lname = sd[14].c_str();
+			int dType = snapshot->Type;
+			int dSubType = snapshot->SubType;
+			int nValue = snapshot->nValue;
+			std::string sValue = snapshot->sValue;
+			int targetType = atoi(sd[2].c_str());
+			std::string targetVariable = sd[3].c_str();
+			int targetDeviceID = atoi(sd[4].c_str());
+			std::string targetProperty = sd[5].c_str();
+			int includeUnit = atoi(sd[6].c_str());
+			int metertype = snapshot->SwitchType;
+			int lastUpdate = (int)snapshot->LastUpdateEpoch;
+			std::string ltargetVariable = sd[3].c_str();
+			std::string ltargetDeviceId = sd[4].c_str();
+			std::string lname = snapshot->Name;
 			sendValue = sValue;
 
 			unsigned long tzoffset = get_tzoffset();
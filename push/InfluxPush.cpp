@@ -8,6 +8,7 @@
 #include "../main/mainworker.h"
 #include "../main/RFXtrx.h"
 #include "../main/SQLHelper.h"
+#include "../main/DeviceSnapshot.h"
 #include "../webserver/Base64.h"
 #include "../main/WebServer.h"
 #include "../webserver/cWebem.h"
@@ -77,10 +78,13 @@ void CInfluxPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowId
 
 void CInfluxPush::DoInfluxPush()
 {			
+	device_snapshot_ptr snapshot = m_devicesnapshots.Get(m_DeviceRowIdx);
+	if (!snapshot)
+		return;
 	std::vector<std::vector<std::string> > result;
 	result = m_sql.safe_query(
-		"SELECT A.DeviceID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, A.IncludeUnit, B.Name, B.SwitchType FROM PushLink as A, DeviceStatus as B "
-		"WHERE (A.PushType==1 AND A.DeviceID == '%" PRIu64 "' AND A.Enabled==1 AND A.DeviceID==B.ID)",
+		"SELECT DeviceID, DelimitedValue, TargetType, TargetVariable, TargetDeviceID, TargetProperty, IncludeUnit FROM PushLink "
+		"WHERE (PushType==1 AND DeviceID == '%" PRIu64 "' AND Enabled==1)",
 		m_DeviceRowIdx);
 	if (result.size()>0)
 	{
@@ -91,17 +95,17 @@ void CInfluxPush::DoInfluxPush()
 		{
 			std::vector<std::string> sd=*itt;
 			int delpos = atoi(sd[1].c_str());
-			int dType = atoi(sd[3].c_str());
-			int dSubType = atoi(sd[4].c_str());
-			int nValue = atoi(sd[5].c_str());
-			std::string sValue = sd[6].c_str();
-			int targetType = atoi(sd[7].c_str());
-			std::string targetVariable = sd[8].c_str();
-			int targetDeviceID = atoi(sd[9].c_str());
-			std::string targetProperty = sd[10].c_str();
-			int includeUnit = atoi(sd[11].c_str());
-			std::string name = sd[12];
-			int metertype = atoi(sd[13].c_str());
+			int dType = snapshot->Type;
+			int dSubType = snapshot->SubType;
+			int nValue = snapshot->nValue;
+			std::string sValue = snapshot->sValue;
+			int targetType = atoi(sd[2].c_str());
+			std::string targetVariable = sd[3].c_str();
+			int targetDeviceID = atoi(sd[4].c_str());
+			std::string targetProperty = sd[5].c_str();
+			int includeUnit = atoi(sd[6].c_str());
+			std::string name = snapshot->Name;
+			int metertype = snapshot->SwitchType;
 			std::string lstatus="";
 
 			std::vector<std::string> strarray;
@@ -3,6 +3,10 @@
 #include "TCPServer.h"
 #include "../main/Helper.h"
 #include "../main/Logger.h"
+
+// maximum number of frames queued for a client, further frames are dropped
+#define TCPCLIENT_MAX_QUEUED_FRAMES 1000
+
 namespace tcp {
 namespace server {
 
@@ -19,9 +23,12 @@ CTCPClientBase::~CTCPClientBase(void)
 }
 
 CTCPClient::CTCPClient(boost::asio::io_service& ios, CTCPServerIntBase *pManager)
-	: CTCPClientBase(pManager)
+	: CTCPClientBase(pManager),
+	ios_(ios)
 {
 	socket_ = new boost::asio::ip::tcp::socket(ios);
+	write_in_progress_ = false;
+	write_overflow_ = false;
 }
 
 
@@ -92,26 +99,72 @@ void CTCPClient::write(const char *pData, size_t Length)
 {
 	if (!m_bIsLoggedIn)
 		return;
-	boost::asio::async_write(*socket_, boost::asio::buffer(pData, Length),
+	boost::lock_guard<boost::mutex> l(writeMutex_);
+	if (writeQ_.size() >= TCPCLIENT_MAX_QUEUED_FRAMES)
+	{
+		if (!write_overflow_)
+			_log.Log(LOG_ERROR, "TCPServer: client %s is not keeping up, dropping data!", m_endpoint.c_str());
+		write_overflow_ = true;
+		return;
+	}
+	write_overflow_ = false;
+	writeQ_.push_back(std::string(pData, Length));
+	if (!write_in_progress_)
+	{
+		// the socket is only used from the io_service thread
+		write_in_progress_ = true;
+		ios_.post(boost::bind(&CTCPClient::startWrite, shared_from_this()));
+	}
+}
+
+void CTCPClient::startWrite()
+{
+	boost::lock_guard<boost::mutex> l(writeMutex_);
+	if (writeQ_.empty())
+	{
+		write_in_progress_ = false;
+		return;
+	}
+	// everything queued so far goes out in one write
+	writeBuf_.clear();
+	while (!writeQ_.empty())
+	{
+		writeBuf_ += writeQ_.front();
+		writeQ_.pop_front();
+	}
+	boost::asio::async_write(*socket_, boost::asio::buffer(writeBuf_),
 		boost::bind(&CTCPClient::handleWrite, shared_from_this(),
 		boost::asio::placeholders::error));
 }
 
 void CTCPClient::handleWrite(const boost::system::error_code& error)
 {
+	{
+		boost::lock_guard<boost::mutex> l(writeMutex_);
+		if (error)
+		{
+			writeQ_.clear();
+			write_in_progress_ = false;
+		}
+	}
 	if (error)
 	{
 		pConnectionManager->stopClient(shared_from_this());
+		return;
 	}
+	startWrite();
 }
 
 #ifndef NOCLOUD
 /* shared server via proxy client class */
-CSharedClient::CSharedClient(CTCPServerIntBase *pManager, boost::shared_ptr<http::server::CProxyClient> proxy, const std::string &token, const std::string &username) : CTCPClientBase(pManager)
+CSharedClient::CSharedClient(CTCPServerIntBase *pManager, boost::shared_ptr<http::server::CProxyClient> proxy, const std::string &token, const std::string &username) : CTCPClientBase(pManager),
+	m_strand(proxy->GetIOService())
 {
 	m_pProxyClient = proxy;
 	m_username = username;
 	_token = token;
+	queued_frames_ = 0;
+	write_overflow_ = false;
 }
 
 CSharedClient::~CSharedClient()
@@ -138,10 +191,33 @@ void CSharedClient::OnIncomingData(const unsigned char *data, size_t bytes_trans
 
 void CSharedClient::write(const char *pData, size_t Length)
 {
+	if (!m_bIsLoggedIn)
+		return;
+	{
+		boost::lock_guard<boost::mutex> l(writeMutex_);
+		if (queued_frames_ >= TCPCLIENT_MAX_QUEUED_FRAMES)
+		{
+			if (!write_overflow_)
+				_log.Log(LOG_ERROR, "TCPServer: shared client %s is not keeping up, dropping data!", m_username.c_str());
+			write_overflow_ = true;
+			return;
+		}
+		write_overflow_ = false;
+		queued_frames_++;
+	}
+	m_strand.post(boost::bind(&CSharedClient::handleWrite, shared_from_this(), std::string(pData, Length)));
+}
+
+void CSharedClient::handleWrite(const std::string &data)
+{
+	{
+		boost::lock_guard<boost::mutex> l(writeMutex_);
+		queued_frames_--;
+	}
 	if (!m_bIsLoggedIn)
 		return;
 	// RK, todo: m_pProxyClient is not valid after a reconnect
-	m_pProxyClient->WriteSlaveData(_token, pData, Length);
+	m_pProxyClient->WriteSlaveData(_token, data.c_str(), data.size());
 }
 
 bool CSharedClient::CompareToken(const std::string &token)
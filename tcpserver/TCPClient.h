@@ -4,12 +4,16 @@
 #include <boost/array.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
 #include "../webserver/proxyclient.h"
 
 namespace tcp {
 namespace server {
 
 class CTCPServerIntBase;
+struct _tRemoteShareAcl;
 
 class CTCPClientBase : 
 	private boost::noncopyable
@@ -26,6 +30,8 @@ public:
 	std::string m_username;
 	std::string m_endpoint;
 	bool m_bIsLoggedIn;
+	// devices this client may receive, set at login
+	boost::shared_ptr<const _tRemoteShareAcl> m_pAcl;
 
 	// usual tcp parameters
 	boost::asio::ip::tcp::socket *socket() { return socket_; }
@@ -48,11 +54,22 @@ public:
 	virtual void write(const char *pData, size_t Length);
 private:
 	void handleRead(const boost::system::error_code& error, size_t length);
+	void startWrite();
 	void handleWrite(const boost::system::error_code& error);
 
 	/// Buffer for incoming data.
 	boost::array<char, 8192> buffer_;
 
+	boost::asio::io_service& ios_;
+
+	/// Frames waiting to be sent, the sender never waits for a (slow) client
+	std::deque<std::string> writeQ_;
+	/// Queued frames taken by the write in progress, only used from the io_service thread
+	std::string writeBuf_;
+	boost::mutex writeMutex_;
+	bool write_in_progress_;
+	bool write_overflow_;
+
 };
 
 #ifndef NOCLOUD
@@ -68,8 +85,16 @@ public:
 	void OnIncomingData(const unsigned char *data, size_t bytes_transferred);
 	bool CompareToken(const std::string &token);
 private:
+	void handleWrite(const std::string &data);
+
 	boost::shared_ptr<http::server::CProxyClient> m_pProxyClient;
 	std::string _token;
+
+	/// Frames are handed to the proxy from its own io_service, the sender never waits for the proxy connection
+	boost::asio::io_service::strand m_strand;
+	boost::mutex writeMutex_;
+	size_t queued_frames_;
+	bool write_overflow_;
 };
 #endif
 
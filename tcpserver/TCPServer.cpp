@@ -137,11 +137,43 @@ _tRemoteShareUser* CTCPServerIntBase::FindUser(const std::string &username)
 
 bool CTCPServerIntBase::HandleAuthentication(CTCPClient_ptr c, const std::string &username, const std::string &password)
 {
+	boost::lock_guard<boost::mutex> l(connectionMutex);
 	_tRemoteShareUser *pUser=FindUser(username);
 	if (pUser==NULL)
 		return false;
 
-	return ((pUser->Username==username)&&(pUser->Password==password));
+	if ((pUser->Username != username) || (pUser->Password != password))
+		return false;
+	std::map<std::string, boost::shared_ptr<const _tRemoteShareAcl> >::const_iterator itt = m_acls.find(username);
+	if (itt != m_acls.end())
+		c->m_pAcl = itt->second;
+	return true;
+}
+
+//Resolve the device permissions of all users, and update the connected clients (connectionMutex should be locked)
+void CTCPServerIntBase::BuildAcls()
+{
+	m_acls.clear();
+	std::vector<_tRemoteShareUser>::const_iterator itt;
+	for (itt = m_users.begin(); itt != m_users.end(); ++itt)
+	{
+		boost::shared_ptr<_tRemoteShareAcl> pAcl(new _tRemoteShareAcl);
+		pAcl->bAllDevices = itt->Devices.empty();
+		pAcl->Devices.insert(itt->Devices.begin(), itt->Devices.end());
+		m_acls[itt->Username] = pAcl;
+	}
+	std::set<CTCPClient_ptr>::const_iterator ittClient;
+	for (ittClient = connections_.begin(); ittClient != connections_.end(); ++ittClient)
+	{
+		CTCPClientBase *pClient = ittClient->get();
+		if (!pClient)
+			continue;
+		std::map<std::string, boost::shared_ptr<const _tRemoteShareAcl> >::const_iterator ittAcl = m_acls.find(pClient->m_username);
+		if (ittAcl != m_acls.end())
+			pClient->m_pAcl = ittAcl->second;
+		else
+			pClient->m_pAcl.reset();
+	}
 }
 
 void CTCPServerIntBase::DoDecodeMessage(const CTCPClientBase *pClient, const unsigned char *pRXCommand)
@@ -180,6 +212,7 @@ void CTCPServerIntBase::SetRemoteUsers(const std::vector<_tRemoteShareUser> &use
 {
 	boost::lock_guard<boost::mutex> l(connectionMutex);
 	m_users=users;
+	BuildAcls();
 }
 
 unsigned int CTCPServerIntBase::GetUserDevicesCount(const std::string &username)
@@ -192,8 +225,6 @@ unsigned int CTCPServerIntBase::GetUserDevicesCount(const std::string &username)
 
 void CTCPServerIntBase::SendToAll(const int HardwareID, const uint64_t DeviceRowID, const char *pData, size_t Length, const CTCPClientBase* pClient2Ignore)
 {
-	boost::lock_guard<boost::mutex> l(connectionMutex);
-
 	//do not share Interface Messages
 	if (
 		(pData[1]==pTypeInterfaceMessage)||
@@ -201,6 +232,8 @@ void CTCPServerIntBase::SendToAll(const int HardwareID, const uint64_t DeviceRow
 		)
 		return;
 
+	boost::lock_guard<boost::mutex> l(connectionMutex);
+
 	std::set<CTCPClient_ptr>::const_iterator itt;
 	for (itt=connections_.begin(); itt!=connections_.end(); ++itt)
 	{
@@ -210,28 +243,12 @@ void CTCPServerIntBase::SendToAll(const int HardwareID, const uint64_t DeviceRow
 
 		if (pClient)
 		{
-			_tRemoteShareUser *pUser=FindUser(pClient->m_username);
-			if (pUser!=NULL)
-			{
-				//check if we are allowed to get this device
-				bool bOk2Send=false;
-				if (pUser->Devices.size()==0)
-					bOk2Send=true;
-				else
-				{
-					int tdevices=pUser->Devices.size();
-					for (int ii=0; ii<tdevices; ii++)
-					{
-						if (pUser->Devices[ii]==DeviceRowID)
-						{
-							bOk2Send=true;
-							break;
-						}
-					}
-				}
-				if (bOk2Send)
-					pClient->write(pData,Length);
-			}
+			//check if we are allowed to get this device
+			const _tRemoteShareAcl *pAcl = pClient->m_pAcl.get();
+			if (pAcl == NULL)
+				continue;
+			if ((pAcl->bAllDevices) || (pAcl->Devices.find(DeviceRowID) != pAcl->Devices.end()))
+				pClient->write(pData, Length); //only queues the data
 		}
 	}
 }
@@ -4,6 +4,7 @@
 #include "TCPClient.h"
 #include "../webserver/proxyclient.h"
 #include <set>
+#include <map>
 #include <vector>
 
 namespace tcp {
@@ -18,6 +19,13 @@ struct _tRemoteShareUser
 	std::vector<uint64_t> Devices;
 };
 
+// device permissions of a remote user, resolved when a client logs in
+struct _tRemoteShareAcl
+{
+	bool bAllDevices;
+	std::set<uint64_t> Devices;
+};
+
 #define RemoteMessage_id_Low 0xE2
 #define RemoteMessage_id_High 0x2E
 #define SECONDS_PER_DAY 60*60*24
@@ -56,9 +64,11 @@ protected:
 	_tRemoteShareUser* FindUser(const std::string &username);
 
 	bool HandleAuthentication(CTCPClient_ptr c, const std::string &username, const std::string &password);
+	void BuildAcls();
 	void DoDecodeMessage(const CTCPClientBase *pClient, const unsigned char *pRXCommand);
 
 	std::vector<_tRemoteShareUser> m_users;
+	std::map<std::string, boost::shared_ptr<const _tRemoteShareAcl> > m_acls;
 	CTCPServer *m_pRoot;
 
 	std::set<CTCPClient_ptr> connections_;
@@ -0,0 +1,296 @@
+//Blockly rule evaluations per second with 500 rules, the Lua evaluation it replaced against the compiled conditions
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../main/BlocklyCondition.h"
+
+extern "C" {
+#ifdef WITH_EXTERNAL_LUA
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#else
+#include "../lua/src/lua.h"
+#include "../lua/src/lualib.h"
+#include "../lua/src/lauxlib.h"
+#endif
+}
+
+#define BENCH_RULES 500
+#define BENCH_EVENTS 2000
+#define SWITCH_DEVICES 500
+#define TEMP_DEVICES 100
+#define VARIABLES 20
+#define SUNRISE 420
+
+struct _tBenchStates
+{
+	std::map<uint64_t, std::string> switches;
+	std::map<uint64_t, float> temperatures;
+	std::map<uint64_t, int> variables;
+};
+
+class CBenchState : public CBlocklyState
+{
+public:
+	CBenchState(const _tBenchStates &states) : m_states(states) {}
+	_tBlocklyValue GetTableValue(const int table, const uint64_t idx)
+	{
+		_tBlocklyValue value;
+		value.Type = BV_NIL;
+		value.fValue = 0;
+		if (table == BT_DEVICE)
+		{
+			std::map<uint64_t, std::string>::const_iterator itt = m_states.switches.find(idx);
+			if (itt != m_states.switches.end())
+			{
+				value.Type = BV_STRING;
+				value.sValue = itt->second;
+			}
+		}
+		else if (table == BT_TEMPERATURE)
+		{
+			std::map<uint64_t, float>::const_iterator itt = m_states.temperatures.find(idx);
+			if (itt != m_states.temperatures.end())
+			{
+				value.Type = BV_NUMBER;
+				value.fValue = itt->second;
+			}
+		}
+		else if (table == BT_VARIABLE)
+		{
+			std::map<uint64_t, int>::const_iterator itt = m_states.variables.find(idx);
+			if (itt != m_states.variables.end())
+			{
+				value.Type = BV_NUMBER;
+				value.fValue = itt->second;
+			}
+		}
+		return value;
+	}
+	double GetGlobal(const int global)
+	{
+		if (global == BG_TIMEOFDAY)
+		{
+			time_t now = time(NULL);
+			struct tm ltime;
+			localtime_r(&now, &ltime);
+			return (ltime.tm_hour * 60) + ltime.tm_min;
+		}
+		if (global == BG_SUNRISE)
+			return SUNRISE;
+		return 0;
+	}
+private:
+	const _tBenchStates &m_states;
+};
+
+static uint64_t SwitchIdx() { return 1 + (rand() % SWITCH_DEVICES); }
+static uint64_t TempIdx() { return SWITCH_DEVICES + 1 + (rand() % TEMP_DEVICES); }
+//variables have their own idx range, the old substring match would also pick variable[12] for device 12
+static uint64_t VariableIdx() { return 1001 + (rand() % VARIABLES); }
+
+//Conditions as the Blockly editor writes them
+static std::string MakeRule(const int ii)
+{
+	char szRule[200];
+	switch (ii % 4)
+	{
+	case 0:
+		sprintf(szRule, "device[%d] == \"On\"", (int)SwitchIdx());
+		break;
+	case 1:
+		sprintf(szRule, "device[%d] == \"On\" and temperaturedevice[%d] > 21.5", (int)SwitchIdx(), (int)TempIdx());
+		break;
+	case 2:
+		sprintf(szRule, "(device[%d] ~= \"Off\" or variable[%d] >= 10) and timeofday > @Sunrise", (int)SwitchIdx(), (int)VariableIdx());
+		break;
+	default:
+		sprintf(szRule, "temperaturedevice[%d] < 18 and not (device[%d] == \"On\")", (int)TempIdx(), (int)SwitchIdx());
+		break;
+	}
+	return szRule;
+}
+
+//The state CEventSystem::CreateBlocklyLuaState built for every evaluation
+static lua_State *CreateLuaState(const _tBenchStates &states)
+{
+	lua_State *lua_state = luaL_newstate();
+	luaL_openlibs(lua_state);
+
+	lua_createtable(lua_state, (int)states.switches.size(), 0);
+	std::map<uint64_t, std::string>::const_iterator itt;
+	for (itt = states.switches.begin(); itt != states.switches.end(); ++itt)
+	{
+		lua_pushnumber(lua_state, (lua_Number)itt->first);
+		lua_pushstring(lua_state, itt->second.c_str());
+		lua_rawset(lua_state, -3);
+	}
+	lua_setglobal(lua_state, "device");
+
+	lua_createtable(lua_state, (int)states.variables.size(), 0);
+	std::map<uint64_t, int>::const_iterator itt2;
+	for (itt2 = states.variables.begin(); itt2 != states.variables.end(); ++itt2)
+	{
+		lua_pushnumber(lua_state, (lua_Number)itt2->first);
+		lua_pushnumber(lua_state, (lua_Number)itt2->second);
+		lua_rawset(lua_state, -3);
+	}
+	lua_setglobal(lua_state, "variable");
+
+	lua_createtable(lua_state, (int)states.temperatures.size(), 0);
+	std::map<uint64_t, float>::const_iterator itt3;
+	for (itt3 = states.temperatures.begin(); itt3 != states.temperatures.end(); ++itt3)
+	{
+		lua_pushnumber(lua_state, (lua_Number)itt3->first);
+		lua_pushnumber(lua_state, (lua_Number)itt3->second);
+		lua_rawset(lua_state, -3);
+	}
+	lua_setglobal(lua_state, "temperaturedevice");
+	return lua_state;
+}
+
+//The device event as CEventSystem::EvaluateBlockly handled it before: a substring search over all rules, and Lua for the matches
+static void EvaluateLua(const std::vector<std::string> &rules, const _tBenchStates &states, const uint64_t idx, std::set<size_t> &triggered, int &evaluations)
+{
+	char szIdx[30];
+	sprintf(szIdx, "[%d]", (int)idx);
+	char szSunrise[30];
+	sprintf(szSunrise, "%d", SUNRISE);
+	lua_State *lua_state = NULL;
+	for (size_t ii = 0; ii < rules.size(); ii++)
+	{
+		std::string conditions = rules[ii];
+		if (conditions.find(szIdx) == std::string::npos)
+			continue;
+		size_t pos = conditions.find("@Sunrise");
+		if (pos != std::string::npos)
+			conditions.replace(pos, 8, szSunrise);
+		std::string ifCondition = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + conditions + " then result = 1 end; return result";
+		if (lua_state == NULL)
+			lua_state = CreateLuaState(states);
+		evaluations++;
+		if (luaL_dostring(lua_state, ifCondition.c_str()))
+		{
+			fprintf(stderr, "lua error: %s\n", lua_tostring(lua_state, -1));
+			exit(1);
+		}
+		if (lua_tonumber(lua_state, -1) != 0)
+			triggered.insert(ii);
+		lua_settop(lua_state, 0);
+	}
+	if (lua_state != NULL)
+		lua_close(lua_state);
+}
+
+static void EvaluateCompiled(const std::vector<CBlocklyCondition> &compiled, const std::map<uint64_t, std::vector<size_t> > &deviceRules, CBenchState &state, const uint64_t idx, std::set<size_t> &triggered, int &evaluations)
+{
+	std::map<uint64_t, std::vector<size_t> >::const_iterator itt = deviceRules.find(idx);
+	if (itt == deviceRules.end())
+		return;
+	std::vector<size_t>::const_iterator itt2;
+	for (itt2 = itt->second.begin(); itt2 != itt->second.end(); ++itt2)
+	{
+		bool bError;
+		evaluations++;
+		if (compiled[*itt2].Evaluate(state, bError))
+			triggered.insert(*itt2);
+		if (bError)
+		{
+			fprintf(stderr, "compiled rule %d: type error\n", (int)*itt2);
+			exit(1);
+		}
+	}
+}
+
+static double PerSecond(const boost::posix_time::ptime &start, const int count)
+{
+	boost::posix_time::time_duration diff = boost::posix_time::microsec_clock::universal_time() - start;
+	double seconds = (double)diff.total_microseconds() / 1000000.0;
+	return (seconds > 0) ? count / seconds : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int events = (argc > 1) ? atoi(argv[1]) : BENCH_EVENTS;
+	if (events < 1)
+		events = BENCH_EVENTS;
+	srand(1);
+
+	_tBenchStates states;
+	for (int ii = 1; ii <= SWITCH_DEVICES; ii++)
+		states.switches[ii] = (rand() % 2) ? "On" : "Off";
+	for (int ii = 1; ii <= TEMP_DEVICES; ii++)
+		states.temperatures[SWITCH_DEVICES + ii] = 15.0f + (float)(rand() % 100) / 10.0f;
+	for (int ii = 1; ii <= VARIABLES; ii++)
+		states.variables[1000 + ii] = rand() % 20;
+
+	//what CEventSystem::LoadEvents/CompileBlockly do once
+	std::vector<std::string> rules;
+	std::vector<CBlocklyCondition> compiled(BENCH_RULES);
+	std::map<uint64_t, std::vector<size_t> > deviceRules;
+	for (int ii = 0; ii < BENCH_RULES; ii++)
+	{
+		rules.push_back(MakeRule(ii));
+		if (!compiled[ii].Compile(rules[ii]))
+		{
+			fprintf(stderr, "rule %d not compiled: %s\n", ii, rules[ii].c_str());
+			return 1;
+		}
+		std::set<uint64_t> devices, variables;
+		CBlocklyCondition::GetReferences(rules[ii], devices, variables);
+		std::set<uint64_t>::const_iterator itt;
+		for (itt = devices.begin(); itt != devices.end(); ++itt)
+			deviceRules[*itt].push_back(ii);
+	}
+
+	std::vector<uint64_t> eventIdx;
+	for (int ii = 0; ii < events; ii++)
+		eventIdx.push_back((rand() % 5) ? SwitchIdx() : TempIdx());
+
+	std::vector<std::set<size_t> > luaTriggered(events), compiledTriggered(events);
+	int luaEvaluations = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int ii = 0; ii < events; ii++)
+		EvaluateLua(rules, states, eventIdx[ii], luaTriggered[ii], luaEvaluations);
+	double luaEvents = PerSecond(start, events);
+	double luaRules = PerSecond(start, luaEvaluations);
+
+	CBenchState state(states);
+	int compiledEvaluations = 0;
+	start = boost::posix_time::microsec_clock::universal_time();
+	for (int ii = 0; ii < events; ii++)
+		EvaluateCompiled(compiled, deviceRules, state, eventIdx[ii], compiledTriggered[ii], compiledEvaluations);
+	double compiledEvents = PerSecond(start, events);
+	double compiledRules = PerSecond(start, compiledEvaluations);
+
+	printf("rules=%d\n", BENCH_RULES);
+	printf("events=%d\n", events);
+	printf("lua_rule_evaluations=%d\n", luaEvaluations);
+	printf("lua_events_per_second=%.0f\n", luaEvents);
+	printf("lua_rule_evaluations_per_second=%.0f\n", luaRules);
+	printf("compiled_rule_evaluations=%d\n", compiledEvaluations);
+	printf("compiled_events_per_second=%.0f\n", compiledEvents);
+	printf("compiled_rule_evaluations_per_second=%.0f\n", compiledRules);
+
+	//both have to trigger exactly the same rules
+	for (int ii = 0; ii < events; ii++)
+	{
+		if (luaTriggered[ii] != compiledTriggered[ii])
+		{
+			fprintf(stderr, "event %d (idx %d): lua and compiled rules trigger different rules!\n", ii, (int)eventIdx[ii]);
+			return 1;
+		}
+	}
+	if (compiledRules < luaRules)
+	{
+		fprintf(stderr, "compiled rules are slower than Lua!\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,308 @@
+//MySensors gateway log replay. Boots MainWorker on an in-memory database and feeds a serial gateway log through
+//MySensorsBase::ParseData line by line. Prints lines per second, the time per line and the queries on the
+//MySensorsVars/MySensorsChilds tables, and checks the rows written back against the last values in the log.
+//usage: bench_mysensors gateway.log [passes]
+#include "stdafx.h"
+#include <fstream>
+#include <sstream>
+#include "../main/mainworker.h"
+#include "../main/Logger.h"
+#include "../main/Helper.h"
+#include "../main/SQLHelper.h"
+#include "../main/Metrics.h"
+#include "../main/DeviceSnapshot.h"
+#include "../main/WebServerHelper.h"
+#include "../hardware/MySensorsBase.h"
+#include "../hardware/hardwaretypes.h"
+#include "../notifications/NotificationHelper.h"
+#include "../webserver/server_settings.hpp"
+#include "../json/json.h"
+
+#define BENCH_PASSES 20
+
+static int g_gatewayWrites = 0;
+
+//The globals main/domoticz.cpp defines for the application
+std::string szStartupFolder;
+std::string szUserDataFolder;
+std::string szWWWFolder;
+std::string szWebRoot;
+bool bHasInternalTemperature = false;
+std::string szInternalTemperatureCommand = "";
+bool bHasInternalVoltage = false;
+std::string szInternalVoltageCommand = "";
+bool bHasInternalCurrent = false;
+std::string szInternalCurrentCommand = "";
+std::string szAppVersion = "bench";
+std::string szAppHash = "???";
+std::string szAppDate = "???";
+int ActYear;
+time_t m_StartTime = time(NULL);
+CMetrics m_metrics;
+CDeviceSnapshots m_devicesnapshots;
+MainWorker m_mainworker;
+CLogger _log;
+http::server::CWebServerHelper m_webservers;
+CSQLHelper m_sql;
+CNotificationHelper m_notifications;
+std::string logfile = "";
+bool g_bStopApplication = false;
+bool g_bUseSyslog = false;
+bool g_bRunAsDaemon = false;
+bool g_bDontCacheWWW = false;
+int pidFilehandle = 0;
+
+//A gateway without a transport, what it would send to the gateway is only counted
+class CBenchMySensors : public MySensorsBase
+{
+public:
+	explicit CBenchMySensors(const int ID)
+	{
+		m_HwdID = ID;
+		HwdType = HTYPE_MySensorsUSB;
+		Name = "Bench MySensors";
+		m_bSkipReceiveCheck = true;
+	}
+	void Parse(const std::string &line)
+	{
+		ParseData((const unsigned char*)line.c_str(), (int)line.size());
+	}
+private:
+	void WriteInt(const std::string &sendStr)
+	{
+		g_gatewayWrites++;
+	}
+	bool StartHardware()
+	{
+		LoadDevicesFromDatabase();
+		StartSendQueue();
+		m_bIsStarted = true;
+		sOnConnected(this);
+		return true;
+	}
+	bool StopHardware()
+	{
+		if (m_bIsStarted)
+			StopSendQueue();
+		m_bIsStarted = false;
+		return true;
+	}
+};
+
+//Frames are handled in order, once the one this sends is done all frames of the gateway before it are
+class CBenchBarrier : public CDomoticzHardwareBase
+{
+public:
+	explicit CBenchBarrier(const int ID)
+	{
+		m_HwdID = ID;
+		HwdType = HTYPE_Dummy;
+		Name = "Bench barrier";
+		m_bSkipReceiveCheck = true;
+	}
+	bool WriteToHardware(const char *pdata, const unsigned char length)
+	{
+		return true;
+	}
+	void Wait()
+	{
+		_tGeneralDevice gDevice;
+		gDevice.subtype = sTypePercentage;
+		gDevice.intval1 = 1;
+		gDevice.floatval1 = 0;
+		m_mainworker.PushAndWaitRxMessage(this, (const unsigned char *)&gDevice, "Bench barrier", 255);
+	}
+private:
+	bool StartHardware()
+	{
+		m_bIsStarted = true;
+		return true;
+	}
+	bool StopHardware()
+	{
+		m_bIsStarted = false;
+		return true;
+	}
+};
+
+static int AddHardware(const char *szName, const int HwdType)
+{
+	m_sql.safe_query("INSERT INTO Hardware (Name, Enabled, Type, Address, Port, SerialPort, Username, Password, Mode1, Mode2, Mode3, Mode4, Mode5, Mode6) "
+		"VALUES ('%q', 1, %d, '', 0, '', '', '', 0, 0, 0, 0, 0, 0)", szName, HwdType);
+	std::vector<std::vector<std::string> > result = m_sql.safe_query("SELECT MAX(ID) FROM Hardware");
+	return (result.empty()) ? 0 : atoi(result[0][0].c_str());
+}
+
+//Statements run so far on the MySensorsVars/MySensorsChilds tables, only the ones starting with szVerb if given
+static uint64_t CountRegistryQueries(const char *szVerb)
+{
+	Json::Value root;
+	m_metrics.GetJson(root);
+	uint64_t total = 0;
+	for (Json::ArrayIndex ii = 0; ii < root.size(); ii++)
+	{
+		if (root[ii]["Name"].asString() != "sql_query")
+			continue;
+		std::string statement = root[ii]["LabelValue"].asString();
+		if ((statement.find("MySensorsVars") == std::string::npos) && (statement.find("MySensorsChilds") == std::string::npos))
+			continue;
+		if ((szVerb != NULL) && (statement.find(szVerb) != 0))
+			continue;
+		total += root[ii]["Count"].asUInt64();
+	}
+	return total;
+}
+
+static uint64_t NowUs()
+{
+	return (uint64_t)(boost::posix_time::microsec_clock::universal_time() - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_microseconds();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: bench_mysensors gateway.log [passes]\n");
+		return 1;
+	}
+	std::ifstream infile(argv[1], std::ios::in | std::ios::binary);
+	if (!infile.is_open())
+	{
+		fprintf(stderr, "can not open %s\n", argv[1]);
+		return 1;
+	}
+	std::stringstream sstr;
+	sstr << infile.rdbuf();
+	std::vector<std::string> lines;
+	StringSplit(sstr.str(), "\n", lines);
+	int passes = (argc > 2) ? atoi(argv[2]) : BENCH_PASSES;
+	if (passes < 1)
+		passes = BENCH_PASSES;
+
+	//the last value of every custom variable and the last presentation of every child, as written back at the end
+	std::map<std::string, std::string> expectedVars;
+	std::map<std::string, std::string> expectedChilds;
+	std::vector<std::string>::const_iterator itt;
+	for (itt = lines.begin(); itt != lines.end(); ++itt)
+	{
+		std::vector<std::string> fields;
+		StringSplit(*itt, ";", fields);
+		if (fields.size() < 6)
+			continue;
+		int subType = atoi(fields[4].c_str());
+		if ((fields[2] == "1") && (subType >= MySensorsBase::V_VAR1) && (subType <= MySensorsBase::V_VAR5))
+			expectedVars[fields[0] + ";" + fields[1] + ";" + fields[4]] = fields[5];
+		else if ((fields[2] == "0") && (fields[0] != "0") && (fields[1] != "255"))
+			expectedChilds[fields[0] + ";" + fields[1]] = fields[4] + ";" + fields[5];
+	}
+
+	_log.SetVerboseLevel(VBL_ERROR);
+	szStartupFolder = "./";
+	szUserDataFolder = "./";
+	szWWWFolder = "./www";
+	m_sql.SetDatabaseName(":memory:");
+	http::server::server_settings webserver_settings;
+	webserver_settings.listening_port = "0";
+	m_mainworker.SetWebserverSettings(webserver_settings);
+#ifdef WWW_ENABLE_SSL
+	http::server::ssl_server_settings secure_webserver_settings;
+	secure_webserver_settings.listening_port = "0";
+	m_mainworker.SetSecureWebserverSettings(secure_webserver_settings);
+#endif
+	if (!m_mainworker.Start())
+	{
+		fprintf(stderr, "MainWorker did not start\n");
+		return 1;
+	}
+
+	const int HwdID = AddHardware("Bench MySensors", HTYPE_MySensorsUSB);
+	const int BarrierID = AddHardware("Bench barrier", HTYPE_Dummy);
+	if ((HwdID < 1) || (BarrierID < 1))
+	{
+		fprintf(stderr, "no bench hardware\n");
+		return 1;
+	}
+	CBenchMySensors *pGateway = new CBenchMySensors(HwdID);
+	m_mainworker.AddDomoticzHardware(pGateway);
+	pGateway->Start();
+	CBenchBarrier *pBarrier = new CBenchBarrier(BarrierID);
+	m_mainworker.AddDomoticzHardware(pBarrier);
+	pBarrier->Start();
+
+	//the first pass presents the nodes and creates the devices, the timed passes replay the log on a known network
+	for (itt = lines.begin(); itt != lines.end(); ++itt)
+		pGateway->Parse(*itt + "\n");
+	pBarrier->Wait();
+
+	const uint64_t selectsBefore = CountRegistryQueries("SELECT");
+	CMetricHistogram *pLine = m_metrics.GetHistogram("bench_mysensors_line");
+	uint64_t start = NowUs();
+	for (int ii = 0; ii < passes; ii++)
+	{
+		for (itt = lines.begin(); itt != lines.end(); ++itt)
+		{
+			const std::string line = *itt + "\n";
+			uint64_t begin = NowUs();
+			pGateway->Parse(line);
+			pLine->Record(NowUs() - begin);
+		}
+	}
+	uint64_t done = NowUs();
+	const uint64_t registrySelects = CountRegistryQueries("SELECT") - selectsBefore;
+	pBarrier->Wait();
+
+	//stopping flushes the registry
+	m_mainworker.RemoveDomoticzHardware(pGateway);
+	const uint64_t registryWrites = CountRegistryQueries("INSERT") + CountRegistryQueries("UPDATE");
+
+	std::vector<std::vector<std::string> > result;
+	int wrongVars = 0;
+	std::map<std::string, std::string>::const_iterator ittExp;
+	for (ittExp = expectedVars.begin(); ittExp != expectedVars.end(); ++ittExp)
+	{
+		std::vector<std::string> key;
+		StringSplit(ittExp->first, ";", key);
+		result = m_sql.safe_query("SELECT [Value] FROM MySensorsVars WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d) AND (VarID=%d)",
+			HwdID, atoi(key[0].c_str()), atoi(key[1].c_str()), atoi(key[2].c_str()));
+		if ((result.size() != 1) || (result[0][0] != ittExp->second))
+			wrongVars++;
+	}
+	int wrongChilds = 0;
+	for (ittExp = expectedChilds.begin(); ittExp != expectedChilds.end(); ++ittExp)
+	{
+		std::vector<std::string> key;
+		StringSplit(ittExp->first, ";", key);
+		result = m_sql.safe_query("SELECT [Type], [Name] FROM MySensorsChilds WHERE (HardwareID=%d) AND (NodeID=%d) AND (ChildID=%d)",
+			HwdID, atoi(key[0].c_str()), atoi(key[1].c_str()));
+		if ((result.size() != 1) || (result[0][0] + ";" + result[0][1] != ittExp->second))
+			wrongChilds++;
+	}
+
+	CMetricHistogram::_tSnapshot latency;
+	pLine->GetSnapshot(latency);
+	const double totalLines = (double)lines.size() * passes;
+	result = m_sql.safe_query("SELECT COUNT(*) FROM DeviceStatus WHERE (HardwareID==%d)", HwdID);
+	printf("log_lines=%d\n", (int)lines.size());
+	printf("passes=%d\n", passes);
+	printf("devices=%s\n", (result.empty()) ? "0" : result[0][0].c_str());
+	printf("lines_per_second=%.0f\n", (done > start) ? totalLines * 1000000.0 / (done - start) : 0);
+	printf("line_p50_us=%llu\n", (unsigned long long)latency.p50);
+	printf("line_p99_us=%llu\n", (unsigned long long)latency.p99);
+	printf("line_max_us=%llu\n", (unsigned long long)latency.max);
+	printf("registry_selects=%llu\n", (unsigned long long)registrySelects);
+	printf("registry_writes=%llu\n", (unsigned long long)registryWrites);
+	printf("gateway_writes=%d\n", g_gatewayWrites);
+	printf("vars=%d\n", (int)expectedVars.size());
+	printf("childs=%d\n", (int)expectedChilds.size());
+
+	m_mainworker.Stop();
+
+	//ParseLine reads the registry from memory, and every value ends in the database once
+	if ((registrySelects > 0) || (wrongVars > 0) || (wrongChilds > 0))
+	{
+		fprintf(stderr, "%llu registry selects while replaying, %d of %d vars and %d of %d childs not written back\n",
+			(unsigned long long)registrySelects, wrongVars, (int)expectedVars.size(), wrongChilds, (int)expectedChilds.size());
+		return 1;
+	}
+	return 0;
+}
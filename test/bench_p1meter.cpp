@@ -0,0 +1,223 @@
+//P1 smart meter parser: telegrams per second, and random corruption of a DSMR5 telegram fed in random chunk sizes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../main/Logger.h"
+#include "../main/SQLHelper.h"
+#include "../main/localtime_r.h"
+#include "../hardware/P1MeterBase.h"
+
+#define BENCH_TELEGRAMS 20000
+#define FUZZ_ROUNDS 20000
+
+//The application parts the parser uses, the benchmark only needs them to link
+CLogger _log;
+CLogger::CLogger(void) {}
+CLogger::~CLogger(void) {}
+void CLogger::Log(const _eLogLevel level, const char* logline, ...) {}
+bool CLogger::isTraceEnabled() { return false; }
+CSQLHelper m_sql;
+CSQLHelper::CSQLHelper(void) {}
+CSQLHelper::~CSQLHelper(void) {}
+std::vector<std::vector<std::string> > CSQLHelper::safe_query(const char *fmt, ...) { return std::vector<std::vector<std::string> >(); }
+time_t mytime(time_t * _Time) { return time(_Time); }
+CDomoticzHardwareBase::CDomoticzHardwareBase() {}
+CDomoticzHardwareBase::~CDomoticzHardwareBase() {}
+void CDomoticzHardwareBase::BeginBatch() {}
+void CDomoticzHardwareBase::EndBatch() {}
+void CDomoticzHardwareBase::SendVoltageSensor(const int NodeID, const int ChildID, const int BatteryLevel, const float Volt, const std::string &defaultname) {}
+
+//DSMR 5.0 telegram without the CRC, the values below are what it has to publish
+static const char *Telegram =
+	"/ISk5\\2MT382-1000\r\n"
+	"\r\n"
+	"1-3:0.2.8(50)\r\n"
+	"0-0:1.0.0(101209113020W)\r\n"
+	"0-0:96.1.1(4B384547303034303436333935353037)\r\n"
+	"1-0:1.8.1(123456.789*kWh)\r\n"
+	"1-0:1.8.2(123456.789*kWh)\r\n"
+	"1-0:2.8.1(123456.789*kWh)\r\n"
+	"1-0:2.8.2(123456.789*kWh)\r\n"
+	"0-0:96.14.0(0002)\r\n"
+	"1-0:1.7.0(01.193*kW)\r\n"
+	"1-0:2.7.0(00.000*kW)\r\n"
+	"0-0:96.7.21(00004)\r\n"
+	"0-0:96.7.9(00002)\r\n"
+	"1-0:99.97.0(2)(0-0:96.7.19)(101208152415W)(0000000240*s)(101208151004W)(0000000301*s)\r\n"
+	"1-0:32.32.0(00002)\r\n"
+	"1-0:32.7.0(220.1*V)\r\n"
+	"1-0:52.7.0(220.2*V)\r\n"
+	"1-0:72.7.0(220.3*V)\r\n"
+	"1-0:31.7.0(001*A)\r\n"
+	"1-0:21.7.0(01.111*kW)\r\n"
+	"1-0:22.7.0(00.000*kW)\r\n"
+	"0-1:24.1.0(003)\r\n"
+	"0-1:96.1.0(3232323241424344313233343536373839)\r\n"
+	"0-1:24.2.1(101209112500W)(12785.123*m3)\r\n"
+	"!";
+
+class CBenchP1Meter : public P1MeterBase
+{
+public:
+	CBenchP1Meter() : m_telegrams(0)
+	{
+		Init();
+		sDecodeRXMessage.connect(boost::bind(&CBenchP1Meter::OnRXMessage, this, _2));
+	}
+	bool WriteToHardware(const char *pdata, const unsigned char length) { return true; }
+	void Parse(const std::string &data) { ParseData((const unsigned char*)data.c_str(), (int)data.size(), false, 0); }
+	int m_telegrams;
+	P1Power m_last;
+private:
+	bool StartHardware() { return true; }
+	bool StopHardware() { return true; }
+	void OnRXMessage(const unsigned char *pRXCommand)
+	{
+		if (pRXCommand[1] != pTypeP1Power)
+			return;
+		m_telegrams++;
+		memcpy(&m_last, pRXCommand, sizeof(P1Power));
+	}
+};
+
+//CRC16/ARC from the '/' up to and including the '!', bit by bit as the DSMR specification describes it
+static std::string AddCRC(const std::string &telegram)
+{
+	uint16_t crc = 0;
+	for (size_t ii = 0; ii < telegram.size(); ii++)
+	{
+		crc ^= (unsigned char)telegram[ii];
+		for (int jj = 0; jj < 8; jj++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+	}
+	char szCRC[10];
+	sprintf(szCRC, "%04X\r\n", crc);
+	return telegram + szCRC;
+}
+
+static bool IsExpected(const P1Power &power)
+{
+	return (power.powerusage1 == 123456789) && (power.powerusage2 == 123456789) && (power.powerdeliv1 == 123456789) && (power.powerdeliv2 == 123456789)
+		&& (power.usagecurrent == 1193) && (power.delivcurrent == 0);
+}
+
+//The way P1MeterTCP (any chunk size) or P1MeterSerial (small reads) hands data to the parser
+static void ParseChunked(CBenchP1Meter &meter, const std::string &data)
+{
+	size_t pos = 0;
+	while (pos < data.size())
+	{
+		size_t len = 1 + (rand() % 64);
+		meter.Parse(data.substr(pos, len));
+		pos += len;
+	}
+}
+
+static std::string Corrupt(const std::string &telegram)
+{
+	std::string data = telegram;
+	int changes = 1 + (rand() % 4);
+	for (int ii = 0; ii < changes; ii++)
+	{
+		size_t pos = rand() % data.size();
+		switch (rand() % 6)
+		{
+		case 0:
+			data[pos] = (char)(rand() % 256);
+			break;
+		case 1:
+			data[pos] ^= (char)(1 << (rand() % 8));
+			break;
+		case 2:
+			data.erase(pos, 1 + (rand() % 20));
+			break;
+		case 3:
+			data.insert(pos, data.substr(rand() % data.size(), 1 + (rand() % 40)));
+			break;
+		case 4:
+			//a line longer than the line buffer
+			data.insert(pos, std::string(100 + (rand() % 300), (char)('0' + (rand() % 10))));
+			break;
+		default:
+			data.resize(pos);
+			break;
+		}
+		if (data.empty())
+			data = "\r\n";
+	}
+	return data;
+}
+
+int main(int argc, char *argv[])
+{
+	int telegrams = (argc > 1) ? atoi(argv[1]) : BENCH_TELEGRAMS;
+	if (telegrams < 1)
+		telegrams = BENCH_TELEGRAMS;
+	srand(1);
+	const std::string telegram = AddCRC(Telegram);
+
+	//a complete telegram per read, as P1MeterTCP mostly gets it
+	CBenchP1Meter meter;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int ii = 0; ii < telegrams; ii++)
+		meter.Parse(telegram);
+	double us = (double)(boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+	if ((meter.m_telegrams != telegrams) || (!IsExpected(meter.m_last)))
+	{
+		fprintf(stderr, "%d of %d valid telegrams published with the expected values!\n", meter.m_telegrams, telegrams);
+		return 1;
+	}
+
+	//the same telegram in random chunks has to give the same result
+	CBenchP1Meter chunked;
+	for (int ii = 0; ii < 1000; ii++)
+		ParseChunked(chunked, telegram);
+	if ((chunked.m_telegrams != 1000) || (!IsExpected(chunked.m_last)))
+	{
+		fprintf(stderr, "%d of 1000 chunked telegrams published with the expected values!\n", chunked.m_telegrams);
+		return 1;
+	}
+
+	//corrupted telegrams may not publish wrong values, and the next valid telegram has to be read again
+	CBenchP1Meter fuzzed;
+	int wrongValues = 0;
+	int notRecovered = 0;
+	for (int ii = 0; ii < FUZZ_ROUNDS; ii++)
+	{
+		int before = fuzzed.m_telegrams;
+		ParseChunked(fuzzed, Corrupt(telegram));
+		if ((fuzzed.m_telegrams != before) && (!IsExpected(fuzzed.m_last)))
+			wrongValues++;
+		before = fuzzed.m_telegrams;
+		ParseChunked(fuzzed, telegram);
+		if ((fuzzed.m_telegrams == before) || (!IsExpected(fuzzed.m_last)))
+			notRecovered++;
+	}
+
+	printf("telegrams=%d\n", telegrams);
+	printf("telegram_bytes=%d\n", (int)telegram.size());
+	printf("us_per_telegram=%.2f\n", us / telegrams);
+	printf("telegrams_per_second=%.0f\n", (us > 0) ? telegrams * 1000000.0 / us : 0);
+	printf("fuzz_rounds=%d\n", FUZZ_ROUNDS);
+	printf("fuzz_wrong_values=%d\n", wrongValues);
+	printf("fuzz_not_recovered=%d\n", notRecovered);
+
+	if (wrongValues > 0)
+	{
+		fprintf(stderr, "corrupted telegrams published wrong values!\n");
+		return 1;
+	}
+	if (notRecovered > 0)
+	{
+		fprintf(stderr, "the parser did not recover after a corrupted telegram!\n");
+		return 1;
+	}
+	return 0;
+}
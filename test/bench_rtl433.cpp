@@ -0,0 +1,163 @@
+//rtl_433 JSON output parser: lines per second over a capture file, read sizes and over-long lines
+//usage: bench_rtl433 capture.json [passes]
+#include "stdafx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../main/Logger.h"
+#include "../main/Helper.h"
+#include "../hardware/Rtl433.h"
+
+#define BENCH_PASSES 200
+
+static int g_sent = 0;
+static int g_errors = 0;
+static int g_tooLong = 0;
+
+//The application parts the parser uses, the benchmark only needs them to link
+CLogger _log;
+CLogger::CLogger(void) {}
+CLogger::~CLogger(void) {}
+void CLogger::Log(const _eLogLevel level, const char* logline, ...)
+{
+	if (level != LOG_ERROR)
+		return;
+	if (strstr(logline, "too long") != NULL)
+		g_tooLong++;
+	else
+		g_errors++;
+}
+bool CLogger::isTraceEnabled() { return false; }
+CDomoticzHardwareBase::CDomoticzHardwareBase() {}
+CDomoticzHardwareBase::~CDomoticzHardwareBase() {}
+void CDomoticzHardwareBase::StartHeartbeatThread() {}
+void CDomoticzHardwareBase::StopHeartbeatThread() {}
+void CDomoticzHardwareBase::SendTempSensor(const int NodeID, const int BatteryLevel, const float temperature, const std::string &defaultname, const int RssiLevel) { g_sent++; }
+void CDomoticzHardwareBase::SendHumiditySensor(const int NodeID, const int BatteryLevel, const int humidity, const std::string &defaultname, const int RssiLevel) { g_sent++; }
+void CDomoticzHardwareBase::SendTempHumSensor(const int NodeID, const int BatteryLevel, const float temperature, const int humidity, const std::string &defaultname, const int RssiLevel) { g_sent++; }
+void CDomoticzHardwareBase::SendTempHumBaroSensor(const int NodeID, const int BatteryLevel, const float temperature, const int humidity, const float pressure, int forecast, const std::string &defaultname, const int RssiLevel) { g_sent++; }
+void CDomoticzHardwareBase::SendSwitch(const int NodeID, const int ChildID, const int BatteryLevel, const bool bOn, const double Level, const std::string &defaultname, const int RssiLevel) { g_sent++; }
+void CDomoticzHardwareBase::SendRainSensor(const int NodeID, const int BatteryLevel, const float RainCounter, const std::string &defaultname, const int RssiLevel) { g_sent++; }
+void CDomoticzHardwareBase::SendDistanceSensor(const int NodeID, const int ChildID, const int BatteryLevel, const float distance, const std::string &defaultname) { g_sent++; }
+
+class CBenchRtl433 : public CRtl433
+{
+public:
+	CBenchRtl433() : CRtl433(1, "") {}
+	bool Parse(const std::string &data) { return ParseData(data.c_str(), data.size()); }
+};
+
+//The way Do_Work hands over what read() returned, at most 1024 bytes and ending anywhere
+static void ParseChunked(CBenchRtl433 &rtl433, const std::string &data)
+{
+	size_t pos = 0;
+	while (pos < data.size())
+	{
+		size_t len = 1 + (rand() % 1024);
+		rtl433.Parse(data.substr(pos, len));
+		pos += len;
+	}
+}
+
+static void ResetCounters()
+{
+	g_sent = 0;
+	g_errors = 0;
+	g_tooLong = 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: bench_rtl433 capture.json [passes]\n");
+		return 1;
+	}
+	std::ifstream infile(argv[1], std::ios::in | std::ios::binary);
+	if (!infile.is_open())
+	{
+		fprintf(stderr, "can not open %s\n", argv[1]);
+		return 1;
+	}
+	std::stringstream sstr;
+	sstr << infile.rdbuf();
+	const std::string capture = sstr.str();
+	std::vector<std::string> lines;
+	StringSplit(capture, "\n", lines);
+	int passes = (argc > 2) ? atoi(argv[2]) : BENCH_PASSES;
+	if (passes < 1)
+		passes = BENCH_PASSES;
+	srand(1);
+
+	//one line per read, the reference result
+	ResetCounters();
+	{
+		CBenchRtl433 rtl433;
+		std::vector<std::string>::const_iterator itt;
+		for (itt = lines.begin(); itt != lines.end(); ++itt)
+			rtl433.Parse(*itt + "\n");
+	}
+	const int sent = g_sent;
+	if ((g_errors > 0) || (g_tooLong > 0) || (sent == 0))
+	{
+		fprintf(stderr, "capture not parsed, %d errors, %d lines too long, %d sensor updates\n", g_errors, g_tooLong, sent);
+		return 1;
+	}
+
+	//reads that end in the middle of a line have to give the same result
+	ResetCounters();
+	{
+		CBenchRtl433 rtl433;
+		ParseChunked(rtl433, capture);
+	}
+	if ((g_sent != sent) || (g_errors > 0) || (g_tooLong > 0))
+	{
+		fprintf(stderr, "chunked reads: %d sensor updates instead of %d, %d errors\n", g_sent, sent, g_errors);
+		return 1;
+	}
+
+	//the rest of a line that was too long is skipped up to its end, the next line is read again
+	ResetCounters();
+	{
+		CBenchRtl433 rtl433;
+		std::string longLine = "{\"time\" : \"2017-11-04 18:00:00\", \"model\" : \"Noise\", \"codes\" : [";
+		while (longLine.size() < 5000)
+			longLine += "{\"len\" : 25, \"data\" : \"0a1b2c\"}, ";
+		longLine += "{}]}\n";
+		ParseChunked(rtl433, lines[0] + "\n" + longLine + "{\"model\" : \"Nexus Temperature\", \"id\" : 99, \"channel\" : 1, \"temperature_C\" : 12.5}\n");
+	}
+	const int longLineSent = g_sent;
+	const int longLineErrors = g_errors;
+	const int longLineTooLong = g_tooLong;
+
+	//throughput, a new hardware per pass so the repeats of the capture are not taken as duplicates
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int ii = 0; ii < passes; ii++)
+	{
+		CBenchRtl433 rtl433;
+		ParseChunked(rtl433, capture);
+	}
+	double us = (double)(boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+	double totalLines = (double)lines.size() * passes;
+
+	printf("capture_lines=%d\n", (int)lines.size());
+	printf("capture_bytes=%d\n", (int)capture.size());
+	printf("sensor_updates=%d\n", sent);
+	printf("passes=%d\n", passes);
+	printf("us_per_line=%.2f\n", (totalLines > 0) ? us / totalLines : 0);
+	printf("lines_per_second=%.0f\n", (us > 0) ? totalLines * 1000000.0 / us : 0);
+	printf("mb_per_second=%.1f\n", (us > 0) ? (double)capture.size() * passes / us : 0);
+	printf("long_line_errors=%d\n", longLineErrors);
+
+	if ((longLineTooLong != 1) || (longLineErrors > 0) || (longLineSent != 2))
+	{
+		fprintf(stderr, "line too long: %d reported, %d invalid lines, %d of 2 sensor updates\n", longLineTooLong, longLineErrors, longLineSent);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,160 @@
+//Allocations and time per message of the RX message queue, the copying queue it replaced against the pooled frame queue
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <new>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../main/concurrent_queue.h"
+
+#define RX_FRAME_SIZE 256
+#define BENCH_MESSAGES 200000
+#define BENCH_WARMUP 1000
+
+static volatile unsigned long g_allocations = 0;
+
+void *operator new(size_t size)
+{
+	g_allocations++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) throw()
+{
+	free(p);
+}
+
+//queue item as MainWorker used it before the pooled frames
+struct _tCopyQueueItem {
+	std::string Name;
+	int BatteryLevel;
+	unsigned long rxMessageIdx;
+	int hardwareId;
+	std::vector<unsigned char> vrxCommand;
+	unsigned short crc;
+	queue_element_trigger* trigger;
+};
+
+//queue item as MainWorker uses it now
+struct _tPooledQueueItem {
+	_tPooledQueueItem *next;
+	std::string Name;
+	int BatteryLevel;
+	unsigned long rxMessageIdx;
+	int hardwareId;
+	unsigned char rxCommand[RX_FRAME_SIZE];
+	unsigned short crc;
+	unsigned char batchFlags;
+	queue_element_trigger* trigger;
+};
+
+//TEMP_HUM frame (pTypeTEMP_HUM/sTypeTH5)
+static const unsigned char RXFrame[] = { 0x0A, 0x52, 0x05, 0x00, 0x12, 0x34, 0x00, 0xD2, 0x37, 0x02, 0x69 };
+static const char *RXName = "Temp + Humidity";
+
+static double Elapsed(const boost::posix_time::ptime &start, const int messages)
+{
+	boost::posix_time::time_duration diff = boost::posix_time::microsec_clock::universal_time() - start;
+	return (double)diff.total_microseconds() * 1000.0 / messages;
+}
+
+static void RunCopyQueue(const int messages, double &allocsPerMessage, double &nsPerMessage)
+{
+	concurrent_queue<_tCopyQueueItem> queue;
+	unsigned long allocations = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int ii = 0; ii < BENCH_WARMUP + messages; ii++)
+	{
+		if (ii == BENCH_WARMUP)
+		{
+			allocations = g_allocations;
+			start = boost::posix_time::microsec_clock::universal_time();
+		}
+		//the same steps as the old CheckAndPushRxMessage / Do_Work_On_Rx_Messages
+		_tCopyQueueItem rxMessage;
+		rxMessage.Name = RXName;
+		rxMessage.BatteryLevel = 255;
+		rxMessage.rxMessageIdx = ii;
+		rxMessage.hardwareId = 1;
+		rxMessage.vrxCommand.resize(RXFrame[0] + 1);
+		rxMessage.vrxCommand.insert(rxMessage.vrxCommand.begin(), RXFrame, RXFrame + RXFrame[0] + 1);
+		rxMessage.crc = 0;
+		rxMessage.trigger = NULL;
+		queue.push(rxMessage);
+
+		_tCopyQueueItem rxQItem;
+		if (!queue.timed_wait_and_pop<>(rxQItem, boost::posix_time::milliseconds(100)))
+		{
+			fprintf(stderr, "copy queue: message lost\n");
+			exit(1);
+		}
+	}
+	allocsPerMessage = (double)(g_allocations - allocations) / messages;
+	nsPerMessage = Elapsed(start, messages);
+}
+
+static void RunPooledQueue(const int messages, double &allocsPerMessage, double &nsPerMessage)
+{
+	concurrent_pooled_queue<_tPooledQueueItem> queue;
+	unsigned long allocations = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int ii = 0; ii < BENCH_WARMUP + messages; ii++)
+	{
+		if (ii == BENCH_WARMUP)
+		{
+			allocations = g_allocations;
+			start = boost::posix_time::microsec_clock::universal_time();
+		}
+		//the same steps as CheckAndPushRxMessage / Do_Work_On_Rx_Messages
+		_tPooledQueueItem *rxMessage = queue.allocate();
+		rxMessage->Name = RXName;
+		rxMessage->BatteryLevel = 255;
+		rxMessage->rxMessageIdx = ii;
+		rxMessage->hardwareId = 1;
+		memcpy(rxMessage->rxCommand, RXFrame, RXFrame[0] + 1);
+		rxMessage->crc = 0;
+		rxMessage->batchFlags = 0;
+		rxMessage->trigger = NULL;
+		queue.push(rxMessage);
+
+		_tPooledQueueItem *rxQItem = queue.timed_wait_and_pop<>(boost::posix_time::milliseconds(100));
+		if (rxQItem == NULL)
+		{
+			fprintf(stderr, "pooled queue: message lost\n");
+			exit(1);
+		}
+		queue.release(rxQItem);
+	}
+	allocsPerMessage = (double)(g_allocations - allocations) / messages;
+	nsPerMessage = Elapsed(start, messages);
+}
+
+int main(int argc, char *argv[])
+{
+	int messages = (argc > 1) ? atoi(argv[1]) : BENCH_MESSAGES;
+	if (messages < 1)
+		messages = BENCH_MESSAGES;
+
+	double copyAllocs, copyNs, pooledAllocs, pooledNs;
+	RunCopyQueue(messages, copyAllocs, copyNs);
+	RunPooledQueue(messages, pooledAllocs, pooledNs);
+
+	printf("messages=%d\n", messages);
+	printf("copy_queue_allocs_per_message=%.2f\n", copyAllocs);
+	printf("copy_queue_ns_per_message=%.0f\n", copyNs);
+	printf("pooled_queue_allocs_per_message=%.2f\n", pooledAllocs);
+	printf("pooled_queue_ns_per_message=%.0f\n", pooledNs);
+
+	//once warmed up the pooled queue should not allocate at all
+	if (pooledAllocs != 0)
+	{
+		fprintf(stderr, "pooled queue allocates %.2f times per message!\n", pooledAllocs);
+		return 1;
+	}
+	return 0;
+}
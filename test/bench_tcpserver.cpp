@@ -0,0 +1,174 @@
+//Shared server fan-out to 20 slaves, time per SendToAll while one slave does not read anything
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../main/Logger.h"
+#include "../main/localtime_r.h"
+#include "../tcpserver/TCPServer.h"
+
+#define BENCH_SLAVES 20
+//enough data to fill the socket buffers of the slave that does not read
+#define BENCH_FRAMES 400000
+//frames sent before waiting for the reading slaves, below the 1000 frames a client may queue
+#define BENCH_BURST 500
+#define BENCH_PORT "16543"
+#define BENCH_USER "bench"
+#define BENCH_PASSWORD "bench"
+
+//The application parts the shared server uses, the benchmark only needs them to link
+CLogger _log;
+CLogger::CLogger(void) {}
+CLogger::~CLogger(void) {}
+void CLogger::Log(const _eLogLevel level, const char* logline, ...)
+{
+	if (level != LOG_ERROR)
+		return;
+	va_list argList;
+	va_start(argList, logline);
+	vfprintf(stderr, logline, argList);
+	va_end(argList);
+	fprintf(stderr, "\n");
+}
+bool CLogger::isTraceEnabled() { return false; }
+time_t mytime(time_t * _Time) { return time(_Time); }
+CDomoticzHardwareBase::CDomoticzHardwareBase() {}
+CDomoticzHardwareBase::~CDomoticzHardwareBase() {}
+
+//TEMP_HUM frame (pTypeTEMP_HUM/sTypeTH5)
+static const unsigned char TXFrame[] = { 0x0A, 0x52, 0x05, 0x00, 0x12, 0x34, 0x00, 0xD2, 0x37, 0x02, 0x69 };
+
+//Total bytes every reading slave has received at least
+static size_t MinReceived(const std::vector<size_t> &received)
+{
+	size_t minReceived = received[1];
+	for (int ii = 2; ii < BENCH_SLAVES; ii++)
+	{
+		if (received[ii] < minReceived)
+			minReceived = received[ii];
+	}
+	return minReceived;
+}
+
+static void ReadSlave(boost::asio::ip::tcp::socket *pSocket, const size_t expected, size_t *pReceived)
+{
+	char buffer[8192];
+	boost::system::error_code ec;
+	while (*pReceived < expected)
+	{
+		size_t bytes = pSocket->read_some(boost::asio::buffer(buffer), ec);
+		if (ec)
+			return;
+		*pReceived += bytes;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = (argc > 1) ? atoi(argv[1]) : BENCH_FRAMES;
+	if (frames < 1)
+		frames = BENCH_FRAMES;
+
+	tcp::server::CTCPServer server;
+	if (!server.StartServer("127.0.0.1", BENCH_PORT))
+	{
+		fprintf(stderr, "could not start the shared server on port %s\n", BENCH_PORT);
+		return 1;
+	}
+	std::vector<tcp::server::_tRemoteShareUser> users(1);
+	users[0].Username = BENCH_USER;
+	users[0].Password = BENCH_PASSWORD;
+	server.SetRemoteUsers(users);
+
+	//slave 0 logs in but never reads, its socket buffers fill up while the others keep reading
+	boost::asio::io_service ios;
+	boost::asio::ip::tcp::resolver resolver(ios);
+	boost::asio::ip::tcp::resolver::query query("127.0.0.1", BENCH_PORT);
+	boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
+	std::vector<boost::asio::ip::tcp::socket*> slaves;
+	for (int ii = 0; ii < BENCH_SLAVES; ii++)
+	{
+		boost::asio::ip::tcp::socket *pSocket = new boost::asio::ip::tcp::socket(ios);
+		pSocket->connect(endpoint);
+		std::string auth = std::string("AUTH;") + BENCH_USER + ";" + BENCH_PASSWORD;
+		boost::asio::write(*pSocket, boost::asio::buffer(auth));
+		slaves.push_back(pSocket);
+	}
+	//the server handles the logins on its own thread
+	boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+	const size_t expected = (size_t)frames * sizeof(TXFrame);
+	std::vector<size_t> received(BENCH_SLAVES, 0);
+	boost::thread_group readers;
+	for (int ii = 1; ii < BENCH_SLAVES; ii++)
+		readers.create_thread(boost::bind(&ReadSlave, slaves[ii], expected, &received[ii]));
+
+	//the reading slaves have to get every frame, even with the stalled slave dropping data
+	double sendUs = 0;
+	double maxUs = 0;
+	bool bComplete = true;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	boost::posix_time::ptime deadline = start + boost::posix_time::seconds(30);
+	int sent = 0;
+	while ((sent < frames) && (bComplete))
+	{
+		int burst = std::min(BENCH_BURST, frames - sent);
+		for (int ii = 0; ii < burst; ii++)
+		{
+			boost::posix_time::ptime frameStart = boost::posix_time::microsec_clock::universal_time();
+			server.SendToAll(1, 1, (const char*)TXFrame, sizeof(TXFrame), NULL);
+			double us = (double)(boost::posix_time::microsec_clock::universal_time() - frameStart).total_microseconds();
+			sendUs += us;
+			if (us > maxUs)
+				maxUs = us;
+		}
+		sent += burst;
+		while (MinReceived(received) < (size_t)sent * sizeof(TXFrame))
+		{
+			if (boost::posix_time::microsec_clock::universal_time() > deadline)
+			{
+				bComplete = false;
+				break;
+			}
+			boost::this_thread::sleep(boost::posix_time::microseconds(200));
+		}
+	}
+	double deliverUs = (double)(boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+
+	for (int ii = 0; ii < BENCH_SLAVES; ii++)
+	{
+		boost::system::error_code ec;
+		slaves[ii]->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+		slaves[ii]->close(ec);
+	}
+	readers.join_all();
+	server.StopServer();
+	for (int ii = 0; ii < BENCH_SLAVES; ii++)
+		delete slaves[ii];
+
+	printf("slaves=%d\n", BENCH_SLAVES);
+	printf("stalled_slaves=1\n");
+	printf("frames=%d\n", frames);
+	printf("sendtoall_us_per_frame=%.2f\n", sendUs / frames);
+	printf("sendtoall_max_us=%.0f\n", maxUs);
+	printf("delivered_frames_per_second=%.0f\n", (deliverUs > 0) ? frames * 1000000.0 / deliverUs : 0);
+
+	if (!bComplete)
+	{
+		fprintf(stderr, "not all reading slaves received every frame!\n");
+		return 1;
+	}
+	//a slave that does not read may not hold up the sender
+	if (maxUs > 1000000)
+	{
+		fprintf(stderr, "SendToAll blocked for %.0f us!\n", maxUs);
+		return 1;
+	}
+	return 0;
+}
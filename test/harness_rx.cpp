@@ -0,0 +1,406 @@
+//RX pipeline replay harness. Boots MainWorker on an in-memory database with a synthetic hardware driver and feeds
+//generated RFX frames and _tGeneralDevice packets through ProcessRXMessage, UpdateValueInt, the event system and the
+//push subscribers. Prints throughput and end-to-end latency as 'key=value' lines, followed by the pipeline metrics.
+//With p1, the frames are DSMR telegrams parsed by a P1MeterBase, every telegram is one RX batch (one transaction).
+//usage: harness_rx [frames] [frames per second, 0 is as fast as possible] [p1]
+#include "stdafx.h"
+#include "../main/mainworker.h"
+#include "../main/Logger.h"
+#include "../main/SQLHelper.h"
+#include "../main/Metrics.h"
+#include "../main/DeviceSnapshot.h"
+#include "../main/WebServerHelper.h"
+#include "../main/RFXtrx.h"
+#include "../hardware/DomoticzHardware.h"
+#include "../hardware/hardwaretypes.h"
+#include "../hardware/P1MeterBase.h"
+#include "../notifications/NotificationHelper.h"
+#include "../webserver/server_settings.hpp"
+
+#define HARNESS_FRAMES 20000
+#define HARNESS_SENSORS 50
+#define HARNESS_SWITCHES 20
+//every Nth frame is sent and waited for, its time through the pipeline is the end-to-end latency
+#define HARNESS_LATENCY_SAMPLE 100
+
+//The globals main/domoticz.cpp defines for the application
+std::string szStartupFolder;
+std::string szUserDataFolder;
+std::string szWWWFolder;
+std::string szWebRoot;
+bool bHasInternalTemperature = false;
+std::string szInternalTemperatureCommand = "";
+bool bHasInternalVoltage = false;
+std::string szInternalVoltageCommand = "";
+bool bHasInternalCurrent = false;
+std::string szInternalCurrentCommand = "";
+std::string szAppVersion = "harness";
+std::string szAppHash = "???";
+std::string szAppDate = "???";
+int ActYear;
+time_t m_StartTime = time(NULL);
+CMetrics m_metrics;
+CDeviceSnapshots m_devicesnapshots;
+MainWorker m_mainworker;
+CLogger _log;
+http::server::CWebServerHelper m_webservers;
+CSQLHelper m_sql;
+CNotificationHelper m_notifications;
+std::string logfile = "";
+bool g_bStopApplication = false;
+bool g_bUseSyslog = false;
+bool g_bRunAsDaemon = false;
+bool g_bDontCacheWWW = false;
+int pidFilehandle = 0;
+
+//Device script evaluated for every received frame
+static const char *HarnessLuaScript =
+	"commandArray = {}\n"
+	"for deviceName, deviceValue in pairs(devicechanged) do\n"
+	"	if (otherdevices[deviceName] == nil) then\n"
+	"		print('harness: unknown device ' .. deviceName)\n"
+	"	end\n"
+	"end\n"
+	"return commandArray\n";
+
+class CHarnessHardware : public CDomoticzHardwareBase
+{
+public:
+	explicit CHarnessHardware(const int ID)
+	{
+		m_HwdID = ID;
+		HwdType = HTYPE_Dummy;
+		Name = "Harness";
+		m_bSkipReceiveCheck = true;
+	}
+	bool WriteToHardware(const char *pdata, const unsigned char length)
+	{
+		return true;
+	}
+	//temperature/humidity, switch and _tGeneralDevice frames in turn
+	void SendFrame(const int ii, const bool bWait)
+	{
+		RBUF tsen;
+		_tGeneralDevice gDevice;
+		const unsigned char *pFrame = (const unsigned char *)&tsen;
+		const char *defaultName = NULL;
+		memset(&tsen, 0, sizeof(RBUF));
+		switch (ii % 3)
+		{
+		case 0:
+		{
+			int temp = 150 + (ii % 100);
+			tsen.TEMP_HUM.packetlength = sizeof(tsen.TEMP_HUM) - 1;
+			tsen.TEMP_HUM.packettype = pTypeTEMP_HUM;
+			tsen.TEMP_HUM.subtype = sTypeTH5;
+			tsen.TEMP_HUM.seqnbr = (BYTE)ii;
+			tsen.TEMP_HUM.id1 = 0x12;
+			tsen.TEMP_HUM.id2 = (BYTE)((ii / 3) % HARNESS_SENSORS);
+			tsen.TEMP_HUM.temperatureh = (BYTE)(temp / 256);
+			tsen.TEMP_HUM.temperaturel = (BYTE)(temp % 256);
+			tsen.TEMP_HUM.humidity = (BYTE)(40 + (ii % 20));
+			tsen.TEMP_HUM.humidity_status = 1;
+			tsen.TEMP_HUM.battery_level = 9;
+			tsen.TEMP_HUM.rssi = 6;
+			break;
+		}
+		case 1:
+			tsen.LIGHTING2.packetlength = sizeof(tsen.LIGHTING2) - 1;
+			tsen.LIGHTING2.packettype = pTypeLighting2;
+			tsen.LIGHTING2.subtype = sTypeAC;
+			tsen.LIGHTING2.seqnbr = (BYTE)ii;
+			tsen.LIGHTING2.id1 = 0x01;
+			tsen.LIGHTING2.id2 = 0x23;
+			tsen.LIGHTING2.id3 = 0x45;
+			tsen.LIGHTING2.id4 = 0x67;
+			tsen.LIGHTING2.unitcode = (BYTE)(1 + ((ii / 3) % HARNESS_SWITCHES));
+			tsen.LIGHTING2.cmnd = ((ii / 3) % 2) ? light2_sOn : light2_sOff;
+			tsen.LIGHTING2.rssi = 6;
+			break;
+		default:
+			gDevice.subtype = sTypePercentage;
+			//intval1 is the device ID of a percentage sensor
+			gDevice.intval1 = 1 + ((ii / 3) % HARNESS_SENSORS);
+			gDevice.floatval1 = (float)(ii % 100);
+			pFrame = (const unsigned char *)&gDevice;
+			defaultName = "Harness percentage";
+			break;
+		}
+		if (bWait)
+			m_mainworker.PushAndWaitRxMessage(this, pFrame, defaultName, 255);
+		else
+			sDecodeRXMessage(this, pFrame, defaultName, 255);
+	}
+private:
+	bool StartHardware()
+	{
+		m_bIsStarted = true;
+		sOnConnected(this);
+		return true;
+	}
+	bool StopHardware()
+	{
+		m_bIsStarted = false;
+		return true;
+	}
+};
+
+//DSMR 5.0 telegram, power, gas and three voltages, the CRC is added at startup
+static const char *HarnessTelegram =
+	"/ISk5\\2MT382-1000\r\n"
+	"\r\n"
+	"1-3:0.2.8(50)\r\n"
+	"0-0:1.0.0(101209113020W)\r\n"
+	"0-0:96.1.1(4B384547303034303436333935353037)\r\n"
+	"1-0:1.8.1(123456.789*kWh)\r\n"
+	"1-0:1.8.2(123456.789*kWh)\r\n"
+	"1-0:2.8.1(123456.789*kWh)\r\n"
+	"1-0:2.8.2(123456.789*kWh)\r\n"
+	"0-0:96.14.0(0002)\r\n"
+	"1-0:1.7.0(01.193*kW)\r\n"
+	"1-0:2.7.0(00.000*kW)\r\n"
+	"1-0:32.7.0(220.1*V)\r\n"
+	"1-0:52.7.0(220.2*V)\r\n"
+	"1-0:72.7.0(220.3*V)\r\n"
+	"1-0:31.7.0(001*A)\r\n"
+	"0-1:24.1.0(003)\r\n"
+	"0-1:96.1.0(3232323241424344313233343536373839)\r\n"
+	"0-1:24.2.1(101209112500W)(12785.123*m3)\r\n"
+	"!";
+
+class CHarnessP1Meter : public P1MeterBase
+{
+public:
+	explicit CHarnessP1Meter(const int ID)
+	{
+		m_HwdID = ID;
+		HwdType = HTYPE_P1SmartMeter;
+		Name = "Harness P1";
+		m_bSkipReceiveCheck = true;
+		Init();
+	}
+	bool WriteToHardware(const char *pdata, const unsigned char length)
+	{
+		return true;
+	}
+	void Parse(const std::string &data)
+	{
+		ParseData((const unsigned char*)data.c_str(), (int)data.size(), false, 0);
+	}
+private:
+	bool StartHardware()
+	{
+		m_bIsStarted = true;
+		sOnConnected(this);
+		return true;
+	}
+	bool StopHardware()
+	{
+		m_bIsStarted = false;
+		return true;
+	}
+};
+
+//CRC16/ARC from the '/' up to and including the '!'
+static std::string AddCRC(const std::string &telegram)
+{
+	uint16_t crc = 0;
+	for (size_t ii = 0; ii < telegram.size(); ii++)
+	{
+		crc ^= (unsigned char)telegram[ii];
+		for (int jj = 0; jj < 8; jj++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+	}
+	char szCRC[10];
+	sprintf(szCRC, "%04X\r\n", crc);
+	return telegram + szCRC;
+}
+
+static uint64_t NowUs()
+{
+	return (uint64_t)(boost::posix_time::microsec_clock::universal_time() - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_microseconds();
+}
+
+//Telegrams through P1MeterBase::SendTelegram, BeginBatch/EndBatch and the batched RX queue, SQL and event path.
+//The harness hardware frame sent after a telegram is waited for, frames are handled in order so the telegram is then done.
+static int RunP1(CHarnessHardware *pHardware, const int telegrams, const int rate)
+{
+	m_sql.safe_query("INSERT INTO Hardware (Name, Enabled, Type, Address, Port, SerialPort, Username, Password, Mode1, Mode2, Mode3, Mode4, Mode5, Mode6) "
+		"VALUES ('Harness P1', 1, %d, '', 0, '', '', '', 0, 0, 0, 0, 0, 0)", HTYPE_P1SmartMeter);
+	std::vector<std::vector<std::string> > result = m_sql.safe_query("SELECT MAX(ID) FROM Hardware");
+	if (result.empty())
+	{
+		fprintf(stderr, "no harness P1 hardware\n");
+		return 1;
+	}
+	CHarnessP1Meter *pMeter = new CHarnessP1Meter(atoi(result[0][0].c_str()));
+	m_mainworker.AddDomoticzHardware(pMeter);
+	pMeter->Start();
+	const std::string telegram = AddCRC(HarnessTelegram);
+
+	//the first telegram creates the devices
+	pMeter->Parse(telegram);
+	pHardware->SendFrame(0, true);
+
+	CMetricCounter *pTransactions = m_metrics.GetCounter("sql_batch_transactions");
+	CMetricCounter *pSplits = m_metrics.GetCounter("sql_batch_splits");
+	CMetricHistogram *pBatch = m_metrics.GetHistogram("rx_batch");
+	CMetricHistogram::_tSnapshot batchBefore;
+	pBatch->GetSnapshot(batchBefore);
+	const uint64_t transactionsBefore = pTransactions->Get();
+	const uint64_t splitsBefore = pSplits->Get();
+
+	CMetricHistogram *pLatency = m_metrics.GetHistogram("harness_telegram_latency");
+	uint64_t start = NowUs();
+	for (int ii = 0; ii < telegrams; ii++)
+	{
+		if (rate > 0)
+		{
+			uint64_t due = start + ((uint64_t)ii * 1000000) / rate;
+			uint64_t now = NowUs();
+			if (due > now)
+				boost::this_thread::sleep(boost::posix_time::microseconds(due - now));
+		}
+		uint64_t sent = NowUs();
+		pMeter->Parse(telegram);
+		//a paced meter is measured on every telegram
+		if ((rate > 0) || (ii % HARNESS_LATENCY_SAMPLE == 0))
+		{
+			pHardware->SendFrame(0, true);
+			pLatency->Record(NowUs() - sent);
+		}
+	}
+	pHardware->SendFrame(0, true);
+	uint64_t done = NowUs();
+
+	CMetricHistogram::_tSnapshot latency, batch;
+	pLatency->GetSnapshot(latency);
+	pBatch->GetSnapshot(batch);
+	const uint64_t batches = batch.count - batchBefore.count;
+	const uint64_t transactions = pTransactions->Get() - transactionsBefore;
+	const uint64_t splits = pSplits->Get() - splitsBefore;
+	result = m_sql.safe_query("SELECT COUNT(*) FROM DeviceStatus WHERE (HardwareID==%d)", pMeter->m_HwdID);
+	printf("telegrams=%d\n", telegrams);
+	printf("rate=%d\n", rate);
+	printf("p1_devices=%s\n", (result.empty()) ? "0" : result[0][0].c_str());
+	printf("telegrams_per_second=%.0f\n", (done > start) ? telegrams * 1000000.0 / (done - start) : 0);
+	printf("telegram_latency_p50_us=%llu\n", (unsigned long long)latency.p50);
+	printf("telegram_latency_p99_us=%llu\n", (unsigned long long)latency.p99);
+	printf("telegram_latency_max_us=%llu\n", (unsigned long long)latency.max);
+	printf("rx_batches=%llu\n", (unsigned long long)batches);
+	printf("sql_batch_transactions=%llu\n", (unsigned long long)transactions);
+	printf("sql_batch_splits=%llu\n", (unsigned long long)splits);
+	printf("transactions_per_telegram=%.2f\n", (telegrams > 0) ? (double)transactions / telegrams : 0);
+	printf("%s", m_metrics.GetPrometheusText().c_str());
+
+	//every telegram has to be one batch, and one transaction unless another thread queried in between
+	if ((batches != (uint64_t)telegrams) || (transactions != batches + splits))
+	{
+		fprintf(stderr, "%llu batches and %llu transactions (%llu split) for %d telegrams\n",
+			(unsigned long long)batches, (unsigned long long)transactions, (unsigned long long)splits, telegrams);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = (argc > 1) ? atoi(argv[1]) : HARNESS_FRAMES;
+	if (frames < 1)
+		frames = HARNESS_FRAMES;
+	int rate = (argc > 2) ? atoi(argv[2]) : 0;
+	if (rate < 0)
+		rate = 0;
+	const bool bP1 = (argc > 3) && (strcmp(argv[3], "p1") == 0);
+
+	_log.SetVerboseLevel(VBL_ERROR);
+	szStartupFolder = "./";
+	szUserDataFolder = "./";
+	szWWWFolder = "./www";
+	m_sql.SetDatabaseName(":memory:");
+	http::server::server_settings webserver_settings;
+	webserver_settings.listening_port = "0";
+	m_mainworker.SetWebserverSettings(webserver_settings);
+#ifdef WWW_ENABLE_SSL
+	http::server::ssl_server_settings secure_webserver_settings;
+	secure_webserver_settings.listening_port = "0";
+	m_mainworker.SetSecureWebserverSettings(secure_webserver_settings);
+#endif
+	if (!m_mainworker.Start())
+	{
+		fprintf(stderr, "MainWorker did not start\n");
+		return 1;
+	}
+
+	m_sql.safe_query("INSERT INTO Hardware (Name, Enabled, Type, Address, Port, SerialPort, Username, Password, Mode1, Mode2, Mode3, Mode4, Mode5, Mode6) "
+		"VALUES ('Harness', 1, %d, '', 0, '', '', '', 0, 0, 0, 0, 0, 0)", HTYPE_Dummy);
+	std::vector<std::vector<std::string> > result = m_sql.safe_query("SELECT MAX(ID) FROM Hardware");
+	if (result.empty())
+	{
+		fprintf(stderr, "no harness hardware\n");
+		return 1;
+	}
+	m_sql.safe_query("INSERT INTO EventMaster (Name, Interpreter, Type, XMLStatement, Status) VALUES ('harness', 'Lua', 'Device', '%q', 1)", HarnessLuaScript);
+
+	CHarnessHardware *pHardware = new CHarnessHardware(atoi(result[0][0].c_str()));
+	m_mainworker.AddDomoticzHardware(pHardware);
+	pHardware->Start();
+	//no hardware in the database at startup, so MainWorker did not start the event system
+	m_mainworker.m_eventsystem.SetEnabled(true);
+	m_mainworker.m_eventsystem.StartEventSystem();
+
+	//create the devices first, the run measures updates of existing devices
+	for (int ii = 0; ii < 3 * HARNESS_SENSORS; ii++)
+		pHardware->SendFrame(ii, true);
+
+	if (bP1)
+	{
+		int ret = RunP1(pHardware, frames, rate);
+		m_mainworker.Stop();
+		return ret;
+	}
+
+	CMetricHistogram *pLatency = m_metrics.GetHistogram("harness_e2e_latency");
+	uint64_t start = NowUs();
+	for (int ii = 0; ii < frames; ii++)
+	{
+		if (rate > 0)
+		{
+			uint64_t due = start + ((uint64_t)ii * 1000000) / rate;
+			uint64_t now = NowUs();
+			if (due > now)
+				boost::this_thread::sleep(boost::posix_time::microseconds(due - now));
+		}
+		if (ii % HARNESS_LATENCY_SAMPLE == 0)
+		{
+			uint64_t sent = NowUs();
+			pHardware->SendFrame(ii, true);
+			pLatency->Record(NowUs() - sent);
+		}
+		else
+			pHardware->SendFrame(ii, false);
+	}
+	//frames are handled in order, once this one is done all of them are
+	pHardware->SendFrame(0, true);
+	uint64_t rxDone = NowUs();
+	CMetricGauge *pEventQueue = m_metrics.GetGauge("event_queue_depth");
+	while (pEventQueue->Get() > 0)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	uint64_t eventsDone = NowUs();
+
+	CMetricHistogram::_tSnapshot latency;
+	pLatency->GetSnapshot(latency);
+	result = m_sql.safe_query("SELECT COUNT(*) FROM DeviceStatus");
+	printf("frames=%d\n", frames);
+	printf("rate=%d\n", rate);
+	printf("devices=%s\n", (result.empty()) ? "0" : result[0][0].c_str());
+	printf("rx_frames_per_second=%.0f\n", (rxDone > start) ? frames * 1000000.0 / (rxDone - start) : 0);
+	printf("pipeline_frames_per_second=%.0f\n", (eventsDone > start) ? frames * 1000000.0 / (eventsDone - start) : 0);
+	printf("e2e_latency_p50_us=%llu\n", (unsigned long long)latency.p50);
+	printf("e2e_latency_p99_us=%llu\n", (unsigned long long)latency.p99);
+	printf("e2e_latency_max_us=%llu\n", (unsigned long long)latency.max);
+	printf("%s", m_metrics.GetPrometheusText().c_str());
+
+	m_mainworker.Stop();
+	return 0;
+}
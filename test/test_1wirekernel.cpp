@@ -0,0 +1,158 @@
+//1-Wire by kernel: the readings of a w1 sysfs tree made in a temporary directory. Two bus masters, the first with
+//therm_bulk_read (bulk conversion) and a dual channel switch, a thermometer with a bad CRC on the second.
+#include "stdafx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include "../main/Logger.h"
+#include "../hardware/1Wire/1WireByKernel.h"
+
+//The application parts the 1-Wire system uses, the test only needs them to link
+CLogger _log;
+CLogger::CLogger(void) {}
+CLogger::~CLogger(void) {}
+void CLogger::Log(const _eLogLevel level, const char* logline, ...) {}
+bool CLogger::isTraceEnabled() { return false; }
+
+static int g_failures = 0;
+//created files and directories, removed in reverse order at the end
+static std::vector<std::string> g_created;
+
+static void Check(const bool bOK, const char *what, const char *device)
+{
+	if (bOK)
+		return;
+	fprintf(stderr, "%s: %s\n", device, what);
+	g_failures++;
+}
+
+static void MakeDir(const std::string &path)
+{
+	mkdir(path.c_str(), 0755);
+	g_created.push_back(path);
+}
+
+static void MakeFile(const std::string &path, const std::string &content)
+{
+	std::ofstream outfile(path.c_str(), std::ios::out | std::ios::binary);
+	outfile << content;
+	outfile.close();
+	g_created.push_back(path);
+}
+
+//w1_slave of w1_therm, milli degrees
+static void MakeThermometer(const std::string &baseDir, const std::string &name, const bool bCrcOK, const int milliDegrees)
+{
+	char szTmp[200];
+	MakeDir(baseDir + "/" + name);
+	sprintf(szTmp, "72 01 4b 46 7f ff 0e 10 57 : crc=57 %s\n72 01 4b 46 7f ff 0e 10 57 t=%d\n", (bCrcOK) ? "YES" : "NO", milliDegrees);
+	MakeFile(baseDir + "/" + name + "/w1_slave", szTmp);
+}
+
+static bool FindDevice(const std::vector<_t1WireDevice> &devices, const std::string &devid, _t1WireDevice &device)
+{
+	for (std::vector<_t1WireDevice>::const_iterator itt = devices.begin(); itt != devices.end(); ++itt)
+	{
+		if (itt->devid == devid)
+		{
+			device = *itt;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void CheckTemperature(const C1WireByKernel &system, const std::vector<_t1WireDevice> &devices, const char *devid, const float expected)
+{
+	_t1WireDevice device;
+	if (!FindDevice(devices, devid, device))
+	{
+		Check(false, "not found", devid);
+		return;
+	}
+	Check(system.GetTemperature(device) == expected, "wrong temperature", devid);
+}
+
+static bool FileContains(const std::string &path, const std::string &text)
+{
+	std::ifstream infile(path.c_str());
+	std::string sLine;
+	if (infile.is_open())
+		getline(infile, sLine);
+	return (sLine == text);
+}
+
+int main(int argc, char *argv[])
+{
+	char szBaseDir[] = "/tmp/w1testXXXXXX";
+	if (mkdtemp(szBaseDir) == NULL)
+	{
+		fprintf(stderr, "no temporary directory\n");
+		return 1;
+	}
+	const std::string baseDir = szBaseDir;
+	g_created.push_back(baseDir);
+
+	MakeDir(baseDir + "/w1_bus_master1");
+	MakeFile(baseDir + "/w1_bus_master1/w1_master_slaves", "28-000005e2fdc3\n10-000801b5d3a2\n3a-00000012ab34\n");
+	MakeFile(baseDir + "/w1_bus_master1/therm_bulk_read", "0\n");
+	MakeDir(baseDir + "/w1_bus_master2");
+	MakeFile(baseDir + "/w1_bus_master2/w1_master_slaves", "28-0316a2790aff\n28-0416a2790bff\n");
+	MakeThermometer(baseDir, "28-000005e2fdc3", true, 23125);
+	MakeThermometer(baseDir, "10-000801b5d3a2", true, -10250);
+	MakeThermometer(baseDir, "28-0316a2790aff", true, 5500);
+	MakeThermometer(baseDir, "28-0416a2790bff", false, 85000);
+	//DS2413 PIO register read: the command byte is written over the first byte, the second is the answer
+	//(0x1E, low nibble 1110: channel A latch 0 so on, channel B 1 so off)
+	MakeDir(baseDir + "/3a-00000012ab34");
+	MakeFile(baseDir + "/3a-00000012ab34/rw", std::string("\x00\x1e", 2));
+
+	Check(C1WireByKernel::IsAvailable(baseDir), "not available", "base dir");
+	Check(!C1WireByKernel::IsAvailable(baseDir + "/none"), "available without bus master", "base dir");
+
+	int deviceCount = 0;
+	{
+		C1WireByKernel system(baseDir);
+		system.PrepareDevices();
+		std::vector<_t1WireDevice> devices;
+		system.GetDevices(devices);
+		deviceCount = (int)devices.size();
+		Check(devices.size() == 5, "not all devices found", "bus masters");
+
+		CheckTemperature(system, devices, "000005E2FDC3", 23.125f);
+		CheckTemperature(system, devices, "000801B5D3A2", -10.25f);
+		CheckTemperature(system, devices, "0316A2790AFF", 5.5f);
+		//a bad CRC is not a reading
+		CheckTemperature(system, devices, "0416A2790BFF", -1000.0f);
+
+		_t1WireDevice device;
+		if (FindDevice(devices, "00000012AB34", device))
+		{
+			Check(device.family == dual_channel_addressable_switch, "wrong family", "00000012AB34");
+			Check(system.GetLightState(device, 0), "channel A not on", "00000012AB34");
+			Check(!system.GetLightState(device, 1), "channel B not off", "00000012AB34");
+		}
+		else
+			Check(false, "not found", "00000012AB34");
+	}
+
+	//the bus with thermometers and bulk read support got the conversion command, the other bus has no such file
+	Check(FileContains(baseDir + "/w1_bus_master1/therm_bulk_read", "trigger"), "no bulk conversion", "w1_bus_master1");
+	struct stat st;
+	Check(stat((baseDir + "/w1_bus_master2/therm_bulk_read").c_str(), &st) != 0, "therm_bulk_read created", "w1_bus_master2");
+
+	for (std::vector<std::string>::reverse_iterator itt = g_created.rbegin(); itt != g_created.rend(); ++itt)
+	{
+		if (unlink(itt->c_str()) != 0)
+			rmdir(itt->c_str());
+	}
+
+	printf("devices=%d\n", deviceCount);
+	printf("failures=%d\n", g_failures);
+	return (g_failures > 0) ? 1 : 0;
+}
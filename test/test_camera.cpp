@@ -0,0 +1,326 @@
+//Camera snapshot cache and MJPEG relay against a local HTTP camera that counts its snapshot requests.
+//Concurrent snapshot requests share one fetch, removing the camera while they wait on that fetch, and two relay
+//viewers sharing one fetch loop that stops when the last viewer leaves.
+#include "stdafx.h"
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "../main/mainworker.h"
+#include "../main/Camera.h"
+#include "../main/Logger.h"
+#include "../main/SQLHelper.h"
+#include "../main/Metrics.h"
+#include "../main/DeviceSnapshot.h"
+#include "../main/WebServerHelper.h"
+#include "../notifications/NotificationHelper.h"
+
+#define CAMERA_FETCHERS 8
+#define CAMERA_RELAY_FRAMES 4
+
+//The globals main/domoticz.cpp defines for the application
+std::string szStartupFolder;
+std::string szUserDataFolder;
+std::string szWWWFolder;
+std::string szWebRoot;
+bool bHasInternalTemperature = false;
+std::string szInternalTemperatureCommand = "";
+bool bHasInternalVoltage = false;
+std::string szInternalVoltageCommand = "";
+bool bHasInternalCurrent = false;
+std::string szInternalCurrentCommand = "";
+std::string szAppVersion = "test";
+std::string szAppHash = "???";
+std::string szAppDate = "???";
+int ActYear;
+time_t m_StartTime = time(NULL);
+CMetrics m_metrics;
+CDeviceSnapshots m_devicesnapshots;
+MainWorker m_mainworker;
+CLogger _log;
+http::server::CWebServerHelper m_webservers;
+CSQLHelper m_sql;
+CNotificationHelper m_notifications;
+std::string logfile = "";
+bool g_bStopApplication = false;
+bool g_bUseSyslog = false;
+bool g_bRunAsDaemon = false;
+bool g_bDontCacheWWW = false;
+int pidFilehandle = 0;
+
+static int g_failures = 0;
+
+static void Check(const bool bOK, const char *what)
+{
+	if (bOK)
+		return;
+	fprintf(stderr, "%s\n", what);
+	g_failures++;
+}
+
+//A camera answering every request with "frame <n>", after a delay so concurrent requests overlap the fetch
+class CTestCamera
+{
+public:
+	CTestCamera() : m_socket(-1), m_port(0), m_requests(0), m_delayMs(0), m_bStop(false) {}
+	bool Start()
+	{
+		m_socket = socket(AF_INET, SOCK_STREAM, 0);
+		if (m_socket < 0)
+			return false;
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		socklen_t addrlen = sizeof(addr);
+		if ((bind(m_socket, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(m_socket, 16) != 0)
+			|| (getsockname(m_socket, (struct sockaddr*)&addr, &addrlen) != 0))
+			return false;
+		m_port = ntohs(addr.sin_port);
+		m_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CTestCamera::Do_Work, this)));
+		return true;
+	}
+	void Stop()
+	{
+		m_bStop = true;
+		if (m_thread)
+			m_thread->join();
+		close(m_socket);
+	}
+	int GetPort() const { return m_port; }
+	int GetRequests()
+	{
+		boost::lock_guard<boost::mutex> l(m_mutex);
+		return m_requests;
+	}
+	void SetDelay(const int delayMs)
+	{
+		boost::lock_guard<boost::mutex> l(m_mutex);
+		m_delayMs = delayMs;
+	}
+private:
+	void Do_Work()
+	{
+		while (!m_bStop)
+		{
+			fd_set fds;
+			FD_ZERO(&fds);
+			FD_SET(m_socket, &fds);
+			struct timeval tv;
+			tv.tv_sec = 0;
+			tv.tv_usec = 50000;
+			if (select(m_socket + 1, &fds, NULL, NULL, &tv) <= 0)
+				continue;
+			int client = accept(m_socket, NULL, NULL);
+			if (client < 0)
+				continue;
+			std::string request;
+			char buf[512];
+			int len;
+			while ((request.find("\r\n\r\n") == std::string::npos) && ((len = recv(client, buf, sizeof(buf), 0)) > 0))
+				request.append(buf, len);
+			int requestNr;
+			int delayMs;
+			{
+				boost::lock_guard<boost::mutex> l(m_mutex);
+				requestNr = ++m_requests;
+				delayMs = m_delayMs;
+			}
+			if (delayMs > 0)
+				boost::this_thread::sleep(boost::posix_time::milliseconds(delayMs));
+			char szBody[50];
+			sprintf(szBody, "frame %d", requestNr);
+			char szReply[200];
+			sprintf(szReply, "HTTP/1.0 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\nConnection: close\r\n\r\n%s", (int)strlen(szBody), szBody);
+			send(client, szReply, strlen(szReply), 0);
+			close(client);
+		}
+	}
+	int m_socket;
+	int m_port;
+	boost::mutex m_mutex;
+	int m_requests;
+	int m_delayMs;
+	volatile bool m_bStop;
+	boost::shared_ptr<boost::thread> m_thread;
+};
+
+static CTestCamera g_camera;
+
+static uint64_t AddCamera()
+{
+	m_sql.safe_query("INSERT INTO Cameras (Name, Enabled, Address, Port, Protocol, Username, Password, ImageURL) VALUES ('Test camera', 1, '127.0.0.1', %d, 0, '', '', 'snapshot.jpg')",
+		g_camera.GetPort());
+	std::vector<std::vector<std::string> > result = m_sql.safe_query("SELECT MAX(ID) FROM Cameras");
+	return (result.empty()) ? 0 : (uint64_t)atoi(result[0][0].c_str());
+}
+
+static void SnapshotThread(CCameraHandler *pCameras, const uint64_t CamID, std::vector<unsigned char> *pImage, bool *pOK)
+{
+	*pOK = pCameras->GetSnapshot(CamID, *pImage);
+}
+
+//Concurrent requests for a camera without a recent snapshot share one fetch, the next one is served from the cache
+static void TestCoalescing(CCameraHandler *pCameras, const uint64_t CamID)
+{
+	g_camera.SetDelay(300);
+	int requests = g_camera.GetRequests();
+	std::vector<unsigned char> images[CAMERA_FETCHERS];
+	bool results[CAMERA_FETCHERS];
+	boost::thread_group fetchers;
+	for (int ii = 0; ii < CAMERA_FETCHERS; ii++)
+		fetchers.create_thread(boost::bind(&SnapshotThread, pCameras, CamID, &images[ii], &results[ii]));
+	fetchers.join_all();
+	int fetched = g_camera.GetRequests() - requests;
+	for (int ii = 0; ii < CAMERA_FETCHERS; ii++)
+	{
+		Check(results[ii], "coalescing: no snapshot");
+		Check(images[ii] == images[0], "coalescing: different snapshots");
+	}
+	Check(fetched == 1, "coalescing: more than one fetch");
+	printf("coalesced_requests=%d\n", CAMERA_FETCHERS);
+	printf("coalesced_fetches=%d\n", fetched);
+
+	std::vector<unsigned char> image;
+	Check(pCameras->GetSnapshot(CamID, image), "cache: no snapshot");
+	Check(image == images[0], "cache: different snapshot");
+	Check(g_camera.GetRequests() - requests == 1, "cache: fetched again");
+}
+
+//Waiters on a fetch of a camera that is removed meanwhile, the reloads erase its entry as soon as the fetch is done
+static void TestRemoveWhileFetching(CCameraHandler *pCameras, const uint64_t CamID)
+{
+	g_camera.SetDelay(300);
+	int requests = g_camera.GetRequests();
+	std::vector<unsigned char> images[CAMERA_FETCHERS];
+	bool results[CAMERA_FETCHERS];
+	boost::thread_group fetchers;
+	for (int ii = 0; ii < CAMERA_FETCHERS; ii++)
+		fetchers.create_thread(boost::bind(&SnapshotThread, pCameras, CamID, &images[ii], &results[ii]));
+	boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+	m_sql.safe_query("DELETE FROM Cameras WHERE (ID==%" PRIu64 ")", CamID);
+	//until the fetch is done and some time after
+	for (int ii = 0; ii < 100; ii++)
+	{
+		pCameras->ReloadCameras();
+		boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+	}
+	fetchers.join_all();
+	Check(g_camera.GetRequests() - requests <= 1, "remove: more than one fetch");
+	for (int ii = 0; ii < CAMERA_FETCHERS; ii++)
+		Check((!results[ii]) || (!images[ii].empty()), "remove: empty snapshot");
+	std::vector<unsigned char> image;
+	Check(!pCameras->GetSnapshot(CamID, image), "remove: snapshot of a removed camera");
+}
+
+static boost::mutex g_readyMutex;
+static boost::condition_variable g_readyCondition;
+static int g_ready = 0;
+
+static void OnRelayReady()
+{
+	boost::lock_guard<boost::mutex> l(g_readyMutex);
+	g_ready++;
+	g_readyCondition.notify_all();
+}
+
+//Next frame for a viewer, false when the relay stopped or nothing came within 5 seconds
+static bool NextRelayFrame(CCameraHandler *pCameras, const uint64_t CamID, unsigned long &sequence, boost::shared_ptr<const std::vector<unsigned char> > &frame)
+{
+	boost::system_time timeout = boost::get_system_time() + boost::posix_time::seconds(5);
+	while (true)
+	{
+		int ready;
+		{
+			boost::lock_guard<boost::mutex> l(g_readyMutex);
+			ready = g_ready;
+		}
+		if (pCameras->GetRelayFrame(CamID, sequence, frame, boost::bind(&OnRelayReady)))
+			return (frame != NULL);
+		boost::unique_lock<boost::mutex> lock(g_readyMutex);
+		while (g_ready == ready)
+		{
+			if (!g_readyCondition.timed_wait(lock, timeout))
+				return false;
+		}
+	}
+}
+
+//Two viewers get the same frames from one fetch loop, which stops fetching when both left
+static void TestRelay(CCameraHandler *pCameras, const uint64_t CamID)
+{
+	g_camera.SetDelay(0);
+	int requests = g_camera.GetRequests();
+	pCameras->AddRelayViewer(CamID);
+	pCameras->AddRelayViewer(CamID);
+	unsigned long sequence1 = 0;
+	unsigned long sequence2 = 0;
+	int frames = 0;
+	for (int ii = 0; ii < CAMERA_RELAY_FRAMES; ii++)
+	{
+		boost::shared_ptr<const std::vector<unsigned char> > frame1;
+		boost::shared_ptr<const std::vector<unsigned char> > frame2;
+		if (!NextRelayFrame(pCameras, CamID, sequence1, frame1))
+			break;
+		if (!NextRelayFrame(pCameras, CamID, sequence2, frame2))
+			break;
+		Check(frame1 == frame2, "relay: viewers got different frames");
+		Check(sequence1 == sequence2, "relay: viewers at a different frame");
+		frames++;
+	}
+	int fetched = g_camera.GetRequests() - requests;
+	Check(frames == CAMERA_RELAY_FRAMES, "relay: frames missing");
+	//one loop fetches once per frame, (a frame may be fetched while the viewers read the previous one)
+	Check(fetched <= frames + 1, "relay: more than one fetch per frame");
+	printf("relay_frames=%d\n", frames);
+	printf("relay_fetches=%d\n", fetched);
+
+	pCameras->RemoveRelayViewer(CamID);
+	pCameras->RemoveRelayViewer(CamID);
+	boost::shared_ptr<const std::vector<unsigned char> > frame;
+	while (NextRelayFrame(pCameras, CamID, sequence1, frame))
+		;
+	Check(frame == NULL, "relay: not stopped");
+	requests = g_camera.GetRequests();
+	boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+	Check(g_camera.GetRequests() == requests, "relay: fetching without viewers");
+}
+
+int main(int argc, char *argv[])
+{
+	_log.SetVerboseLevel(VBL_ERROR);
+	szStartupFolder = "./";
+	szUserDataFolder = "./";
+	m_sql.SetDatabaseName(":memory:");
+	if (!m_sql.OpenDatabase())
+	{
+		fprintf(stderr, "no database\n");
+		return 1;
+	}
+	if (!g_camera.Start())
+	{
+		fprintf(stderr, "no test camera\n");
+		return 1;
+	}
+	//the relay fetches a frame every CAMERA_RELAY_MIN_INTERVAL
+	m_sql.UpdatePreferencesVar("CameraSnapshotMaxAge", 1000);
+
+	CCameraHandler *pCameras = new CCameraHandler();
+	uint64_t CamID = AddCamera();
+	pCameras->ReloadCameras();
+	TestCoalescing(pCameras, CamID);
+	TestRemoveWhileFetching(pCameras, CamID);
+
+	m_sql.UpdatePreferencesVar("CameraSnapshotMaxAge", 0);
+	CamID = AddCamera();
+	pCameras->ReloadCameras();
+	TestRelay(pCameras, CamID);
+
+	delete pCameras;
+	g_camera.Stop();
+	printf("failures=%d\n", g_failures);
+	return (g_failures > 0) ? 1 : 0;
+}
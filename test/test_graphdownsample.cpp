@@ -0,0 +1,159 @@
+//Graph downsampling: the first, last, minimum and maximum rows of every field survive LTTB, MINMAX and the streaming
+//first stage, the row order is kept and the number of rows is bounded
+#include "stdafx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "../main/GraphDownsample.h"
+#include "../json/json.h"
+
+#define TEST_ROWS 100000
+#define TEST_MAX_POINTS 500
+
+static int g_failures = 0;
+
+static void Check(const bool bOK, const char *what, const char *method)
+{
+	if (bOK)
+		return;
+	fprintf(stderr, "%s: %s\n", method, what);
+	g_failures++;
+}
+
+//Two fields with noise, a spike up in one and down in the other somewhere in the middle, five minute samples
+static void MakeRows(const size_t total, std::vector<std::vector<std::string> > &rows)
+{
+	char szTmp[40];
+	rows.clear();
+	for (size_t ii = 0; ii < total; ii++)
+	{
+		std::vector<std::string> row;
+		double te = 20.0 + 5.0 * sin((double)ii / 300.0) + (double)(rand() % 100) / 100.0;
+		double hu = 50.0 + 10.0 * cos((double)ii / 500.0) + (double)(rand() % 100) / 100.0;
+		if (ii == total / 3)
+			te = 80.0;
+		if (ii == (2 * total) / 3)
+			hu = -5.0;
+		sprintf(szTmp, "%.2f", te);
+		row.push_back(szTmp);
+		sprintf(szTmp, "%.2f", hu);
+		row.push_back(szTmp);
+		const int minutes = (int)(ii * 5);
+		const int days = minutes / 1440;
+		sprintf(szTmp, "%04d-%02d-%02d %02d:%02d", 2017 + days / 336, 1 + (days / 28) % 12, 1 + days % 28, (minutes / 60) % 24, minutes % 60);
+		row.push_back(szTmp);
+		rows.push_back(row);
+	}
+}
+
+static void ToJson(const std::vector<std::vector<std::string> > &rows, Json::Value &result)
+{
+	result = Json::Value(Json::arrayValue);
+	for (size_t ii = 0; ii < rows.size(); ii++)
+	{
+		result[(Json::ArrayIndex)ii]["d"] = rows[ii][2];
+		result[(Json::ArrayIndex)ii]["te"] = rows[ii][0];
+		result[(Json::ArrayIndex)ii]["hu"] = rows[ii][1];
+	}
+}
+
+static void CheckRetained(const Json::Value &original, const Json::Value &reduced, const size_t maxRows, const char *method)
+{
+	Check(reduced.size() <= maxRows, "too many rows", method);
+	Check(reduced.size() > 0, "no rows", method);
+	if (reduced.size() == 0)
+		return;
+	Check(reduced[0u]["d"] == original[0u]["d"], "first row not kept", method);
+	Check(reduced[reduced.size() - 1]["d"] == original[original.size() - 1]["d"], "last row not kept", method);
+	for (Json::ArrayIndex ii = 1; ii < reduced.size(); ii++)
+		Check(reduced[ii]["d"].asString() > reduced[ii - 1]["d"].asString(), "row order changed", method);
+
+	const char *fields[] = { "te", "hu" };
+	for (int ff = 0; ff < 2; ff++)
+	{
+		double minValue = 0, maxValue = 0;
+		for (Json::ArrayIndex ii = 0; ii < original.size(); ii++)
+		{
+			double value = atof(original[ii][fields[ff]].asCString());
+			if ((ii == 0) || (value < minValue))
+				minValue = value;
+			if ((ii == 0) || (value > maxValue))
+				maxValue = value;
+		}
+		bool bMin = false, bMax = false;
+		for (Json::ArrayIndex ii = 0; ii < reduced.size(); ii++)
+		{
+			double value = atof(reduced[ii][fields[ff]].asCString());
+			bMin |= (value == minValue);
+			bMax |= (value == maxValue);
+		}
+		Check(bMin, "minimum not kept", method);
+		Check(bMax, "maximum not kept", method);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	srand(1);
+	std::vector<std::vector<std::string> > rows;
+	MakeRows(TEST_ROWS, rows);
+	Json::Value original;
+	ToJson(rows, original);
+
+	//LTTB gives maxPoints rows, plus the extremes that lost in their bucket
+	Json::Value lttb = original;
+	DownsampleGraphResult(lttb, TEST_MAX_POINTS, DOWNSAMPLE_LTTB);
+	CheckRetained(original, lttb, TEST_MAX_POINTS + 4, "lttb");
+
+	Json::Value minmax = original;
+	DownsampleGraphResult(minmax, TEST_MAX_POINTS, DOWNSAMPLE_MINMAX);
+	CheckRetained(original, minmax, TEST_MAX_POINTS + 2, "minmax");
+
+	//a result that already fits is not changed
+	Json::Value small;
+	std::vector<std::vector<std::string> > smallRows(rows.begin(), rows.begin() + TEST_MAX_POINTS);
+	ToJson(smallRows, small);
+	Json::Value smallCopy = small;
+	DownsampleGraphResult(smallCopy, TEST_MAX_POINTS, DOWNSAMPLE_LTTB);
+	Check(smallCopy == small, "result within maxPoints changed", "lttb");
+
+	//streaming first stage: bounded rows whatever the input, then the same reduction as above
+	CGraphRowDownsampler downsampler(TEST_MAX_POINTS, 2);
+	size_t maxKept = 0;
+	for (size_t ii = 0; ii < rows.size(); ii++)
+	{
+		downsampler.AddRow(rows[ii]);
+		if (downsampler.GetKeptRowCount() > maxKept)
+			maxKept = downsampler.GetKeptRowCount();
+	}
+	//2*maxPoints buckets of at most first, last and the minimum and maximum of two fields
+	const size_t streamLimit = 2 * TEST_MAX_POINTS * 6 + 6;
+	Check(maxKept <= streamLimit, "streaming stage holds too many rows", "stream");
+	Check(downsampler.GetRowCount() == rows.size(), "rows not counted", "stream");
+	std::vector<std::vector<std::string> > streamed;
+	downsampler.GetRows(streamed);
+	Json::Value stream;
+	ToJson(streamed, stream);
+	CheckRetained(original, stream, streamLimit, "stream");
+	DownsampleGraphResult(stream, TEST_MAX_POINTS, DOWNSAMPLE_LTTB);
+	CheckRetained(original, stream, TEST_MAX_POINTS + 4, "stream+lttb");
+
+	//maxPoints 0 keeps every row
+	CGraphRowDownsampler all(0, 2);
+	for (size_t ii = 0; ii < smallRows.size(); ii++)
+		all.AddRow(smallRows[ii]);
+	std::vector<std::vector<std::string> > allRows;
+	all.GetRows(allRows);
+	Check(allRows == smallRows, "rows changed without maxPoints", "stream");
+
+	printf("rows=%d\n", TEST_ROWS);
+	printf("max_points=%d\n", TEST_MAX_POINTS);
+	printf("lttb_rows=%d\n", (int)lttb.size());
+	printf("minmax_rows=%d\n", (int)minmax.size());
+	printf("stream_max_kept_rows=%d\n", (int)maxKept);
+	printf("stream_rows=%d\n", (int)streamed.size());
+	printf("failures=%d\n", g_failures);
+	return (g_failures > 0) ? 1 : 0;
+}
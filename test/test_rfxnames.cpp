@@ -0,0 +1,105 @@
+//RFXNames descriptor lookups, the dense indexes against the linear table scan for every id of every table
+//(RFXNames.cpp is built with RFXNAMES_VERIFY_INDEX, each indexed lookup then compares itself with the scan).
+//Then the same lookups are timed through the indexes only and through the scan only.
+//usage: test_rfxnames [passes]
+#include "stdafx.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../main/RFXNames.h"
+#include "../main/Logger.h"
+#include "../hardware/EvohomeBase.h"
+
+extern int RFXNames_IndexMismatches;
+extern int RFXNames_LookupMode; //0 compare, 1 index only, 2 scan only
+
+//The application parts RFXNames.cpp uses, the test only needs them to link
+CLogger _log;
+CLogger::CLogger(void) {}
+CLogger::~CLogger(void) {}
+void CLogger::Log(const _eLogLevel level, const char* logline, ...) {}
+bool CLogger::isTraceEnabled() { return false; }
+const char* CEvohomeBase::GetWebAPIModeName(uint8_t nControllerMode) { return ""; }
+
+//highest id of the int keyed tables that is tried, above the dense index limit so the sparse path is checked as well
+#define MAX_TEST_ID 5000
+#define TIMING_PASSES 5
+
+static unsigned long LookupAll()
+{
+	unsigned long lookups = 0;
+	for (int ii = -5; ii <= MAX_TEST_ID; ii++)
+	{
+		Timer_Type_Desc(ii);
+		Timer_Cmd_Desc(ii);
+		Hardware_Type_Desc(ii);
+		Switch_Type_Desc((_eSwitchType)ii);
+		Meter_Type_Desc((_eMeterType)ii);
+		Notification_Type_Desc(ii, 0);
+		Notification_Type_Desc(ii, 1);
+		Notification_Type_Label(ii);
+		Media_Player_States((_eMediaStatus)ii);
+		lookups += 9;
+	}
+	for (int ii = 0; ii < 256; ii++)
+	{
+		const unsigned char id = (unsigned char)ii;
+		RFX_Humidity_Status_Desc(id);
+		Security_Status_Desc(id);
+		RFX_Forecast_Desc(id);
+		RFX_WSForecast_Desc(id);
+		BMP_Forecast_Desc(id);
+		RFX_Type_Desc(id, 1);
+		RFX_Type_Desc(id, 2);
+		ZWave_Clock_Days(id);
+		lookups += 8;
+		for (int jj = 0; jj < 256; jj++)
+			RFX_Type_SubType_Desc(id, (unsigned char)jj);
+		lookups += 256;
+	}
+	return lookups;
+}
+
+static uint64_t NowUs()
+{
+	return (uint64_t)(boost::posix_time::microsec_clock::universal_time() - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_microseconds();
+}
+
+//Lookups per second of all tables in the given mode
+static double TimeLookups(const int mode, const int passes)
+{
+	RFXNames_LookupMode = mode;
+	unsigned long lookups = 0;
+	uint64_t start = NowUs();
+	for (int ii = 0; ii < passes; ii++)
+		lookups += LookupAll();
+	uint64_t done = NowUs();
+	RFXNames_LookupMode = 0;
+	return (done > start) ? lookups * 1000000.0 / (done - start) : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int passes = (argc > 1) ? atoi(argv[1]) : TIMING_PASSES;
+	if (passes < 1)
+		passes = 1;
+
+	unsigned long lookups = LookupAll();
+	printf("lookups=%lu\n", lookups);
+	printf("index_mismatches=%d\n", RFXNames_IndexMismatches);
+	if (RFXNames_IndexMismatches > 0)
+	{
+		fprintf(stderr, "indexed lookups differ from the table scan!\n");
+		return 1;
+	}
+
+	double indexRate = TimeLookups(1, passes);
+	double scanRate = TimeLookups(2, passes);
+	printf("passes=%d\n", passes);
+	printf("index_lookups_per_second=%.0f\n", indexRate);
+	printf("scan_lookups_per_second=%.0f\n", scanRate);
+	printf("index_speedup=%.1f\n", (scanRate > 0) ? indexRate / scanRate : 0);
+	return 0;
+}
@@ -49,11 +49,13 @@ cWebem::cWebem(
 				myRequestHandler(doc_root, this),
 				m_DigistRealm("Domoticz.com"),
 				m_session_clean_timer(m_io_service, boost::posix_time::minutes(1)),
+				m_session_flush_timer(m_io_service, boost::posix_time::minutes(1)),
 				m_io_service_thread(boost::bind(&boost::asio::io_service::run, &m_io_service)),
 				m_sessions(), // Rene, make sure we initialize m_sessions first, before starting a server
 				myServer(server_factory::create(settings, myRequestHandler)) {
 	// associate handler to timer and schedule the first iteration
 	m_session_clean_timer.async_wait(boost::bind(&cWebem::CleanSessions, this));
+	m_session_flush_timer.async_wait(boost::bind(&cWebem::FlushSessions, this));
 }
 
 cWebem::~cWebem() {
@@ -95,6 +97,10 @@ void cWebem::Stop() {
 	} catch (...) {
 		_log.Log(LOG_ERROR, "[web:%s] exception thrown while stopping session cleaner", GetPort().c_str());
 	}
+	// Write pending session updates
+	if (mySessionStore != NULL) {
+		mySessionStore->FlushSessions();
+	}
 	// Stop Web server
 	if (myServer != NULL) {
 		myServer->stop();
@@ -628,7 +634,14 @@ bool cWebem::CheckForPageOverride(WebEmSession & session, request& req, reply& r
 			}
 		}
 
-		if (!boost::algorithm::starts_with(strMimeType, "image"))
+		if (rep.stream)
+		{
+			// streamed content, the connection takes care of the transfer encoding
+			reply::add_header_if_absent(&rep, "Content-Type", strMimeType);
+			reply::add_header(&rep, "Cache-Control", "no-cache");
+			reply::add_header(&rep, "Pragma", "no-cache");
+		}
+		else if (!boost::algorithm::starts_with(strMimeType, "image"))
 		{
 			reply::add_header(&rep, "Content-Length", boost::lexical_cast<std::string>(rep.content.size()));
 			reply::add_header(&rep, "Content-Type", strMimeType + ";charset=UTF-8");
@@ -978,6 +991,16 @@ void cWebem::CleanSessions() {
 	m_session_clean_timer.async_wait(boost::bind(&cWebem::CleanSessions, this));
 }
 
+void cWebem::FlushSessions() {
+	// Session expiration updates are kept in memory by the store and written in batches
+	if (mySessionStore != NULL) {
+		mySessionStore->FlushSessions();
+	}
+	// Schedule next flush
+	m_session_flush_timer.expires_at(m_session_flush_timer.expires_at() + boost::posix_time::minutes(1));
+	m_session_flush_timer.async_wait(boost::bind(&cWebem::FlushSessions, this));
+}
+
 // Return 1 on success. Always initializes the ah structure.
 int cWebemRequestHandler::parse_auth_header(const request& req, struct ah *ah)
 {
@@ -1264,6 +1287,8 @@ void cWebemRequestHandler::send_authorization_request(reply& rep)
 
 bool cWebemRequestHandler::CompressWebOutput(const request& req, reply& rep)
 {
+	if ((rep.stream) || (rep.shared_content))
+		return false;
 	std::string request_path;
 	if (!url_decode(req.uri, request_path))
 		return false;
@@ -1838,7 +1863,7 @@ void cWebemRequestHandler::handle_request(const request& req, reply& rep)
 			)
 		{
 				// check if content is not gzipped, include wont work with non-text content
-			if (!rep.bIsGZIP) {
+			if ((!rep.bIsGZIP) && (!rep.shared_content)) {
 				// Find and include any special cWebem strings
 				if (!myWebem->Include(rep.content)) {
 					if (mInfo.mtime_support && !mInfo.is_modified) {
@@ -228,6 +228,7 @@ namespace http {
 			/// store map between pages and application functions
 			std::map < std::string, webem_page_function > myPages_w;
 			void CleanSessions();
+			void FlushSessions();
 			session_store_impl_ptr mySessionStore; /// session store
 			/// request handler specialized to handle webem requests
 			/// Rene: Beware: myRequestHandler should be declared BEFORE myServer
@@ -240,6 +241,7 @@ namespace http {
 			boost::mutex m_sessionsMutex;
 			boost::asio::io_service m_io_service;
 			boost::asio::deadline_timer m_session_clean_timer;
+			boost::asio::deadline_timer m_session_flush_timer;
 			boost::thread m_io_service_thread;
 		};
 
@@ -33,11 +33,13 @@ connection::connection(boost::asio::io_service& io_service,
 				status_(INITIALIZING),
 				default_abandoned_timeout_(20*60), // 20mn before stopping abandoned connection
 				abandoned_timer_(io_service, boost::posix_time::seconds(default_abandoned_timeout_)),
-				default_max_requests_(20)
+				default_max_requests_(20),
+				io_service_(io_service)
 {
 	secure_ = false;
 	keepalive_ = false;
 	write_in_progress = false;
+	stream_chunked_ = false;
 	connection_type = connection_http;
 #ifdef WWW_ENABLE_SSL
 	sslsocket_ = NULL;
@@ -57,11 +59,13 @@ connection::connection(boost::asio::io_service& io_service,
 				status_(INITIALIZING),
 				default_abandoned_timeout_(20*60), // 20mn before stopping abandoned connection
 				abandoned_timer_(io_service, boost::posix_time::seconds(default_abandoned_timeout_)),
-				default_max_requests_(20)
+				default_max_requests_(20),
+				io_service_(io_service)
 {
 	secure_ = true;
 	keepalive_ = false;
 	write_in_progress = false;
+	stream_chunked_ = false;
 	connection_type = connection_http;
 	socket_ = NULL;
 	sslsocket_ = new ssl_socket(io_service, context);
@@ -134,6 +138,8 @@ void connection::stop()
 	// Cancel timers
 	cancel_abandoned_timeout();
 	cancel_read_timeout();
+	// release a (live) stream, it might be waiting for data
+	stream_.reset();
 
 	// Initiate graceful connection closure.
 	boost::system::error_code ignored_ec;
@@ -216,7 +222,7 @@ void connection::read_more()
 	}
 }
 
-void connection::SocketWrite(const std::string &buf)
+void connection::SocketWrite(const boost::shared_ptr<const std::string> &buf)
 {
 	// do not call directly, use MyWrite()
 	if (write_in_progress) {
@@ -226,11 +232,11 @@ void connection::SocketWrite(const std::string &buf)
 	write_buffer = buf;
 	if (secure_) {
 #ifdef WWW_ENABLE_SSL
-		boost::asio::async_write(*sslsocket_, boost::asio::buffer(write_buffer), boost::bind(&connection::handle_write, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+		boost::asio::async_write(*sslsocket_, boost::asio::buffer(*write_buffer), boost::bind(&connection::handle_write, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
 #endif
 	}
 	else {
-		boost::asio::async_write(*socket_, boost::asio::buffer(write_buffer), boost::bind(&connection::handle_write, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+		boost::asio::async_write(*socket_, boost::asio::buffer(*write_buffer), boost::bind(&connection::handle_write, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
 	}
 
 }
@@ -241,6 +247,11 @@ void connection::WS_Write(const std::string &packet_data)
 }
 
 void connection::MyWrite(const std::string &buf)
+{
+	MyWriteShared(boost::shared_ptr<const std::string>(new std::string(buf)));
+}
+
+void connection::MyWriteShared(const boost::shared_ptr<const std::string> &buf)
 {
 	switch (connection_type) {
 	case connection_http:
@@ -294,16 +305,6 @@ void connection::handle_read(const boost::system::error_code& error, std::size_t
 				_log.Log(LOG_ERROR, "Exception parsing http request.");
 			}
 
-			request_handler_.handle_request(request_, reply_);
-
-			if (request_.keep_alive && ((reply_.status == reply::ok) || (reply_.status == reply::no_content) || (reply_.status == reply::not_modified))) {
-				// Allows request handler to override the header (but it should not)
-				reply::add_header_if_absent(&reply_, "Connection", "Keep-Alive");
-				std::stringstream ss;
-				ss << "max=" << default_max_requests_ << ", timeout=" << read_timeout_;
-				reply::add_header_if_absent(&reply_, "Keep-Alive", ss.str());
-			}
-
 			if (result) {
 				size_t sizeread = begin - boost::asio::buffer_cast<const char*>(_buf.data());
 				_buf.consume(sizeread);
@@ -317,6 +318,15 @@ void connection::handle_read(const boost::system::error_code& error, std::size_t
 					request_.host_address = request_.host_address.substr(7);
 				}
 				request_handler_.handle_request(request_, reply_);
+
+				if (request_.keep_alive && ((reply_.status == reply::ok) || (reply_.status == reply::no_content) || (reply_.status == reply::not_modified))) {
+					// Allows request handler to override the header (but it should not)
+					reply::add_header_if_absent(&reply_, "Connection", "Keep-Alive");
+					std::stringstream ss;
+					ss << "max=" << default_max_requests_ << ", timeout=" << read_timeout_;
+					reply::add_header_if_absent(&reply_, "Keep-Alive", ss.str());
+				}
+
 				if (reply_.status == reply::switching_protocols) {
 					// this was an upgrade request
 					connection_type = connection_websocket;
@@ -326,7 +336,26 @@ void connection::handle_read(const boost::system::error_code& error, std::size_t
 					websocket_parser.GetHandler()->store_session_id(request_, reply_);
 					// todo: check if multiple connection from the same client in CONNECTING state?
 				}
-				MyWrite(reply_.to_string(request_.method));
+				if (reply_.stream) {
+					// the content length is unknown, send the content in chunks and close afterwards
+					keepalive_ = false;
+					stream_chunked_ = (request_.http_version_major > 1) || ((request_.http_version_major == 1) && (request_.http_version_minor >= 1));
+					reply::remove_header(&reply_, "Content-Length");
+					reply::remove_header(&reply_, "Keep-Alive");
+					reply::add_header(&reply_, "Connection", "close");
+					if (stream_chunked_)
+						reply::add_header(&reply_, "Transfer-Encoding", "chunked");
+					if (request_.method != "HEAD")
+						stream_ = reply_.stream;
+					MyWrite(reply_.header_to_string());
+				}
+				else if ((reply_.shared_content) && (request_.method != "HEAD")) {
+					// cached content is sent from its own buffer
+					MyWrite(reply_.header_to_string());
+					MyWriteShared(reply_.shared_content);
+				}
+				else
+					MyWrite(reply_.to_string(request_.method));
 				if (reply_.status == reply::switching_protocols) {
 					// this was an upgrade request, set this value after MyWrite to allow the 101 response to go out
 					connection_type = connection_websocket;
@@ -382,25 +411,84 @@ void connection::handle_read(const boost::system::error_code& error, std::size_t
 void connection::handle_write(const boost::system::error_code& error, size_t bytes_transferred)
 {
 	boost::unique_lock<boost::mutex>(writeMutex);
-	write_buffer.clear();
+	write_buffer.reset();
 	write_in_progress = false;
-	if (!error) {
-		if (!writeQ.empty()) {
-			std::string buf = writeQ.front();
-			writeQ.pop();
-			SocketWrite(buf);
-		}
-		else if (!keepalive_) {
-			connection_manager_.stop(shared_from_this());
-		}
+	if (error) {
+		connection_manager_.stop(shared_from_this());
+		return;
+	}
+	bool bSending = true;
+	if (!writeQ.empty()) {
+		boost::shared_ptr<const std::string> buf = writeQ.front();
+		writeQ.pop();
+		SocketWrite(buf);
 	}
-	if (!error && keepalive_) {
-	status_ = ENDING_WRITE;
-		// if a keep-alive connection is requested, we read the next request
-		reset_abandoned_timeout();
-	} else {
+	else if (!write_next_stream_chunk()) {
+		bSending = false;
+	}
+	if (!bSending && !keepalive_) {
+		// everything is sent, close the connection
+		connection_manager_.stop(shared_from_this());
+		return;
+	}
+	if (keepalive_)
+		status_ = ENDING_WRITE;
+	// if a keep-alive connection is requested, we read the next request
+	// a (long running) streamed reply also keeps the connection alive
+	reset_abandoned_timeout();
+}
+
+// called by a stream (from any thread) when it has new data after data_ready() returned false
+void connection::stream_data_ready(const boost::weak_ptr<connection> &weak_conn)
+{
+	connection_ptr conn = weak_conn.lock();
+	if (conn)
+		conn->io_service_.post(boost::bind(&connection::handle_stream_data_ready, conn));
+}
+
+void connection::handle_stream_data_ready()
+{
+	if ((!stream_) || (write_in_progress))
+		return;
+	if (!write_next_stream_chunk() && !keepalive_)
 		connection_manager_.stop(shared_from_this());
+}
+
+// send the next part of a streamed reply, returns false when there is nothing (left) to send
+bool connection::write_next_stream_chunk()
+{
+	if (!stream_)
+		return false;
+	std::string chunk;
+	bool bMore = false;
+	try {
+		if (!stream_->data_ready(boost::bind(&connection::stream_data_ready, boost::weak_ptr<connection>(shared_from_this()))))
+			return true; // the stream calls us back when it has data
+		bMore = stream_->next_chunk(chunk);
+	}
+	catch (...) {
+		_log.Log(LOG_ERROR, "%s -> exception thrown while streaming reply", host_endpoint_address_.c_str());
+		stream_.reset();
+		return false;
+	}
+	if (!bMore)
+		stream_.reset();
+	std::string buf;
+	if (stream_chunked_) {
+		if (!chunk.empty()) {
+			std::stringstream sstr;
+			sstr << std::hex << chunk.size() << "\r\n";
+			buf = sstr.str() + chunk + "\r\n";
+		}
+		if (!bMore)
+			buf += "0\r\n\r\n";
 	}
+	else
+		buf.swap(chunk);
+	if (buf.empty())
+		return (bMore) ? write_next_stream_chunk() : false;
+	SocketWrite(boost::shared_ptr<const std::string>(new std::string(buf)));
+	return true;
 }
 
 connection::~connection()
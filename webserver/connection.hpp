@@ -68,6 +68,8 @@ public:
   void WS_Write(const std::string &packet_data);
   /// Add content to write buffer
   void MyWrite(const std::string &buf);
+  /// Add content to write buffer without copying it
+  void MyWriteShared(const boost::shared_ptr<const std::string> &buf);
   /// Timer handlers
   void handle_timeout(const boost::system::error_code& error);
 
@@ -85,10 +87,18 @@ private:
   /// Protect the write queue
   boost::mutex writeMutex;
   /// Is protected by writeMutex
-  std::queue<std::string> writeQ;
+  std::queue<boost::shared_ptr<const std::string> > writeQ;
   /// indicates if we are currently writing
   bool write_in_progress;
-  void SocketWrite(const std::string &buf);
+  void SocketWrite(const boost::shared_ptr<const std::string> &buf);
+  /// Streamed reply content that is still to be sent, pulled from handle_write
+  boost::shared_ptr<reply_stream> stream_;
+  /// Send the stream with chunked transfer encoding (HTTP/1.1), else until close
+  bool stream_chunked_;
+  bool write_next_stream_chunk();
+  /// Resume a stream that was waiting for data
+  static void stream_data_ready(const boost::weak_ptr<connection> &weak_conn);
+  void handle_stream_data_ready();
 
 	/// Initialize read timeout timer
 	void set_read_timeout();
@@ -133,8 +143,8 @@ private:
   /// The parser for the incoming request.
   request_parser request_parser_;
 
-  /// our write buffer
-  std::string write_buffer;
+  /// our write buffer, kept alive until the write completes
+  boost::shared_ptr<const std::string> write_buffer;
 
   /// The buffer that we receive data in
   boost::asio::streambuf _buf;
@@ -169,6 +179,9 @@ private:
 	  connection_websocket,
 	  connection_closing
   } connection_type;
+
+  /// The io_service this connection runs on, used to resume waiting streams
+  boost::asio::io_service &io_service_;
 };
 
 typedef boost::shared_ptr<connection> connection_ptr;
@@ -327,6 +327,8 @@ namespace http {
 			{
 				request_.host_address = originatingip;
 				m_pWebEm->myRequestHandler.handle_request(request_, reply_);
+				// the proxy sends the reply in one piece
+				http::server::reply::flatten_stream(&reply_);
 			}
 			else if (!result)
 			{
@@ -47,6 +47,7 @@ namespace http {
 			void ConnectToDomoticz(std::string instancekey, std::string username, std::string password, DomoticzTCP *master, int protocol_version);
 			void DisconnectFromDomoticz(const std::string &token, DomoticzTCP *master);
 			void SetSharedServer(tcp::server::CTCPServerProxied *domserv);
+			boost::asio::io_service &GetIOService() { return _io_service; }
 		private:
 
 			void handle_connect(const boost::system::error_code& error,
@@ -13,8 +13,13 @@
 #include "utf.hpp"
 #include <string>
 #include <fstream>
+#include <cstdio>
+#include <cstring>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
+#include "../zlib/zlib.h"
+
+#define REPLY_STREAM_CHUNK_SIZE (64 * 1024)
 
 namespace http {
 namespace server {
@@ -124,7 +129,10 @@ std::string reply::to_string(const std::string &method)
 {
 	std::string buffers = header_to_string();
 	if (method != "HEAD") {
-		buffers += content;
+		if (shared_content)
+			buffers += *shared_content;
+		else
+			buffers += content;
 	}
 	return buffers;
 }
@@ -134,6 +142,8 @@ void reply::reset()
 	headers.clear();
 	content = "";
 	bIsGZIP = false;
+	stream.reset();
+	shared_content.reset();
 }
 
 namespace stock_replies {
@@ -351,5 +361,115 @@ void reply::add_header_content_type(reply *rep, const std::string & content_type
 	reply::add_header(rep, "Content-Type", content_type);
 }
 
+void reply::remove_header(reply *rep, const std::string &name) {
+	std::vector<header>::iterator itt = rep->headers.begin();
+	while (itt != rep->headers.end()) {
+		if (boost::iequals(itt->name, name))
+			itt = rep->headers.erase(itt);
+		else
+			++itt;
+	}
+}
+
+void reply::set_content_stream(reply *rep, const boost::shared_ptr<reply_stream> &stream) {
+	rep->content.clear();
+	rep->stream = stream;
+}
+
+void reply::set_shared_content(reply *rep, const boost::shared_ptr<const std::string> &content) {
+	rep->content.clear();
+	rep->shared_content = content;
+}
+
+void reply::flatten_stream(reply *rep) {
+	if (rep->shared_content) {
+		rep->content = *rep->shared_content;
+		rep->shared_content.reset();
+		return;
+	}
+	if (!rep->stream)
+		return;
+	boost::shared_ptr<reply_stream> stream = rep->stream;
+	rep->stream.reset();
+	rep->content.clear();
+	std::string chunk;
+	bool bMore = true;
+	while (bMore) {
+		chunk.clear();
+		bMore = stream->next_chunk(chunk);
+		rep->content += chunk;
+	}
+	add_header(rep, "Content-Length", boost::lexical_cast<std::string>(rep->content.size()));
+}
+
+file_reply_stream::file_reply_stream(const std::string &file_path, const bool bGZip, const bool bDeleteWhenDone) :
+	m_file_path(file_path),
+	m_file(file_path.c_str(), std::ios::in | std::ios::binary),
+	m_bDeleteWhenDone(bDeleteWhenDone),
+	m_zstream(NULL),
+	m_bFinished(false)
+{
+	if (bGZip) {
+		z_stream *zs = new z_stream;
+		memset(zs, 0, sizeof(z_stream));
+		// 15 + 16: gzip header instead of zlib header
+		if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+			m_zstream = zs;
+		}
+		else {
+			delete zs;
+		}
+	}
+}
+
+file_reply_stream::~file_reply_stream()
+{
+	if (m_zstream) {
+		deflateEnd((z_stream*)m_zstream);
+		delete (z_stream*)m_zstream;
+	}
+	if (m_file.is_open())
+		m_file.close();
+	if (m_bDeleteWhenDone)
+		std::remove(m_file_path.c_str());
+}
+
+bool file_reply_stream::next_chunk(std::string &chunk)
+{
+	chunk.clear();
+	if (m_bFinished || !m_file.is_open())
+		return false;
+
+	char buffer[REPLY_STREAM_CHUNK_SIZE];
+	m_file.read(buffer, sizeof(buffer));
+	std::streamsize bytes_read = m_file.gcount();
+	bool bEOF = (bytes_read < (std::streamsize)sizeof(buffer)) || (m_file.peek() == EOF);
+
+	if (!m_zstream) {
+		chunk.assign(buffer, (size_t)bytes_read);
+		m_bFinished = bEOF;
+		return !m_bFinished;
+	}
+
+	z_stream *zs = (z_stream*)m_zstream;
+	char out[REPLY_STREAM_CHUNK_SIZE];
+	zs->next_in = (Bytef*)buffer;
+	zs->avail_in = (uInt)bytes_read;
+	int flush = (bEOF) ? Z_FINISH : Z_NO_FLUSH;
+	int ret;
+	do {
+		zs->next_out = (Bytef*)out;
+		zs->avail_out = sizeof(out);
+		ret = deflate(zs, flush);
+		if (ret == Z_STREAM_ERROR) {
+			m_bFinished = true;
+			return false;
+		}
+		chunk.append(out, sizeof(out) - zs->avail_out);
+	} while (zs->avail_out == 0);
+	m_bFinished = bEOF;
+	return !m_bFinished;
+}
+
 } // namespace server
 } // namespace http
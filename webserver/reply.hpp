@@ -14,12 +14,45 @@
 #include <string>
 #include <vector>
 #include <iterator>
+#include <fstream>
 #include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 #include "header.hpp"
 
 namespace http {
 namespace server {
 
+/// Produces the content of a reply piece by piece, so large content does not
+/// have to be kept in memory. The connection sends it with chunked transfer encoding.
+class reply_stream
+{
+public:
+  virtual ~reply_stream() {}
+  /// Fill chunk with the next part of the content (may be empty),
+  /// returns false when this was the last part.
+  virtual bool next_chunk(std::string &chunk) = 0;
+  /// Live streams return false when they have no data yet, and call on_ready
+  /// (from any thread, once) when next_chunk can be called.
+  virtual bool data_ready(const boost::function<void()> &on_ready) { return true; }
+};
+
+/// Streams a file from disk, optionally gzip compressed on the fly
+class file_reply_stream : public reply_stream
+{
+public:
+  file_reply_stream(const std::string &file_path, const bool bGZip, const bool bDeleteWhenDone);
+  ~file_reply_stream();
+  bool is_open() { return m_file.is_open(); }
+  bool next_chunk(std::string &chunk);
+private:
+  std::string m_file_path;
+  std::ifstream m_file;
+  bool m_bDeleteWhenDone;
+  void *m_zstream;
+  bool m_bFinished;
+};
+
 /// A reply to be sent to a client.
 struct reply
 {
@@ -52,6 +85,12 @@ struct reply
   std::string content;
   bool bIsGZIP;
 
+  /// When set, the content is produced by this stream instead of the content member
+  boost::shared_ptr<reply_stream> stream;
+
+  /// When set, this (cached, read-only) buffer is sent instead of the content member
+  boost::shared_ptr<const std::string> shared_content;
+
   /// Convert the reply into a vector of buffers. The buffers do not own the
   /// underlying memory blocks, therefore the reply object must remain valid and
   /// not be changed until the write operation has completed.
@@ -59,12 +98,17 @@ struct reply
   std::vector<boost::asio::const_buffer> to_buffers(const std::string &method);
   static void add_header(reply *rep, const std::string &name, const std::string &value, bool replace = true);
   static void add_header_if_absent(reply *rep, const std::string &name, const std::string &value);
+  static void remove_header(reply *rep, const std::string &name);
   static void set_content(reply *rep, const std::string & content);
   static void set_content(reply *rep, const std::wstring & content_w);
   static bool set_content_from_file(reply *rep, const std::string & file_path);
   static bool set_content_from_file(reply *rep, const std::string & file_path, const std::string & attachment, bool set_content_type = false);
   static void add_header_attachment(reply *rep, const std::string & attachment);
   static void add_header_content_type(reply *rep, const std::string & content_type);
+  static void set_content_stream(reply *rep, const boost::shared_ptr<reply_stream> &stream);
+  static void set_shared_content(reply *rep, const boost::shared_ptr<const std::string> &content);
+  // move streamed or shared content into the content member, for consumers that need it there
+  static void flatten_stream(reply *rep);
 
   template <class InputIterator>
   static void set_content(reply *rep, InputIterator first, InputIterator last) {
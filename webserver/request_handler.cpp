@@ -31,6 +31,11 @@
 
 #define ZIPREADBUFFERSIZE (8192)
 
+// files above this size are not kept in the static file cache
+#define STATIC_CACHE_MAX_FILE_SIZE (2 * 1024 * 1024)
+// total size of all cached buffers
+#define STATIC_CACHE_MAX_SIZE (32 * 1024 * 1024)
+
 #define HTTP_DATE_RFC_1123 "%a, %d %b %Y %H:%M:%S %Z" // Sun, 06 Nov 1994 08:49:37 GMT
 #define HTTP_DATE_RFC_850  "%A, %d-%b-%y %H:%M:%S %Z" // Sunday, 06-Nov-94 08:49:37 GMT
 #define HTTP_DATE_ASCTIME  "%a %b %e %H:%M:%S %Y"     // Sun Nov  6 08:49:37 1994
@@ -64,7 +69,7 @@ namespace server {
 
 
 request_handler::request_handler(const std::string& doc_root, cWebem* webem)
-  : doc_root_(doc_root), myWebem(webem)
+  : doc_root_(doc_root), myWebem(webem), m_static_cache_size(0)
 {
 #ifndef WEBSERVER_DONT_USE_ZIP
 	m_uf=NULL;
@@ -198,6 +203,212 @@ bool request_handler::not_modified(std::string full_path, const request &req, re
 	return false;
 }
 
+static bool is_compressible_type(const std::string &content_type)
+{
+	return (content_type.find("text/") == 0)
+		|| (content_type.find("javascript") != std::string::npos)
+		|| (content_type.find("json") != std::string::npos)
+		|| (content_type.find("xml") != std::string::npos);
+}
+
+// FNV-1a, used as strong entity tag of the content
+static std::string content_etag(const std::string &content)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (std::string::const_iterator itt = content.begin(); itt != content.end(); ++itt)
+	{
+		hash ^= (unsigned char)*itt;
+		hash *= 1099511628211ULL;
+	}
+	char szTmp[40];
+	sprintf(szTmp, "%08x%08x-%x", (unsigned int)(hash >> 32), (unsigned int)(hash & 0xFFFFFFFF), (unsigned int)content.size());
+	return szTmp;
+}
+
+static bool read_file(const std::string &full_path, std::string &content)
+{
+	std::ifstream is(full_path.c_str(), std::ios::in | std::ios::binary);
+	if (!is.is_open())
+		return false;
+	content.assign((std::istreambuf_iterator<char>(is)), (std::istreambuf_iterator<char>()));
+	return true;
+}
+
+static bool stat_regular_file(const std::string &path, struct stat &st)
+{
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+	return ((st.st_mode & S_IFMT) == S_IFREG);
+}
+
+boost::shared_ptr<const static_file_entry> request_handler::load_static_file(const std::string &full_path, const std::string &content_type,
+	const bool bHaveRaw, const bool bHaveGZip, const time_t mtime, const long long size)
+{
+	boost::shared_ptr<static_file_entry> entry(new static_file_entry);
+	entry->mtime = mtime;
+	entry->size = size;
+	entry->dynamic = false;
+
+	std::string raw, gzip;
+	if (bHaveGZip)
+	{
+		if (!read_file(full_path + ".gz", gzip))
+			return boost::shared_ptr<const static_file_entry>();
+	}
+	if (bHaveRaw)
+	{
+		if (!read_file(full_path, raw))
+			return boost::shared_ptr<const static_file_entry>();
+	}
+	else
+	{
+		CGZIP2AT<> decompress((LPGZIP)gzip.c_str(), gzip.size());
+		raw.assign(decompress.psz, decompress.Length);
+	}
+
+	if (is_compressible_type(content_type))
+	{
+		if (raw.find("<!--#embed") != std::string::npos)
+		{
+			// include codes are replaced per request
+			entry->dynamic = true;
+			return entry;
+		}
+		if (gzip.empty())
+		{
+			CA2GZIP compress((char*)raw.c_str(), raw.size());
+			if ((compress.Length > 0) && (compress.Length < (int)raw.size()))
+				gzip.assign((char*)compress.pgzip, compress.Length);
+		}
+	}
+
+	entry->etag = "\"" + content_etag(raw) + "\"";
+	entry->raw.reset(new std::string(raw));
+	if (!gzip.empty())
+	{
+		entry->etag_gzip = "\"" + content_etag(raw) + "-gz\"";
+		entry->gzip.reset(new std::string(gzip));
+	}
+	return entry;
+}
+
+// Serve a static file from memory. Returns false when the file is not handled by the cache
+bool request_handler::serve_from_cache(const request &req, reply &rep, modify_info &mInfo, const std::string &request_path, const std::string &extension)
+{
+	std::string file_path = request_path;
+	std::string file_extension = extension;
+	struct stat st_raw, st_gzip;
+	std::string full_path = doc_root_ + file_path;
+	bool bHaveRaw = stat_regular_file(full_path, st_raw);
+	bool bHaveGZip = stat_regular_file(full_path + ".gz", st_gzip);
+	if ((!bHaveRaw) && (!bHaveGZip) && (file_extension.empty()))
+	{
+		//Maybe it is a folder, lets add the index file
+		file_path += "/index.html";
+		file_extension = "html";
+		full_path = doc_root_ + file_path;
+		bHaveRaw = stat_regular_file(full_path, st_raw);
+		bHaveGZip = stat_regular_file(full_path + ".gz", st_gzip);
+	}
+	if ((!bHaveRaw) && (!bHaveGZip))
+		return false;
+
+	time_t mtime = 0;
+	long long size = 0;
+	if (bHaveRaw)
+	{
+		mtime = st_raw.st_mtime;
+		size += st_raw.st_size;
+	}
+	if (bHaveGZip)
+	{
+		mtime = std::max(mtime, (time_t)st_gzip.st_mtime);
+		size += st_gzip.st_size;
+	}
+	if (size > STATIC_CACHE_MAX_FILE_SIZE)
+		return false;
+
+	std::string content_type = mime_types::extension_to_type(file_extension);
+
+	boost::shared_ptr<const static_file_entry> entry;
+	{
+		boost::lock_guard<boost::mutex> l(m_static_cache_mutex);
+		std::map<std::string, boost::shared_ptr<const static_file_entry> >::iterator itt = m_static_cache.find(full_path);
+		if (itt != m_static_cache.end())
+		{
+			if ((itt->second->mtime == mtime) && (itt->second->size == size))
+				entry = itt->second;
+			else
+			{
+				// file changed on disk
+				m_static_cache_size -= (size_t)itt->second->size;
+				m_static_cache.erase(itt);
+			}
+		}
+	}
+	if (!entry)
+	{
+		entry = load_static_file(full_path, content_type, bHaveRaw, bHaveGZip, mtime, size);
+		if (!entry)
+			return false;
+		boost::lock_guard<boost::mutex> l(m_static_cache_mutex);
+		if ((m_static_cache.find(full_path) == m_static_cache.end()) && (m_static_cache_size + size <= STATIC_CACHE_MAX_SIZE))
+		{
+			m_static_cache[full_path] = entry;
+			m_static_cache_size += (size_t)size;
+		}
+	}
+	if (entry->dynamic)
+		return false;
+
+	bool bGZip = false;
+	if (entry->gzip)
+	{
+		const char *encoding_header = request::get_req_header(&req, "Accept-Encoding");
+		bGZip = ((encoding_header != NULL) && (strstr(encoding_header, "gzip") != NULL));
+	}
+	const std::string &etag = (bGZip) ? entry->etag_gzip : entry->etag;
+
+	// conditional requests are answered here, the cWebem handler should not check the modification time again
+	mInfo.mtime_support = false;
+	mInfo.is_modified = true;
+	mInfo.last_written = entry->mtime;
+
+	bool bNotModified = false;
+	const char *if_none_match = request::get_req_header(&req, "If-None-Match");
+	if (if_none_match != NULL)
+	{
+		bNotModified = (strstr(if_none_match, etag.c_str()) != NULL) || (strcmp(if_none_match, "*") == 0);
+	}
+	else
+	{
+		const char *if_modified = request::get_req_header(&req, "If-Modified-Since");
+		if (if_modified != NULL)
+			bNotModified = (convert_from_http_date(if_modified) >= entry->mtime);
+	}
+
+	if (bNotModified)
+	{
+		rep = reply::stock_reply(reply::not_modified);
+	}
+	else
+	{
+		rep.status = reply::ok;
+		rep.bIsGZIP = bGZip;
+		reply::set_shared_content(&rep, (bGZip) ? entry->gzip : entry->raw);
+		reply::add_header(&rep, "Content-Length", boost::lexical_cast<std::string>(rep.shared_content->size()));
+		reply::add_header(&rep, "Content-Type", content_type);
+		reply::add_header(&rep, "Access-Control-Allow-Origin", "*");
+		if (bGZip)
+			reply::add_header(&rep, "Content-Encoding", "gzip");
+	}
+	reply::add_header(&rep, "Last-Modified", convert_to_http_date(entry->mtime));
+	reply::add_header(&rep, "ETag", etag);
+	if (entry->gzip)
+		reply::add_header(&rep, "Vary", "Accept-Encoding");
+	return true;
+}
+
 void request_handler::handle_request(const request& req, reply& rep)
 {
 	modify_info mInfo;
@@ -267,6 +478,10 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 		  fastcgi_parser::handlePHP(myWebem->m_settings, request_path, req, rep, mInfo);
 		  return;
 	  }
+	  else if (serve_from_cache(req, rep, mInfo, request_path, extension))
+	  {
+		  return;
+	  }
 	  else
 	  {
 		  //first try gzip version
@@ -13,7 +13,10 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #ifndef WEBSERVER_DONT_USE_ZIP
 	#include "zip/unzip.h"
 	#define USEWIN32IOAPI
@@ -34,6 +37,17 @@ struct modify_info {
 	time_t last_written;
 };
 
+/// A static file held in memory, the buffers are shared with the replies sending them
+struct static_file_entry {
+	time_t mtime;
+	long long size;
+	bool dynamic; // contains include codes, has to be processed per request
+	boost::shared_ptr<const std::string> raw;
+	boost::shared_ptr<const std::string> gzip; // empty when not worth compressing
+	std::string etag;
+	std::string etag_gzip;
+};
+
 /// The common handler for all incoming requests.
 class request_handler
   : private boost::noncopyable
@@ -63,6 +77,14 @@ protected:
 
 private:
 	bool not_modified(std::string full_path, const request &req, reply &rep, modify_info &mInfo);
+
+	// static file cache (not used for zip archives)
+	bool serve_from_cache(const request &req, reply &rep, modify_info &mInfo, const std::string &request_path, const std::string &extension);
+	boost::shared_ptr<const static_file_entry> load_static_file(const std::string &full_path, const std::string &content_type,
+		const bool bHaveRaw, const bool bHaveGZip, const time_t mtime, const long long size);
+	std::map<std::string, boost::shared_ptr<const static_file_entry> > m_static_cache;
+	size_t m_static_cache_size;
+	boost::mutex m_static_cache_mutex;
 	//zip support
 #ifndef WEBSERVER_DONT_USE_ZIP
 	  zlib_filefunc_def m_ffunc;
@@ -45,6 +45,11 @@ public:
 	 * Remove expired user sessions from store
 	 */
 	virtual void CleanSessions()=0;
+
+	/**
+	 * Write pending session changes to the store
+	 */
+	virtual void FlushSessions() {};
 };
 
 typedef session_store* session_store_impl_ptr;
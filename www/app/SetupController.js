@@ -253,6 +253,33 @@ define(['app'], function (app) {
 				}
 			});
 
+			//Get Notification delivery statistics
+			$.ajax({
+				url: "json.htm?type=command&param=getnotificationstats",
+				async: false,
+				dataType: 'json',
+				success: function (data) {
+					if (typeof data.result != 'undefined') {
+						$("#notificationstatstable tbody").html("");
+						$.each(data.result, function (i, item) {
+							var row = $('<tr />');
+							row.append($('<td />').text(item.Subsystem));
+							row.append($('<td />').text(item.Queued));
+							row.append($('<td />').text(item.Sent));
+							row.append($('<td />').text(item.Failed));
+							row.append($('<td />').text(item.Retried));
+							row.append($('<td />').text(item.Deduplicated));
+							row.append($('<td />').text(item.Dropped));
+							row.append($('<td />').text(item.AvgLatency));
+							row.append($('<td />').text(item.LastSent));
+							row.append($('<td />').text(item.LastFailed));
+							$("#notificationstatstable tbody").append(row);
+						});
+						$("#notificationstats").show();
+					}
+				}
+			});
+
 			//Get Timer Plans
 			$.ajax({
 				url: "json.htm?type=command&param=gettimerplans",
@@ -170,7 +170,7 @@ define(['app'], function (app) {
                     if (cb.checked==true) {
                         $.ajax({
                             url: "json.htm?type=graph&sensor=temp&idx="+cb.id+"&range="+$("#customlog #graphfrom").val()+"T"+$("#customlog #graphto").val()+"&graphtype="+$("#customlog #combocustomgraphtype").val()+
-                            "&graphTemp="+$("#customlog #graphTemp").prop("checked")+"&graphChill="+$("#customlog #graphChill").prop("checked")+"&graphHum="+$("#customlog #graphHum").prop("checked")+"&graphBaro="+$("#customlog #graphBaro").prop("checked")+"&graphDew="+$("#customlog #graphDew").prop("checked")+"&graphSet="+$("#customlog #graphSet").prop("checked"),
+                            "&graphTemp="+$("#customlog #graphTemp").prop("checked")+"&graphChill="+$("#customlog #graphChill").prop("checked")+"&graphHum="+$("#customlog #graphHum").prop("checked")+"&graphBaro="+$("#customlog #graphBaro").prop("checked")+"&graphDew="+$("#customlog #graphDew").prop("checked")+"&graphSet="+$("#customlog #graphSet").prop("checked")+"&maxpoints="+$.CustomChart.highcharts().plotWidth,
                             async: false,
                             dataType: 'json',
                             success: function(data) {
@@ -198,7 +198,7 @@ define(['app'], function (app) {
                         ctrl.RemoveMultipleDataFromTempChart($.CustomChart.highcharts(),$(this).attr('id'));
                         $.ajax({
                             url: "json.htm?type=graph&sensor=temp&idx="+$(this).attr('id')+"&range="+$("#customlog #graphfrom").val()+"T"+$("#customlog #graphto").val()+"&graphtype="+$("#customlog #combocustomgraphtype").val()+
-                            "&graphTemp="+$("#customlog #graphTemp").prop("checked")+"&graphChill="+$("#customlog #graphChill").prop("checked")+"&graphHum="+$("#customlog #graphHum").prop("checked")+"&graphBaro="+$("#customlog #graphBaro").prop("checked")+"&graphDew="+$("#customlog #graphDew").prop("checked")+"&graphSet="+$("#customlog #graphSet").prop("checked"),
+                            "&graphTemp="+$("#customlog #graphTemp").prop("checked")+"&graphChill="+$("#customlog #graphChill").prop("checked")+"&graphHum="+$("#customlog #graphHum").prop("checked")+"&graphBaro="+$("#customlog #graphBaro").prop("checked")+"&graphDew="+$("#customlog #graphDew").prop("checked")+"&graphSet="+$("#customlog #graphSet").prop("checked")+"&maxpoints="+$.CustomChart.highcharts().plotWidth,
                             async: false,
                             dataType: 'json',
                             graphid: $(this).attr('id'),